@@ -65,6 +65,14 @@ bool needs_arena_allocation(const TensorPtr &t) {
 }
 
 class FindAllocatableTensors : public TensorVisitor {
+    const std::vector<int> &op_stage_;
+
+    // When ops run concurrently, a tensor must stay live for the whole of
+    // every stage that uses it, so measure lifetimes in stages instead of ops.
+    int time() const {
+        return op_stage_.empty() ? op_index() : op_stage_[op_index()];
+    }
+
     void visit_tensor(const TensorPtr &t) override {
         if (!needs_arena_allocation(t)) {
             return;
@@ -76,21 +84,25 @@ class FindAllocatableTensors : public TensorVisitor {
         assert(info.size_needed == 0 || info.size_needed == storage->storage_size());
 
         info.size_needed = storage->storage_size();
-        info.first_use = std::min(info.first_use, op_index());
-        info.last_use = std::max(info.last_use, op_index());
+        info.first_use = std::min(info.first_use, time());
+        info.last_use = std::max(info.last_use, time());
         // leave block_index as -1
         info.tensors.insert(t);
     }
 
 public:
+    explicit FindAllocatableTensors(const std::vector<int> &op_stage)
+        : op_stage_(op_stage) {
+    }
+
     // Iteration order matters, so don't use unordered_map without consideration.
     std::map<TensorStoragePtr, TensorAllocationInfo> tensor_info;
 };
 
-std::unique_ptr<char[]> allocate_tensors(const Op *root, const InterpreterOptions &options) {
+std::unique_ptr<char[]> allocate_tensors(const Op *root, const InterpreterOptions &options, const std::vector<int> &op_stage) {
     // Find the tensors that we want to allocate in an arena,
     // along the needed storage size and lifetime for each.
-    FindAllocatableTensors find_tensors;
+    FindAllocatableTensors find_tensors(op_stage);
     root->accept(&find_tensors);
 
     if (options.verbosity >= 1) {
@@ -162,6 +174,73 @@ class VerifyAllAllocated : public TensorVisitor {
     }
 };
 
+// Split the ops of a flattened model into stages, such that each op only
+// depends on ops in earlier stages. Two ops conflict if one of them writes
+// memory that the other reads or writes; tensors that alias each other
+// share memory. The stage of each op is put in op_stage.
+std::vector<std::vector<Op *>> find_stages(OpGroup *root, std::vector<int> &op_stage) {
+    const auto memory_of = [](const TensorPtr &t) -> const void * {
+        // Don't call storage() on tensors that aren't aliased, it
+        // creates storage that dynamic tensors must not have yet.
+        if (t->alias_type() != AliasType::None) {
+            return t->storage().get();
+        }
+        return t.get();
+    };
+
+    // The last stage that read or wrote each piece of memory.
+    std::map<const void *, int> last_read, last_write;
+    const auto stage_after = [](const std::map<const void *, int> &m, const void *key) {
+        auto it = m.find(key);
+        return it != m.end() ? it->second + 1 : 0;
+    };
+
+    std::vector<std::vector<Op *>> stages;
+    op_stage.resize(root->op_count());
+    for (int i = 0; i < root->op_count(); i++) {
+        Op *op = root->op(i);
+        int stage = 0;
+        for (int j = 0; j < op->input_count(); j++) {
+            const TensorPtr &t = op->input(j);
+            if (t && !t->is_constant()) {
+                stage = std::max(stage, stage_after(last_write, memory_of(t)));
+            }
+        }
+        for (int j = 0; j < op->output_count(); j++) {
+            const TensorPtr &t = op->output(j);
+            if (t) {
+                const void *m = memory_of(t);
+                stage = std::max({stage, stage_after(last_write, m), stage_after(last_read, m)});
+            }
+        }
+        for (int j = 0; j < op->input_count(); j++) {
+            const TensorPtr &t = op->input(j);
+            if (t && !t->is_constant()) {
+                int &s = last_read.emplace(memory_of(t), stage).first->second;
+                s = std::max(s, stage);
+            }
+        }
+        for (int j = 0; j < op->output_count(); j++) {
+            const TensorPtr &t = op->output(j);
+            if (t) {
+                last_write[memory_of(t)] = stage;
+            }
+        }
+
+        op_stage[i] = stage;
+        if (stage >= (int)stages.size()) {
+            stages.resize(stage + 1);
+        }
+        stages[stage].push_back(op);
+    }
+    return stages;
+}
+
+int execute_op(void *user_context, int i, uint8_t *closure) {
+    ((Op *const *)closure)[i]->execute();
+    return 0;
+}
+
 #ifndef NDEBUG
 
 class Checker : public OpVisitor {
@@ -275,8 +354,18 @@ bool Interpreter::prepare() {
 #ifndef NDEBUG
     do_check_op_order(model_.get());
 #endif
+    std::vector<int> op_stage;
+    if (options_.concurrent_ops) {
+        // flatten_groups() leaves a single OpGroup at the root.
+        assert(model_->name() == "OpGroup");
+        stages_ = find_stages(static_cast<OpGroup *>(model_.get()), op_stage);
+        if (options_.verbosity >= 1) {
+            HLOG(INFO) << "Running " << op_stage.size() << " ops in " << stages_.size() << " stages";
+        }
+    }
+
     assert(tensor_storage_arena_ == nullptr);
-    tensor_storage_arena_ = allocate_tensors(model_.get(), options_);
+    tensor_storage_arena_ = allocate_tensors(model_.get(), options_, op_stage);
 
 #ifndef NDEBUG
     VerifyAllAllocated verify_all;
@@ -294,7 +383,17 @@ void Interpreter::execute() {
         HLOG(ERROR) << "Must call prepare() before execute()";
         return;
     }
-    model_->execute();
+    if (stages_.empty()) {
+        model_->execute();
+        return;
+    }
+    for (std::vector<Op *> &stage : stages_) {
+        if (stage.size() == 1) {
+            stage[0]->execute();
+        } else {
+            halide_do_par_for(nullptr, execute_op, 0, (int)stage.size(), (uint8_t *)stage.data());
+        }
+    }
 }
 
 TensorPtr Interpreter::get_tensor(const std::string &name) {
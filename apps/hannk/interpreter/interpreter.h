@@ -14,6 +14,12 @@ struct InterpreterOptions {
 
     // Whether to enable tracing.
     bool trace = false;
+
+    // Whether to run ops that don't depend on each other at the same time,
+    // on the Halide thread pool. Tensors may then need to live longer, so
+    // this can need more memory. (The HANNK_PROFILER hooks are only called
+    // when ops run one at a time.)
+    bool concurrent_ops = false;
 };
 
 class Interpreter {
@@ -21,6 +27,9 @@ class Interpreter {
     std::unique_ptr<char[]> tensor_storage_arena_;
     InterpreterOptions options_;
     bool prepared_ = false;
+    // If options_.concurrent_ops is set, the ops of the model, in stages
+    // that must run in order. The ops in a stage can run at the same time.
+    std::vector<std::vector<Op *>> stages_;
 
 public:
     explicit Interpreter(OpPtr m, InterpreterOptions options = InterpreterOptions());
@@ -380,6 +380,7 @@ void ModelRunner::status() {
     if (verbosity > 0) {
         std::cout << "Using random seed: " << seed_tracker_.next_seed() << "\n";
         std::cout << "Using threads: " << threads << "\n";
+        std::cout << "Using concurrent ops: " << concurrent_ops << "\n";
 
 #if HANNK_BUILD_TFLITE
         std::string tf_ver = TfLiteVersion();
@@ -406,6 +407,7 @@ ModelRunner::RunResult ModelRunner::run_in_hannk(const std::vector<char> &buffer
 
     InterpreterOptions options;
     options.verbosity = verbosity;
+    options.concurrent_ops = concurrent_ops;
     Interpreter interpreter(std::move(model), std::move(options));
     if (!interpreter.prepare()) {
         std::cerr << "hannk::Interpreter::prepare() failed\n";
@@ -526,6 +528,10 @@ int ModelRunner::parse_flags(int argc, char **argv, std::vector<std::string> &fi
              this->do_compare_results = std::stoi(value) != 0;
              return 0;
          }},
+        {"concurrent_ops", [this](const std::string &value) {
+             this->concurrent_ops = std::stoi(value) != 0;
+             return 0;
+         }},
         {"csv", [this](const std::string &value) {
              this->csv_output = std::stoi(value) != 0;
              return 0;
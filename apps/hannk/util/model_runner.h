@@ -106,6 +106,7 @@ struct ModelRunner {
     bool do_benchmark = true;
     bool do_compare_results = true;
     bool keep_going = false;
+    bool concurrent_ops = false;
     double tolerance;
     bool csv_output = false;
     int run_count = 0;
@@ -43,11 +43,8 @@ void define_serialization(py::module &m) {
     // Deserialize pipeline functions
     m.def("deserialize_pipeline",  //
           [](const py::bytes &data, const std::map<std::string, Parameter> &user_params) -> Pipeline {
-              // TODO: rework API in serialize_pipeline to take a std::span<> in C++20
-              // https://github.com/halide/Halide/issues/8722
               std::string_view view{data};
-              std::vector<uint8_t> span{view.begin(), view.end()};
-              return deserialize_pipeline(span, user_params);  //
+              return deserialize_pipeline((const uint8_t *)view.data(), view.size(), user_params);  //
           },
           py::arg("data"),                                              //
           py::arg("user_params") = std::map<std::string, Parameter>{},  //
@@ -64,11 +61,8 @@ void define_serialization(py::module &m) {
     // Deserialize parameters functions
     m.def("deserialize_parameters",  //
           [](const py::bytes &data) -> std::map<std::string, Parameter> {
-              // TODO: rework API in serialize_pipeline to take a std::span<> in C++20
-              // https://github.com/halide/Halide/issues/8722
               std::string_view view{data};
-              std::vector<uint8_t> span{view.begin(), view.end()};
-              return deserialize_parameters(span);  //
+              return deserialize_parameters((const uint8_t *)view.data(), view.size());  //
           },
           py::arg("data"),  //
           "Deserialize external parameters from serialized pipeline bytes.");
@@ -75,8 +75,9 @@ public:
     struct Entry {
         Expr expr;
         int use_count = 0;
-        // All consumer Exprs for which this is the last child Expr.
-        map<Expr, int, IRGraphDeepCompare> uses;
+        // All consumer Exprs for which this is the last child Expr. These
+        // maps are only used for lookups, so they can be ordered by hash.
+        map<Expr, int, IRGraphHashCompare> uses;
         Entry(const Expr &e)
             : expr(e) {
         }
@@ -84,7 +85,7 @@ public:
     vector<std::unique_ptr<Entry>> entries;
 
     map<Expr, int, ExprCompare> shallow_numbering, output_numbering;
-    map<Expr, int, IRGraphDeepCompare> leaves;
+    map<Expr, int, IRGraphHashCompare> leaves;
 
     int number = 0;
 
@@ -1,4 +1,9 @@
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <map>
+#include <mutex>
+#include <thread>
 
 #include "Argument.h"
 #include "Callable.h"
@@ -30,7 +35,7 @@ struct CallableContents {
     std::vector<Callable::QuickCallCheckInfo> quick_call_check_info;
 
     // Encoded values for complete runtime type checking, used
-    // only for make_std_function. Lazily created.
+    // only for make_std_function.
     std::vector<Callable::FullCallCheckInfo> full_call_check_info;
 };
 
@@ -65,14 +70,19 @@ Callable::Callable(const std::string &name,
     contents->saved_jit_externs = jit_externs;
 
     contents->quick_call_check_info.reserve(contents->jit_cache.arguments.size());
+    contents->full_call_check_info.reserve(contents->jit_cache.arguments.size());
     for (const Argument &a : contents->jit_cache.arguments) {
         const auto qcci = (a.name == "__user_context") ?
                               Callable::make_ucon_qcci() :
                               (a.is_scalar() ? Callable::make_scalar_qcci(a.type) : Callable::make_buffer_qcci());
         contents->quick_call_check_info.push_back(qcci);
-    }
 
-    // Don't create full_call_check_info yet.
+        // This is cheap, and making it here rather than on the first call
+        // to make_std_function() means that a Callable is never mutated
+        // after it is created, so it can be shared between threads.
+        const auto fcci = a.is_scalar() ? Callable::make_scalar_fcci(a.type) : Callable::make_buffer_fcci(a.type, a.dimensions);
+        contents->full_call_check_info.push_back(fcci);
+    }
 }
 
 const std::vector<Argument> &Callable::arguments() const {
@@ -142,15 +152,6 @@ Callable::FailureFn Callable::check_qcci(size_t argc, const QuickCallCheckInfo *
 Callable::FailureFn Callable::check_fcci(size_t argc, const FullCallCheckInfo *actual_fcci) const {
     user_assert(defined()) << "Cannot call() a default-constructed Callable.";
 
-    // Lazily create full_call_check_info upon the first call to make_std_function().
-    if (contents->full_call_check_info.empty()) {
-        contents->full_call_check_info.reserve(contents->jit_cache.arguments.size());
-        for (const Argument &a : contents->jit_cache.arguments) {
-            const auto fcci = a.is_scalar() ? Callable::make_scalar_fcci(a.type) : Callable::make_buffer_fcci(a.type, a.dimensions);
-            contents->full_call_check_info.push_back(fcci);
-        }
-    }
-
     FailureFn failure_fn = nullptr;
     const size_t required_arg_count = contents->full_call_check_info.size();
     if (argc == required_arg_count) {
@@ -214,4 +215,109 @@ int Callable::call_argv_checked(size_t argc, const void *const *argv, const Quic
     return call_argv_fast(argc, argv);
 }
 
+struct AsyncCallableContents {
+    mutable RefCount ref_count;
+
+    Callable fallback;
+
+    // Written once by the compiling thread, before ready is set, and never
+    // touched again, so callers that see ready can read it without a lock.
+    Callable compiled;
+#ifdef HALIDE_WITH_EXCEPTIONS
+    std::exception_ptr error = nullptr;  // NOLINT - clang-tidy complains this isn't thrown
+#endif
+    std::atomic<bool> ready{false};
+
+    // Only used to wait for compilation to finish.
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    // The compiling thread only holds a raw pointer to these contents, so
+    // they must outlive it.
+    std::thread worker;
+
+    ~AsyncCallableContents() {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // Wait for compilation to finish, and report any error it hit.
+    const Callable &wait() {
+        if (!ready.load(std::memory_order_acquire)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&]() { return ready.load(std::memory_order_acquire); });
+        }
+#ifdef HALIDE_WITH_EXCEPTIONS
+        if (error) {
+            std::rethrow_exception(error);
+        }
+#endif
+        return compiled;
+    }
+};
+
+namespace Internal {
+template<>
+RefCount &ref_count<AsyncCallableContents>(const AsyncCallableContents *p) noexcept {
+    return p->ref_count;
+}
+
+template<>
+void destroy<AsyncCallableContents>(const AsyncCallableContents *p) {
+    delete p;
+}
+}  // namespace Internal
+
+AsyncCallable::AsyncCallable()
+    : contents(nullptr) {
+}
+
+AsyncCallable::AsyncCallable(const Callable &fallback, std::function<Callable()> compile)
+    : contents(new AsyncCallableContents) {
+    contents->fallback = fallback;
+    AsyncCallableContents *c = contents.get();
+    c->worker = std::thread([c, compile = std::move(compile)]() {
+#ifdef HALIDE_WITH_EXCEPTIONS
+        try {
+#endif
+            c->compiled = compile();
+#ifdef HALIDE_WITH_EXCEPTIONS
+        } catch (...) {
+            c->error = std::current_exception();
+        }
+#endif
+        {
+            std::lock_guard<std::mutex> lock(c->mutex);
+            c->ready.store(true, std::memory_order_release);
+        }
+        c->finished.notify_all();
+    });
+}
+
+bool AsyncCallable::defined() const {
+    return contents.defined();
+}
+
+bool AsyncCallable::ready() const {
+    user_assert(defined()) << "Cannot use a default-constructed AsyncCallable.";
+    return contents->ready.load(std::memory_order_acquire);
+}
+
+Callable AsyncCallable::get() const {
+    user_assert(defined()) << "Cannot use a default-constructed AsyncCallable.";
+    return contents->wait();
+}
+
+const Callable &AsyncCallable::current() const {
+    user_assert(defined()) << "Cannot call() a default-constructed AsyncCallable.";
+    // Don't copy any Callables here: their reference counts would be
+    // contended by every thread calling this handle.
+    if (contents->fallback.defined() &&
+        !(contents->ready.load(std::memory_order_acquire) && contents->compiled.defined())) {
+        return contents->fallback;
+    }
+    return contents->wait();
+}
+
 }  // namespace Halide
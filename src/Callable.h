@@ -7,6 +7,7 @@
  */
 
 #include <array>
+#include <functional>
 #include <map>
 
 #include "Buffer.h"
@@ -16,6 +17,7 @@
 namespace Halide {
 
 struct Argument;
+struct AsyncCallableContents;
 struct CallableContents;
 
 namespace PythonBindings {
@@ -405,6 +407,51 @@ public:
     int call_argv_fast(size_t argc, const void *const *argv) const;
 };
 
+/** A handle to a Callable that is being jit-compiled on a background
+ * thread, as returned by Pipeline::compile_to_callable_async(). Until the
+ * compiled code is ready, calls go to the fallback Callable given when the
+ * handle was created (e.g. a version of the pipeline with a cheaper
+ * schedule), or wait for compilation to finish if there is no fallback. Once
+ * it is ready, all subsequent calls go to the compiled code. Like Callable,
+ * it is safe to call an AsyncCallable from several threads at once.
+ *
+ * Destroying the last handle waits for compilation to finish. */
+class AsyncCallable {
+private:
+    friend class Pipeline;
+
+    Internal::IntrusivePtr<AsyncCallableContents> contents;
+
+    AsyncCallable(const Callable &fallback, std::function<Callable()> compile);
+
+public:
+    /** Construct a default AsyncCallable. This is not usable (trying to call it will fail).
+     * The defined() method will return false. */
+    AsyncCallable();
+
+    /** Return true if the AsyncCallable is well-defined and usable, false if it is a default-constructed empty AsyncCallable. */
+    bool defined() const;
+
+    /** Return true if compilation has finished, successfully or not. Never blocks. */
+    bool ready() const;
+
+    /** Wait for compilation to finish, and return the compiled Callable. If
+     * compilation failed, the error is reported here. */
+    Callable get() const;
+
+    /** Return the Callable that calls are currently forwarded to: the
+     * compiled one if it is ready, otherwise the fallback. If there is no
+     * fallback, waits for compilation to finish. If compilation failed,
+     * calls keep going to the fallback. */
+    const Callable &current() const;
+
+    template<typename... Args>
+    HALIDE_FUNCTION_ATTRS int
+    operator()(Args &&...args) const {
+        return current()(std::forward<Args>(args)...);
+    }
+};
+
 }  // namespace Halide
 
 #endif
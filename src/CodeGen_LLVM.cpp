@@ -1278,6 +1278,7 @@ void CodeGen_LLVM::optimize_module() {
         auto time_end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> diff = time_end - time_start;
         logger->record_compilation_time(CompilerLogger::Phase::LLVM, diff.count());
+        logger->record_compilation_time(CompilerLogger::Phase::LLVMOptimization, diff.count());
     }
 }
 
@@ -17,7 +17,10 @@ namespace {
 // TODO: for now we are just going to ignore potential issues with
 // static-initialization-order-fiasco, as CompilerLogger isn't currently used
 // from any static-initialization execution scope.
-std::unique_ptr<CompilerLogger> active_compiler_logger;
+//
+// Each thread has its own, so that compile_multitarget can log each target
+// it compiles concurrently to a separate logger.
+thread_local std::unique_ptr<CompilerLogger> active_compiler_logger;
 
 class ObfuscateNames : public IRMutator {
     using IRMutator::visit;
@@ -116,6 +119,15 @@ void JSONCompilerLogger::record_compilation_time(Phase phase, double duration) {
     compilation_time[phase] += duration;
 }
 
+void JSONCompilerLogger::record_lowering_pass(const std::string &pass_name, const LoweringPassStats &stats) {
+    lowering_passes.emplace_back(pass_name, stats);
+}
+
+void JSONCompilerLogger::record_simplify_cache_stats(uint64_t hits, uint64_t misses) {
+    simplify_cache_hits += hits;
+    simplify_cache_misses += misses;
+}
+
 void JSONCompilerLogger::obfuscate() {
     {
         std::map<std::string, std::vector<Expr>> n;
@@ -277,6 +289,45 @@ std::ostream &JSONCompilerLogger::emit_to_stream(std::ostream &o) {
     if (compilation_time.count(Phase::LLVM)) {
         emit_key_value(o, indent, "compilation_time_llvm", compilation_time[Phase::LLVM]);
     }
+    if (compilation_time.count(Phase::LLVMOptimization)) {
+        emit_key_value(o, indent, "compilation_time_llvm_optimization", compilation_time[Phase::LLVMOptimization]);
+    }
+    if (compilation_time.count(Phase::LLVMCodeGen)) {
+        emit_key_value(o, indent, "compilation_time_llvm_codegen", compilation_time[Phase::LLVMCodeGen]);
+    }
+
+    if (!lowering_passes.empty()) {
+        uint64_t peak_ir_nodes = 0, peak_ir_bytes = 0;
+        for (const auto &it : lowering_passes) {
+            peak_ir_nodes = std::max(peak_ir_nodes, it.second.ir_nodes);
+            peak_ir_bytes = std::max(peak_ir_bytes, it.second.ir_bytes);
+        }
+        emit_key_value(o, indent, "peak_ir_nodes", peak_ir_nodes);
+        emit_key_value(o, indent, "peak_ir_bytes", peak_ir_bytes);
+
+        emit_key(o, indent, "lowering_passes");
+        emit_eol(o, false);
+        std::string spaces(indent, ' ');
+        o << spaces << "[\n";
+        int commas_to_emit = (int)lowering_passes.size() - 1;
+        for (const auto &it : lowering_passes) {
+            o << spaces << " {\n";
+            emit_key_value(o, indent + 2, "name", it.first);
+            emit_key_value(o, indent + 2, "time", it.second.duration);
+            emit_key_value(o, indent + 2, "ir_nodes", it.second.ir_nodes);
+            emit_key_value(o, indent + 2, "stmts", it.second.stmts);
+            emit_key_value(o, indent + 2, "ir_bytes", it.second.ir_bytes, false);
+            o << spaces << " }";
+            emit_eol(o, commas_to_emit-- > 0);
+        }
+        o << spaces << "]";
+        emit_eol(o);
+    }
+
+    if (simplify_cache_hits || simplify_cache_misses) {
+        emit_key_value(o, indent, "simplify_cache_hits", simplify_cache_hits);
+        emit_key_value(o, indent, "simplify_cache_misses", simplify_cache_misses);
+    }
 
     if (!matched_simplifier_rules.empty()) {
         emit_object_key_open(o, indent, "matched_simplifier_rules");
@@ -15,6 +15,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "Expr.h"
 #include "Target.h"
@@ -28,6 +29,22 @@ public:
     enum class Phase {
         HalideLowering,
         LLVM,
+        // The parts of the LLVM phase spent in the optimization passes and
+        // in the code generator respectively.
+        LLVMOptimization,
+        LLVMCodeGen,
+    };
+
+    /** The cost of a single lowering pass, and the size of the IR it produced. */
+    struct LoweringPassStats {
+        // The time taken by the pass, in seconds.
+        double duration = 0;
+        // The number of distinct IR nodes in the Stmt after the pass, and
+        // how many of those are Stmts rather than Exprs.
+        uint64_t ir_nodes = 0;
+        uint64_t stmts = 0;
+        // The number of bytes taken up by those IR nodes.
+        uint64_t ir_bytes = 0;
     };
 
     CompilerLogger() = default;
@@ -53,19 +70,33 @@ public:
      */
     virtual void record_compilation_time(Phase phase, double duration) = 0;
 
+    /** Record the cost of a lowering pass. Passes are recorded in the order
+     * they run, and a pass may appear more than once. The default
+     * implementation ignores them.
+     */
+    virtual void record_lowering_pass(const std::string &pass_name, const LoweringPassStats &stats) {
+    }
+
+    /** Record how many of the Exprs simplified during lowering were found in
+     * the simplifier's cache, and how many weren't. The default
+     * implementation ignores them.
+     */
+    virtual void record_simplify_cache_stats(uint64_t hits, uint64_t misses) {
+    }
+
     /**
      * Emit all the gathered data to the given stream. This may be called multiple times.
      */
     virtual std::ostream &emit_to_stream(std::ostream &o) = 0;
 };
 
-/** Set the active CompilerLogger object, replacing any existing one.
+/** Set the active CompilerLogger object for the calling thread, replacing any existing one.
  * It is legal to pass in a nullptr (which means "don't do any compiler logging").
  * Returns the previous CompilerLogger (if any). */
 std::unique_ptr<CompilerLogger> set_compiler_logger(std::unique_ptr<CompilerLogger> compiler_logger);
 
-/** Return the currently active CompilerLogger object. If set_compiler_logger()
- * has never been called, a nullptr implementation will be returned.
+/** Return the currently active CompilerLogger object for the calling thread. If
+ * set_compiler_logger() has never been called on it, a nullptr implementation will be returned.
  * Do not save the pointer returned! It is intended to be used for immediate
  * calls only. */
 CompilerLogger *get_compiler_logger();
@@ -90,6 +121,8 @@ public:
     void record_failed_to_prove(Expr failed_to_prove, Expr original_expr) override;
     void record_object_code_size(uint64_t bytes) override;
     void record_compilation_time(Phase phase, double duration) override;
+    void record_lowering_pass(const std::string &pass_name, const LoweringPassStats &stats) override;
+    void record_simplify_cache_stats(uint64_t hits, uint64_t misses) override;
 
     std::ostream &emit_to_stream(std::ostream &o) override;
 
@@ -116,6 +149,12 @@ protected:
     // Map of the time take for each phase of compilation.
     std::map<Phase, double> compilation_time;
 
+    // The lowering passes, in the order they ran.
+    std::vector<std::pair<std::string, LoweringPassStats>> lowering_passes;
+
+    // The number of Exprs the simplifier found and didn't find in its cache.
+    uint64_t simplify_cache_hits{0}, simplify_cache_misses{0};
+
     void obfuscate();
     void emit();
 };
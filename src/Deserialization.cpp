@@ -6,12 +6,15 @@
 #include "Func.h"
 #include "Function.h"
 #include "IR.h"
+#include "IREquality.h"
 #include "Schedule.h"
+#include "Util.h"
 #include "halide_ir.fbs.h"
 
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -36,6 +39,9 @@ public:
     // Deserialize a pipeline from the given buffer of bytes
     Pipeline deserialize(const std::vector<uint8_t> &data);
 
+    // Deserialize a pipeline from the given bytes, without copying them
+    Pipeline deserialize(const uint8_t *data, size_t size);
+
     // Deserialize just the unbound external parameters that need to be defined for the pipeline from the given filename
     // (so they can be remapped and overridden with user parameters prior to deserializing the pipeline)
     std::map<std::string, Parameter> deserialize_parameters(const std::string &filename);
@@ -46,6 +52,9 @@ public:
     // Deserialize just the unbound external parameters that need to be defined for the pipeline from the given buffer of bytes
     std::map<std::string, Parameter> deserialize_parameters(const std::vector<uint8_t> &data);
 
+    // Deserialize just the unbound external parameters that need to be defined for the pipeline from the given bytes
+    std::map<std::string, Parameter> deserialize_parameters(const uint8_t *data, size_t size);
+
 private:
     // Helper function to deserialize a homogenous vector from a flatbuffer vector,
     // does not apply to union types like Stmt and Expr or enum types like MemoryType
@@ -78,6 +87,14 @@ private:
     // Default external parameters that were created during deserialization
     std::map<std::string, Parameter> external_params;
 
+    // Every Expr deserialized so far, used to share a single copy of Exprs
+    // that appear many times in the pipeline (variables, constants, calls
+    // to a Func at the same site, ...) instead of making a new copy for
+    // each appearance. Parameters, Buffers, and Functions are already
+    // looked up by name, so Exprs that are equal here refer to the same
+    // objects.
+    std::set<Expr, IRGraphHashCompare> exprs_in_pipeline;
+
     MemoryType deserialize_memory_type(Serialize::MemoryType memory_type);
 
     ForType deserialize_for_type(Serialize::ForType for_type);
@@ -114,6 +131,8 @@ private:
 
     Expr deserialize_expr(Serialize::Expr type_code, const void *expr);
 
+    Expr deserialize_expr_node(Serialize::Expr type_code, const void *expr);
+
     std::vector<Expr> deserialize_expr_vector(const flatbuffers::Vector<Serialize::Expr> *exprs_types, const flatbuffers::Vector<flatbuffers::Offset<void>> *exprs_serialized);
 
     Range deserialize_range(const Serialize::Range *range);
@@ -670,6 +689,17 @@ Stmt Deserializer::deserialize_stmt(Serialize::Stmt type_code, const void *stmt)
 }
 
 Expr Deserializer::deserialize_expr(Serialize::Expr type_code, const void *expr) {
+    // The children of the node have already been shared, so comparing a
+    // new node against the ones we have seen doesn't have to look further
+    // than its children.
+    Expr e = deserialize_expr_node(type_code, expr);
+    if (!e.defined()) {
+        return e;
+    }
+    return *exprs_in_pipeline.insert(e).first;
+}
+
+Expr Deserializer::deserialize_expr_node(Serialize::Expr type_code, const void *expr) {
     user_assert(expr != nullptr);
     switch (type_code) {
     case Serialize::Expr::IntImm: {
@@ -1375,18 +1405,13 @@ void Deserializer::build_reverse_function_mappings(const std::vector<Function> &
 }
 
 Pipeline Deserializer::deserialize(const std::string &filename) {
-    std::ifstream in(filename, std::ios::binary | std::ios::in);
-    if (!in) {
+    // Map the file rather than reading it, so that it isn't copied.
+    MappedFile file(filename);
+    if (!file.is_open()) {
         user_error << "failed to open file " << filename << "\n";
         return Pipeline();
     }
-    Pipeline result = deserialize(in);
-    if (!in.good()) {
-        user_error << "failed to deserialize from file " << filename << " properly\n";
-        return Pipeline();
-    }
-    in.close();
-    return result;
+    return deserialize(file.data(), file.size());
 }
 
 Pipeline Deserializer::deserialize(std::istream &in) {
@@ -1403,7 +1428,15 @@ Pipeline Deserializer::deserialize(std::istream &in) {
 }
 
 Pipeline Deserializer::deserialize(const std::vector<uint8_t> &data) {
-    const auto *pipeline_obj = Serialize::GetPipeline(data.data());
+    return deserialize(data.data(), data.size());
+}
+
+Pipeline Deserializer::deserialize(const uint8_t *data, size_t size) {
+    if (size == 0) {
+        user_warning << "deserialized pipeline is empty\n";
+        return Pipeline();
+    }
+    const auto *pipeline_obj = Serialize::GetPipeline(data);
     if (pipeline_obj == nullptr) {
         user_warning << "deserialized pipeline is empty\n";
         return Pipeline();
@@ -1498,18 +1531,12 @@ Pipeline Deserializer::deserialize(const std::vector<uint8_t> &data) {
 
 std::map<std::string, Parameter> Deserializer::deserialize_parameters(const std::string &filename) {
     std::map<std::string, Parameter> empty;
-    std::ifstream in(filename, std::ios::binary | std::ios::in);
-    if (!in) {
+    MappedFile file(filename);
+    if (!file.is_open()) {
         user_error << "failed to open file " << filename << "\n";
         return empty;
     }
-    std::map<std::string, Parameter> params = deserialize_parameters(in);
-    if (!in.good()) {
-        user_error << "failed to deserialize from file " << filename << " properly\n";
-        return empty;
-    }
-    in.close();
-    return params;
+    return deserialize_parameters(file.data(), file.size());
 }
 
 std::map<std::string, Parameter> Deserializer::deserialize_parameters(std::istream &in) {
@@ -1527,8 +1554,16 @@ std::map<std::string, Parameter> Deserializer::deserialize_parameters(std::istre
 }
 
 std::map<std::string, Parameter> Deserializer::deserialize_parameters(const std::vector<uint8_t> &data) {
+    return deserialize_parameters(data.data(), data.size());
+}
+
+std::map<std::string, Parameter> Deserializer::deserialize_parameters(const uint8_t *data, size_t size) {
     std::map<std::string, Parameter> external_parameters_by_name;
-    const auto *pipeline_obj = Serialize::GetPipeline(data.data());
+    if (size == 0) {
+        user_warning << "deserialized pipeline is empty\n";
+        return external_parameters_by_name;
+    }
+    const auto *pipeline_obj = Serialize::GetPipeline(data);
     if (pipeline_obj == nullptr) {
         user_warning << "deserialized pipeline is empty\n";
         return external_parameters_by_name;
@@ -1561,6 +1596,11 @@ Pipeline deserialize_pipeline(const std::vector<uint8_t> &buffer, const std::map
     return deserializer.deserialize(buffer);
 }
 
+Pipeline deserialize_pipeline(const uint8_t *data, size_t size, const std::map<std::string, Parameter> &user_params) {
+    Internal::Deserializer deserializer(user_params);
+    return deserializer.deserialize(data, size);
+}
+
 std::map<std::string, Parameter> deserialize_parameters(const std::string &filename) {
     Internal::Deserializer deserializer;
     return deserializer.deserialize_parameters(filename);
@@ -1576,6 +1616,11 @@ std::map<std::string, Parameter> deserialize_parameters(const std::vector<uint8_
     return deserializer.deserialize_parameters(buffer);
 }
 
+std::map<std::string, Parameter> deserialize_parameters(const uint8_t *data, size_t size) {
+    Internal::Deserializer deserializer;
+    return deserializer.deserialize_parameters(data, size);
+}
+
 }  // namespace Halide
 
 #else  // WITH_SERIALIZATION
@@ -1597,6 +1642,11 @@ Pipeline deserialize_pipeline(const std::vector<uint8_t> &buffer, const std::map
     return Pipeline();
 }
 
+Pipeline deserialize_pipeline(const uint8_t *data, size_t size, const std::map<std::string, Parameter> &user_params) {
+    user_error << "Deserialization is not supported in this build of Halide; try rebuilding with WITH_SERIALIZATION=ON.";
+    return Pipeline();
+}
+
 std::map<std::string, Parameter> deserialize_parameters(const std::string &filename) {
     user_error << "Deserialization is not supported in this build of Halide; try rebuilding with WITH_SERIALIZATION=ON.";
     return {};
@@ -1612,6 +1662,11 @@ std::map<std::string, Parameter> deserialize_parameters(const std::vector<uint8_
     return {};
 }
 
+std::map<std::string, Parameter> deserialize_parameters(const uint8_t *data, size_t size) {
+    user_error << "Deserialization is not supported in this build of Halide; try rebuilding with WITH_SERIALIZATION=ON.";
+    return {};
+}
+
 }  // namespace Halide
 
 #endif  // WITH_SERIALIZATION
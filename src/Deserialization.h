@@ -7,7 +7,7 @@
 
 namespace Halide {
 
-/// @brief Deserialize a Halide pipeline from a file.
+/// @brief Deserialize a Halide pipeline from a file. The file is memory mapped rather than read, where that's supported.
 /// @param filename The location of the file to deserialize.  Must use .hlpipe extension.
 /// @param user_params Map of named input/output parameters to bind with the resulting pipeline (used to avoid deserializing specific objects and enable the use of externally defined ones instead).
 /// @return Returns a newly constructed deserialized Pipeline object/
@@ -25,6 +25,14 @@ Pipeline deserialize_pipeline(std::istream &in, const std::map<std::string, Para
 /// @return Returns a newly constructed deserialized Pipeline object/
 Pipeline deserialize_pipeline(const std::vector<uint8_t> &data, const std::map<std::string, Parameter> &user_params);
 
+/// @brief Deserialize a Halide pipeline from bytes containing a serialized pipeline in binary format, without copying them
+///        (e.g. from a file the caller has memory mapped). The bytes are only read during the call.
+/// @param data Pointer to the serialized Halide pipeline
+/// @param size Size of the serialized Halide pipeline in bytes
+/// @param user_params Map of named input/output parameters to bind with the resulting pipeline (used to avoid deserializing specific objects and enable the use of externally defined ones instead).
+/// @return Returns a newly constructed deserialized Pipeline object/
+Pipeline deserialize_pipeline(const uint8_t *data, size_t size, const std::map<std::string, Parameter> &user_params);
+
 /// @brief Deserialize the external parameters for the Halide pipeline from a file.
 ///        This method allows a minimal deserialization of just the external pipeline parameters, so they can be
 ///        remapped and overridden with user parameters prior to deserializing the pipeline definition.
@@ -47,6 +55,13 @@ std::map<std::string, Parameter> deserialize_parameters(std::istream &in);
 /// @return Returns a map containing the names and description of external parameters referenced in the pipeline
 std::map<std::string, Parameter> deserialize_parameters(const std::vector<uint8_t> &data);
 
+/// @brief Deserialize the external parameters for the Halide pipeline from bytes containing a serialized pipeline in
+///        binary format, without copying them.  The bytes are only read during the call.
+/// @param data Pointer to the serialized Halide pipeline
+/// @param size Size of the serialized Halide pipeline in bytes
+/// @return Returns a map containing the names and description of external parameters referenced in the pipeline
+std::map<std::string, Parameter> deserialize_parameters(const uint8_t *data, size_t size);
+
 }  // namespace Halide
 
 #endif
@@ -1,4 +1,5 @@
 #include "Expr.h"
+#include "IREquality.h"
 #include "IROperator.h"  // for lossless_cast()
 
 namespace Halide {
@@ -21,6 +22,7 @@ const IntImm *IntImm::make(Type t, int64_t value) {
     IntImm *node = new IntImm;
     node->type = t;
     node->value = value;
+    cache_structural_hash(node);
     return node;
 }
 
@@ -37,6 +39,7 @@ const UIntImm *UIntImm::make(Type t, uint64_t value) {
     UIntImm *node = new UIntImm;
     node->type = t;
     node->value = value;
+    cache_structural_hash(node);
     return node;
 }
 
@@ -63,6 +66,7 @@ const FloatImm *FloatImm::make(Type t, double value) {
         internal_error << "FloatImm must be 16, 32, or 64-bit\n";
     }
 
+    cache_structural_hash(node);
     return node;
 }
 
@@ -70,6 +74,7 @@ const StringImm *StringImm::make(const std::string &val) {
     StringImm *node = new StringImm;
     node->type = type_of<const char *>();
     node->value = val;
+    cache_structural_hash(node);
     return node;
 }
 
@@ -90,9 +90,17 @@ struct IRNode {
     virtual void accept(IRVisitor *v) const = 0;
     IRNode(IRNodeType t)
         : node_type(t) {
+        in_ir_arena = claim_ir_arena_allocation(this);
     }
     virtual ~IRNode() = default;
 
+    /** IR nodes are allocated from the calling thread's IR arena, if it
+     * has one (see IRArena.h), and from the heap otherwise. */
+    // @{
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr);
+    // @}
+
     /** These classes are all managed with intrusive reference
      * counting, so we also track a reference count. It's mutable
      * so that we can do reference counting even through const
@@ -111,8 +119,20 @@ struct IRNode {
      * anyway, so this doesn't increase the memory footprint of an IR node.
      */
     IRNodeType node_type;
+
+    /** Whether this node's memory belongs to an IR arena, in which case it
+     * must be freed with destroy_ir_arena_node. This fits in the padding
+     * after the node type. */
+    bool in_ir_arena = false;
+
+private:
+    static bool claim_ir_arena_allocation(IRNode *node);
 };
 
+/** Destroy an IR node allocated from an IR arena, and give back its
+ * memory. */
+void destroy_ir_arena_node(const IRNode *t);
+
 template<>
 inline RefCount &ref_count<IRNode>(const IRNode *t) noexcept {
     return t->ref_count;
@@ -120,7 +140,11 @@ inline RefCount &ref_count<IRNode>(const IRNode *t) noexcept {
 
 template<>
 inline void destroy<IRNode>(const IRNode *t) {
-    delete t;
+    if (t->in_ir_arena) {
+        destroy_ir_arena_node(t);
+    } else {
+        delete t;
+    }
 }
 
 /** IR nodes are split into expressions and statements. These are
@@ -146,6 +170,12 @@ struct BaseExprNode : public IRNode {
     }
     virtual Expr mutate_expr(IRMutator *v) const = 0;
     Type type;
+
+    /** A hash of the structure of this Expr, computed from those of its
+     * children when it is made, so that Exprs can be told apart without
+     * walking them. Structurally equal Exprs have equal hashes, unless one of
+     * them is zero, which means the hash is unknown. See IREquality.h. */
+    uint32_t structural_hash = 0;
 };
 
 /** We use the "curiously recurring template pattern" to avoid
@@ -3621,4 +3621,8 @@ Callable Func::compile_to_callable(const std::vector<Argument> &args, const Targ
     return pipeline().compile_to_callable(args, target);
 }
 
+AsyncCallable Func::compile_to_callable_async(const std::vector<Argument> &args, const Callable &fallback, const Target &target) {
+    return pipeline().compile_to_callable_async(args, fallback, target);
+}
+
 }  // namespace Halide
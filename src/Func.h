@@ -1054,6 +1054,13 @@ public:
     Callable compile_to_callable(const std::vector<Argument> &args,
                                  const Target &target = get_jit_target_from_environment());
 
+    /** Start jit compiling the function on a background thread, and return
+     * a handle that calls the fallback until the compiled code is ready. See
+     * Pipeline::compile_to_callable_async(). */
+    AsyncCallable compile_to_callable_async(const std::vector<Argument> &args,
+                                            const Callable &fallback,
+                                            const Target &target = get_jit_target_from_environment());
+
     /** Add a custom pass to be used during lowering. It is run after
      * all other lowering passes. Can be used to verify properties of
      * the lowered Stmt, instrument it with extra code, or otherwise
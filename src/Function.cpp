@@ -307,6 +307,17 @@ public:
 // Note that this will be reset by Internal::reset_random_counters().
 std::atomic<int> random_variable_counter = 0;
 
+namespace {
+
+int next_random_variable_tag() {
+    if (NameCounters *counters = get_scoped_name_counters()) {
+        return counters->random_variable_counter++;
+    }
+    return random_variable_counter++;
+}
+
+}  // namespace
+
 Function::Function(const FunctionPtr &ptr)
     : contents(ptr) {
     contents.strengthen();
@@ -594,7 +605,7 @@ void Function::define(const vector<string> &args, vector<Expr> values) {
     }
 
     // Tag calls to random() with the free vars
-    int tag = random_variable_counter++;
+    int tag = next_random_variable_tag();
     vector<VarOrRVar> free_vars;
     free_vars.reserve(args.size());
     for (const auto &arg : args) {
@@ -821,7 +832,7 @@ void Function::define_update(const vector<Expr> &_args, vector<Expr> values, con
             free_vars.emplace_back(RVar(check.reduction_domain, i));
         }
     }
-    int tag = random_variable_counter++;
+    int tag = next_random_variable_tag();
     for (auto &arg : args) {
         arg = lower_random(arg, free_vars, tag);
     }
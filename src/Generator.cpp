@@ -1,14 +1,18 @@
 #include <atomic>
 #include <cmath>
 #include <condition_variable>
+#include <filesystem>
 #include <fstream>
 #include <memory>
+#include <random>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 
 #include "CompilerLogger.h"
 #include "Generator.h"
 #include "IRPrinter.h"
+#include "LLVM_Output.h"
 #include "Module.h"
 #include "Serialization.h"
 #include "Simplify.h"
@@ -653,10 +657,18 @@ int generate_filter_main_inner(int argc,
 gengen
   [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME]
   [-d 1|0] [-e EMIT_OPTIONS] [-n FILE_BASE_NAME] [-p PLUGIN_NAME]
-  [-s AUTOSCHEDULER_NAME] [-t TIMEOUT]
+  [-s AUTOSCHEDULER_NAME] [-t TIMEOUT] [-j THREADS] [-c CACHE_DIR]
   target=target-string[,target-string...]
   [generator_param=value [...]]
 
+ -c  A directory in which to cache outputs, keyed by a hash of the serialized
+     pipeline for each target and of everything else the outputs depend on.
+     If the directory already holds outputs for the same key, they are copied
+     rather than compiled again. Nothing is cached when an autoscheduler is
+     used or a compiler_log is emitted. Defaults to the value of the
+     HL_GENERATOR_CACHE_DIR environment variable; if neither is set, nothing
+     is cached.
+
  -d  Build a module that is suitable for using for gradient descent calculation
      in TensorFlow or PyTorch. See Generator::build_gradient_module()
      documentation.
@@ -681,6 +693,13 @@ gengen
      find one. Flags across all of the targets that do not affect runtime code
      generation, such as `no_asserts` and `no_runtime`, are ignored.
 
+ -j  The number of targets of a multitarget build to compile at the same time.
+     Specify 0 to use one thread per target, up to the number of cores, unless
+     an autoscheduler is used, in which case targets are compiled one at a
+     time. With more than one thread, the Generator's generate() method runs
+     on several threads at once, so only use this if it is safe to do so. The
+     output does not depend on this value. Defaults to 1.
+
  -t  Timeout for the Generator to run, in seconds; mainly useful to ensure that
      bugs and/or degenerate cases don't stall build systems. Specify 0 to allow
      infinite time. Defaults to infinite.
@@ -689,10 +708,12 @@ gengen
 )INLINE_CODE";
 
     std::map<std::string, std::string> flags_info = {
+        {"-c", get_env_variable("HL_GENERATOR_CACHE_DIR")},
         {"-d", "0"},
         {"-e", ""},
         {"-f", ""},
         {"-g", ""},
+        {"-j", "1"},
         {"-n", ""},
         {"-o", ""},
         {"-p", ""},
@@ -748,6 +769,12 @@ gengen
     user_assert(v_val == "1" || v_val == "0") << "-v must be 0 or 1\n"
                                               << kUsage;
 
+    const auto &j_str = flags_info["-j"];
+    char *j_end = nullptr;
+    const long j_val = strtol(j_str.c_str(), &j_end, 10);
+    user_assert(!j_str.empty() && *j_end == '\0' && j_val >= 0 && j_val <= 1024) << "-j must be an integer between 0 and 1024\n"
+                                                                                 << kUsage;
+
     const std::vector<std::string> generator_names = generator_factory_provider.enumerate();
 
     const auto create_generator = [&](const std::string &generator_name, const Halide::GeneratorContext &context) -> AbstractGeneratorPtr {
@@ -862,6 +889,15 @@ gengen
     // args.generator_params is already set
     // If true, log the path of all output files to stdout.
     args.log_outputs = (v_val == "1");
+    args.cache_dir = flags_info["-c"];
+    if (j_val > 0) {
+        args.num_threads = (int)j_val;
+    } else if (args.generator_params.count("autoscheduler")) {
+        // Autoschedulers are plugins, and aren't required to be reentrant.
+        args.num_threads = 1;
+    } else {
+        args.num_threads = std::max(1, std::min((int)args.targets.size(), (int)std::thread::hardware_concurrency()));
+    }
 
     // Allow quick-n-dirty use of compiler logging via HL_DEBUG_COMPILER_LOGGER env var
     const bool do_compiler_logging = args.output_types.count(OutputFileType::compiler_log) ||
@@ -987,6 +1023,201 @@ int generate_filter_main(int argc, char **argv) {
     return generate_filter_main(argc, argv, GeneratorsFromRegistry());
 }
 
+namespace {
+
+using OutputFiles = std::map<OutputFileType, std::string>;
+
+// Wraps an AbstractGenerator so that build_pipeline() can be called more
+// than once: the first call runs generate() and schedule(), and later calls
+// return the same Pipeline. The build cache uses this to compile, on a miss,
+// the very Pipelines it built to compute the key.
+class BuildOnceGenerator : public AbstractGenerator {
+    AbstractGeneratorPtr gen;
+    Pipeline pipeline;
+
+public:
+    explicit BuildOnceGenerator(AbstractGeneratorPtr gen)
+        : gen(std::move(gen)) {
+    }
+
+    std::string name() override {
+        return gen->name();
+    }
+    GeneratorContext context() const override {
+        return gen->context();
+    }
+    std::vector<ArgInfo> arginfos() override {
+        return gen->arginfos();
+    }
+    void set_generatorparam_value(const std::string &name, const std::string &value) override {
+        gen->set_generatorparam_value(name, value);
+    }
+    void set_generatorparam_value(const std::string &name, const LoopLevel &loop_level) override {
+        gen->set_generatorparam_value(name, loop_level);
+    }
+    Pipeline build_pipeline() override {
+        if (!pipeline.defined()) {
+            pipeline = gen->build_pipeline();
+        }
+        return pipeline;
+    }
+    std::vector<Parameter> input_parameter(const std::string &name) override {
+        return gen->input_parameter(name);
+    }
+    std::vector<Func> output_func(const std::string &name) override {
+        return gen->output_func(name);
+    }
+    void bind_input(const std::string &name, const std::vector<Parameter> &v) override {
+        gen->bind_input(name, v);
+    }
+    void bind_input(const std::string &name, const std::vector<Func> &v) override {
+        gen->bind_input(name, v);
+    }
+    void bind_input(const std::string &name, const std::vector<Expr> &v) override {
+        gen->bind_input(name, v);
+    }
+    bool emit_cpp_stub(const std::string &stub_file_path) override {
+        return gen->emit_cpp_stub(stub_file_path);
+    }
+    bool emit_hlpipe(const std::string &hlpipe_file_path) override {
+        return gen->emit_hlpipe(hlpipe_file_path);
+    }
+    bool allow_out_of_order_inputs_and_outputs() const override {
+        return gen->allow_out_of_order_inputs_and_outputs();
+    }
+};
+
+// Compute the key for the outputs of a Generator in a build cache: a hash of
+// its serialized pipeline for each target, and of everything else that goes
+// into the outputs. Returns an empty string if the outputs can't be cached.
+std::string generator_cache_key(const ExecuteGeneratorArgs &args,
+                                const OutputFiles &output_files,
+                                const std::function<AbstractGenerator &(const Target &)> &generator_for) {
+#ifdef WITH_SERIALIZATION
+    if (args.generator_params.count("autoscheduler")) {
+        // The schedule would come from a plugin we know nothing about.
+        return "";
+    }
+    if (output_files.count(OutputFileType::compiler_log)) {
+        // The log describes the compilation itself.
+        return "";
+    }
+
+    std::ostringstream key;
+    key << "Halide " << HALIDE_VERSION_MAJOR << "." << HALIDE_VERSION_MINOR << "." << HALIDE_VERSION_PATCH
+        << " LLVM " << get_llvm_version() << " " << get_env_variable("HL_LLVM_ARGS") << "\n"
+        << "generator " << args.generator_name << "\n"
+        << "function " << args.function_name << "\n"
+        << "build_mode " << (int)args.build_mode << "\n";
+    for (const auto &[type, path] : output_files) {
+        key << "output " << (int)type << " " << std::filesystem::path(path).filename().string() << "\n";
+    }
+    for (const auto &[name, value] : args.generator_params) {
+        key << "param " << name << "=" << value << "\n";
+    }
+    for (size_t i = 0; i < args.targets.size(); i++) {
+        key << "target " << args.targets[i] << " " << (i < args.suffixes.size() ? args.suffixes[i] : "") << "\n";
+        AbstractGenerator &gen = generator_for(args.targets[i]);
+        // Inputs become arguments of the compiled pipeline even if the
+        // pipeline doesn't use them, so they aren't necessarily serialized.
+        for (const auto &a : gen.arginfos()) {
+            key << "arg " << a.name << " " << (int)a.dir << " " << (int)a.kind << " " << a.dimensions;
+            for (const Type &t : a.types) {
+                key << " " << t;
+            }
+            key << "\n";
+        }
+        std::vector<uint8_t> pipeline;
+        serialize_pipeline(gen.build_pipeline(), pipeline);
+        key << "pipeline " << pipeline.size() << "\n";
+        key.write((const char *)pipeline.data(), pipeline.size());
+        key << "\n";
+    }
+    return sha256_hex(key.str());
+#else
+    return "";
+#endif
+}
+
+// Copy all the files in one directory to another. Returns false on failure.
+bool copy_files(const std::filesystem::path &from, const std::filesystem::path &to) {
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(from, ec), end; it != end && !ec; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) {
+            continue;
+        }
+        std::filesystem::copy_file(it->path(), to / it->path().filename(),
+                                   std::filesystem::copy_options::overwrite_existing, ec);
+        if (ec) {
+            return false;
+        }
+    }
+    return !ec;
+}
+
+// Produce the outputs of a Generator by calling compile, unless the build
+// cache in args.cache_dir already holds them, in which case copy them from
+// there instead. compile may write files besides the ones in output_files
+// (e.g. the object files for each target of a multitarget build), but only
+// to the same directory, so an entry in the cache is a directory holding
+// everything compile wrote.
+void compile_with_cache(const ExecuteGeneratorArgs &args,
+                        const OutputFiles &output_files,
+                        const std::function<AbstractGenerator &(const Target &)> &generator_for,
+                        const std::function<void(const OutputFiles &)> &compile) {
+    const std::string key = args.cache_dir.empty() ? "" : generator_cache_key(args, output_files, generator_for);
+    if (key.empty()) {
+        compile(output_files);
+        return;
+    }
+
+    namespace fs = std::filesystem;
+    const fs::path entry = fs::path(args.cache_dir) / key;
+    std::error_code ec;
+    if (fs::is_directory(entry, ec)) {
+        if (copy_files(entry, args.output_dir)) {
+            debug(1) << "Copied the outputs of " << args.generator_name << " from the build cache: " << entry.string() << "\n";
+            return;
+        }
+        debug(1) << "Failed to copy the outputs of " << args.generator_name << " from the build cache: " << entry.string() << "\n";
+    }
+
+    // Compile into a new directory in the cache, and then move it into
+    // place, so that other processes never see a partially written entry.
+    std::random_device rd;
+    const fs::path staging = fs::path(args.cache_dir) / (key + ".tmp" + std::to_string(rd()));
+    fs::create_directories(staging, ec);
+    if (ec) {
+        debug(1) << "Failed to create " << staging.string() << " in the build cache: " << ec.message() << "\n";
+        compile(output_files);
+        return;
+    }
+    // Don't leave the staging directory behind if compile throws.
+    struct RemoveStaging {
+        const fs::path &staging;
+        ~RemoveStaging() {
+            std::error_code ec;
+            fs::remove_all(staging, ec);
+        }
+    } remove_staging{staging};
+    OutputFiles staged_files;
+    for (const auto &[type, path] : output_files) {
+        staged_files[type] = (staging / fs::path(path).filename()).string();
+    }
+    compile(staged_files);
+    user_assert(copy_files(staging, args.output_dir))
+        << "Failed to copy the outputs of " << args.generator_name << " from " << staging.string()
+        << " to " << args.output_dir << "\n";
+    // If this fails, most likely another process added the same entry
+    // first, and the staging directory is removed either way.
+    fs::rename(staging, entry, ec);
+    if (!ec) {
+        debug(1) << "Added the outputs of " << args.generator_name << " to the build cache: " << entry.string() << "\n";
+    }
+}
+
+}  // namespace
+
 void execute_generator(const ExecuteGeneratorArgs &args_in) {
     const auto fix_defaults = [](const ExecuteGeneratorArgs &args_in) -> ExecuteGeneratorArgs {
         ExecuteGeneratorArgs args = args_in;
@@ -1107,13 +1338,37 @@ void execute_generator(const ExecuteGeneratorArgs &args_in) {
         // Don't bother with this if we're just emitting a cpp_stub.
         if (!cpp_stub_only) {
             auto output_files = compute_output_files(args.targets[0], base_path, args.output_types);
+            // The Generators whose Pipelines were built to compute the key
+            // of the build cache, by the target compile_multitarget() will
+            // ask for, so that a miss doesn't run generate() again.
+            // compile_multitarget() adds NoRuntime to each of several targets.
+            std::map<std::string, AbstractGeneratorPtr> keyed_generators;
+            auto generator_for = [&](const Target &t) -> AbstractGenerator & {
+                const Target target = args.targets.size() > 1 ? t.with_feature(Target::NoRuntime) : t;
+                // Each target starts from the same random numbers, as in
+                // compile_multitarget().
+                reset_random_counters();
+                auto &gen = keyed_generators[target.to_string()];
+                gen = std::make_unique<BuildOnceGenerator>(generator_factory(args.function_name, target));
+                return *gen;
+            };
             auto module_factory = [&](const std::string &function_name, const Target &target) -> Module {
-                auto gen = generator_factory(function_name, target);
+                // compile_multitarget() may call this from several threads,
+                // but with a different target on each, so the map itself is
+                // never modified here.
+                auto it = keyed_generators.find(target.to_string());
+                AbstractGeneratorPtr gen = it != keyed_generators.end() && it->second ?
+                                               std::move(it->second) :
+                                               generator_factory(function_name, target);
                 return args.build_mode == ExecuteGeneratorArgs::Gradient ?
                            gen->build_gradient_module(function_name) :
                            gen->build_module(function_name);
             };
-            compile_multitarget(args.function_name, output_files, args.targets, args.suffixes, module_factory, args.compiler_logger_factory);
+            compile_with_cache(
+                args, output_files, generator_for,
+                [&](const OutputFiles &files) {
+                    compile_multitarget(args.function_name, files, args.targets, args.suffixes, module_factory, args.compiler_logger_factory, args.num_threads);
+                });
             if (args.log_outputs) {
                 for (const auto &o : output_files) {
                     std::cout << "Generated file: " << o.second << "\n";
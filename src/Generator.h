@@ -4021,6 +4021,22 @@ struct ExecuteGeneratorArgs {
 
     // If true, log the path of all output files to stdout.
     bool log_outputs = false;
+
+    // The number of targets of a multitarget build to compile concurrently.
+    // The Generators for the targets are created and run on separate threads,
+    // so this should only be more than one if doing that is safe.
+    int num_threads = 1;
+
+    // A directory in which to cache the outputs of the Generator, keyed by a
+    // hash of its serialized pipeline for each target, and of everything else
+    // the outputs depend on. If the directory already holds outputs for the
+    // same key, they are copied instead of being compiled again. If empty, or
+    // if an autoscheduler is used or a compiler_log is requested, nothing is
+    // cached. Outputs are never evicted, but the directory may be deleted at
+    // any time when no generator is using it. It doesn't know when Halide
+    // itself has changed (beyond its version number), so it should be cleared
+    // when Halide is rebuilt from modified sources.
+    std::string cache_dir;
 };
 
 /**
@@ -1,5 +1,6 @@
 #include "IR.h"
 
+#include "IREquality.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "IRPrinter.h"
@@ -17,6 +18,7 @@ Expr Cast::make(Type t, Expr v) {
     Cast *node = new Cast;
     node->type = t;
     node->value = std::move(v);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -33,6 +35,7 @@ Expr Reinterpret::make(Type t, Expr v) {
     Reinterpret *node = new Reinterpret;
     node->type = t;
     node->value = std::move(v);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -45,6 +48,7 @@ Expr Add::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -57,6 +61,7 @@ Expr Sub::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -69,6 +74,7 @@ Expr Mul::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -81,6 +87,7 @@ Expr Div::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -93,6 +100,7 @@ Expr Mod::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -105,6 +113,7 @@ Expr Min::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -117,6 +126,7 @@ Expr Max::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -129,6 +139,7 @@ Expr EQ::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -141,6 +152,7 @@ Expr NE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -153,6 +165,7 @@ Expr LT::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -165,6 +178,7 @@ Expr LE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -177,6 +191,7 @@ Expr GT::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -189,6 +204,7 @@ Expr GE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -203,6 +219,7 @@ Expr And::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -217,6 +234,7 @@ Expr Or::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -227,6 +245,7 @@ Expr Not::make(Expr a) {
     Not *node = new Not;
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -244,6 +263,7 @@ Expr Select::make(Expr condition, Expr true_value, Expr false_value) {
     node->condition = std::move(condition);
     node->true_value = std::move(true_value);
     node->false_value = std::move(false_value);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -262,6 +282,7 @@ Expr Load::make(Type type, const std::string &name, Expr index, Buffer<> image,
     node->image = std::move(image);
     node->param = std::move(param);
     node->alignment = alignment;
+    cache_structural_hash(node);
     return node;
 }
 
@@ -276,6 +297,7 @@ Expr Ramp::make(Expr base, Expr stride, int lanes) {
     node->base = std::move(base);
     node->stride = std::move(stride);
     node->lanes = lanes;
+    cache_structural_hash(node);
     return node;
 }
 
@@ -287,6 +309,7 @@ Expr Broadcast::make(Expr value, int lanes) {
     node->type = value.type().with_lanes(lanes * value.type().lanes());
     node->value = std::move(value);
     node->lanes = lanes;
+    cache_structural_hash(node);
     return node;
 }
 
@@ -299,6 +322,7 @@ Expr Let::make(const std::string &name, Expr value, Expr body) {
     node->name = name;
     node->value = std::move(value);
     node->body = std::move(body);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -755,6 +779,7 @@ Expr Call::make(Type type, const std::string &name, const std::vector<Expr> &arg
     node->value_index = value_index;
     node->image = std::move(image);
     node->param = std::move(param);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -766,6 +791,7 @@ Expr Variable::make(Type type, const std::string &name, Buffer<> image, Paramete
     node->image = std::move(image);
     node->param = std::move(param);
     node->reduction_domain = std::move(reduction_domain);
+    cache_structural_hash(node);
     return node;
 }
 
@@ -787,6 +813,7 @@ Expr Shuffle::make(const std::vector<Expr> &vectors,
     node->type = element_ty.with_lanes((int)indices.size());
     node->vectors = vectors;
     node->indices = indices;
+    cache_structural_hash(node);
     return node;
 }
 
@@ -982,6 +1009,7 @@ Expr VectorReduce::make(VectorReduce::Operator op,
     node->type = vec.type().with_lanes(lanes);
     node->op = op;
     node->value = std::move(vec);
+    cache_structural_hash(node);
     return node;
 }
 
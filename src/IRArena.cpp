@@ -0,0 +1,212 @@
+#include "IRArena.h"
+#include "Error.h"
+#include "Expr.h"
+#include "Util.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+namespace Halide {
+namespace Internal {
+
+namespace {
+
+// Nodes are carved out of chunks of this size, which are aligned to it so
+// that the chunk a node is in can be found from its address.
+constexpr size_t chunk_size = 64 * 1024;
+
+// Memory is handed out in multiples of this, and nodes bigger than
+// max_slot_size come from the heap.
+constexpr size_t granule = 8;
+constexpr size_t max_slot_size = 512;
+
+// Precedes each node in a chunk.
+struct SlotHeader {
+    // The size of the slot, including this header.
+    uint64_t size;
+};
+
+static_assert(sizeof(SlotHeader) % granule == 0, "Nodes after a SlotHeader must be aligned");
+
+// Lives at the start of each chunk.
+struct Chunk {
+    // The address malloc returned, which the chunk was aligned within.
+    void *allocation;
+    // The arena the chunk belongs to, or null once that arena has been
+    // destroyed.
+    std::atomic<IRArena *> arena;
+    // The number of live nodes in the chunk, plus one while it belongs to
+    // an arena. The chunk is freed when this reaches zero.
+    std::atomic<int64_t> references;
+};
+
+constexpr size_t first_slot_offset = (sizeof(Chunk) + granule - 1) / granule * granule;
+
+Chunk *chunk_of(const void *p) {
+    return (Chunk *)((uintptr_t)p & ~(uintptr_t)(chunk_size - 1));
+}
+
+std::atomic<bool> &ir_arena_flag() {
+    static std::atomic<bool> flag{get_env_variable("HL_IR_ARENA") == "1"};
+    return flag;
+}
+
+thread_local IRArena *active_ir_arena = nullptr;
+
+}  // namespace
+
+class IRArena {
+    std::vector<Chunk *> chunks;
+    std::unordered_set<const Chunk *> chunk_set;
+    char *next = nullptr, *limit = nullptr;
+
+    // Slots of destroyed nodes, by size in granules, linked through the
+    // first word after their header.
+    std::vector<SlotHeader *> free_slots;
+
+    void add_chunk() {
+        void *allocation = std::malloc(2 * chunk_size);
+        internal_assert(allocation) << "Out of memory allocating an IR arena chunk\n";
+        Chunk *c = chunk_of((char *)allocation + chunk_size - 1);
+        c->allocation = allocation;
+        new (&c->arena) std::atomic<IRArena *>(this);
+        new (&c->references) std::atomic<int64_t>(1);
+        chunks.push_back(c);
+        chunk_set.insert(c);
+        next = (char *)c + first_slot_offset;
+        limit = (char *)c + chunk_size;
+    }
+
+public:
+    // The most recent allocation, which the node being constructed in it
+    // claims. See IRNode::claim_ir_arena_allocation.
+    void *last_allocation = nullptr;
+
+    IRArena()
+        : free_slots(max_slot_size / granule + 1, nullptr) {
+    }
+
+    void *allocate(size_t size) {
+        const size_t slot_size = (size + sizeof(SlotHeader) + granule - 1) / granule * granule;
+        if (slot_size > max_slot_size) {
+            return nullptr;
+        }
+        SlotHeader *&free_slot = free_slots[slot_size / granule];
+        SlotHeader *slot;
+        if (free_slot) {
+            slot = free_slot;
+            free_slot = *(SlotHeader **)(slot + 1);
+        } else {
+            if (limit - next < (ptrdiff_t)slot_size) {
+                add_chunk();
+            }
+            slot = (SlotHeader *)next;
+            slot->size = (uint32_t)slot_size;
+            next += slot_size;
+        }
+        chunk_of(slot)->references.fetch_add(1, std::memory_order_relaxed);
+        last_allocation = slot + 1;
+        return last_allocation;
+    }
+
+    // Give back the slot of a node destroyed on the arena's thread. The
+    // chunk can't be freed here, as the arena still holds a reference.
+    void free(SlotHeader *slot) {
+        chunk_of(slot)->references.fetch_sub(1, std::memory_order_relaxed);
+        SlotHeader *&free_slot = free_slots[slot->size / granule];
+        *(SlotHeader **)(slot + 1) = free_slot;
+        free_slot = slot;
+    }
+
+    bool owns(const void *p) const {
+        return chunk_set.count(chunk_of(p)) != 0;
+    }
+
+    ~IRArena() {
+        // Nodes that are still alive (e.g. in the lowered Module, or in some
+        // cache that outlives lowering) keep their chunks alive.
+        for (Chunk *c : chunks) {
+            c->arena.store(nullptr, std::memory_order_release);
+            if (c->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::free(c->allocation);
+            }
+        }
+    }
+};
+
+void set_ir_arena_enabled(bool enabled) {
+    ir_arena_flag() = enabled;
+}
+
+bool ir_arena_enabled() {
+    return ir_arena_flag();
+}
+
+ScopedIRArena::ScopedIRArena() {
+    if (ir_arena_enabled() && !active_ir_arena) {
+        arena = std::make_unique<IRArena>();
+        active_ir_arena = arena.get();
+    }
+}
+
+ScopedIRArena::~ScopedIRArena() {
+    if (arena) {
+        internal_assert(active_ir_arena == arena.get());
+        active_ir_arena = nullptr;
+    }
+}
+
+void *IRNode::operator new(size_t size) {
+    if (IRArena *arena = active_ir_arena) {
+        if (void *p = arena->allocate(size)) {
+            return p;
+        }
+    }
+    return ::operator new(size);
+}
+
+void IRNode::operator delete(void *ptr) {
+    // Arena nodes are normally freed with destroy_ir_arena_node, so this
+    // only sees arena memory when a node's constructor throws, which
+    // happens on the arena's thread.
+    if (IRArena *arena = active_ir_arena) {
+        if (arena->owns(ptr)) {
+            if (arena->last_allocation == ptr) {
+                arena->last_allocation = nullptr;
+            }
+            arena->free((SlotHeader *)ptr - 1);
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
+bool IRNode::claim_ir_arena_allocation(IRNode *node) {
+    IRArena *arena = active_ir_arena;
+    if (arena && arena->last_allocation == node) {
+        arena->last_allocation = nullptr;
+        return true;
+    }
+    return false;
+}
+
+void destroy_ir_arena_node(const IRNode *t) {
+    SlotHeader *slot = (SlotHeader *)t - 1;
+    Chunk *c = chunk_of(slot);
+    t->~IRNode();
+    // Only the arena's own thread may reuse the slot. A node freed on any
+    // other thread just gives up its reference on the chunk.
+    IRArena *arena = c->arena.load(std::memory_order_acquire);
+    if (arena && arena == active_ir_arena) {
+        arena->free(slot);
+    } else if (c->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::free(c->allocation);
+    }
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,48 @@
+#ifndef HALIDE_IR_ARENA_H
+#define HALIDE_IR_ARENA_H
+
+/** \file
+ * Defines an arena that IR nodes can be allocated from while lowering.
+ */
+
+#include <memory>
+
+namespace Halide {
+namespace Internal {
+
+/** Set whether lowering allocates the IR nodes it makes from an IR arena.
+ * The initial value is taken from the HL_IR_ARENA environment variable, and
+ * defaults to false. */
+void set_ir_arena_enabled(bool enabled);
+
+/** Check whether lowering allocates the IR nodes it makes from an IR
+ * arena. */
+bool ir_arena_enabled();
+
+class IRArena;
+
+/** Allocate the IR nodes made on the calling thread from an arena over the
+ * lifetime of this object, if IR arenas are enabled. Nodes are carved out
+ * of large chunks, and nodes freed on the calling thread are reused for
+ * nodes of the same size, which is much cheaper than going through
+ * malloc. Arena nodes are otherwise ordinary IR: their reference counts are
+ * atomic, so they may be shared with and freed on other threads, and a
+ * chunk is freed once the arena and all the nodes in it are gone. Arenas
+ * on different threads are independent, so several threads can lower at
+ * once, each with its own arena. If an arena is already alive on the
+ * calling thread, this does nothing. */
+class ScopedIRArena {
+    std::unique_ptr<IRArena> arena;
+
+public:
+    ScopedIRArena();
+    ~ScopedIRArena();
+
+    ScopedIRArena(const ScopedIRArena &) = delete;
+    ScopedIRArena &operator=(const ScopedIRArena &) = delete;
+};
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -1,6 +1,10 @@
+#include <atomic>
+#include <functional>
+
 #include "IREquality.h"
 #include "IROperator.h"
 #include "IRVisitor.h"
+#include "Util.h"
 
 namespace Halide {
 namespace Internal {
@@ -33,8 +37,13 @@ struct Comparer {
     const IRNode *next_a = nullptr, *next_b = nullptr;
     Order result = Order::Equal;
 
-    Comparer(const IRNode **cache)
-        : cache(cache) {
+    // If true, we only care whether the IR is equal, so we can stop as soon
+    // as the cached hashes of two Exprs differ. The Order we return in that
+    // case is arbitrary.
+    bool hash_first = false;
+
+    Comparer(const IRNode **cache, bool hash_first = false)
+        : cache(cache), hash_first(hash_first) {
     }
 
     // Compare the given member variable of next_a and next_b. If it's an Expr
@@ -96,7 +105,7 @@ struct Comparer {
         if (a.get() == b.get()) {
         } else if (stack_ptr == stack_end) {
             // Out of stack space. Make a recursive call to buy some more stack.
-            Comparer<cache_size> sub_comparer(cache);
+            Comparer<cache_size> sub_comparer(cache, hash_first);
             result = sub_comparer.compare(*(a.get()), *(b.get()));
         } else {
             *stack_ptr++ = a.get();
@@ -273,6 +282,11 @@ struct Comparer {
                 break;
             }
 
+            if (hash_first && structural_hashes_differ(*next_a, *next_b)) {
+                result = Order::LessThan;
+                break;
+            }
+
             if (next_a->node_type < IRNodeType::LetStmt) {
                 cmp(&BaseExprNode::type);
             }
@@ -509,13 +523,198 @@ struct Comparer {
 
 }  // namespace
 
+namespace {
+
+std::atomic<bool> &ir_hash_caching_flag() {
+    static std::atomic<bool> flag{get_env_variable("HL_CACHE_IR_HASHES") != "0"};
+    return flag;
+}
+
+// Combines the fields of an Expr node into its structural hash. Only fields
+// that Comparer looks at may go into it, and in a way that can't tell apart
+// values Comparer considers equal.
+class StructuralHasher {
+    uint64_t h = 0;
+    bool known = true;
+
+public:
+    void add(uint64_t v) {
+        h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    }
+
+    void add(const std::string &s) {
+        add((uint64_t)std::hash<std::string>()(s));
+    }
+
+    void add(double v) {
+        if (std::isnan(v)) {
+            // All NaNs are equal.
+            add((uint64_t)1);
+        } else if (v == 0) {
+            // So are 0 and -0.
+            add((uint64_t)0);
+        } else {
+            add(reinterpret_bits<uint64_t>(v));
+        }
+    }
+
+    void add(const Type &t) {
+        add((uint64_t)((halide_type_t)t).as_u32());
+    }
+
+    void add(const Expr &e) {
+        if (!e.defined()) {
+            add((uint64_t)0);
+        } else if (e.get()->structural_hash == 0) {
+            known = false;
+        } else {
+            add((uint64_t)e.get()->structural_hash);
+        }
+    }
+
+    void add(const std::vector<Expr> &v) {
+        add((uint64_t)v.size());
+        for (const Expr &e : v) {
+            add(e);
+        }
+    }
+
+    uint32_t result() const {
+        if (!known) {
+            return 0;
+        }
+        uint32_t r = (uint32_t)(h ^ (h >> 32));
+        // Zero means unknown.
+        return r == 0 ? 1 : r;
+    }
+};
+
+}  // namespace
+
+void set_ir_hash_caching(bool enabled) {
+    ir_hash_caching_flag().store(enabled, std::memory_order_relaxed);
+}
+
+bool ir_hash_caching_enabled() {
+    return ir_hash_caching_flag().load(std::memory_order_relaxed);
+}
+
+void cache_structural_hash(BaseExprNode *node) {
+    if (!ir_hash_caching_enabled()) {
+        return;
+    }
+
+    StructuralHasher h;
+    h.add((uint64_t)node->node_type);
+    h.add(node->type);
+    switch (node->node_type) {
+    case IRNodeType::IntImm:
+        h.add((uint64_t)((const IntImm *)node)->value);
+        break;
+    case IRNodeType::UIntImm:
+        h.add(((const UIntImm *)node)->value);
+        break;
+    case IRNodeType::FloatImm:
+        h.add(((const FloatImm *)node)->value);
+        break;
+    case IRNodeType::StringImm:
+        h.add(((const StringImm *)node)->value);
+        break;
+    case IRNodeType::Broadcast:
+        h.add(((const Broadcast *)node)->value);
+        break;
+    case IRNodeType::Cast:
+        h.add(((const Cast *)node)->value);
+        break;
+    case IRNodeType::Reinterpret:
+        h.add(((const Reinterpret *)node)->value);
+        break;
+    case IRNodeType::Variable:
+        h.add(((const Variable *)node)->name);
+        break;
+    case IRNodeType::Add:
+    case IRNodeType::Sub:
+    case IRNodeType::Mod:
+    case IRNodeType::Mul:
+    case IRNodeType::Div:
+    case IRNodeType::Min:
+    case IRNodeType::Max:
+    case IRNodeType::EQ:
+    case IRNodeType::NE:
+    case IRNodeType::LT:
+    case IRNodeType::LE:
+    case IRNodeType::GT:
+    case IRNodeType::GE:
+    case IRNodeType::And:
+    case IRNodeType::Or:
+        // All the binary operators have the same layout.
+        h.add(((const Add *)node)->a);
+        h.add(((const Add *)node)->b);
+        break;
+    case IRNodeType::Not:
+        h.add(((const Not *)node)->a);
+        break;
+    case IRNodeType::Select: {
+        const Select *op = (const Select *)node;
+        h.add(op->condition);
+        h.add(op->true_value);
+        h.add(op->false_value);
+        break;
+    }
+    case IRNodeType::Load: {
+        const Load *op = (const Load *)node;
+        h.add(op->name);
+        h.add((uint64_t)op->alignment.modulus);
+        h.add((uint64_t)op->alignment.remainder);
+        h.add(op->index);
+        h.add(op->predicate);
+        break;
+    }
+    case IRNodeType::Ramp:
+        h.add(((const Ramp *)node)->base);
+        h.add(((const Ramp *)node)->stride);
+        break;
+    case IRNodeType::Call: {
+        const Call *op = (const Call *)node;
+        h.add(op->name);
+        h.add((uint64_t)op->call_type);
+        h.add((uint64_t)op->value_index);
+        h.add(op->args);
+        break;
+    }
+    case IRNodeType::Let: {
+        const Let *op = (const Let *)node;
+        h.add(op->name);
+        h.add(op->value);
+        h.add(op->body);
+        break;
+    }
+    case IRNodeType::Shuffle: {
+        const Shuffle *op = (const Shuffle *)node;
+        h.add((uint64_t)op->indices.size());
+        for (int i : op->indices) {
+            h.add((uint64_t)i);
+        }
+        h.add(op->vectors);
+        break;
+    }
+    case IRNodeType::VectorReduce:
+        h.add((uint64_t)((const VectorReduce *)node)->op);
+        h.add(((const VectorReduce *)node)->value);
+        break;
+    default:
+        internal_error << "Not an Expr node type: " << (int)node->node_type << "\n";
+    }
+    node->structural_hash = h.result();
+}
+
 bool equal_impl(const IRNode &a, const IRNode &b) {
-    return Comparer<0>(nullptr).compare(a, b) == Order::Equal;
+    return Comparer<0>(nullptr, true).compare(a, b) == Order::Equal;
 }
 
 bool graph_equal_impl(const IRNode &a, const IRNode &b) {
     const IRNode *cache[256] = {};
-    return Comparer<128>(cache).compare(a, b) == Order::Equal;
+    return Comparer<128>(cache, true).compare(a, b) == Order::Equal;
 }
 
 bool less_than_impl(const IRNode &a, const IRNode &b) {
@@ -608,6 +807,34 @@ void ir_equality_test() {
     e2 = e2 * e2 + e2;
     check_not_equal(e1, e2);
 
+    // Equal Exprs must have equal cached hashes, including the ones the
+    // comparison treats specially.
+    if (ir_hash_caching_enabled()) {
+        auto check_same_hash = [](const Expr &a, const Expr &b) {
+            internal_assert(a.get()->structural_hash != 0 &&
+                            a.get()->structural_hash == b.get()->structural_hash)
+                << "Error in ir_equality_test: different hashes for equal Exprs:\n"
+                << a << "\nand\n"
+                << b << "\n";
+        };
+        check_same_hash(e1 * 2, e1 * 2);
+        check_same_hash(make_const(Float(32), 0.0), make_const(Float(32), -0.0));
+        check_same_hash(make_const(Float(64), NAN), make_const(Float(64), -NAN));
+        check_same_hash(Ramp::make(x, 4, 3), Ramp::make(Variable::make(Int(32), "x"), 4, 3));
+    }
+
+    // Exprs made without cached hashes still compare correctly against ones
+    // with them.
+    {
+        bool enabled = ir_hash_caching_enabled();
+        set_ir_hash_caching(false);
+        Expr e3 = Ramp::make(Variable::make(Int(32), "x"), 4, 3);
+        set_ir_hash_caching(enabled);
+        internal_assert(e3.get()->structural_hash == 0);
+        internal_assert(equal(e3, Ramp::make(x, 4, 3)));
+        internal_assert(!equal(e3, Ramp::make(x, 2, 3)));
+    }
+
     debug(0) << "ir_equality_test passed\n";
 }
 
@@ -33,6 +33,34 @@ bool equal(const Expr &a, int b) {
     }
 }
 
+/** Control whether Exprs cache a hash of their structure when they are
+ * made, which lets equal() and graph_equal() reject most unequal Exprs
+ * without walking them, and lets common_subexpression_elimination find
+ * matching Exprs faster. It is enabled by default, unless the
+ * HL_CACHE_IR_HASHES environment variable is set to 0. Exprs made while it
+ * is disabled, and any Exprs made from them, have no cached hash. */
+// @{
+void set_ir_hash_caching(bool enabled);
+bool ir_hash_caching_enabled();
+// @}
+
+/** Compute and store the structural hash of a newly-made Expr node, from
+ * those of its children, if hash caching is enabled. Called by the make
+ * methods of the Expr nodes. */
+void cache_structural_hash(BaseExprNode *node);
+
+/** Check if the cached structural hashes of two IR nodes show that they are
+ * not equal. Only Exprs have hashes, so this is false for Stmts. */
+HALIDE_ALWAYS_INLINE
+bool structural_hashes_differ(const IRNode &a, const IRNode &b) {
+    if (a.node_type > StrongestExprNodeType) {
+        return false;
+    }
+    uint32_t ha = ((const BaseExprNode &)a).structural_hash;
+    uint32_t hb = ((const BaseExprNode &)b).structural_hash;
+    return ha != hb && ha != 0 && hb != 0;
+}
+
 /** Check if two defined Stmts or Exprs are equal. */
 HALIDE_ALWAYS_INLINE
 bool equal(const IRNode &a, const IRNode &b) {
@@ -40,6 +68,8 @@ bool equal(const IRNode &a, const IRNode &b) {
         return true;
     } else if (a.node_type != b.node_type) {
         return false;
+    } else if (structural_hashes_differ(a, b)) {
+        return false;
     } else {
         return equal_impl(a, b);
     }
@@ -65,6 +95,8 @@ bool graph_equal(const IRNode &a, const IRNode &b) {
         return true;
     } else if (a.node_type != b.node_type) {
         return false;
+    } else if (structural_hashes_differ(a, b)) {
+        return false;
     } else {
         return graph_equal_impl(a, b);
     }
@@ -157,6 +189,22 @@ struct IRGraphDeepCompare {
     }
 };
 
+/** A compare struct for Exprs that orders them by their cached structural
+ * hashes first, and then by graph_less_than. Equal Exprs are equivalent
+ * under it if they both have a cached hash or both don't. It is cheaper
+ * than IRGraphDeepCompare, but the order isn't meaningful, so only use it
+ * for maps and sets whose order doesn't matter. */
+struct IRGraphHashCompare {
+    bool operator()(const Expr &a, const Expr &b) const {
+        uint32_t ha = a.defined() ? a.get()->structural_hash : 0;
+        uint32_t hb = b.defined() ? b.get()->structural_hash : 0;
+        if (ha != hb) {
+            return ha < hb;
+        }
+        return graph_less_than(a, b);
+    }
+};
+
 void ir_equality_test();
 
 }  // namespace Internal
@@ -2658,19 +2658,31 @@ namespace {
 
 std::atomic<int> random_number_counter = 0;
 
+int next_random_number_id() {
+    if (Internal::NameCounters *counters = Internal::get_scoped_name_counters()) {
+        return counters->random_number_counter++;
+    }
+    return random_number_counter++;
+}
+
 }  // namespace
 
 namespace Internal {
 
 void reset_random_counters() {
-    random_number_counter = 0;
-    random_variable_counter = 0;
+    if (NameCounters *counters = get_scoped_name_counters()) {
+        counters->random_number_counter = 0;
+        counters->random_variable_counter = 0;
+    } else {
+        random_number_counter = 0;
+        random_variable_counter = 0;
+    }
 }
 
 }  // namespace Internal
 
 Expr random_float(Expr seed) {
-    const int id = random_number_counter++;
+    const int id = next_random_number_id();
 
     std::vector<Expr> args;
     if (seed.defined()) {
@@ -2688,7 +2700,7 @@ Expr random_float(Expr seed) {
 }
 
 Expr random_uint(Expr seed) {
-    const int id = random_number_counter++;
+    const int id = next_random_number_id();
 
     std::vector<Expr> args;
     if (seed.defined()) {
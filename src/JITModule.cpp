@@ -1,7 +1,14 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #ifdef _WIN32
 #ifdef _MSC_VER
@@ -148,6 +155,7 @@ public:
 
     ~JITModuleContents() {
         if (JIT != nullptr) {
+            forget_memoized_funcs();
             auto err = dtorRunner->run();
             internal_assert(!err) << llvm::toString(std::move(err)) << "\n";
         }
@@ -162,6 +170,18 @@ public:
     JITModule::Symbol argv_entrypoint;
 
     std::string name;
+
+    // Free the slots the memoization cache in the shared runtime uses to
+    // keep statistics about this pipeline's memoized Funcs, if any.
+    void forget_memoized_funcs() {
+        for (const JITModule &dep : dependencies) {
+            auto f = dep.exports().find("halide_memoization_cache_forget_pipeline");
+            if (f != dep.exports().end()) {
+                (reinterpret_bits<void (*)(const char *)>(f->second.address))(name.c_str());
+                return;
+            }
+        }
+    }
 };
 
 template<>
@@ -245,6 +265,204 @@ public:
     void deregisterEHFrames() override {};
 };
 
+// An on-disk cache of the object code that the JIT generates, so that
+// compiling the same pipeline again, usually in a later process, can skip
+// LLVM's code generator. Entries are keyed by a hash of the LLVM module as it
+// is handed to the code generator, which captures the lowered pipeline and
+// the target, salted with the Halide and LLVM versions and any LLVM
+// command-line options.
+//
+// The cache is off unless HL_JIT_CACHE=1. HL_JIT_CACHE_DIR moves it (the
+// default is a "halide/jit" directory under the user's cache directory), and
+// HL_JIT_CACHE_SIZE sets the number of bytes it may hold before the least
+// recently used entries are removed. Filesystem errors just lose the entry.
+class JITObjectCache : public llvm::ObjectCache {
+    std::mutex mutex;
+
+    // Codegen may modify the module, so the key computed when looking it up
+    // is kept until the object code comes back.
+    std::map<const llvm::Module *, std::string> pending_keys;
+
+    // An estimate of the size of the cache directory, so that it is only
+    // walked when the cache may be over budget. It is measured on the first
+    // write, and then only counts the writes of this process, so it is
+    // corrected whenever the directory is pruned. Guarded by mutex.
+    uint64_t estimated_size = 0;
+    bool size_measured = false;
+
+    static std::string cache_dir() {
+        std::string dir = get_env_variable("HL_JIT_CACHE_DIR");
+        if (dir.empty()) {
+            llvm::SmallString<256> path;
+            if (!llvm::sys::path::cache_directory(path)) {
+                return "";
+            }
+            llvm::sys::path::append(path, "halide", "jit");
+            dir = path.str().str();
+        }
+        return dir;
+    }
+
+    static uint64_t max_cache_size() {
+        std::string size = get_env_variable("HL_JIT_CACHE_SIZE");
+        if (size.empty()) {
+            return (uint64_t)256 * 1024 * 1024;
+        }
+        return std::strtoull(size.c_str(), nullptr, 10);
+    }
+
+    static std::string compute_key(const llvm::Module &m) {
+        llvm::SmallVector<char, 0> bitcode;
+        llvm::raw_svector_ostream stream(bitcode);
+        llvm::WriteBitcodeToFile(m, stream);
+
+        std::string salt = "Halide " + std::to_string(HALIDE_VERSION_MAJOR) + "." +
+                           std::to_string(HALIDE_VERSION_MINOR) + "." +
+                           std::to_string(HALIDE_VERSION_PATCH) +
+                           " LLVM " + std::to_string(LLVM_VERSION) +
+                           " " + get_env_variable("HL_LLVM_ARGS");
+
+        llvm::SHA256 hash;
+        hash.update(llvm::ArrayRef<uint8_t>((const uint8_t *)bitcode.data(), bitcode.size()));
+        hash.update(salt);
+        return llvm::toHex(hash.final(), /*LowerCase*/ true);
+    }
+
+    static std::string entry_path(const std::string &dir, const std::string &key) {
+        llvm::SmallString<256> path(dir);
+        llvm::sys::path::append(path, key + ".o");
+        return path.str().str();
+    }
+
+    // Mark an entry as recently used.
+    static void touch(const std::string &path) {
+        int fd;
+        if (llvm::sys::fs::openFileForReadWrite(path, fd, llvm::sys::fs::CD_OpenExisting, llvm::sys::fs::OF_None)) {
+            return;
+        }
+        (void)llvm::sys::fs::setLastAccessAndModificationTime(
+            fd, std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now()));
+        (void)llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    }
+
+    // Remove the least recently used entries until the cache holds at most
+    // max_size bytes, and return the number of bytes it holds.
+    static uint64_t prune(const std::string &dir, uint64_t max_size) {
+        std::vector<std::tuple<llvm::sys::TimePoint<>, uint64_t, std::string>> entries;
+        uint64_t total = 0;
+        std::error_code ec;
+        for (llvm::sys::fs::directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+            if (llvm::sys::path::extension(it->path()) != ".o") {
+                continue;
+            }
+            auto status = it->status();
+            if (!status) {
+                continue;
+            }
+            entries.emplace_back(status->getLastModificationTime(), status->getSize(), it->path());
+            total += status->getSize();
+        }
+        if (total <= max_size) {
+            return total;
+        }
+        std::sort(entries.begin(), entries.end());
+        for (const auto &[time, size, path] : entries) {
+            if (total <= max_size) {
+                break;
+            }
+            if (!llvm::sys::fs::remove(path)) {
+                debug(2) << "Removed " << path << " from the JIT cache\n";
+                total -= size;
+            }
+        }
+        return total;
+    }
+
+public:
+    // Returns nullptr if the cache is turned off.
+    static JITObjectCache *get() {
+        if (get_env_variable("HL_JIT_CACHE") != "1" || cache_dir().empty()) {
+            return nullptr;
+        }
+        static JITObjectCache cache;
+        return &cache;
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *m) override {
+        const std::string dir = cache_dir();
+        if (dir.empty()) {
+            return nullptr;
+        }
+        std::string key = compute_key(*m);
+        const std::string path = entry_path(dir, key);
+        auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText*/ false, /*RequiresNullTerminator*/ false);
+        if (buffer) {
+            debug(1) << "Loaded object code for " << m->getModuleIdentifier()
+                     << " from the JIT cache: " << path << "\n";
+            touch(path);
+            return std::move(*buffer);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_keys[m] = std::move(key);
+        return nullptr;
+    }
+
+    void notifyObjectCompiled(const llvm::Module *m, llvm::MemoryBufferRef obj) override {
+        std::string key;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = pending_keys.find(m);
+            if (it == pending_keys.end()) {
+                return;
+            }
+            key = std::move(it->second);
+            pending_keys.erase(it);
+        }
+
+        const std::string dir = cache_dir();
+        if (dir.empty() || llvm::sys::fs::create_directories(dir)) {
+            return;
+        }
+
+        // Write to a temporary file and rename it into place, so that other
+        // processes never see a partial entry.
+        int fd;
+        llvm::SmallString<256> temp_path;
+        if (llvm::sys::fs::createUniqueFile(entry_path(dir, key) + "-%%%%%%%%.tmp", fd, temp_path)) {
+            return;
+        }
+        bool ok;
+        {
+            llvm::raw_fd_ostream stream(fd, /*shouldClose*/ true);
+            stream << obj.getBuffer();
+            stream.close();
+            ok = !stream.has_error();
+            stream.clear_error();
+        }
+        const std::string path = entry_path(dir, key);
+        if (!ok || llvm::sys::fs::rename(temp_path, path)) {
+            (void)llvm::sys::fs::remove(temp_path);
+            return;
+        }
+        debug(1) << "Stored object code for " << m->getModuleIdentifier()
+                 << " in the JIT cache: " << path << "\n";
+
+        const uint64_t max_size = max_cache_size();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!size_measured) {
+            estimated_size = prune(dir, max_size);
+            size_measured = true;
+        } else {
+            estimated_size += obj.getBufferSize();
+            if (estimated_size > max_size) {
+                // Leave some room, so that the next few writes don't walk
+                // the directory again.
+                estimated_size = prune(dir, max_size / 4 * 3);
+            }
+        }
+    }
+};
+
 }  // namespace
 
 JITModule::JITModule() {
@@ -310,7 +528,7 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     // Create LLJIT
     const auto compilerBuilder = [&](const llvm::orc::JITTargetMachineBuilder & /*jtmb*/)
         -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
-        return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*tm));
+        return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*tm), JITObjectCache::get());
     };
 
     llvm::orc::LLJITBuilderState::ObjectLinkingLayerCreator linkerBuilder;
@@ -536,6 +754,41 @@ void JITModule::memoization_cache_evict(uint64_t eviction_key) const {
     }
 }
 
+halide_memoization_cache_eviction_policy_t
+JITModule::memoization_cache_set_eviction_policy(halide_memoization_cache_eviction_policy_t policy) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_set_eviction_policy");
+    if (f != exports().end()) {
+        using fn_t = halide_memoization_cache_eviction_policy_t (*)(halide_memoization_cache_eviction_policy_t);
+        return (reinterpret_bits<fn_t>(f->second.address))(policy);
+    }
+    return halide_memoization_cache_evict_lru;
+}
+
+int JITModule::memoization_cache_set_persistent_path(const char *path) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_set_persistent_path");
+    if (f != exports().end()) {
+        return (reinterpret_bits<int (*)(const char *)>(f->second.address))(path);
+    }
+    return -1;
+}
+
+int JITModule::memoization_cache_get_stats(halide_memoization_cache_stats_t *stats,
+                                           halide_memoization_cache_func_stats_t *func_stats,
+                                           int max_func_stats) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_get_stats");
+    if (f != exports().end()) {
+        using fn_t = int (*)(halide_memoization_cache_stats_t *, halide_memoization_cache_func_stats_t *, int);
+        return (reinterpret_bits<fn_t>(f->second.address))(stats, func_stats, max_func_stats);
+    }
+    if (stats) {
+        *stats = halide_memoization_cache_stats_t{};
+    }
+    return 0;
+}
+
 void JITModule::reuse_device_allocations(bool b) const {
     std::map<std::string, Symbol>::const_iterator f =
         exports().find("halide_reuse_device_allocations");
@@ -544,6 +797,24 @@ void JITModule::reuse_device_allocations(bool b) const {
     }
 }
 
+void JITModule::reuse_host_allocations(bool b) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_reuse_host_allocations");
+    if (f != exports().end()) {
+        (reinterpret_bits<int (*)(void *, bool)>(f->second.address))(nullptr, b);
+    }
+}
+
+void JITModule::get_host_allocation_stats(halide_host_allocation_stats_t *stats) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_get_host_allocation_stats");
+    if (f != exports().end()) {
+        (reinterpret_bits<void (*)(halide_host_allocation_stats_t *)>(f->second.address))(stats);
+    } else {
+        *stats = halide_host_allocation_stats_t{};
+    }
+}
+
 int JITModule::get_num_threads() const {
     std::map<std::string, Symbol>::const_iterator f =
         exports().find("halide_get_num_threads");
@@ -562,6 +833,15 @@ int JITModule::set_num_threads(int n) const {
     return 1;
 }
 
+bool JITModule::set_thread_affinity(bool b) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_set_thread_affinity");
+    if (f != exports().end()) {
+        return (reinterpret_bits<bool (*)(bool)>(f->second.address))(b);
+    }
+    return false;
+}
+
 bool JITModule::compiled() const {
     return jit_module->JIT != nullptr;
 }
@@ -570,9 +850,23 @@ namespace {
 
 JITHandlers runtime_internal_handlers;
 JITHandlers default_handlers;
-JITHandlers active_handlers;
 int64_t default_cache_size;
 
+// The handlers used for anything not overridden by the call or the
+// pipeline: the runtime's own, with the default handlers on top. These only
+// change when a runtime is loaded or the default handlers are set, but are
+// read on every call into jitted code, possibly while another thread is
+// jit-compiling. So each version is published as an immutable snapshot that
+// calls read without taking a lock. Old versions are kept, because a call
+// may still be using one.
+const JITHandlers no_handlers;
+std::atomic<const JITHandlers *> active_handlers_snapshot{&no_handlers};
+std::vector<std::unique_ptr<JITHandlers>> old_active_handlers;
+
+const JITHandlers &active_handlers() {
+    return *active_handlers_snapshot.load(std::memory_order_acquire);
+}
+
 void merge_handlers(JITHandlers &base, const JITHandlers &addins) {
     if (addins.custom_print) {
         base.custom_print = addins.custom_print;
@@ -615,11 +909,19 @@ void merge_handlers(JITHandlers &base, const JITHandlers &addins) {
     }
 }
 
+// Must be called with the shared_runtimes_mutex held.
+void update_active_handlers() {
+    auto handlers = std::make_unique<JITHandlers>(runtime_internal_handlers);
+    merge_handlers(*handlers, default_handlers);
+    active_handlers_snapshot.store(handlers.get(), std::memory_order_release);
+    old_active_handlers.push_back(std::move(handlers));
+}
+
 void print_handler(JITUserContext *context, const char *msg) {
     if (context && context->handlers.custom_print) {
         context->handlers.custom_print(context, msg);
     } else {
-        active_handlers.custom_print(context, msg);
+        active_handlers().custom_print(context, msg);
     }
 }
 
@@ -627,7 +929,7 @@ void *malloc_handler(JITUserContext *context, size_t x) {
     if (context && context->handlers.custom_malloc) {
         return context->handlers.custom_malloc(context, x);
     } else {
-        return active_handlers.custom_malloc(context, x);
+        return active_handlers().custom_malloc(context, x);
     }
 }
 
@@ -635,7 +937,7 @@ void free_handler(JITUserContext *context, void *ptr) {
     if (context && context->handlers.custom_free) {
         context->handlers.custom_free(context, ptr);
     } else {
-        active_handlers.custom_free(context, ptr);
+        active_handlers().custom_free(context, ptr);
     }
 }
 
@@ -644,7 +946,7 @@ int do_task_handler(JITUserContext *context, int (*f)(JITUserContext *, int, uin
     if (context && context->handlers.custom_do_task) {
         return context->handlers.custom_do_task(context, f, idx, closure);
     } else {
-        return active_handlers.custom_do_task(context, f, idx, closure);
+        return active_handlers().custom_do_task(context, f, idx, closure);
     }
 }
 
@@ -653,7 +955,7 @@ int do_par_for_handler(JITUserContext *context, int (*f)(JITUserContext *, int,
     if (context && context->handlers.custom_do_par_for) {
         return context->handlers.custom_do_par_for(context, f, min, size, closure);
     } else {
-        return active_handlers.custom_do_par_for(context, f, min, size, closure);
+        return active_handlers().custom_do_par_for(context, f, min, size, closure);
     }
 }
 
@@ -661,7 +963,7 @@ void error_handler_handler(JITUserContext *context, const char *msg) {
     if (context && context->handlers.custom_error) {
         context->handlers.custom_error(context, msg);
     } else {
-        active_handlers.custom_error(context, msg);
+        active_handlers().custom_error(context, msg);
     }
 }
 
@@ -669,27 +971,27 @@ int32_t trace_handler(JITUserContext *context, const halide_trace_event_t *e) {
     if (context && context->handlers.custom_trace) {
         return context->handlers.custom_trace(context, e);
     } else {
-        return active_handlers.custom_trace(context, e);
+        return active_handlers().custom_trace(context, e);
     }
 }
 
 void *get_symbol_handler(const char *name) {
-    return (*active_handlers.custom_get_symbol)(name);
+    return (*active_handlers().custom_get_symbol)(name);
 }
 
 void *load_library_handler(const char *name) {
-    return (*active_handlers.custom_load_library)(name);
+    return (*active_handlers().custom_load_library)(name);
 }
 
 void *get_library_symbol_handler(void *lib, const char *name) {
-    return (*active_handlers.custom_get_library_symbol)(lib, name);
+    return (*active_handlers().custom_get_library_symbol)(lib, name);
 }
 
 int cuda_acquire_context_handler(JITUserContext *context, void **cuda_context_ptr, bool create) {
     if (context && context->handlers.custom_cuda_acquire_context) {
         return context->handlers.custom_cuda_acquire_context(context, cuda_context_ptr, create);
     } else {
-        return active_handlers.custom_cuda_acquire_context(context, cuda_context_ptr, create);
+        return active_handlers().custom_cuda_acquire_context(context, cuda_context_ptr, create);
     }
 }
 
@@ -697,7 +999,7 @@ int cuda_release_context_handler(JITUserContext *context) {
     if (context && context->handlers.custom_cuda_release_context) {
         return context->handlers.custom_cuda_release_context(context);
     } else {
-        return active_handlers.custom_cuda_release_context(context);
+        return active_handlers().custom_cuda_release_context(context);
     }
 }
 
@@ -705,7 +1007,7 @@ int cuda_get_stream_handler(JITUserContext *context, void *cuda_context, void **
     if (context && context->handlers.custom_cuda_get_stream) {
         return context->handlers.custom_cuda_get_stream(context, cuda_context, cuda_stream_ptr);
     } else {
-        return active_handlers.custom_cuda_get_stream(context, cuda_context, cuda_stream_ptr);
+        return active_handlers().custom_cuda_get_stream(context, cuda_context, cuda_stream_ptr);
     }
 }
 
@@ -929,8 +1231,7 @@ JITModule &make_module(llvm::Module *for_module, Target target,
             runtime_internal_handlers.custom_get_library_symbol =
                 hook_function(runtime.exports(), "halide_set_custom_get_library_symbol", get_library_symbol_handler);
 
-            active_handlers = runtime_internal_handlers;
-            merge_handlers(active_handlers, default_handlers);
+            update_active_handlers();
 
             if (default_cache_size != 0) {
                 runtime.memoization_cache_set_size(default_cache_size);
@@ -962,8 +1263,7 @@ JITModule &make_module(llvm::Module *for_module, Target target,
                     runtime_internal_handlers.custom_cuda_get_stream =
                         hook_function(runtime.exports(), "halide_set_cuda_get_stream", cuda_get_stream_handler);
 
-                    active_handlers = runtime_internal_handlers;
-                    merge_handlers(active_handlers, default_handlers);
+                    update_active_handlers();
                 } else if (runtime_kind == CUDA) {
                     // The CUDADebug module has already been created.
                     // Use the context in the CUDADebug module and add
@@ -1065,7 +1365,7 @@ std::vector<JITModule> JITSharedRuntime::get(llvm::Module *for_module, const Tar
 
 void JITSharedRuntime::populate_jit_handlers(JITUserContext *jit_user_context, const JITHandlers &handlers) {
     // Take the active global handlers
-    JITHandlers merged = active_handlers;
+    JITHandlers merged = active_handlers();
     // Clobber with any custom handlers set on the pipeline
     merge_handlers(merged, handlers);
     // Clobber with any custom handlers set on the call
@@ -1082,10 +1382,10 @@ void JITSharedRuntime::release_all() {
 }
 
 JITHandlers JITSharedRuntime::set_default_handlers(const JITHandlers &handlers) {
+    std::scoped_lock lock(shared_runtimes_mutex);
     JITHandlers result = default_handlers;
     default_handlers = handlers;
-    active_handlers = runtime_internal_handlers;
-    merge_handlers(active_handlers, default_handlers);
+    update_active_handlers();
     return result;
 }
 
@@ -1103,11 +1403,39 @@ void JITSharedRuntime::memoization_cache_evict(uint64_t eviction_key) {
     shared_runtimes(MainShared).memoization_cache_evict(eviction_key);
 }
 
+halide_memoization_cache_eviction_policy_t
+JITSharedRuntime::memoization_cache_set_eviction_policy(halide_memoization_cache_eviction_policy_t policy) {
+    std::scoped_lock lock(shared_runtimes_mutex);
+    return shared_runtimes(MainShared).memoization_cache_set_eviction_policy(policy);
+}
+
+int JITSharedRuntime::memoization_cache_set_persistent_path(const std::string &path) {
+    std::scoped_lock lock(shared_runtimes_mutex);
+    return shared_runtimes(MainShared).memoization_cache_set_persistent_path(path.empty() ? nullptr : path.c_str());
+}
+
+int JITSharedRuntime::memoization_cache_get_stats(halide_memoization_cache_stats_t *stats,
+                                                  halide_memoization_cache_func_stats_t *func_stats,
+                                                  int max_func_stats) {
+    std::scoped_lock lock(shared_runtimes_mutex);
+    return shared_runtimes(MainShared).memoization_cache_get_stats(stats, func_stats, max_func_stats);
+}
+
 void JITSharedRuntime::reuse_device_allocations(bool b) {
     std::scoped_lock lock(shared_runtimes_mutex);
     shared_runtimes(MainShared).reuse_device_allocations(b);
 }
 
+void JITSharedRuntime::reuse_host_allocations(bool b) {
+    std::scoped_lock lock(shared_runtimes_mutex);
+    shared_runtimes(MainShared).reuse_host_allocations(b);
+}
+
+void JITSharedRuntime::get_host_allocation_stats(halide_host_allocation_stats_t *stats) {
+    std::scoped_lock lock(shared_runtimes_mutex);
+    shared_runtimes(MainShared).get_host_allocation_stats(stats);
+}
+
 int JITSharedRuntime::get_num_threads() {
     std::scoped_lock lock(shared_runtimes_mutex);
     return shared_runtimes(MainShared).get_num_threads();
@@ -1118,6 +1446,11 @@ int JITSharedRuntime::set_num_threads(int n) {
     return shared_runtimes(MainShared).set_num_threads(n);
 }
 
+bool JITSharedRuntime::set_thread_affinity(bool b) {
+    std::scoped_lock lock(shared_runtimes_mutex);
+    return shared_runtimes(MainShared).set_thread_affinity(b);
+}
+
 JITCache::JITCache(Target jit_target,
                    std::vector<Argument> arguments,
                    std::map<std::string, JITExtern> jit_externs,
@@ -1155,7 +1488,10 @@ int JITCache::call_jit_code(const void *const *args) {
                     "compilation for Halide code.";
 #endif
 #endif
-    if (get_compiled_jit_target().arch == Target::WebAssembly) {
+    // This is on the path of every call into jitted code, which may come
+    // from many threads at once, so skip the checks in
+    // get_compiled_jit_target() here.
+    if (jit_target.arch == Target::WebAssembly) {
         internal_assert(wasm_module.contents.defined());
         return wasm_module.run(args);
     } else {
@@ -244,15 +244,36 @@ struct JITModule {
     /** See JITSharedRuntime::memoization_cache_evict */
     void memoization_cache_evict(uint64_t eviction_key) const;
 
+    /** See JITSharedRuntime::memoization_cache_set_eviction_policy */
+    halide_memoization_cache_eviction_policy_t
+    memoization_cache_set_eviction_policy(halide_memoization_cache_eviction_policy_t policy) const;
+
+    /** See JITSharedRuntime::memoization_cache_set_persistent_path */
+    int memoization_cache_set_persistent_path(const char *path) const;
+
+    /** See JITSharedRuntime::memoization_cache_get_stats */
+    int memoization_cache_get_stats(halide_memoization_cache_stats_t *stats,
+                                    halide_memoization_cache_func_stats_t *func_stats,
+                                    int max_func_stats) const;
+
     /** See JITSharedRuntime::reuse_device_allocations */
     void reuse_device_allocations(bool) const;
 
+    /** See JITSharedRuntime::reuse_host_allocations */
+    void reuse_host_allocations(bool) const;
+
+    /** See JITSharedRuntime::get_host_allocation_stats */
+    void get_host_allocation_stats(halide_host_allocation_stats_t *stats) const;
+
     /** See JITSharedRuntime::get_num_threads */
     int get_num_threads() const;
 
     /** See JITSharedRuntime::set_num_threads */
     int set_num_threads(int) const;
 
+    /** See JITSharedRuntime::set_thread_affinity */
+    bool set_thread_affinity(bool) const;
+
     /** Return true if compile_module has been called on this module. */
     bool compiled() const;
 };
@@ -277,6 +298,31 @@ public:
      */
     static void memoization_cache_evict(uint64_t eviction_key);
 
+    /** Set how the memoization cache picks entries to evict, and return
+     * the old policy. If you are compiling statically, you should include
+     * HalideRuntime.h and call
+     * halide_memoization_cache_set_eviction_policy() instead.
+     */
+    static halide_memoization_cache_eviction_policy_t
+    memoization_cache_set_eviction_policy(halide_memoization_cache_eviction_policy_t policy);
+
+    /** Set the directory of the persistent tier of the memoization cache,
+     * or disable it if the path is empty. Returns zero on success. If you
+     * are compiling statically, you should include HalideRuntime.h and call
+     * halide_memoization_cache_set_persistent_path() instead.
+     */
+    static int memoization_cache_set_persistent_path(const std::string &path);
+
+    /** Get hit, miss, eviction and size statistics for the memoization
+     * cache, optionally broken down by memoized Func. Returns the number
+     * of memoized Funcs tracked. If you are compiling statically, you
+     * should include HalideRuntime.h and call
+     * halide_memoization_cache_get_stats() instead.
+     */
+    static int memoization_cache_get_stats(halide_memoization_cache_stats_t *stats,
+                                           halide_memoization_cache_func_stats_t *func_stats = nullptr,
+                                           int max_func_stats = 0);
+
     /** Set whether or not Halide may hold onto and reuse device
      * allocations to avoid calling expensive device API allocation
      * functions. If you are compiling statically, you should include
@@ -284,6 +330,17 @@ public:
      * instead. */
     static void reuse_device_allocations(bool);
 
+    /** Set whether or not Halide may hold onto freed host allocations and
+     * reuse them for later allocations of a similar size. If you are
+     * compiling statically, you should include HalideRuntime.h and call
+     * halide_reuse_host_allocations instead. */
+    static void reuse_host_allocations(bool);
+
+    /** Get statistics about the reuse of host allocations. If you are
+     * compiling statically, you should include HalideRuntime.h and call
+     * halide_get_host_allocation_stats instead. */
+    static void get_host_allocation_stats(halide_host_allocation_stats_t *stats);
+
     static void release_all();
 
     /** Get the number of threads in the Halide thread pool. Includes the
@@ -297,6 +354,12 @@ public:
      * avoid deadlock when using the async scheduling directive. Returns the old
      * number. */
     static int set_num_threads(int);
+
+    /** Set whether the Halide thread pool pins its worker threads to CPUs
+     * and keeps work on the NUMA node it came from. See
+     * halide_set_thread_affinity in HalideRuntime.h. Takes effect the next
+     * time the thread pool starts up. Returns the old value. */
+    static bool set_thread_affinity(bool);
 };
 
 void *get_symbol_address(const char *s);
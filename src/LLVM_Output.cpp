@@ -6,6 +6,7 @@
 #include "LLVM_Headers.h"
 #include "LLVM_Runtime_Linker.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -349,29 +350,18 @@ std::unique_ptr<llvm::Module> clone_module(const llvm::Module &module_in) {
     return std::move(cloned_module.get());
 }
 
-void emit_file(const llvm::Module &module_in, Internal::LLVMOStream &out,
-               llvm::CodeGenFileType file_type) {
-    debug(1) << "emit_file.Compiling to native code...\n";
-#if LLVM_VERSION >= 210
-    debug(2) << "Target triple: " << module_in.getTargetTriple().str() << "\n";
-#else
-    debug(2) << "Target triple: " << module_in.getTargetTriple() << "\n";
-#endif
-
-    auto time_start = std::chrono::high_resolution_clock::now();
-
-    // Work on a copy of the module to avoid modifying the original.
-    std::unique_ptr<llvm::Module> module = clone_module(module_in);
-
+// Run the code generator on a module, which it may modify.
+void emit_module(llvm::Module &module, Internal::LLVMOStream &out,
+                 llvm::CodeGenFileType file_type) {
     // Get the target specific parser.
-    auto target_machine = Internal::make_target_machine(*module);
+    auto target_machine = Internal::make_target_machine(module);
     internal_assert(target_machine.get()) << "Could not allocate target machine!\n";
 
     llvm::DataLayout target_data_layout(target_machine->createDataLayout());
-    if (!(target_data_layout == module->getDataLayout())) {
+    if (!(target_data_layout == module.getDataLayout())) {
         internal_error << "Warning: module's data layout does not match target machine's\n"
                        << target_data_layout.getStringRepresentation() << "\n"
-                       << module->getDataLayout().getStringRepresentation() << "\n";
+                       << module.getDataLayout().getStringRepresentation() << "\n";
     }
 
     // Build up all of the passes that we want to do to the module.
@@ -388,7 +378,7 @@ void emit_file(const llvm::Module &module_in, Internal::LLVMOStream &out,
     // https://groups.google.com/g/llvm-dev/c/HoS07gXx0p8
     llvm::legacy::PassManager pass_manager;
 
-    const auto &triple = llvm::Triple(module->getTargetTriple());
+    const auto &triple = llvm::Triple(module.getTargetTriple());
     pass_manager.add(new llvm::TargetLibraryInfoWrapperPass(triple));
 
     // Make sure things marked as always-inline get inlined
@@ -415,19 +405,125 @@ void emit_file(const llvm::Module &module_in, Internal::LLVMOStream &out,
     // Ask the target to add backend passes as necessary.
     target_machine->addPassesToEmitFile(pass_manager, out, nullptr, file_type);
 
-    pass_manager.run(*module);
+    pass_manager.run(module);
+}
+
+void emit_file(const llvm::Module &module_in, Internal::LLVMOStream &out,
+               llvm::CodeGenFileType file_type) {
+    debug(1) << "emit_file.Compiling to native code...\n";
+#if LLVM_VERSION >= 210
+    debug(2) << "Target triple: " << module_in.getTargetTriple().str() << "\n";
+#else
+    debug(2) << "Target triple: " << module_in.getTargetTriple() << "\n";
+#endif
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+
+    // Work on a copy of the module to avoid modifying the original.
+    std::unique_ptr<llvm::Module> module = clone_module(module_in);
+
+    emit_module(*module, out, file_type);
 
     auto *logger = Internal::get_compiler_logger();
     if (logger) {
         auto time_end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> diff = time_end - time_start;
         logger->record_compilation_time(Internal::CompilerLogger::Phase::LLVM, diff.count());
+        logger->record_compilation_time(Internal::CompilerLogger::Phase::LLVMCodeGen, diff.count());
     }
 
     // If -time-passes is in HL_LLVM_ARGS, this will print llvm passes time statstics otherwise its no-op.
     llvm::reportAndResetTimings();
 }
 
+// Give every global value with local linkage a name that is unique to this
+// module, so that they can be made visible to the other partitions without
+// clashing with symbols of other modules linked into the same program.
+// Returns the suffix used.
+std::string make_local_names_unique(llvm::Module &module) {
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream stream(bitcode);
+    WriteBitcodeToFile(module, stream);
+    llvm::SHA256 hash;
+    hash.update(llvm::ArrayRef<uint8_t>((const uint8_t *)bitcode.data(), bitcode.size()));
+    const std::string suffix = "." + llvm::toHex(hash.final(), /*LowerCase*/ true).substr(0, 16);
+
+    for (llvm::GlobalValue &gv : module.global_values()) {
+        if (gv.hasLocalLinkage()) {
+            gv.setName((gv.hasName() ? gv.getName().str() : std::string("unnamed")) + suffix);
+        }
+    }
+    return suffix;
+}
+
+// A static library member is only linked in if it defines a symbol that is
+// needed, so make every partition refer to a symbol in each partition that
+// has static constructors or destructors. They then get linked in whenever
+// any other part of the module is.
+void anchor_constructors(std::vector<std::unique_ptr<llvm::Module>> &parts, const std::string &suffix) {
+    for (size_t i = 0; i < parts.size(); i++) {
+        bool has_constructors = false;
+        for (const char *name : {"llvm.global_ctors", "llvm.global_dtors"}) {
+            llvm::GlobalVariable *gv = parts[i]->getNamedGlobal(name);
+            has_constructors |= gv && !gv->isDeclaration();
+        }
+        if (!has_constructors) {
+            continue;
+        }
+
+        const std::string anchor_name = "halide_partition_anchor" + suffix + "." + std::to_string(i);
+        llvm::Type *i8_t = llvm::Type::getInt8Ty(parts[i]->getContext());
+        auto *anchor = new llvm::GlobalVariable(*parts[i], i8_t, /*isConstant*/ true,
+                                                llvm::GlobalValue::ExternalLinkage,
+                                                llvm::ConstantInt::get(i8_t, 0), anchor_name);
+        anchor->setVisibility(llvm::GlobalValue::HiddenVisibility);
+
+        for (size_t j = 0; j < parts.size(); j++) {
+            if (j == i) {
+                continue;
+            }
+            auto *decl = new llvm::GlobalVariable(*parts[j], i8_t, /*isConstant*/ true,
+                                                  llvm::GlobalValue::ExternalLinkage,
+                                                  nullptr, anchor_name);
+            decl->setVisibility(llvm::GlobalValue::HiddenVisibility);
+            auto *ref = new llvm::GlobalVariable(*parts[j], decl->getType(), /*isConstant*/ true,
+                                                 llvm::GlobalValue::PrivateLinkage,
+                                                 decl, anchor_name + ".ref");
+            llvm::appendToCompilerUsed(*parts[j], {ref});
+        }
+    }
+}
+
+// Split a module into at most max_partitions modules that can be compiled
+// independently, and serialize each of them to bitcode so that they can be
+// read into a separate LLVMContext on each codegen thread.
+std::vector<llvm::SmallVector<char, 0>> split_module_to_bitcode(const llvm::Module &module_in, int max_partitions) {
+    std::unique_ptr<llvm::Module> module = clone_module(module_in);
+    const std::string suffix = make_local_names_unique(*module);
+
+    std::vector<std::unique_ptr<llvm::Module>> parts;
+    llvm::SplitModule(
+        *module, max_partitions, [&](std::unique_ptr<llvm::Module> part) {
+            bool has_contents = !part->getModuleInlineAsm().empty();
+            for (const llvm::GlobalValue &gv : part->global_values()) {
+                has_contents |= !gv.isDeclaration();
+            }
+            if (has_contents) {
+                parts.push_back(std::move(part));
+            }
+        },
+        /*PreserveLocals*/ false, /*RoundRobin*/ true);
+
+    anchor_constructors(parts, suffix);
+
+    std::vector<llvm::SmallVector<char, 0>> result(parts.size());
+    for (size_t i = 0; i < parts.size(); i++) {
+        llvm::raw_svector_ostream stream(result[i]);
+        WriteBitcodeToFile(*parts[i], stream);
+    }
+    return result;
+}
+
 }  // namespace
 
 std::unique_ptr<llvm::Module> compile_module_to_llvm_module(const Module &module, llvm::LLVMContext &context) {
@@ -438,6 +534,54 @@ void compile_llvm_module_to_object(llvm::Module &module, Internal::LLVMOStream &
     emit_file(module, out, llvm::CodeGenFileType::ObjectFile);
 }
 
+int compile_llvm_module_to_objects(const llvm::Module &module, int num_threads,
+                                   const std::function<std::unique_ptr<llvm::raw_fd_ostream>(int)> &make_output) {
+    debug(1) << "compile_llvm_module_to_objects: compiling to native code on " << num_threads << " threads...\n";
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+
+    std::vector<llvm::SmallVector<char, 0>> parts = split_module_to_bitcode(module, num_threads);
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> outs;
+    for (size_t i = 0; i < parts.size(); i++) {
+        outs.push_back(make_output((int)i));
+    }
+
+    Internal::run_in_parallel((int)parts.size(), num_threads, [&](int i) {
+        llvm::LLVMContext context;
+        llvm::MemoryBufferRef buffer_ref(llvm::StringRef(parts[i].data(), parts[i].size()), "partition");
+        auto part = llvm::parseBitcodeFile(buffer_ref, context);
+        internal_assert(part) << llvm::toString(part.takeError()) << "\n";
+        emit_module(**part, *outs[i], llvm::CodeGenFileType::ObjectFile);
+        outs[i]->flush();
+    });
+
+    auto *logger = Internal::get_compiler_logger();
+    if (logger) {
+        auto time_end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> diff = time_end - time_start;
+        logger->record_compilation_time(Internal::CompilerLogger::Phase::LLVM, diff.count());
+        logger->record_compilation_time(Internal::CompilerLogger::Phase::LLVMCodeGen, diff.count());
+    }
+
+    llvm::reportAndResetTimings();
+
+    return (int)parts.size();
+}
+
+int get_codegen_thread_count() {
+    std::string threads = Internal::get_env_variable("HL_CODEGEN_THREADS");
+    if (threads.empty()) {
+        return 1;
+    }
+    return std::max(1, std::atoi(threads.c_str()));
+}
+
+std::string sha256_hex(const std::string &data) {
+    llvm::SHA256 hash;
+    hash.update(data);
+    return llvm::toHex(hash.final(), /*LowerCase*/ true);
+}
+
 void compile_llvm_module_to_assembly(llvm::Module &module, Internal::LLVMOStream &out) {
     emit_file(module, out, llvm::CodeGenFileType::AssemblyFile);
 }
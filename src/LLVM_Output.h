@@ -5,6 +5,7 @@
  *
  */
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -39,6 +40,25 @@ void compile_llvm_module_to_object(llvm::Module &module, Internal::LLVMOStream &
 void compile_llvm_module_to_assembly(llvm::Module &module, Internal::LLVMOStream &out);
 // @}
 
+/** Split an LLVM module into at most num_threads partitions and compile
+ * them to object files concurrently. make_output is called on the calling
+ * thread to open the output for each partition, and the number of
+ * partitions is returned. Symbols with internal linkage are made hidden
+ * (and renamed to be unique to the module) so that the partitions can refer
+ * to each other, and every partition refers to those with static
+ * constructors, so that the objects can be put in a static library in
+ * place of a single object for the whole module. */
+int compile_llvm_module_to_objects(const llvm::Module &module, int num_threads,
+                                   const std::function<std::unique_ptr<llvm::raw_fd_ostream>(int)> &make_output);
+
+/** The number of threads to use to compile a module to a static library,
+ * set with the environment variable HL_CODEGEN_THREADS. Defaults to 1, in
+ * which case the module is compiled to a single object. */
+int get_codegen_thread_count();
+
+/** Return the SHA-256 of a string of bytes, as lowercase hex digits. */
+std::string sha256_hex(const std::string &data);
+
 /** Compile an LLVM module to LLVM targets (bitcode, LLVM assembly). */
 // @{
 void compile_llvm_module_to_llvm_bitcode(llvm::Module &module, Internal::LLVMOStream &out);
@@ -35,6 +35,7 @@
 #include "FuseGPUThreadLoops.h"
 #include "FuzzFloatStores.h"
 #include "HexagonOffload.h"
+#include "IRArena.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "IRPrinter.h"
@@ -91,6 +92,84 @@ using std::vector;
 
 namespace {
 
+// Counts the distinct IR nodes in a Stmt, for the compiler log.
+class CountIRNodes : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    template<typename T>
+    void count(const T *op) {
+        stats.ir_nodes++;
+        stats.ir_bytes += sizeof(T);
+        if (op->node_type > StrongestExprNodeType) {
+            stats.stmts++;
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+#define HALIDE_COUNT_IR_NODE(T)          \
+    void visit(const T *op) override { \
+        count(op);                       \
+    }
+    HALIDE_COUNT_IR_NODE(IntImm)
+    HALIDE_COUNT_IR_NODE(UIntImm)
+    HALIDE_COUNT_IR_NODE(FloatImm)
+    HALIDE_COUNT_IR_NODE(StringImm)
+    HALIDE_COUNT_IR_NODE(Broadcast)
+    HALIDE_COUNT_IR_NODE(Cast)
+    HALIDE_COUNT_IR_NODE(Reinterpret)
+    HALIDE_COUNT_IR_NODE(Variable)
+    HALIDE_COUNT_IR_NODE(Add)
+    HALIDE_COUNT_IR_NODE(Sub)
+    HALIDE_COUNT_IR_NODE(Mod)
+    HALIDE_COUNT_IR_NODE(Mul)
+    HALIDE_COUNT_IR_NODE(Div)
+    HALIDE_COUNT_IR_NODE(Min)
+    HALIDE_COUNT_IR_NODE(Max)
+    HALIDE_COUNT_IR_NODE(EQ)
+    HALIDE_COUNT_IR_NODE(NE)
+    HALIDE_COUNT_IR_NODE(LT)
+    HALIDE_COUNT_IR_NODE(LE)
+    HALIDE_COUNT_IR_NODE(GT)
+    HALIDE_COUNT_IR_NODE(GE)
+    HALIDE_COUNT_IR_NODE(And)
+    HALIDE_COUNT_IR_NODE(Or)
+    HALIDE_COUNT_IR_NODE(Not)
+    HALIDE_COUNT_IR_NODE(Select)
+    HALIDE_COUNT_IR_NODE(Load)
+    HALIDE_COUNT_IR_NODE(Ramp)
+    HALIDE_COUNT_IR_NODE(Call)
+    HALIDE_COUNT_IR_NODE(Let)
+    HALIDE_COUNT_IR_NODE(Shuffle)
+    HALIDE_COUNT_IR_NODE(VectorReduce)
+    HALIDE_COUNT_IR_NODE(LetStmt)
+    HALIDE_COUNT_IR_NODE(AssertStmt)
+    HALIDE_COUNT_IR_NODE(ProducerConsumer)
+    HALIDE_COUNT_IR_NODE(For)
+    HALIDE_COUNT_IR_NODE(Acquire)
+    HALIDE_COUNT_IR_NODE(Store)
+    HALIDE_COUNT_IR_NODE(Provide)
+    HALIDE_COUNT_IR_NODE(Allocate)
+    HALIDE_COUNT_IR_NODE(Free)
+    HALIDE_COUNT_IR_NODE(Realize)
+    HALIDE_COUNT_IR_NODE(Block)
+    HALIDE_COUNT_IR_NODE(Fork)
+    HALIDE_COUNT_IR_NODE(IfThenElse)
+    HALIDE_COUNT_IR_NODE(Evaluate)
+    HALIDE_COUNT_IR_NODE(Prefetch)
+    HALIDE_COUNT_IR_NODE(Atomic)
+    HALIDE_COUNT_IR_NODE(HoistedStorage)
+#undef HALIDE_COUNT_IR_NODE
+
+public:
+    CompilerLogger::LoweringPassStats stats;
+
+    void count(const Stmt &s) {
+        if (s.defined()) {
+            include(s);
+        }
+    }
+};
+
 class LoweringLogger {
     Stmt last_written;
     std::chrono::time_point<std::chrono::high_resolution_clock> last_time;
@@ -111,12 +190,30 @@ public:
             debug(2) << message << "\n"
                      << s << "\n";
             last_written = s;
-            last_time = t;
         } else {
             debug(2) << message << " (unchanged)\n\n";
-            last_time = t;
         }
         timings.emplace_back(diff.count() * 1000, message);
+
+        if (auto *logger = get_compiler_logger()) {
+            // Log the pass by what it did, e.g. "Lowering after vectorizing:"
+            // is logged as "vectorizing".
+            string pass_name = message;
+            const string prefix = "Lowering after ";
+            if (starts_with(pass_name, prefix)) {
+                pass_name = pass_name.substr(prefix.size());
+            }
+            if (ends_with(pass_name, ":")) {
+                pass_name.pop_back();
+            }
+            CountIRNodes counter;
+            counter.count(s);
+            counter.stats.duration = diff.count();
+            logger->record_lowering_pass(pass_name, counter.stats);
+        }
+
+        // Don't count the time spent logging against the next pass.
+        last_time = std::chrono::high_resolution_clock::now();
     }
 
     ~LoweringLogger() {
@@ -145,6 +242,15 @@ void lower_impl(const vector<Function> &output_funcs,
                 Module &result_module) {
     auto time_start = std::chrono::high_resolution_clock::now();
 
+    // Lowering makes and destroys a great many short-lived IR nodes, so
+    // allocate them from an arena if enabled. This is declared before
+    // anything that holds onto IR, so that that IR is freed back to the arena.
+    ScopedIRArena ir_arena;
+
+    // Lowering simplifies a lot of the same Exprs over and over, so
+    // memoize them for the duration.
+    ScopedSimplifyCache simplify_cache;
+
     size_t initial_lowered_function_count = result_module.functions().size();
 
     // Create a deep-copy of the entire graph of Funcs.
@@ -474,8 +580,7 @@ void lower_impl(const vector<Function> &output_funcs,
         for (size_t i = 0; i < custom_passes.size(); i++) {
             debug(1) << "Running custom lowering pass " << i << "...\n";
             s = custom_passes[i]->mutate(s);
-            debug(1) << "Lowering after custom pass " << i << ":\n"
-                     << s << "\n\n";
+            log("Lowering after custom pass " + std::to_string(i) + ":", s);
         }
     }
 
@@ -485,8 +590,7 @@ void lower_impl(const vector<Function> &output_funcs,
     if (t.arch != Target::Hexagon && t.has_feature(Target::HVX)) {
         debug(1) << "Splitting off Hexagon offload...\n";
         s = inject_hexagon_rpc(s, t, result_module);
-        debug(2) << "Lowering after splitting off Hexagon offload:\n"
-                 << s << "\n";
+        log("Lowering after splitting off Hexagon offload:", s);
     } else {
         debug(1) << "Skipping Hexagon offload...\n";
     }
@@ -494,8 +598,7 @@ void lower_impl(const vector<Function> &output_funcs,
     if (t.has_gpu_feature()) {
         debug(1) << "Offloading GPU loops...\n";
         s = inject_gpu_offload(s, t);
-        debug(2) << "Lowering after splitting off GPU loops:\n"
-                 << s << "\n\n";
+        log("Lowering after splitting off GPU loops:", s);
     } else {
         debug(1) << "Skipping GPU offload...\n";
     }
@@ -525,8 +628,7 @@ void lower_impl(const vector<Function> &output_funcs,
     for (auto &lowered_func : closure_implementations) {
         result_module.append(lowered_func);
     }
-    debug(2) << "Lowering after generating parallel tasks and closures:\n"
-             << s << "\n\n";
+    log("Lowering after generating parallel tasks and closures:", s);
 
     vector<Argument> public_args = args;
     for (const auto &out : outputs) {
@@ -615,6 +717,7 @@ void lower_impl(const vector<Function> &output_funcs,
         auto time_end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> diff = time_end - time_start;
         logger->record_compilation_time(CompilerLogger::Phase::HalideLowering, diff.count());
+        logger->record_simplify_cache_stats(simplify_cache.hits(), simplify_cache.misses());
     }
 }
 
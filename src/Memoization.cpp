@@ -3,13 +3,17 @@
 #include "Function.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "IRPrinter.h"
 #include "IRVisitor.h"
 #include "Param.h"
 #include "Scope.h"
 #include "Util.h"
 #include "Var.h"
 
+#include <algorithm>
+#include <cctype>
 #include <map>
+#include <sstream>
 
 namespace Halide {
 namespace Internal {
@@ -158,11 +162,90 @@ public:
 typedef std::pair<FindParameterDependencies::DependencyKey, FindParameterDependencies::DependencyInfo> DependencyKeyInfoPair;
 typedef std::pair<const FindParameterDependencies::DependencyKey, FindParameterDependencies::DependencyInfo> ConstDependencyKeyInfoPair;
 
+// Unique names are numbered in the order they were made in the process,
+// e.g. "f", "f$1", "f$2", or "t12" for names made by the compiler. Renumber
+// them in the order they appear, so that the same pipeline gets the same
+// build id, and its memoized Funcs the same names in the cache key,
+// whatever else the process made first. The renaming is one-to-one, so
+// different code still gets different text.
+class CanonicalNames {
+    std::map<std::string, std::string> renamed;
+    std::map<std::string, int> counts;
+
+    static bool is_name_char(char c) {
+        return std::isalnum((unsigned char)c) || c == '_' || c == '$';
+    }
+
+    static bool is_digits(const std::string &s, size_t begin, size_t end) {
+        if (begin >= end) {
+            return false;
+        }
+        for (size_t i = begin; i < end; i++) {
+            if (!std::isdigit((unsigned char)s[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The length of the unique name a token starts with, e.g. "f$2" in
+    // "f$2$x", or "r4" in "r4$x".
+    static size_t unique_name_size(const std::string &token) {
+        const size_t base = std::min(token.find('$'), token.size());
+        if (base == token.size()) {
+            return base;
+        }
+        const size_t counter = std::min(token.find('$', base + 1), token.size());
+        return is_digits(token, base + 1, counter) ? counter : base;
+    }
+
+public:
+    std::string name(const std::string &n) {
+        auto it = renamed.find(n);
+        if (it != renamed.end()) {
+            return it->second;
+        }
+        const std::string base = n.substr(0, std::min(n.find('$'), n.size()));
+        std::string result;
+        if (base.size() > 1 && std::isalpha((unsigned char)base[0]) && is_digits(base, 1, base.size())) {
+            // A name the compiler made from a single letter.
+            const std::string letter = base.substr(0, 1);
+            result = letter + std::to_string(counts[letter]++);
+        } else {
+            const int k = counts[base]++;
+            result = k == 0 ? base : base + "$" + std::to_string(k);
+        }
+        renamed.emplace(n, result);
+        return result;
+    }
+
+    std::string text(const std::string &t) {
+        std::string result;
+        result.reserve(t.size());
+        for (size_t i = 0; i < t.size();) {
+            size_t j = i;
+            while (j < t.size() && is_name_char(t[j])) {
+                j++;
+            }
+            if (j == i) {
+                result += t[i++];
+                continue;
+            }
+            const std::string token = t.substr(i, j - i);
+            const size_t size = unique_name_size(token);
+            result += name(token.substr(0, size)) + token.substr(size);
+            i = j;
+        }
+        return result;
+    }
+};
+
 class KeyInfo {
     FindParameterDependencies dependencies;
     Expr key_size_expr;
     const std::string &top_level_name;
-    const std::string &function_name;
+    std::string function_name;
+    const std::string &build_id;
     int memoize_instance;
 
     size_t parameters_alignment() {
@@ -195,9 +278,11 @@ class KeyInfo {
     // It was deleted as part of the address_of intrinsic cleanup).
 
 public:
-    KeyInfo(const Function &function, const std::string &name, int memoize_instance)
+    KeyInfo(const Function &function, const std::string &function_name, const std::string &name,
+            const std::string &build_id, int memoize_instance)
         : top_level_name(name),
-          function_name(function.origin_name()),
+          function_name(function_name),
+          build_id(build_id),
           memoize_instance(memoize_instance) {
         dependencies.visit_function(function);
         size_t size_so_far = 0;
@@ -230,10 +315,13 @@ public:
         // Store a pointer to a string identifying the filter and
         // function. Assume this will be unique due to CSE. This can
         // break with loading and unloading of code, though the name
-        // mechanism can also break in those conditions.
+        // mechanism can also break in those conditions. The string ends
+        // with the build id, so that the runtime can tell results
+        // written to disk by a different build of the pipeline apart.
         writes.push_back(Store::make(key_name,
                                      StringImm::make(std::to_string(top_level_name.size()) + ":" + top_level_name +
-                                                     std::to_string(function_name.size()) + ":" + function_name),
+                                                     std::to_string(function_name.size()) + ":" + function_name +
+                                                     std::to_string(build_id.size()) + ":" + build_id),
                                      (index / Handle().bytes()), Parameter(), const_true(), ModulusRemainder()));
         size_t alignment = Handle().bytes();
         index += Handle().bytes();
@@ -327,13 +415,17 @@ public:
     const std::map<std::string, Function> &env;
     int memoize_instance;
     const std::string &top_level_name;
+    const std::string &build_id;
+    CanonicalNames &names;
     const std::vector<Function> &outputs;
 
     InjectMemoization(const std::map<std::string, Function> &e,
                       int memoize_instance,
                       const std::string &name,
+                      const std::string &build_id,
+                      CanonicalNames &names,
                       const std::vector<Function> &outputs)
-        : env(e), memoize_instance(memoize_instance), top_level_name(name), outputs(outputs) {
+        : env(e), memoize_instance(memoize_instance), top_level_name(name), build_id(build_id), names(names), outputs(outputs) {
     }
 
 private:
@@ -366,7 +458,7 @@ private:
 
             Stmt mutated_body = mutate(op->body);
 
-            KeyInfo key_info(f, top_level_name, memoize_instance);
+            KeyInfo key_info(f, names.name(f.origin_name()), top_level_name, build_id, memoize_instance);
 
             std::string cache_key_name = op->name + ".cache_key";
             std::string cache_result_name = op->name + ".cache_result";
@@ -433,7 +525,7 @@ private:
                 Expr cache_miss = Variable::make(Bool(), cache_miss_name);
 
                 const Function f(iter->second);
-                KeyInfo key_info(f, top_level_name, memoize_instance);
+                KeyInfo key_info(f, names.name(f.origin_name()), top_level_name, build_id, memoize_instance);
 
                 std::string cache_key_name = op->name + ".cache_key";
                 std::string computed_bounds_name = op->name + ".computed_bounds.buffer";
@@ -464,11 +556,27 @@ Stmt inject_memoization(const Stmt &s, const std::map<std::string, Function> &en
                         const std::vector<Function> &outputs) {
     // Cache keys use the addresses of names of Funcs. For JIT, a
     // counter for the pipeline is needed as the address may be reused
-    // across pipelines. This isn't a problem when using full names as
-    // the function names already are uniquefied by a counter.
+    // across pipelines. The counter only means something in this process,
+    // so the persistent tier of the cache leaves it out, and relies on the
+    // build id instead.
     static std::atomic<int> memoize_instance{0};
 
-    InjectMemoization injector(env, memoize_instance++, name, outputs);
+    // Identify this build of the pipeline by a hash of its loop nest,
+    // which covers the definitions and schedules of all its Funcs. Use
+    // FNV-1a rather than std::hash, as it must be the same in every build
+    // of the compiler.
+    std::ostringstream stmt;
+    stmt << s;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    CanonicalNames names;
+    for (char c : names.text(stmt.str())) {
+        hash = (hash ^ (uint8_t)c) * 0x100000001b3ULL;
+    }
+    std::ostringstream hex;
+    hex << std::hex << hash;
+    const std::string build_id = hex.str();
+
+    InjectMemoization injector(env, memoize_instance++, name, build_id, names, outputs);
 
     return injector.mutate(s);
 }
@@ -633,7 +633,24 @@ void Module::compile(const std::map<OutputFileType, std::string> &output_files)
             // (Use a separate TemporaryFileDir here so we don't try to embed assembly files from
             // `temp_assembly_dir` into a static library...)
             TemporaryFileDir temp_object_dir;
-            {
+            const int codegen_threads = get_codegen_thread_count();
+            if (codegen_threads > 1) {
+                // A static library can hold one object per partition of the
+                // module, so compile the partitions concurrently.
+                compile_llvm_module_to_objects(*llvm_module, codegen_threads, [&](int i) {
+                    std::string object = temp_object_dir.add_temp_object_file(output_files.at(OutputFileType::static_library),
+                                                                              "_part" + std::to_string(i), target());
+                    debug(1) << "Module.compile(): temporary object " << object << "\n";
+                    return make_raw_fd_ostream(object);
+                });
+                if (logger && !contains(output_files, OutputFileType::object)) {
+                    uint64_t size = 0;
+                    for (const auto &object : temp_object_dir.files()) {
+                        size += file_stat(object).file_size;
+                    }
+                    logger->record_object_code_size(size);
+                }
+            } else {
                 std::string object = temp_object_dir.add_temp_object_file(output_files.at(OutputFileType::static_library), "", target());
                 debug(1) << "Module.compile(): temporary object " << object << "\n";
                 auto out = make_raw_fd_ostream(object);
@@ -834,7 +851,8 @@ void compile_multitarget(const std::string &fn_name,
                          const std::vector<Target> &targets,
                          const std::vector<std::string> &suffixes,
                          const ModuleFactory &module_factory,
-                         const CompilerLoggerFactory &compiler_logger_factory) {
+                         const CompilerLoggerFactory &compiler_logger_factory,
+                         int num_threads) {
     validate_outputs(output_files);
 
     user_assert(!fn_name.empty()) << "Function name must be specified.\n";
@@ -911,10 +929,18 @@ void compile_multitarget(const std::string &fn_name,
     uint64_t runtime_features[kFeaturesWordCount] = {(uint64_t)-1LL};
 
     TemporaryFileDir temp_obj_dir, temp_compiler_log_dir;
-    std::vector<Expr> wrapper_args;
-    std::vector<LoweredArgument> base_target_args;
-    std::vector<AutoSchedulerResults> auto_scheduler_results;
-    MetadataNameMap metadata_name_map;
+
+    // Validate the targets and decide where each of their outputs goes up
+    // front, so that the targets can then be compiled concurrently.
+    struct SubTarget {
+        std::string fn_name;
+        Target target;
+        std::map<OutputFileType, std::string> outputs;
+        std::vector<LoweredArgument> args;
+        AutoSchedulerResults auto_scheduler_results;
+        MetadataNameMap metadata_name_map;
+    };
+    std::vector<SubTarget> sub_targets(targets.size());
 
     for (size_t i = 0; i < targets.size(); ++i) {
         const Target &target = targets[i];
@@ -946,40 +972,56 @@ void compile_multitarget(const std::string &fn_name,
 
         // Each sub-target has a function name that is the 'real' name plus a suffix
         std::string suffix = suffix_for_entry(i);
-        std::string sub_fn_name = needs_wrapper ? (fn_name + suffix) : fn_name;
+        SubTarget &sub = sub_targets[i];
+        sub.fn_name = needs_wrapper ? (fn_name + suffix) : fn_name;
 
         // We always produce the runtime separately, so add NoRuntime explicitly.
-        Target sub_fn_target = target.with_feature(Target::NoRuntime);
+        sub.target = target.with_feature(Target::NoRuntime);
 
-        // Ensure that each subtarget sees the same sequence of random numbers
-        reset_random_counters();
-        {
-            ScopedCompilerLogger activate(compiler_logger_factory, sub_fn_name, sub_fn_target);
-            Module sub_module = module_factory(sub_fn_name, sub_fn_target);
-            // Re-assign every time -- should be the same across all targets anyway,
-            // but base_target is always the last one we encounter.
-            base_target_args = sub_module.get_function_by_name(sub_fn_name).args;
-
-            auto sub_out = add_suffixes(output_files, suffix);
-            if (contains(output_files, OutputFileType::static_library)) {
-                sub_out[OutputFileType::object] = temp_obj_dir.add_temp_object_file(output_files.at(OutputFileType::static_library), suffix, target);
-                sub_out.erase(OutputFileType::static_library);
-            }
-            sub_out.erase(OutputFileType::registration);
-            sub_out.erase(OutputFileType::schedule);
-            sub_out.erase(OutputFileType::c_header);
-            sub_out.erase(OutputFileType::function_info_header);
-            if (contains(sub_out, OutputFileType::compiler_log)) {
-                sub_out[OutputFileType::compiler_log] = temp_compiler_log_dir.add_temp_file(output_files.at(OutputFileType::compiler_log), suffix, target);
-            }
-            debug(1) << "compile_multitarget: compile_sub_target " << sub_out[OutputFileType::object] << "\n";
-            sub_module.compile(sub_out);
-            const auto *r = sub_module.get_auto_scheduler_results();
-            auto_scheduler_results.push_back(r ? *r : AutoSchedulerResults());
-            if (target == base_target) {
-                metadata_name_map = sub_module.get_metadata_name_map();
-            }
+        auto sub_out = add_suffixes(output_files, suffix);
+        if (contains(output_files, OutputFileType::static_library)) {
+            sub_out[OutputFileType::object] = temp_obj_dir.add_temp_object_file(output_files.at(OutputFileType::static_library), suffix, target);
+            sub_out.erase(OutputFileType::static_library);
+        }
+        sub_out.erase(OutputFileType::registration);
+        sub_out.erase(OutputFileType::schedule);
+        sub_out.erase(OutputFileType::c_header);
+        sub_out.erase(OutputFileType::function_info_header);
+        if (contains(sub_out, OutputFileType::compiler_log)) {
+            sub_out[OutputFileType::compiler_log] = temp_compiler_log_dir.add_temp_file(output_files.at(OutputFileType::compiler_log), suffix, target);
         }
+        sub.outputs = std::move(sub_out);
+    }
+
+    // Every sub-target starts from the same unique_name counters, and sees
+    // the same sequence of random numbers, so what each one produces doesn't
+    // depend on the order in which they are compiled.
+    std::vector<NameCounters> name_counters(targets.size(), snapshot_name_counters());
+    run_in_parallel((int)targets.size(), num_threads, [&](int i) {
+        SubTarget &sub = sub_targets[i];
+        ScopedNameCounters scoped_name_counters(name_counters[i]);
+        ScopedCompilerLogger activate(compiler_logger_factory, sub.fn_name, sub.target);
+        Module sub_module = module_factory(sub.fn_name, sub.target);
+        sub.args = sub_module.get_function_by_name(sub.fn_name).args;
+        debug(1) << "compile_multitarget: compile_sub_target " << sub.outputs[OutputFileType::object] << "\n";
+        sub_module.compile(sub.outputs);
+        const auto *r = sub_module.get_auto_scheduler_results();
+        sub.auto_scheduler_results = r ? *r : AutoSchedulerResults();
+        sub.metadata_name_map = sub_module.get_metadata_name_map();
+    });
+    for (const NameCounters &counters : name_counters) {
+        merge_name_counters(counters);
+    }
+
+    // Should be the same across all targets anyway, but the base target is the last one.
+    const std::vector<LoweredArgument> &base_target_args = sub_targets.back().args;
+    const MetadataNameMap &metadata_name_map = sub_targets.back().metadata_name_map;
+    std::vector<AutoSchedulerResults> auto_scheduler_results;
+    std::vector<Expr> wrapper_args;
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+        const Target &target = targets[i];
+        auto_scheduler_results.push_back(sub_targets[i].auto_scheduler_results);
 
         uint64_t cur_target_features[kFeaturesWordCount] = {0};
         for (int i = 0; i < Target::FeatureEnd; ++i) {
@@ -1006,7 +1048,7 @@ void compile_multitarget(const std::string &fn_name,
         }
 
         wrapper_args.push_back(can_use != 0);
-        wrapper_args.emplace_back(sub_fn_name);
+        wrapper_args.emplace_back(sub_targets[i].fn_name);
     }
 
     // If we haven't specified "no runtime", build a runtime with the base target
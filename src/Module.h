@@ -242,12 +242,19 @@ std::map<OutputFileType, std::string> compile_standalone_runtime(const std::map<
 using ModuleFactory = std::function<Module(const std::string &fn_name, const Target &target)>;
 using CompilerLoggerFactory = std::function<std::unique_ptr<Internal::CompilerLogger>(const std::string &fn_name, const Target &target)>;
 
+/** Compile the Modules produced by module_factory for each of the given
+ * targets, plus a wrapper that picks between them at runtime. If num_threads
+ * is greater than one, up to that many targets are lowered and compiled
+ * concurrently, so module_factory and compiler_logger_factory must be safe
+ * to call from several threads at once. The output doesn't depend on
+ * num_threads. */
 void compile_multitarget(const std::string &fn_name,
                          const std::map<OutputFileType, std::string> &output_files,
                          const std::vector<Target> &targets,
                          const std::vector<std::string> &suffixes,
                          const ModuleFactory &module_factory,
-                         const CompilerLoggerFactory &compiler_logger_factory = nullptr);
+                         const CompilerLoggerFactory &compiler_logger_factory = nullptr,
+                         int num_threads = 1);
 
 }  // namespace Halide
 
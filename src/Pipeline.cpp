@@ -1,4 +1,9 @@
 #include <algorithm>
+#include <atomic>
+#include <list>
+#include <set>
+#include <sstream>
+#include <thread>
 #include <utility>
 
 #include "Argument.h"
@@ -7,6 +12,8 @@
 #include "Deserialization.h"
 #include "FindCalls.h"
 #include "Func.h"
+#include "IREquality.h"
+#include "IRPrinter.h"
 #include "IRVisitor.h"
 #include "InferArguments.h"
 #include "LLVM_Output.h"
@@ -16,6 +23,7 @@
 #include "PrintLoopNest.h"
 #include "RealizationOrder.h"
 #include "Serialization.h"
+#include "Util.h"
 #include "WasmExecutor.h"
 
 using namespace Halide::Internal;
@@ -70,10 +78,358 @@ std::string sanitize_function_name(const std::string &s) {
     return name;
 }
 
+std::atomic<size_t> &lowering_cache_size_limit() {
+    static std::atomic<size_t> limit{[]() -> size_t {
+        std::string size = get_env_variable("HL_LOWERING_CACHE_SIZE");
+        if (size.empty()) {
+            return 1;
+        }
+        return (size_t)std::max(0LL, std::atoll(size.c_str()));
+    }()};
+    return limit;
+}
+
+// Everything lowering a Pipeline depends on, so that the Module lowered
+// from it can be reused for as long as none of it has changed. The Exprs and
+// Stmts involved are compared structurally, and everything else, including
+// the Parameters and Buffers those refer to, is written out as text.
+struct LoweringKey {
+    Target target;
+    std::string text;
+    std::vector<IRHandle> ir;
+
+    bool operator==(const LoweringKey &other) const {
+        if (target != other.target ||
+            text != other.text ||
+            ir.size() != other.ir.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < ir.size(); i++) {
+            if (!graph_equal(ir[i], other.ir[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+class MakeLoweringKey : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    std::ostringstream s;
+    std::vector<IRHandle> ir;
+    std::set<Parameter> params;
+
+    void visit(const Variable *op) override {
+        add(op->param);
+        add(op->image);
+    }
+
+    void visit(const Call *op) override {
+        IRGraphVisitor::visit(op);
+        add(op->param);
+        add(op->image);
+    }
+
+    void add(const std::string &str) {
+        s << str.size() << ":" << str << " ";
+    }
+
+    void add(const std::vector<std::string> &strs) {
+        s << strs.size() << " ";
+        for (const std::string &str : strs) {
+            add(str);
+        }
+    }
+
+    void add(const Expr &e) {
+        ir.push_back(e);
+        if (e.defined()) {
+            include(e);
+        }
+    }
+
+    void add(const Stmt &st) {
+        ir.push_back(st);
+        if (st.defined()) {
+            include(st);
+        }
+    }
+
+    void add(const std::vector<Expr> &exprs) {
+        s << exprs.size() << " ";
+        for (const Expr &e : exprs) {
+            add(e);
+        }
+    }
+
+    void add(const std::vector<Type> &types) {
+        s << types.size() << " ";
+        for (const Type &t : types) {
+            s << t << " ";
+        }
+    }
+
+    void add(const Buffer<> &b) {
+        // A Buffer embedded in the pipeline is kept alive by the Module
+        // lowered from it, so its address identifies it.
+        s << "buffer ";
+        if (b.defined()) {
+            add(b.name());
+            s << (const void *)b.raw_buffer() << " ";
+        }
+    }
+
+    void add(const Parameter &p) {
+        if (!p.defined() || !params.insert(p).second) {
+            return;
+        }
+        s << "param ";
+        add(p.name());
+        s << p.is_buffer() << " " << p.type() << " " << p.dimensions() << " "
+          << p.memory_type() << " " << p.is_tracing_loads() << " ";
+        add(p.get_trace_tags());
+        if (p.is_buffer()) {
+            s << p.host_alignment() << " ";
+            for (const BufferConstraint &c : p.buffer_constraints()) {
+                add(c.min);
+                add(c.extent);
+                add(c.stride);
+                add(c.min_estimate);
+                add(c.extent_estimate);
+            }
+        } else {
+            add(p.min_value());
+            add(p.max_value());
+            add(p.estimate());
+            add(p.default_value());
+        }
+    }
+
+    void add(const LoopLevel &l) {
+        // LoopLevels set by the user may not be locked yet, which most of
+        // the ways of inspecting them assert against.
+        add(l.func_name());
+        add(l.var_name());
+        s << l.is_rvar() << " " << l.get_stage_index() << " ";
+    }
+
+    void add(const FuncSchedule &sched) {
+        add(sched.store_level());
+        add(sched.compute_level());
+        add(sched.hoist_storage_level());
+        s << sched.storage_dims().size() << " ";
+        for (const StorageDim &d : sched.storage_dims()) {
+            add(d.var);
+            add(d.alignment);
+            add(d.bound);
+            add(d.fold_factor);
+            s << d.fold_forward << " ";
+        }
+        for (const auto *bounds : {&sched.bounds(), &sched.estimates()}) {
+            s << bounds->size() << " ";
+            for (const Bound &b : *bounds) {
+                add(b.var);
+                add(b.min);
+                add(b.extent);
+                add(b.modulus);
+                add(b.remainder);
+            }
+        }
+        s << sched.wrappers().size() << " ";
+        for (const auto &it : sched.wrappers()) {
+            add(it.first);
+            add(Function(it.second).name());
+        }
+        s << sched.memory_type() << " " << sched.memoized() << " " << sched.async() << " ";
+        add(sched.ring_buffer());
+        add(sched.memoize_eviction_key());
+    }
+
+    void add(const StageSchedule &sched) {
+        s << sched.rvars().size() << " ";
+        for (const ReductionVariable &rv : sched.rvars()) {
+            add(rv.var);
+            add(rv.min);
+            add(rv.extent);
+        }
+        s << sched.splits().size() << " ";
+        for (const Split &split : sched.splits()) {
+            add(split.old_var);
+            add(split.outer);
+            add(split.inner);
+            add(split.factor);
+            s << split.exact << " " << (int)split.tail << " " << (int)split.split_type << " ";
+        }
+        s << sched.dims().size() << " ";
+        for (const Dim &d : sched.dims()) {
+            add(d.var);
+            s << (int)d.for_type << " " << (int)d.device_api << " "
+              << (int)d.dim_type << " " << (int)d.partition_policy << " ";
+        }
+        s << sched.prefetches().size() << " ";
+        for (const PrefetchDirective &p : sched.prefetches()) {
+            add(p.name);
+            add(p.at);
+            add(p.from);
+            add(p.offset);
+            s << (int)p.strategy << " ";
+            add(p.param);
+        }
+        add(sched.fuse_level().level);
+        s << sched.fuse_level().align.size() << " ";
+        for (const auto &it : sched.fuse_level().align) {
+            add(it.first);
+            s << (int)it.second << " ";
+        }
+        s << sched.fused_pairs().size() << " ";
+        for (const FusedPair &p : sched.fused_pairs()) {
+            add(p.func_1);
+            add(p.func_2);
+            add(p.var_name);
+            s << p.stage_1 << " " << p.stage_2 << " ";
+        }
+        s << sched.touched() << " " << sched.allow_race_conditions() << " "
+          << sched.atomic() << " " << sched.override_atomic_associativity_test() << " ";
+    }
+
+    void add(const Definition &def) {
+        s << "definition " << def.defined() << " ";
+        if (!def.defined()) {
+            return;
+        }
+        s << def.is_init() << " ";
+        add(def.args());
+        add(def.values());
+        add(def.predicate());
+        add(def.schedule());
+        s << def.specializations().size() << " ";
+        for (const Specialization &spec : def.specializations()) {
+            add(spec.condition);
+            add(spec.definition);
+            add(spec.failure_message);
+        }
+    }
+
+    void add(const Function &f) {
+        s << "function ";
+        add(f.name());
+        add(f.origin_name());
+        add(f.output_types());
+        add(f.required_types());
+        s << f.required_dimensions() << " ";
+        add(f.args());
+        add(f.schedule());
+        if (f.has_pure_definition()) {
+            add(f.definition());
+        }
+        s << f.updates().size() << " ";
+        for (const Definition &def : f.updates()) {
+            add(def);
+        }
+        add(f.debug_file());
+        if (f.has_pure_definition() || f.has_extern_definition()) {
+            for (const Parameter &p : f.output_buffers()) {
+                add(p);
+            }
+        }
+        s << f.has_extern_definition() << " ";
+        if (f.has_extern_definition()) {
+            add(f.extern_function_name());
+            s << (int)f.extern_definition_name_mangling() << " "
+              << (int)f.extern_function_device_api() << " ";
+            add(f.extern_definition_proxy_expr());
+            for (const ExternFuncArgument &arg : f.extern_arguments()) {
+                s << (int)arg.arg_type << " ";
+                if (arg.is_func()) {
+                    add(Function(arg.func).name());
+                } else if (arg.is_expr()) {
+                    add(arg.expr);
+                } else if (arg.is_buffer()) {
+                    add(arg.buffer);
+                } else if (arg.is_image_param()) {
+                    add(arg.image_param);
+                }
+            }
+        }
+        s << f.is_tracing_loads() << " " << f.is_tracing_stores() << " "
+          << f.is_tracing_realizations() << " " << f.should_not_profile() << " ";
+        add(f.get_trace_tags());
+    }
+
+public:
+    LoweringKey make(const vector<Function> &outputs,
+                     const vector<Argument> &args,
+                     const string &fn_name,
+                     const Target &target,
+                     LinkageType linkage_type,
+                     const vector<Stmt> &requirements,
+                     bool trace_pipeline) {
+        add(fn_name);
+        s << (int)linkage_type << " " << trace_pipeline << " " << args.size() << " ";
+        for (const Argument &arg : args) {
+            add(arg.name);
+            s << (int)arg.kind << " " << (int)arg.dimensions << " " << arg.type << " ";
+            const ArgumentEstimates &e = arg.argument_estimates;
+            add(e.scalar_def);
+            add(e.scalar_min);
+            add(e.scalar_max);
+            add(e.scalar_estimate);
+            s << e.buffer_estimates.size() << " ";
+            for (const Range &r : e.buffer_estimates) {
+                add(r.min);
+                add(r.extent);
+            }
+        }
+        s << outputs.size() << " ";
+        for (const Function &f : outputs) {
+            add(f.name());
+        }
+        s << requirements.size() << " ";
+        for (const Stmt &r : requirements) {
+            add(r);
+        }
+        for (const auto &it : build_environment(outputs)) {
+            add(it.second);
+        }
+        return {target, s.str(), std::move(ir)};
+    }
+};
+
+// A copy of a Module that shares its IR, so that changes made to the
+// Module returned by compile_to_module (e.g. remapping metadata names) don't
+// affect the one cached in the Pipeline.
+Module copy_module(const Module &m) {
+    Module copy(m.name(), m.target(), m.get_metadata_name_map());
+    for (const auto &b : m.buffers()) {
+        copy.append(b);
+    }
+    for (const auto &f : m.functions()) {
+        copy.append(f);
+    }
+    for (const auto &sub : m.submodules()) {
+        copy.append(sub);
+    }
+    if (const AutoSchedulerResults *results = m.get_auto_scheduler_results()) {
+        copy.set_auto_scheduler_results(*results);
+    }
+    copy.set_any_strict_float(m.any_strict_float());
+    copy.set_conceptual_code_stmt(m.get_conceptual_stmt());
+    return copy;
+}
+
 }  // namespace
 
 namespace Internal {
 
+void set_lowering_cache_size(size_t max_entries) {
+    lowering_cache_size_limit() = max_entries;
+}
+
+size_t lowering_cache_size() {
+    return lowering_cache_size_limit();
+}
+
 struct JITCallArgs {
     size_t size{0};
     const void **store;
@@ -110,15 +466,22 @@ public:
 struct PipelineContents {
     mutable RefCount ref_count;
 
-    // Cached lowered stmt
-    Module module;
+    // Recently lowered Modules, most recently used first, along with
+    // everything lowering them depended on. A Module is only reused if none
+    // of that has changed; any change, even to the schedule of one Func,
+    // lowers the whole pipeline again. As they are checked against the
+    // current state of the pipeline, they survive invalidate_cache.
+    struct LoweredModule {
+        LoweringKey key;
+        Module module;
+    };
+    std::list<LoweredModule> lowered_modules;
 
     // Cached jit-compiled code
     JITCache jit_cache;
 
     /** Clear all cached state */
     void invalidate_cache() {
-        module = Module("", Target());
         jit_cache = JITCache();
     }
 
@@ -151,8 +514,7 @@ struct PipelineContents {
 
     bool trace_pipeline = false;
 
-    PipelineContents()
-        : module("", Target()) {
+    PipelineContents() {
         user_context_arg.arg = Argument("__user_context", Argument::InputScalar, type_of<const void *>(), 0, ArgumentEstimates{});
         user_context_arg.param = Parameter(Handle(), false, 0, "__user_context");
     }
@@ -375,11 +737,14 @@ void Pipeline::compile_to_static_library(const string &filename_prefix,
 void Pipeline::compile_to_multitarget_static_library(const std::string &filename_prefix,
                                                      const std::vector<Argument> &args,
                                                      const std::vector<Target> &targets) {
+    // The targets may be lowered concurrently, so don't touch the Module
+    // cached by compile_to_module.
     auto module_producer = [this, &args](const std::string &name, const Target &target) -> Module {
-        return compile_to_module(args, name, target);
+        return lower_to_module(args, name, target, LinkageType::ExternalPlusMetadata);
     };
     auto outputs = static_library_outputs(filename_prefix, targets.back());
-    compile_multitarget(generate_function_name(), outputs, targets, {}, module_producer);
+    compile_multitarget(generate_function_name(), outputs, targets, {}, module_producer,
+                        nullptr, multitarget_thread_count(targets.size()));
 }
 
 void Pipeline::compile_to_multitarget_object_files(const std::string &filename_prefix,
@@ -387,10 +752,11 @@ void Pipeline::compile_to_multitarget_object_files(const std::string &filename_p
                                                    const std::vector<Target> &targets,
                                                    const std::vector<std::string> &suffixes) {
     auto module_producer = [this, &args](const std::string &name, const Target &target) -> Module {
-        return compile_to_module(args, name, target);
+        return lower_to_module(args, name, target, LinkageType::ExternalPlusMetadata);
     };
     auto outputs = object_file_outputs(filename_prefix, targets.back());
-    compile_multitarget(generate_function_name(), outputs, targets, suffixes, module_producer);
+    compile_multitarget(generate_function_name(), outputs, targets, suffixes, module_producer,
+                        nullptr, multitarget_thread_count(targets.size()));
 }
 
 void Pipeline::compile_to_file(const string &filename_prefix,
@@ -497,15 +863,6 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
                                    const LinkageType linkage_type) {
     user_assert(defined()) << "Can't compile undefined Pipeline.\n";
 
-    for (const Function &f : contents->outputs) {
-        user_assert(f.has_pure_definition() || f.has_extern_definition())
-            << "Can't compile Pipeline with undefined output Func: " << f.name() << ".";
-        user_assert(!f.schedule().memoized())
-            << "Can't compile Pipeline with memoized output Func: " << f.name() << ". "
-            << "Memoization is valid only on intermediate Funcs because it takes "
-            << "control of buffer allocation.";
-    }
-
     string new_fn_name(fn_name);
     if (new_fn_name.empty()) {
         new_fn_name = generate_function_name();
@@ -513,6 +870,36 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
     internal_assert(!new_fn_name.empty()) << "new_fn_name cannot be empty\n";
     // TODO: Assert that the function name is legal
 
+    const size_t cache_size = lowering_cache_size();
+    if (cache_size == 0 || !contents->custom_lowering_passes.empty()) {
+        // Custom lowering passes can do anything, so there's no telling
+        // whether a Module lowered with them is still valid.
+        contents->lowered_modules.clear();
+        return lower_to_module(args, new_fn_name, target, linkage_type);
+    }
+
+    LoweringKey key = MakeLoweringKey().make(contents->outputs, add_user_context_arg(args, target),
+                                             new_fn_name, target, linkage_type,
+                                             contents->requirements, contents->trace_pipeline);
+    auto &cache = contents->lowered_modules;
+    for (auto it = cache.begin(); it != cache.end(); it++) {
+        if (it->key == key) {
+            // We can avoid relowering and just reuse the existing module.
+            debug(2) << "Reusing old module " << it->module.name() << "\n";
+            cache.splice(cache.begin(), cache, it);
+            return copy_module(cache.front().module);
+        }
+    }
+
+    Module module = lower_to_module(args, new_fn_name, target, linkage_type);
+    cache.push_front({std::move(key), module});
+    while (cache.size() > cache_size) {
+        cache.pop_back();
+    }
+    return copy_module(module);
+}
+
+vector<Argument> Pipeline::add_user_context_arg(const vector<Argument> &args, const Target &target) const {
     vector<Argument> lowering_args(args);
 
     // If the target specifies user context but it's not in the args
@@ -528,43 +915,39 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
     if (requires_user_context && !has_user_context) {
         lowering_args.insert(lowering_args.begin(), contents->user_context_arg.arg);
     }
+    return lowering_args;
+}
 
-    const Module &old_module = contents->module;
-
-    bool same_compile = !old_module.functions().empty() && old_module.target() == target;
-    // Either generated name or one of the LoweredFuncs in the existing module has the same name.
-    same_compile = same_compile && fn_name.empty();
-    bool found_name = false;
-    for (const auto &lf : old_module.functions()) {
-        if (lf.name == fn_name) {
-            found_name = true;
-            break;
-        }
+Module Pipeline::lower_to_module(const vector<Argument> &args,
+                                 const string &fn_name,
+                                 const Target &target,
+                                 const LinkageType linkage_type) const {
+    for (const Function &f : contents->outputs) {
+        user_assert(f.has_pure_definition() || f.has_extern_definition())
+            << "Can't compile Pipeline with undefined output Func: " << f.name() << ".";
+        user_assert(!f.schedule().memoized())
+            << "Can't compile Pipeline with memoized output Func: " << f.name() << ". "
+            << "Memoization is valid only on intermediate Funcs because it takes "
+            << "control of buffer allocation.";
     }
-    same_compile = same_compile && found_name;
-    // Number of args + number of outputs is the same as total args in existing LoweredFunc
-    same_compile = same_compile && (lowering_args.size() + outputs().size()) == old_module.functions().front().args.size();
-    // The initial args are the same.
-    same_compile = same_compile && std::equal(lowering_args.begin(), lowering_args.end(), old_module.functions().front().args.begin());
-    // Linkage is the same.
-    same_compile = same_compile && old_module.functions().front().linkage == linkage_type;
-    // The outputs of a Pipeline cannot change, so no need to test them.
-
-    if (same_compile) {
-        // We can avoid relowering and just reuse the existing module.
-        debug(2) << "Reusing old module\n";
-    } else {
-        vector<IRMutator *> custom_passes;
-        for (const CustomLoweringPass &p : contents->custom_lowering_passes) {
-            custom_passes.push_back(p.pass);
-        }
 
-        contents->module = lower(contents->outputs, new_fn_name, target, lowering_args,
-                                 linkage_type, contents->requirements, contents->trace_pipeline,
-                                 custom_passes);
+    vector<IRMutator *> custom_passes;
+    for (const CustomLoweringPass &p : contents->custom_lowering_passes) {
+        custom_passes.push_back(p.pass);
     }
 
-    return contents->module;
+    return lower(contents->outputs, fn_name, target, add_user_context_arg(args, target),
+                 linkage_type, contents->requirements, contents->trace_pipeline,
+                 custom_passes);
+}
+
+int Pipeline::multitarget_thread_count(size_t num_targets) const {
+    // Custom lowering passes are shared by all the targets, and can't be
+    // assumed to be safe to run concurrently.
+    if (!contents->custom_lowering_passes.empty()) {
+        return 1;
+    }
+    return std::min((int)num_targets, std::max(1, (int)std::thread::hardware_concurrency()));
 }
 
 std::string Pipeline::generate_function_name() const {
@@ -671,6 +1054,35 @@ Callable Pipeline::compile_to_callable(const std::vector<Argument> &args_in, con
     return Callable(module.name(), jit_handlers(), get_jit_externs(), std::move(jit_cache));
 }
 
+AsyncCallable Pipeline::compile_to_callable_async(const std::vector<Argument> &args,
+                                                  const Callable &fallback,
+                                                  const Target &target) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+
+    if (!contents->custom_lowering_passes.empty()) {
+        // Custom lowering passes belong to this Pipeline and are usually
+        // stateful, so they can't run on another thread. Compile here, and
+        // hand back a handle that is already ready.
+        Callable compiled = compile_to_callable(args, target);
+        return AsyncCallable(fallback, [compiled]() { return compiled; });
+    }
+
+    // Lowering starts with a deep copy of the Functions anyway. Make that
+    // copy here instead, so that the caller is free to change the schedule
+    // while the background thread lowers the copy.
+    Pipeline copy;
+    copy.contents = new PipelineContents;
+    copy.contents->outputs = deep_copy(contents->outputs, build_environment(contents->outputs)).first;
+    copy.contents->jit_handlers = contents->jit_handlers;
+    copy.contents->jit_externs = contents->jit_externs;
+    copy.contents->requirements = contents->requirements;
+    copy.contents->trace_pipeline = contents->trace_pipeline;
+
+    return AsyncCallable(fallback, [copy, args, target]() mutable {
+        return copy.compile_to_callable(args, target);
+    });
+}
+
 /*static*/ JITCache Pipeline::compile_jit_cache(const Module &module,
                                                 std::vector<Argument> args,
                                                 const std::vector<Internal::Function> &outputs,
@@ -23,6 +23,7 @@
 namespace Halide {
 
 struct Argument;
+class AsyncCallable;
 class Callable;
 class Func;
 struct PipelineContents;
@@ -64,6 +65,18 @@ namespace Internal {
 class IRMutator;
 struct JITCache;
 struct JITCallArgs;
+
+/** Set the maximum number of lowered Modules each Pipeline keeps, along
+ * with everything lowering them depended on, so that compiling it again
+ * after changing nothing that lowering reads skips lowering. This is not
+ * incremental: changing anything, e.g. the schedule of one Func, lowers
+ * the whole pipeline again. Zero turns this off. The initial value is taken
+ * from the HL_LOWERING_CACHE_SIZE environment variable, and defaults to
+ * 1. */
+void set_lowering_cache_size(size_t max_entries);
+
+/** Get the maximum number of lowered Modules each Pipeline keeps. */
+size_t lowering_cache_size();
 }  // namespace Internal
 
 /**
@@ -361,6 +374,18 @@ public:
     Callable compile_to_callable(const std::vector<Argument> &args,
                                  const Target &target = get_jit_target_from_environment());
 
+    /** Start jit compiling the pipeline on a background thread, and return
+     * a handle that can be called right away. Until the compiled code is
+     * ready, calls go to the fallback Callable, which should have the same
+     * Arguments (e.g. this pipeline compiled earlier with a cheaper
+     * schedule), or wait for compilation if the fallback is undefined. The
+     * pipeline is copied before this returns, so it can be rescheduled or
+     * destroyed while the copy is compiled, but the Params and Buffers it
+     * uses are shared with it. See AsyncCallable. */
+    AsyncCallable compile_to_callable_async(const std::vector<Argument> &args,
+                                            const Callable &fallback,
+                                            const Target &target = get_jit_target_from_environment());
+
     /** Install a set of external C functions or Funcs to satisfy
      * dependencies introduced by HalideExtern and define_extern
      * mechanisms. These will be used by calls to realize,
@@ -469,7 +494,9 @@ public:
     bool defined() const;
 
     /** Invalidate any internal cached state, e.g. because Funcs have
-     * been rescheduled. */
+     * been rescheduled. Lowered Modules are kept, because they are only
+     * reused if nothing they were lowered from has changed (see
+     * Internal::set_lowering_cache_size). */
     void invalidate_cache();
 
     /** Add a top-level precondition to the generated pipeline,
@@ -496,6 +523,22 @@ public:
 
 private:
     std::string generate_function_name() const;
+
+    /** Add the user context argument to the arguments, if the target
+     * needs it and it isn't there. */
+    std::vector<Argument> add_user_context_arg(const std::vector<Argument> &args, const Target &target) const;
+
+    /** Lower the pipeline to a Module, without reusing or replacing the ones
+     * cached by compile_to_module, so it can be called concurrently. */
+    Module lower_to_module(const std::vector<Argument> &args,
+                           const std::string &fn_name,
+                           const Target &target,
+                           LinkageType linkage_type) const;
+
+    /** The number of threads to compile the given number of targets on in
+     * compile_to_multitarget_static_library and
+     * compile_to_multitarget_object_files. */
+    int multitarget_thread_count(size_t num_targets) const;
 };
 
 struct ExternSignature {
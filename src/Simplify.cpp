@@ -3,8 +3,16 @@
 
 #include "CSE.h"
 #include "CompilerLogger.h"
+#include "IREquality.h"
 #include "IRMutator.h"
+#include "IRVisitor.h"
 #include "Substitute.h"
+#include "Util.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <set>
+#include <tuple>
 
 namespace Halide {
 namespace Internal {
@@ -375,10 +383,25 @@ Simplify::ScopedFact::~ScopedFact() {
     }
 }
 
-Expr simplify(const Expr &e, bool remove_dead_let_stmts,
-              const Scope<Interval> &bounds,
-              const Scope<ModulusRemainder> &alignment,
-              const std::vector<Expr> &assumptions) {
+namespace {
+
+std::atomic<size_t> &simplify_cache_size_limit() {
+    static std::atomic<size_t> limit{[]() -> size_t {
+        std::string size = get_env_variable("HL_SIMPLIFY_CACHE_SIZE");
+        if (size.empty()) {
+            return 16384;
+        }
+        return (size_t)std::max(0LL, std::atoll(size.c_str()));
+    }()};
+    return limit;
+}
+
+thread_local SimplifyCache *active_simplify_cache = nullptr;
+
+Expr simplify_uncached(const Expr &e, bool remove_dead_let_stmts,
+                       const Scope<Interval> &bounds,
+                       const Scope<ModulusRemainder> &alignment,
+                       const std::vector<Expr> &assumptions) {
     Simplify m(remove_dead_let_stmts, &bounds, &alignment);
     std::vector<Simplify::ScopedFact> facts;
     facts.reserve(assumptions.size());
@@ -392,6 +415,160 @@ Expr simplify(const Expr &e, bool remove_dead_let_stmts,
     return result;
 }
 
+}  // namespace
+
+// Maps each Expr simplified to the results of simplifying it. The result
+// also depends on whether dead lets are removed, and on the constant bounds
+// and alignment of its free variables that the Simplify constructor takes
+// from the scopes passed in, so those are kept alongside it.
+struct SimplifyCache {
+    struct VarFact {
+        std::string name;
+        bool min_defined = false, max_defined = false;
+        int64_t min = 0, max = 0;
+        int64_t modulus = 1, remainder = 0;
+
+        bool operator==(const VarFact &other) const {
+            return std::tie(name, min_defined, max_defined, min, max, modulus, remainder) ==
+                   std::tie(other.name, other.min_defined, other.max_defined, other.min, other.max, other.modulus, other.remainder);
+        }
+    };
+
+    struct Entry {
+        bool remove_dead_code;
+        std::vector<VarFact> facts;
+        Expr result;
+    };
+
+    std::map<Expr, std::vector<Entry>, IRGraphHashCompare> entries;
+    size_t num_entries = 0;
+    uint64_t hits = 0, misses = 0;
+
+    static std::vector<VarFact> relevant_facts(const Expr &e,
+                                               const Scope<Interval> &bounds,
+                                               const Scope<ModulusRemainder> &alignment) {
+        std::vector<VarFact> facts;
+        if (bounds.size() == 0 && alignment.size() == 0) {
+            return facts;
+        }
+
+        class FreeVars : public IRGraphVisitor {
+            using IRGraphVisitor::visit;
+            void visit(const Variable *op) override {
+                names.insert(op->name);
+            }
+
+        public:
+            std::set<std::string> names;
+        } free_vars;
+        e.accept(&free_vars);
+
+        std::map<std::string, VarFact> by_name;
+        for (auto iter = bounds.cbegin(); iter != bounds.cend(); ++iter) {
+            if (!free_vars.names.count(iter.name())) {
+                continue;
+            }
+            VarFact &f = by_name[iter.name()];
+            if (auto i_min = as_const_int(iter.value().min)) {
+                f.min_defined = true;
+                f.min = *i_min;
+            }
+            if (auto i_max = as_const_int(iter.value().max)) {
+                f.max_defined = true;
+                f.max = *i_max;
+            }
+        }
+        for (auto iter = alignment.cbegin(); iter != alignment.cend(); ++iter) {
+            if (!free_vars.names.count(iter.name())) {
+                continue;
+            }
+            VarFact &f = by_name[iter.name()];
+            f.modulus = iter.value().modulus;
+            f.remainder = iter.value().remainder;
+        }
+        for (auto &it : by_name) {
+            it.second.name = it.first;
+            facts.push_back(std::move(it.second));
+        }
+        return facts;
+    }
+
+    const Expr *find(const Expr &e, bool remove_dead_code, const std::vector<VarFact> &facts) {
+        auto it = entries.find(e);
+        if (it != entries.end()) {
+            for (const Entry &entry : it->second) {
+                if (entry.remove_dead_code == remove_dead_code && entry.facts == facts) {
+                    hits++;
+                    return &entry.result;
+                }
+            }
+        }
+        misses++;
+        return nullptr;
+    }
+
+    void insert(const Expr &e, bool remove_dead_code, std::vector<VarFact> facts, const Expr &result) {
+        const size_t limit = simplify_cache_size_limit();
+        if (num_entries >= limit) {
+            entries.clear();
+            num_entries = 0;
+        }
+        entries[e].push_back({remove_dead_code, std::move(facts), result});
+        num_entries++;
+    }
+};
+
+void set_simplify_cache_size(size_t max_entries) {
+    simplify_cache_size_limit() = max_entries;
+}
+
+size_t simplify_cache_size() {
+    return simplify_cache_size_limit();
+}
+
+ScopedSimplifyCache::ScopedSimplifyCache()
+    : cache(std::make_unique<SimplifyCache>()), old_cache(active_simplify_cache) {
+    active_simplify_cache = cache.get();
+}
+
+ScopedSimplifyCache::~ScopedSimplifyCache() {
+    internal_assert(active_simplify_cache == cache.get());
+    active_simplify_cache = old_cache;
+}
+
+uint64_t ScopedSimplifyCache::hits() const {
+    return cache->hits;
+}
+
+uint64_t ScopedSimplifyCache::misses() const {
+    return cache->misses;
+}
+
+Expr simplify(const Expr &e, bool remove_dead_let_stmts,
+              const Scope<Interval> &bounds,
+              const Scope<ModulusRemainder> &alignment,
+              const std::vector<Expr> &assumptions) {
+    // Assumptions are rare, and can mention anything, so simplifications
+    // made with them aren't memoized.
+    SimplifyCache *cache = active_simplify_cache;
+    if (!cache || !assumptions.empty() || !e.defined() || simplify_cache_size() == 0) {
+        cache = nullptr;
+    }
+    std::vector<SimplifyCache::VarFact> facts;
+    if (cache) {
+        facts = SimplifyCache::relevant_facts(e, bounds, alignment);
+        if (const Expr *result = cache->find(e, remove_dead_let_stmts, facts)) {
+            return *result;
+        }
+    }
+
+    Expr result = simplify_uncached(e, remove_dead_let_stmts, bounds, alignment, assumptions);
+    if (cache) {
+        cache->insert(e, remove_dead_let_stmts, std::move(facts), result);
+    }
+    return result;
+}
+
 Stmt simplify(const Stmt &s, bool remove_dead_let_stmts,
               const Scope<Interval> &bounds,
               const Scope<ModulusRemainder> &alignment,
@@ -5,6 +5,8 @@
  * Methods for simplifying halide statements and expressions
  */
 
+#include <memory>
+
 #include "Expr.h"
 #include "Interval.h"
 #include "ModulusRemainder.h"
@@ -33,6 +35,44 @@ Expr simplify(const Expr &,
               const std::vector<Expr> &assumptions = std::vector<Expr>());
 // @}
 
+/** Set the maximum number of Exprs the simplifier memoizes during a
+ * lowering session (see ScopedSimplifyCache). Zero turns memoization off.
+ * The initial value is taken from the HL_SIMPLIFY_CACHE_SIZE environment
+ * variable, and defaults to 16384. */
+void set_simplify_cache_size(size_t max_entries);
+
+/** Get the maximum number of Exprs the simplifier memoizes during a
+ * lowering session. */
+size_t simplify_cache_size();
+
+struct SimplifyCache;
+
+/** Memoize the results of simplify() on Exprs, along with the constant
+ * bounds and alignment facts it was given about their free variables, for
+ * calls made on this thread over the lifetime of this object. Lowering
+ * simplifies the same Exprs many times over (in bounds inference, loop
+ * partitioning, and so on), and the Stmt produced by each pass is still
+ * valid for the next, so a cache lasts for one lowering session. When it
+ * holds simplify_cache_size() entries, it is emptied. */
+class ScopedSimplifyCache {
+    std::unique_ptr<SimplifyCache> cache;
+    SimplifyCache *old_cache;
+
+public:
+    ScopedSimplifyCache();
+    ~ScopedSimplifyCache();
+
+    ScopedSimplifyCache(const ScopedSimplifyCache &) = delete;
+    ScopedSimplifyCache &operator=(const ScopedSimplifyCache &) = delete;
+
+    /** The number of calls to simplify() answered from the cache, and the
+     * number that weren't but could have been. */
+    // @{
+    uint64_t hits() const;
+    uint64_t misses() const;
+    // @}
+};
+
 /** Attempt to statically prove an expression is true using the simplifier. */
 bool can_prove(Expr e, const Scope<Interval> &bounds = Scope<Interval>::empty_scope());
 
@@ -7,6 +7,7 @@
 #include "Util.h"
 #include "Debug.h"
 #include "Error.h"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <fstream>
@@ -15,11 +16,14 @@
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #ifdef _MSC_VER
 #include <io.h>
 #else
 #include <cstdlib>
+#include <fcntl.h>     // For open
 #include <sys/mman.h>  // For mmap
 #include <unistd.h>
 #endif
@@ -171,12 +175,50 @@ const int num_unique_name_counters = (1 << 14);
 // this is a global, which is always zero-initialized.
 std::atomic<int> unique_name_counters[num_unique_name_counters] = {};
 
+thread_local NameCounters *scoped_name_counters = nullptr;
+
 int unique_count(size_t h) {
     h = h & (num_unique_name_counters - 1);
+    if (scoped_name_counters) {
+        return scoped_name_counters->unique_name_counters[h]++;
+    }
     return unique_name_counters[h]++;
 }
 }  // namespace
 
+NameCounters snapshot_name_counters() {
+    NameCounters result;
+    result.unique_name_counters.resize(num_unique_name_counters);
+    for (int i = 0; i < num_unique_name_counters; i++) {
+        result.unique_name_counters[i] = unique_name_counters[i];
+    }
+    return result;
+}
+
+void merge_name_counters(const NameCounters &counters) {
+    internal_assert(counters.unique_name_counters.size() == (size_t)num_unique_name_counters);
+    for (int i = 0; i < num_unique_name_counters; i++) {
+        int current = unique_name_counters[i];
+        while (current < counters.unique_name_counters[i] &&
+               !unique_name_counters[i].compare_exchange_weak(current, counters.unique_name_counters[i])) {
+        }
+    }
+}
+
+ScopedNameCounters::ScopedNameCounters(NameCounters &counters)
+    : old(scoped_name_counters) {
+    internal_assert(counters.unique_name_counters.size() == (size_t)num_unique_name_counters);
+    scoped_name_counters = &counters;
+}
+
+ScopedNameCounters::~ScopedNameCounters() {
+    scoped_name_counters = old;
+}
+
+NameCounters *get_scoped_name_counters() {
+    return scoped_name_counters;
+}
+
 // There are three possible families of names returned by the methods below:
 // 1) char pattern: (char that isn't '$') + number (e.g. v234)
 // 2) string pattern: (string without '$') + '$' + number (e.g. fr#nk82$42)
@@ -488,6 +530,53 @@ std::vector<char> read_entire_file(const std::string &pathname) {
     return result;
 }
 
+MappedFile::MappedFile(const std::string &pathname) {
+#ifndef _WIN32
+    int fd = ::open(pathname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat s;
+    if (fstat(fd, &s) == 0 && s.st_size > 0) {
+        void *p = mmap(nullptr, (size_t)s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            contents = (const uint8_t *)p;
+            contents_size = (size_t)s.st_size;
+            open = mapped = true;
+        }
+    }
+    // The mapping stays valid after the file is closed.
+    ::close(fd);
+    if (mapped) {
+        return;
+    }
+#endif
+    // Empty files can't be mapped, and some files (or platforms) don't
+    // support it at all, so read the file instead.
+    std::ifstream f(pathname, std::ios::in | std::ios::binary);
+    if (!f) {
+        return;
+    }
+    f.seekg(0, std::ifstream::end);
+    copy.resize((size_t)f.tellg());
+    f.seekg(0, std::ifstream::beg);
+    f.read((char *)copy.data(), copy.size());
+    if (!f.good()) {
+        return;
+    }
+    contents = copy.data();
+    contents_size = copy.size();
+    open = true;
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<uint8_t *>(contents), contents_size);
+    }
+#endif
+}
+
 void write_entire_file(const std::string &pathname, const void *source, size_t source_len) {
     std::ofstream f(pathname, std::ios::out | std::ios::binary);
 
@@ -855,6 +944,57 @@ void run_with_large_stack(const std::function<void()> &action) {
 #endif
 }
 
+void run_in_parallel(int count, int max_threads, const std::function<void(int)> &body) {
+    const int num_threads = std::min(count, max_threads);
+    if (num_threads <= 1) {
+        for (int i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+
+    std::atomic<int> next{0};
+#ifdef HALIDE_WITH_EXCEPTIONS
+    std::mutex exception_mutex;
+    std::exception_ptr exception = nullptr;  // NOLINT - clang-tidy complains this isn't thrown
+#endif
+
+    auto worker = [&]() {
+        run_with_large_stack([&]() {
+            for (int i = next++; i < count; i = next++) {
+#ifdef HALIDE_WITH_EXCEPTIONS
+                try {
+                    body(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(exception_mutex);
+                    if (!exception) {
+                        exception = std::current_exception();
+                    }
+                    next = count;
+                }
+#else
+                body(i);
+#endif
+            }
+        });
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+#ifdef HALIDE_WITH_EXCEPTIONS
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+#endif
+}
+
 // Portable bit-counting methods
 int popcount64(uint64_t x) {
 #ifdef _MSC_VER
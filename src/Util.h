@@ -170,6 +170,42 @@ std::string unique_name(char prefix);
 std::string unique_name(const std::string &prefix);
 // @}
 
+/** The counters behind unique_name, and the ones that tag calls to the
+ * random number functions. */
+struct NameCounters {
+    std::vector<int> unique_name_counters;
+    int random_number_counter = 0;
+    int random_variable_counter = 0;
+};
+
+/** Copy the process-wide unique_name counters. The random number counters
+ * of the copy start at zero. */
+NameCounters snapshot_name_counters();
+
+/** Raise the process-wide unique_name counters to at least the values in
+ * the given counters, so that the names handed out from them aren't handed
+ * out again. */
+void merge_name_counters(const NameCounters &counters);
+
+/** While alive, unique_name and the random number functions draw from the
+ * given counters on the thread that created it, instead of from the
+ * process-wide ones. This lets compilations run concurrently and each
+ * produce the names it would produce if it ran alone. */
+class ScopedNameCounters {
+    NameCounters *old;
+
+public:
+    explicit ScopedNameCounters(NameCounters &counters);
+    ~ScopedNameCounters();
+
+    ScopedNameCounters(const ScopedNameCounters &) = delete;
+    ScopedNameCounters &operator=(const ScopedNameCounters &) = delete;
+};
+
+/** The counters installed on the calling thread by ScopedNameCounters, or
+ * nullptr if there are none. */
+NameCounters *get_scoped_name_counters();
+
 /** Test if the first string starts with the second string */
 bool starts_with(const std::string &str, const std::string &prefix);
 
@@ -371,6 +407,40 @@ public:
     TemporaryFile &operator=(TemporaryFile &&) = delete;
 };
 
+/** A read-only view of the entire contents of a file, which is memory
+ * mapped where that's supported (so it isn't copied, and pages that are
+ * never touched are never read), and read into memory otherwise. The file
+ * is unmapped in the dtor. */
+class MappedFile final {
+public:
+    explicit MappedFile(const std::string &pathname);
+    ~MappedFile();
+
+    /** Whether the file could be opened and mapped (or read). */
+    bool is_open() const {
+        return open;
+    }
+    const uint8_t *data() const {
+        return contents;
+    }
+    size_t size() const {
+        return contents_size;
+    }
+
+private:
+    const uint8_t *contents = nullptr;
+    size_t contents_size = 0;
+    bool open = false;
+    bool mapped = false;
+    std::vector<uint8_t> copy;
+
+public:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+};
+
 /** Routines to test if math would overflow for signed integers with
  * the given number of bits. */
 // @{
@@ -555,6 +625,13 @@ namespace Internal {
  * uses a Fiber, and on other platforms it uses swapcontext. */
 void run_with_large_stack(const std::function<void()> &action);
 
+/** Call body(i) for every i in [0, count), spread over at most
+ * max_threads threads, each of which runs with run_with_large_stack. The
+ * calls may happen in any order. If any of them throws, the remaining
+ * indices are skipped and the first exception is rethrown on the calling
+ * thread. */
+void run_in_parallel(int count, int max_threads, const std::function<void(int)> &body);
+
 /** Portable versions of popcount, count-leading-zeros, and
     count-trailing-zeros. */
 // @{
@@ -43,13 +43,16 @@
 #include "HalidePlugin.h"
 
 #include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <queue>
 #include <random>
 #include <set>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -65,6 +68,8 @@
 #include "NetworkSize.h"
 #include "ParamParser.h"
 #include "PerfectHashMap.h"
+#include "Rfactor.h"
+#include "ScheduleDatabase.h"
 #include "State.h"
 #include "Timer.h"
 
@@ -223,6 +228,95 @@ void configure_pipeline_features(const FunctionDAG &dag,
     cost_model->set_pipeline_features(dag, params);
 }
 
+// Stands in for the cost model while a State generates its children,
+// which may happen on any thread. It holds on to what would have been
+// enqueued, until it can be passed on to the real cost model in order.
+class DeferredCostModel : public CostModel {
+    struct Entry {
+        StageMapOfScheduleFeatures schedule_feats;
+        double *cost_ptr;
+    };
+    const FunctionDAG *dag = nullptr;
+    vector<Entry> entries;
+
+public:
+    void set_pipeline_features(const FunctionDAG &dag,
+                               const Adams2019Params &params) override {
+        internal_error << "DeferredCostModel can't be configured\n";
+    }
+
+    void enqueue(const FunctionDAG &dag,
+                 const StageMapOfScheduleFeatures &schedule_feats,
+                 double *cost_ptr) override {
+        this->dag = &dag;
+        entries.push_back(Entry{schedule_feats, cost_ptr});
+    }
+
+    void evaluate_costs() override {
+        internal_error << "DeferredCostModel can't evaluate costs\n";
+    }
+
+    void reset() override {
+        entries.clear();
+    }
+
+    // Pass everything enqueued so far on to another cost model.
+    void flush(CostModel *cost_model) {
+        for (const auto &e : entries) {
+            cost_model->enqueue(*dag, e.schedule_feats, e.cost_ptr);
+        }
+        entries.clear();
+    }
+};
+
+// Generate the children of each of the given states, using up to
+// num_threads threads. The children are passed to accept_child, and
+// their costs are enqueued into the cost model, in the same order as
+// if the states had generated them one at a time, so the search
+// doesn't depend on the number of threads.
+void expand_states(const vector<IntrusivePtr<State>> &states,
+                   const FunctionDAG &dag,
+                   const Adams2019Params &params,
+                   CostModel *cost_model,
+                   std::function<void(IntrusivePtr<State> &&)> &accept_child,
+                   Cache *cache,
+                   int num_threads) {
+    const int n = (int)states.size();
+    vector<vector<IntrusivePtr<State>>> children(n);
+    vector<DeferredCostModel> deferred(n);
+
+    // Whichever thread finishes a state passes on the costs of every
+    // state that's ready, in order, so they don't pile up.
+    std::mutex mutex;
+    vector<bool> done(n, false);
+    int next_to_flush = 0;
+
+    run_in_parallel(n, num_threads, [&](int i) {
+        std::function<void(IntrusivePtr<State> &&)> collect_child =
+            [&](IntrusivePtr<State> &&s) {
+                children[i].emplace_back(std::move(s));
+            };
+        states[i]->generate_children(dag, params, &deferred[i], collect_child, cache);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        done[i] = true;
+        while (next_to_flush < n && done[next_to_flush]) {
+            if (cost_model) {
+                deferred[next_to_flush].flush(cost_model);
+            }
+            next_to_flush++;
+        }
+    });
+
+    cache->commit_memoized_blocks(states);
+
+    for (auto &c : children) {
+        for (auto &s : c) {
+            accept_child(std::move(s));
+        }
+    }
+}
+
 // A single pass of coarse-to-fine beam search.
 IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
                                           const vector<Function> &outputs,
@@ -250,6 +344,10 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
 
     int expanded = 0;
 
+    const int num_threads = params.search_threads > 0 ?
+                                params.search_threads :
+                                std::max(1, (int)std::thread::hardware_concurrency());
+
     std::function<void(IntrusivePtr<State> &&)> enqueue_new_children =
         [&](IntrusivePtr<State> &&s) {
             // Each child should have one more decision made than its parent state.
@@ -301,6 +399,11 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
             aslog(1) << "*** Warning: Huge number of states generated (" << pending.size() << ").\n";
         }
 
+        // The states to expand in this step. Which ones they are
+        // depends on the random number generator, so they are picked
+        // on this thread before any of them are expanded.
+        vector<IntrusivePtr<State>> to_expand;
+
         expanded = 0;
         while (expanded < params.beam_size && !pending.empty()) {
 
@@ -379,10 +482,12 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
                 return best;
             }
 
-            state->generate_children(dag, params, cost_model, enqueue_new_children, cache);
+            to_expand.emplace_back(std::move(state));
             expanded++;
         }
 
+        expand_states(to_expand, dag, params, cost_model, enqueue_new_children, cache, num_threads);
+
         // Drop the other states unconsidered.
         pending.clear();
 
@@ -424,13 +529,221 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
     }
 }
 
+// Halide gives every Func a unique name, with a suffix that depends on the
+// order the Funcs in the process were made in, so what goes into the
+// schedule database names each Func by its place in the DAG instead.
+std::string with_canonical_names(const FunctionDAG &dag, const std::string &text) {
+    std::unordered_map<std::string, std::string> names;
+    for (size_t i = 0; i < dag.nodes.size(); i++) {
+        names.emplace(dag.nodes[i].func.name(), "f" + std::to_string(i));
+    }
+    const auto is_name_char = [](char c) {
+        return std::isalnum((unsigned char)c) || c == '_' || c == '$';
+    };
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size();) {
+        size_t j = i;
+        while (j < text.size() && is_name_char(text[j])) {
+            j++;
+        }
+        if (j == i) {
+            result += text[i++];
+            continue;
+        }
+        const std::string token = text.substr(i, j - i);
+        auto it = names.find(token);
+        result += it == names.end() ? token : it->second;
+        i = j;
+    }
+    return result;
+}
+
+// A fingerprint of a state that tells it apart from the other
+// children of its parent.
+uint64_t state_fingerprint(const FunctionDAG &dag, const State &state) {
+    std::ostringstream out;
+    state.root->dump(out, "", nullptr);
+    return ScheduleDatabase::hash(with_canonical_names(dag, out.str()));
+}
+
+// What the schedule database remembers about the best state found by a
+// search: the path of states that leads to it from the initial state.
+struct SearchRecord {
+    // The fingerprint of each state on the path, used to follow the
+    // same path again when nothing has changed.
+    vector<uint64_t> fingerprints;
+
+    // The coarsest structural hash used by the coarse-to-fine search of
+    // each state on the path. These don't depend on the exact loop sizes,
+    // so they still make sense when only the estimates have changed.
+    vector<uint64_t> coarse_hashes;
+
+    SearchRecord() = default;
+
+    SearchRecord(const FunctionDAG &dag, const State *best) {
+        for (const State *s = best; s && s->parent.defined(); s = s->parent.get()) {
+            fingerprints.insert(fingerprints.begin(), state_fingerprint(dag, *s));
+        }
+        for (const State *s = best; s; s = s->parent.get()) {
+            coarse_hashes.push_back(s->structural_hash(1));
+        }
+    }
+
+    std::string to_string() const {
+        std::ostringstream out;
+        out << std::hex;
+        for (const auto *v : {&fingerprints, &coarse_hashes}) {
+            out << v->size();
+            for (uint64_t h : *v) {
+                out << " " << h;
+            }
+            out << "\n";
+        }
+        return out.str();
+    }
+
+    bool from_string(const std::string &str) {
+        std::istringstream in(str);
+        in >> std::hex;
+        for (auto *v : {&fingerprints, &coarse_hashes}) {
+            size_t size = 0;
+            in >> size;
+            v->resize(size);
+            for (uint64_t &h : *v) {
+                in >> h;
+            }
+        }
+        return !in.fail();
+    }
+};
+
+// The key of a pipeline in the schedule database. The structure is the
+// algorithm, and the details are everything else the schedule found
+// depends on.
+ScheduleDatabase::Key make_database_key(const FunctionDAG &dag,
+                                        const Target &target,
+                                        const Adams2019Params &params,
+                                        uint64_t weights_hash) {
+    std::ostringstream structure, details;
+
+    const auto print_definition = [&](const Definition &def) {
+        for (const Expr &e : def.args()) {
+            structure << " " << e;
+        }
+        structure << " =";
+        for (const Expr &e : def.values()) {
+            structure << " " << e;
+        }
+        for (const ReductionVariable &rv : def.schedule().rvars()) {
+            structure << " " << rv.var << "(" << rv.min << ", " << rv.extent << ")";
+        }
+        structure << "\n";
+    };
+    for (const auto &n : dag.nodes) {
+        const Function &f = n.func;
+        structure << "Func " << f.name() << " " << f.dimensions()
+                  << " input " << n.is_input << " output " << n.is_output << " types";
+        for (const Type &t : f.output_types()) {
+            structure << " " << t;
+        }
+        structure << "\n";
+        if (f.has_extern_definition()) {
+            structure << " extern " << f.extern_function_name() << "\n";
+        } else if (f.has_pure_definition()) {
+            print_definition(f.definition());
+            for (const Definition &def : f.updates()) {
+                print_definition(def);
+            }
+        }
+    }
+
+    // The number of threads to search on and the database itself don't
+    // change the schedule found.
+    details << "Halide " << HALIDE_VERSION_MAJOR << "." << HALIDE_VERSION_MINOR << "." << HALIDE_VERSION_PATCH << "\n"
+            << "target " << target.to_string() << "\n"
+            << "parallelism " << params.parallelism << "\n"
+            << "beam_size " << params.beam_size << "\n"
+            << "random_dropout " << params.random_dropout << "\n"
+            << "random_dropout_seed " << params.random_dropout_seed << "\n"
+            << "weights " << std::hex << weights_hash << std::dec << "\n"
+            << "disable_subtiling " << params.disable_subtiling << "\n"
+            << "disable_memoized_features " << params.disable_memoized_features << "\n"
+            << "disable_memoized_blocks " << params.disable_memoized_blocks << "\n"
+            << "memory_limit " << params.memory_limit << "\n"
+            << "disable_rfactor " << params.disable_rfactor << "\n"
+            << "HL_NUM_PASSES " << get_env_variable("HL_NUM_PASSES") << "\n";
+    for (const auto &n : dag.nodes) {
+        details << "Estimate " << n.func.name();
+        for (const Span &s : n.estimated_region_required) {
+            details << " [" << s.min() << ", " << s.max() << "]";
+        }
+        details << "\n";
+    }
+    // The parameter estimates are baked into the bounds in the DAG.
+    dag.dump(details);
+
+    return {with_canonical_names(dag, structure.str()), with_canonical_names(dag, details.str())};
+}
+
+// Follow the path to a state found by an earlier search, expanding one
+// state per decision instead of a whole beam. Returns nullptr if a state
+// on the path is no longer among the children of its parent.
+IntrusivePtr<State> replay_schedule(FunctionDAG &dag,
+                                    const Adams2019Params &params,
+                                    CostModel *cost_model,
+                                    const CachingOptions &options,
+                                    const vector<uint64_t> &fingerprints) {
+    configure_pipeline_features(dag, params, cost_model);
+
+    // Memoized blocks only help when expanding many states.
+    CachingOptions replay_options = options;
+    replay_options.cache_blocks = false;
+    Cache cache(replay_options, dag.nodes.size());
+
+    IntrusivePtr<State> state{new State};
+    state->root = new LoopNest;
+    for (uint64_t fingerprint : fingerprints) {
+        vector<IntrusivePtr<State>> children;
+        std::function<void(IntrusivePtr<State> &&)> accept_child =
+            [&](IntrusivePtr<State> &&s) {
+                children.emplace_back(std::move(s));
+            };
+        state->generate_children(dag, params, cost_model, accept_child, &cache);
+        // The cost model holds pointers to the costs of the children, so
+        // evaluate them before any of the children go away.
+        cost_model->evaluate_costs();
+
+        IntrusivePtr<State> next;
+        for (auto &c : children) {
+            if (state_fingerprint(dag, *c) == fingerprint) {
+                next = std::move(c);
+                break;
+            }
+        }
+        if (!next.defined()) {
+            return nullptr;
+        }
+        state = std::move(next);
+    }
+
+    if (state->num_decisions_made != 2 * (int)dag.nodes.size()) {
+        return nullptr;
+    }
+    return state;
+}
+
 // Performance coarse-to-fine beam search and return the best state found.
+// If warm_start is set, the passes that settle the coarse structure of
+// the schedule are skipped, and the search starts from the structure of
+// the state it describes instead.
 IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
                                      const vector<Function> &outputs,
                                      const Adams2019Params &params,
                                      CostModel *cost_model,
                                      std::mt19937 &rng,
-                                     const CachingOptions &options) {
+                                     const CachingOptions &options,
+                                     const SearchRecord *warm_start = nullptr) {
 
     IntrusivePtr<State> best;
 
@@ -457,7 +770,15 @@ IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
         num_passes = std::atoi(num_passes_str.c_str());
     }
 
-    for (int i = 0; i < num_passes; i++) {
+    int first_pass = 0;
+    if (warm_start && num_passes > 2) {
+        // The structure of the earlier schedule is what the first two
+        // passes would have permitted the third to explore.
+        permitted_hashes.insert(warm_start->coarse_hashes.begin(), warm_start->coarse_hashes.end());
+        first_pass = 2;
+    }
+
+    for (int i = first_pass; i < num_passes; i++) {
         ProgressBar tick;
 
         Timer timer;
@@ -482,7 +803,7 @@ IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
             pass->dump(aslog(2).get_ostream());
         }
 
-        if (i == 0 || pass->cost < best->cost) {
+        if (i == first_pass || pass->cost < best->cost) {
             // Track which pass produced the lowest-cost state. It's
             // not necessarily the final one.
             best = pass;
@@ -514,6 +835,9 @@ void generate_schedule(const std::vector<Function> &outputs,
     aslog(1) << "Adams2019.disable_memoized_features:" << params.disable_memoized_features << "\n";
     aslog(1) << "Adams2019.disable_memoized_blocks:" << params.disable_memoized_blocks << "\n";
     aslog(1) << "Adams2019.memory_limit:" << params.memory_limit << "\n";
+    aslog(1) << "Adams2019.search_threads:" << params.search_threads << "\n";
+    aslog(1) << "Adams2019.schedule_database:" << params.schedule_database << "\n";
+    aslog(1) << "Adams2019.disable_rfactor:" << params.disable_rfactor << "\n";
 
     // Start a timer
     HALIDE_TIC;
@@ -528,6 +852,13 @@ void generate_schedule(const std::vector<Function> &outputs,
     string randomize_weights_str = get_env_variable("HL_RANDOMIZE_WEIGHTS");
     bool randomize_weights = randomize_weights_str == "1";
 
+    // Rfactor the reductions that would otherwise run on one core. This
+    // adds Funcs to the pipeline, so it must come before analysing it.
+    string rfactor_source;
+    if (!params.disable_rfactor) {
+        rfactor_source = rfactor_large_reductions(outputs, params.parallelism);
+    }
+
     // Analyse the Halide algorithm and construct our abstract representation of it
     FunctionDAG dag(outputs, target);
     if (aslog::aslog_level() >= 2) {
@@ -537,7 +868,7 @@ void generate_schedule(const std::vector<Function> &outputs,
     // Construct a cost model to use to evaluate states. Currently we
     // just have the one, but it's an abstract interface, so others
     // can be slotted in for experimentation.
-    std::unique_ptr<CostModel> cost_model = make_default_cost_model(weights_in_path, weights_out_path, randomize_weights);
+    std::unique_ptr<DefaultCostModel> cost_model = make_default_cost_model(weights_in_path, weights_out_path, randomize_weights);
     internal_assert(cost_model != nullptr);
 
     IntrusivePtr<State> optimal;
@@ -545,8 +876,43 @@ void generate_schedule(const std::vector<Function> &outputs,
     // Options generated from environment variables, decide whether or not to cache features and/or tilings.
     CachingOptions cache_options = CachingOptions::MakeOptionsFromParams(params);
 
-    // Run beam search
-    optimal = optimal_schedule(dag, outputs, params, cost_model.get(), rng, cache_options);
+    // Look for the schedule in the database. Randomized weights make any
+    // schedule stored there meaningless.
+    const ScheduleDatabase database(randomize_weights ? "" : params.schedule_database);
+    ScheduleDatabase::Key database_key;
+    SearchRecord warm_start;
+    bool near_miss = false;
+    // How the lookup went: a hit, a near-miss or a miss. It is reported at
+    // the start of the schedule source, so that it's clear where a
+    // schedule came from.
+    string database_result;
+    if (database.enabled()) {
+        database_key = make_database_key(dag, target, params, cost_model->weights_hash());
+        string payload;
+        SearchRecord record;
+        if (database.lookup(database_key, &payload) && record.from_string(payload)) {
+            optimal = replay_schedule(dag, params, cost_model.get(), cache_options, record.fingerprints);
+            if (optimal.defined()) {
+                database_result = "hit";
+            } else {
+                aslog(1) << "Failed to reproduce the schedule from the database\n";
+                database_result = "miss";
+            }
+        } else if (database.lookup_closest(database_key, &payload) && warm_start.from_string(payload)) {
+            near_miss = true;
+            database_result = "near-miss";
+        } else {
+            database_result = "miss";
+        }
+        aslog(1) << "Schedule database: " << database_result << "\n";
+    }
+
+    if (!optimal.defined()) {
+        // Run beam search
+        optimal = optimal_schedule(dag, outputs, params, cost_model.get(), rng, cache_options,
+                                   near_miss ? &warm_start : nullptr);
+        database.store(database_key, SearchRecord(dag, optimal.get()).to_string());
+    }
 
     HALIDE_TOC;
 
@@ -567,7 +933,11 @@ void generate_schedule(const std::vector<Function> &outputs,
     }
 
     if (auto_scheduler_results) {
-        auto_scheduler_results->schedule_source = optimal->schedule_source;
+        auto_scheduler_results->schedule_source = rfactor_source + optimal->schedule_source;
+        if (!database_result.empty()) {
+            auto_scheduler_results->schedule_source =
+                "// Schedule database: " + database_result + "\n" + auto_scheduler_results->schedule_source;
+        }
         {
             std::ostringstream out;
             optimal->save_featurization(dag, params, cache_options, out);
@@ -597,6 +967,9 @@ struct Adams2019 {
             parser.parse("disable_memoized_features", &params.disable_memoized_features);
             parser.parse("disable_memoized_blocks", &params.disable_memoized_blocks);
             parser.parse("memory_limit", &params.memory_limit);
+            parser.parse("search_threads", &params.search_threads);
+            parser.parse("schedule_database", &params.schedule_database);
+            parser.parse("disable_rfactor", &params.disable_rfactor);
             parser.finish();
         }
         Autoscheduler::generate_schedule(outputs, target, params, results);
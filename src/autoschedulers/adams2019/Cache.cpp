@@ -2,6 +2,8 @@
 #include "LoopNest.h"
 #include "State.h"
 
+#include <set>
+
 namespace Halide {
 namespace Internal {
 namespace Autoscheduler {
@@ -71,7 +73,7 @@ bool Cache::add_memoized_blocks(const State *state,
     return true;
 }
 
-void Cache::memoize_blocks(const FunctionDAG::Node *node, LoopNest *new_root) {
+void Cache::memoize_blocks(const State *state, const FunctionDAG::Node *node, const LoopNest *new_root) {
     if (!options.cache_blocks) {
         return;
     }
@@ -89,8 +91,7 @@ void Cache::memoize_blocks(const FunctionDAG::Node *node, LoopNest *new_root) {
 
     internal_assert(loop_nest_found) << "memoize_blocks did not find loop nest!\n";
 
-    auto &blocks = memoized_compute_root_blocks.get_or_create(node)[vector_dim];
-
+    std::vector<IntrusivePtr<const LoopNest>> blocks;
     for (auto &child : new_root->children) {
         if (child->node == node) {
             // Need const reference for copy.
@@ -98,9 +99,45 @@ void Cache::memoize_blocks(const FunctionDAG::Node *node, LoopNest *new_root) {
             LoopNest *new_block = new LoopNest;
             new_block->copy_from_including_features(*child_ptr);
             blocks.emplace_back(new_block);
-            cache_misses++;
         }
     }
+
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    pending_blocks[state].push_back({node, vector_dim, std::move(blocks)});
+}
+
+void Cache::commit_memoized_blocks(const std::vector<IntrusivePtr<State>> &states) {
+    if (!options.cache_blocks) {
+        return;
+    }
+
+    for (const auto &state : states) {
+        auto it = pending_blocks.find(state.get());
+        if (it == pending_blocks.end()) {
+            continue;
+        }
+
+        // A State that missed in the cache memoizes one tiling per
+        // child, all for the same Func and vector dimension. When
+        // expanding States one at a time, any later State would have
+        // hit on those, and not memoized its own.
+        std::set<std::pair<const FunctionDAG::Node *, int>> added;
+        for (auto &p : it->second) {
+            auto &vector_dim_map = memoized_compute_root_blocks.get_or_create(p.node);
+            auto key = std::make_pair(p.node, p.vector_dim);
+            if (!added.count(key) && vector_dim_map.count(p.vector_dim)) {
+                continue;
+            }
+            added.insert(key);
+
+            auto &blocks = vector_dim_map[p.vector_dim];
+            for (auto &b : p.blocks) {
+                blocks.emplace_back(std::move(b));
+                cache_misses++;
+            }
+        }
+    }
+    pending_blocks.clear();
 }
 
 }  // namespace Autoscheduler
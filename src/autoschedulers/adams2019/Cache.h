@@ -9,6 +9,9 @@
 #include "LoopNest.h"
 #include "PerfectHashMap.h"
 
+#include <atomic>
+#include <mutex>
+
 namespace Halide {
 namespace Internal {
 namespace Autoscheduler {
@@ -64,6 +67,11 @@ namespace Autoscheduler {
     Cache::add_memoized_blocks below (and in Cache.cpp).
     Additionally, if a tiling has not been cached, and it is not pruned, then the tiling will be
     cached using Cache::memoize_blocks (see below and in Cache.cpp).
+
+  The States of one step of beam search may generate their children on several threads at once.
+  Tilings memoized during a step only become visible to Cache::add_memoized_blocks once
+  Cache::commit_memoized_blocks has been called at the end of the step, so what each State sees
+  doesn't depend on how the work was split between threads.
 */
 
 struct State;
@@ -95,8 +103,18 @@ struct Cache {
     CachingOptions options;
     BlockCache memoized_compute_root_blocks;
 
-    mutable size_t cache_hits = 0;
-    mutable size_t cache_misses = 0;
+    mutable std::atomic<size_t> cache_hits{0};
+    size_t cache_misses = 0;
+
+    // Tilings memoized during the current step of beam search,
+    // by the State whose children they are.
+    struct PendingBlocks {
+        const FunctionDAG::Node *node;
+        int vector_dim;
+        std::vector<IntrusivePtr<const LoopNest>> blocks;
+    };
+    std::map<const State *, std::vector<PendingBlocks>> pending_blocks;
+    std::mutex pending_mutex;
 
     Cache() = delete;
     Cache(const CachingOptions &_options, size_t nodes_size)
@@ -119,8 +137,15 @@ struct Cache {
                              const Adams2019Params &params,
                              CostModel *cost_model) const;
 
-    // Generate tilings for a specific vector dimension and memoize them.
-    void memoize_blocks(const FunctionDAG::Node *node, LoopNest *new_root);
+    // Memoize the tiling of node in new_root, a child of state. It
+    // isn't used until commit_memoized_blocks is called.
+    void memoize_blocks(const State *state, const FunctionDAG::Node *node, const LoopNest *new_root);
+
+    // Make the tilings memoized while generating the children of the
+    // given states visible to add_memoized_blocks. If several of them
+    // memoized tilings for the same Func and vector dimension, the
+    // first one's are kept.
+    void commit_memoized_blocks(const std::vector<IntrusivePtr<State>> &states);
 };
 
 }  // namespace Autoscheduler
@@ -53,6 +53,22 @@ struct Adams2019Params {
     /** If >= 0, only consider schedules that allocate at most this much memory (measured in bytes).
      * Formerly HL_AUTOSCHEDULE_MEMORY_LIMIT */
     int64_t memory_limit = -1;
+
+    /** Number of threads to generate and featurize the states of the beam search on.
+     * If 0, use one per core. Defaults to 1, so that builds running many generators
+     * at once don't oversubscribe the machine. The schedule found doesn't depend on it. */
+    int search_threads = 1;
+
+    /** If set, look for a schedule in the schedule database in this directory before searching,
+     * and store the schedule found there afterwards. If the database holds a schedule for the
+     * same pipeline with different estimates or parameters, the search starts from it. The
+     * schedule source starts with a comment saying whether the lookup was a hit, a near-miss
+     * or a miss. */
+    std::string schedule_database;
+
+    /** If set to nonzero value: don't rfactor reductions that have too little parallelism
+     * in their pure loops to keep the machine busy. */
+    int disable_rfactor = 0;
 };
 
 }  // namespace Autoscheduler
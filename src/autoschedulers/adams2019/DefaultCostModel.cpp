@@ -48,6 +48,7 @@ bool ends_with(const std::string &str, const std::string &suffix) {
 
 void DefaultCostModel::set_pipeline_features(const Internal::Autoscheduler::FunctionDAG &dag,
                                              const Internal::Autoscheduler::Adams2019Params &params) {
+    wait_for_inference();
 
     const int pipeline_feat_size = head1_w * head1_h;
     // We ignore the first seven pipeline features in the cost
@@ -85,6 +86,7 @@ void DefaultCostModel::set_pipeline_features(const Internal::Autoscheduler::Func
 }
 
 void DefaultCostModel::set_pipeline_features(const Runtime::Buffer<float> &pipeline_feats, int n) {
+    wait_for_inference();
     pipeline_feat_queue = pipeline_feats;
     internal_assert(n > 0);
     num_cores = n;
@@ -162,7 +164,7 @@ void DefaultCostModel::enqueue(int ns, Runtime::Buffer<float> *schedule_feats, d
     }
 
     if (cursor == batch_size) {
-        evaluate_costs();
+        evaluate_costs_async();
     }
 
     *schedule_feats = schedule_feat_queue.sliced(0, cursor);
@@ -178,6 +180,7 @@ void DefaultCostModel::enqueue(int ns, Runtime::Buffer<float> *schedule_feats, d
 // the first moment, and buf(_, 2) is the ADAM running average of
 // the second moment.
 float DefaultCostModel::backprop(const Runtime::Buffer<const float> &true_runtimes, float learning_rate) {
+    wait_for_inference();
     internal_assert(cursor != 0);
     internal_assert(pipeline_feat_queue.data());
     internal_assert(schedule_feat_queue.data());
@@ -275,40 +278,90 @@ float DefaultCostModel::backprop(const Runtime::Buffer<const float> &true_runtim
     return loss();
 }
 
-void DefaultCostModel::evaluate_costs() {
-    if (cursor == 0 || !schedule_feat_queue.data()) {
-        return;
-    }
-
-    internal_assert(pipeline_feat_queue.data());
-    internal_assert(schedule_feat_queue.data());
-
-    Runtime::Buffer<float> dst = costs.cropped(0, 0, cursor);
+void DefaultCostModel::run_cost_model(int n, int ns,
+                                      Runtime::Buffer<float> pipeline_feats,
+                                      Runtime::Buffer<float> schedule_feats,
+                                      Runtime::Buffer<float> dst) {
+    internal_assert(pipeline_feats.data());
+    internal_assert(schedule_feats.data());
 
     auto loss = Runtime::Buffer<float>::make_scalar();
 
-    int result = cost_model(num_stages,
-                            cursor,
+    int result = cost_model(ns,
+                            n,
                             num_cores,
-                            pipeline_feat_queue,
-                            schedule_feat_queue,
+                            pipeline_feats,
+                            schedule_feats,
                             weights.head1_filter, weights.head1_bias,
                             weights.head2_filter, weights.head2_bias,
                             weights.conv1_filter, weights.conv1_bias,
                             0.0f, 0, 0, nullptr,
-                            dst, loss);
+                            dst.cropped(0, 0, n), loss);
     (void)result;
     internal_assert(result == 0);
+}
+
+void DefaultCostModel::evaluate_costs_async() {
+    // Only one batch is evaluated at a time, so that it can use all the cores.
+    wait_for_inference();
+
+    if (!spare_schedule_feat_queue.data() ||
+        spare_schedule_feat_queue.dim(2).extent() != schedule_feat_queue.dim(2).extent()) {
+        spare_schedule_feat_queue = Runtime::Buffer<float>(schedule_feat_queue.dim(0).extent(), head2_w, schedule_feat_queue.dim(2).extent());
+        spare_costs = Runtime::Buffer<float>(costs.dim(0).extent());
+        spare_cost_ptrs = Runtime::Buffer<double *>(cost_ptrs.dim(0).extent());
+    }
+    std::swap(schedule_feat_queue, spare_schedule_feat_queue);
+    std::swap(costs, spare_costs);
+    std::swap(cost_ptrs, spare_cost_ptrs);
+
+    // The thread gets its own references to the buffers it uses, but the
+    // weights are shared, so anything that changes them must wait for it.
+    in_flight = cursor;
+    inference_thread = std::thread([this, n = cursor, ns = num_stages,
+                                    pipeline_feats = pipeline_feat_queue,
+                                    schedule_feats = spare_schedule_feat_queue,
+                                    dst = spare_costs]() {
+        run_cost_model(n, ns, pipeline_feats, schedule_feats, dst);
+    });
+    cursor = 0;
+}
+
+void DefaultCostModel::wait_for_inference() {
+    if (!inference_thread.joinable()) {
+        return;
+    }
+    inference_thread.join();
+
+    // The costs are only written out on this thread, so that the search
+    // never sees them change underneath it.
+    for (int i = 0; i < in_flight; i++) {
+        internal_assert(spare_cost_ptrs(i));
+        *(spare_cost_ptrs(i)) = spare_costs(i);
+    }
+    in_flight = 0;
+}
+
+void DefaultCostModel::evaluate_costs() {
+    wait_for_inference();
+
+    if (cursor == 0 || !schedule_feat_queue.data()) {
+        return;
+    }
+
+    run_cost_model(cursor, num_stages, pipeline_feat_queue, schedule_feat_queue, costs);
 
     for (int i = 0; i < cursor; i++) {
         internal_assert(cost_ptrs(i));
-        *(cost_ptrs(i)) = dst(i);
+        *(cost_ptrs(i)) = costs(i);
     }
 
     cursor = 0;
 }
 
 void DefaultCostModel::load_weights() {
+    wait_for_inference();
+
     bool need_randomize = randomize_weights;
 
     if (weights_in_path.empty()) {
@@ -382,11 +435,28 @@ void DefaultCostModel::save_weights() {
     }
 }
 
+uint64_t DefaultCostModel::weights_hash() const {
+    std::ostringstream o;
+    const bool saved = weights.save(o);
+    internal_assert(saved) << "Unable to serialize the weights\n";
+    // FNV-1a, which unlike std::hash is the same in every build.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : o.str()) {
+        hash = (hash ^ (uint8_t)c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 // Discard any enqueued but unevaluated schedules
 void DefaultCostModel::reset() {
+    wait_for_inference();
     cursor = 0;
 }
 
+DefaultCostModel::~DefaultCostModel() {
+    wait_for_inference();
+}
+
 std::unique_ptr<DefaultCostModel> make_default_cost_model(const std::string &weights_in_path,
                                                           const std::string &weights_out_path,
                                                           bool randomize_weights) {
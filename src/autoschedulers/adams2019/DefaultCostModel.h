@@ -4,6 +4,7 @@
 #include "CostModel.h"
 #include "Weights.h"
 #include <string>
+#include <thread>
 
 namespace Halide {
 
@@ -20,6 +21,13 @@ private:
     Runtime::Buffer<double *> cost_ptrs;
     int cursor, num_stages, num_cores;
 
+    // When the queue fills up, it is evaluated on another thread while
+    // these take its place, so the search can keep enqueueing schedules.
+    Runtime::Buffer<float> spare_schedule_feat_queue, spare_costs;
+    Runtime::Buffer<double *> spare_cost_ptrs;
+    std::thread inference_thread;
+    int in_flight = 0;
+
     const std::string weights_in_path, weights_out_path;
     const bool randomize_weights;
 
@@ -29,6 +37,19 @@ private:
         conv1_filter_update, conv1_bias_update;
     int timestep = 0;
 
+    // Run the cost model on the first n schedules of a queue.
+    void run_cost_model(int n, int ns,
+                        Runtime::Buffer<float> pipeline_feats,
+                        Runtime::Buffer<float> schedule_feats,
+                        Runtime::Buffer<float> dst);
+
+    // Start evaluating the full queue on another thread.
+    void evaluate_costs_async();
+
+    // Wait for any evaluation started by evaluate_costs_async to finish,
+    // and write out its costs.
+    void wait_for_inference();
+
 public:
     DefaultCostModel(const std::string &weights_in_path,
                      const std::string &weights_out_path,
@@ -39,7 +60,7 @@ public:
 
         load_weights();
     }
-    ~DefaultCostModel() override = default;
+    ~DefaultCostModel() override;
 
     // Configure the cost model for the algorithm to be scheduled.
     void set_pipeline_features(const Internal::Autoscheduler::FunctionDAG &dag,
@@ -65,6 +86,10 @@ public:
     // Save/Load the model weights to/from disk.
     void save_weights();
     void load_weights();
+
+    // A hash of the current weights, which changes when they are
+    // retrained even if the path they were loaded from doesn't.
+    uint64_t weights_hash() const;
 };
 
 std::unique_ptr<DefaultCostModel> make_default_cost_model(const std::string &weights_in_dir = "",
@@ -113,7 +113,7 @@ void LoopNest::copy_from(const LoopNest &n) {
     children = n.children;
     inlined = n.inlined;
     store_at = n.store_at;
-    bounds = n.bounds;
+    copy_bounds_from(n);
     node = n.node;
     stage = n.stage;
     innermost = n.innermost;
@@ -123,6 +123,11 @@ void LoopNest::copy_from(const LoopNest &n) {
     vectorized_loop_index = n.vectorized_loop_index;
 };
 
+void LoopNest::copy_bounds_from(const LoopNest &n) {
+    std::lock_guard<std::mutex> lock(n.cache_mutex);
+    bounds = n.bounds;
+}
+
 // Hash the loop structure and sizes up to a fixed depth. This is
 // used as the hash function for the coarse-to-fine beam search in
 // the paper.
@@ -309,6 +314,11 @@ void LoopNest::compute_features(const FunctionDAG &dag,
     }
 
     if (is_root()) {
+        // Features computed here for children that weren't in the
+        // cache. They only go into the cache once they are complete,
+        // because other threads may be reading it.
+        vector<pair<const LoopNest *, StageMap<ScheduleFeatures>>> to_memoize;
+
         // TODO: This block of code is repeated below. Refactor
         for (const auto &c : children) {
 
@@ -316,8 +326,17 @@ void LoopNest::compute_features(const FunctionDAG &dag,
 
             if (use_cached_features) {
                 // Checks if the features cache has seen this state before, and use the cached features if so.
-                if (c->features_cache.count(hash_of_producers) > 0) {
-                    const auto &entry = c->features_cache.at(hash_of_producers);
+                // Entries are never modified once added, so they can be read without holding the lock.
+                const StageMap<ScheduleFeatures> *cached = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(c->cache_mutex);
+                    auto it = c->features_cache.find(hash_of_producers);
+                    if (it != c->features_cache.end()) {
+                        cached = &(it->second);
+                    }
+                }
+                if (cached) {
+                    const auto &entry = *cached;
 
                     for (auto it = entry.begin(); it != entry.end(); it++) {
                         const auto *stage_ptr = it.key();
@@ -341,8 +360,10 @@ void LoopNest::compute_features(const FunctionDAG &dag,
 
             if (use_cached_features) {
                 // Cache these features for future reference.
-                c->features_cache[hash_of_producers].make_large(dag.nodes[0].stages[0].max_id);
-                c->memoize_features(c->features_cache[hash_of_producers], features);
+                to_memoize.emplace_back(c.get(), StageMap<ScheduleFeatures>());
+                auto &entry = to_memoize.back().second;
+                entry.make_large(dag.nodes[0].stages[0].max_id);
+                c->memoize_features(entry, features);
             }
         }
 
@@ -416,7 +437,8 @@ void LoopNest::compute_features(const FunctionDAG &dag,
         }
 
         if (use_cached_features) {
-            for (const auto &c : children) {
+            for (auto &m : to_memoize) {
+                const LoopNest *c = m.first;
                 uint64_t hash_of_producers = sites.get(c->stage).hash_of_producers_stored_at_root;
 
                 // When computing feat.points_computed_minimum above, the order
@@ -425,9 +447,12 @@ void LoopNest::compute_features(const FunctionDAG &dag,
                 // may not have been computed when it is accessed as a memoized
                 // feature. We memoize 'points_computed_minimum' here to ensure
                 // its value is always available
-                if (c->features_cache.count(hash_of_producers) > 0) {
-                    c->memoize_points_computed_minimum(c->features_cache[hash_of_producers], features);
-                }
+                c->memoize_points_computed_minimum(m.second, features);
+
+                // If another thread cached features for the same
+                // producers in the meantime, they are the same as these.
+                std::lock_guard<std::mutex> lock(c->cache_mutex);
+                c->features_cache.emplace(hash_of_producers, std::move(m.second));
             }
             recompute_inlined_features(sites, features);
         }
@@ -997,6 +1022,7 @@ void LoopNest::compute_features(const FunctionDAG &dag,
         if (use_cached_features) {
             const auto &block = sites.get(stage).task;
             uint64_t hash_of_producers = sites.get(block->stage).hash_of_producers_stored_at_root;
+            std::lock_guard<std::mutex> lock(block->cache_mutex);
             auto &intermediate_map = block->feature_intermediates_cache[hash_of_producers].get_or_create(&(f->stages[0]));
             auto &intermediate = intermediate_map.get_or_create(stage);
 
@@ -1011,12 +1037,15 @@ void LoopNest::compute_features(const FunctionDAG &dag,
 // Get the region required of a Func at this site, from which we
 // know what region would be computed if it were scheduled here,
 // and what its loop nest would be.
-const Bound &LoopNest::get_bounds(const FunctionDAG::Node *f) const {
-    if (bounds.contains(f)) {
-        const Bound &b = bounds.get(f);
-        // Expensive validation for debugging
-        // b->validate();
-        return b;
+Bound LoopNest::get_bounds(const FunctionDAG::Node *f) const {
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if (bounds.contains(f)) {
+            const Bound &b = bounds.get(f);
+            // Expensive validation for debugging
+            // b->validate();
+            return b;
+        }
     }
     auto *bound = f->make_bound();
 
@@ -1067,7 +1096,9 @@ const Bound &LoopNest::get_bounds(const FunctionDAG::Node *f) const {
         f->loop_nest_for_region(i, &(bound->region_computed(0)), &(bound->loops(i, 0)));
     }
 
-    const Bound &b = set_bounds(f, bound);
+    // If another thread got here first, it computed the same
+    // thing, so it doesn't matter which one we keep.
+    Bound b = set_bounds(f, bound);
     // Validation is expensive, turn if off by default.
     // b->validate();
     return b;
@@ -1362,7 +1393,7 @@ IntrusivePtr<const LoopNest> LoopNest::parallelize_in_tiles(const Adams2019Param
     inner->innermost = innermost;
     inner->children = children;
     inner->inlined = inlined;
-    inner->bounds = bounds;
+    inner->copy_bounds_from(*this);
     inner->store_at = store_at;
 
     auto *b = inner->get_bounds(node)->make_copy();
@@ -1536,7 +1567,7 @@ vector<IntrusivePtr<const LoopNest>> LoopNest::compute_in_tiles(const FunctionDA
             inner->innermost = innermost;
             inner->children = children;
             inner->inlined = inlined;
-            inner->bounds = bounds;
+            inner->copy_bounds_from(*this);
             inner->store_at = store_at;
 
             {
@@ -1943,6 +1974,7 @@ void LoopNest::apply(LoopLevel here,
 }
 
 void LoopNest::copy_from_including_features(const LoopNest &n) {
+    std::lock_guard<std::mutex> lock(n.cache_mutex);
     size = n.size;
     children = n.children;
     inlined = n.inlined;
@@ -2030,9 +2062,13 @@ void LoopNest::recompute_inlined_features(const StageMap<Sites> &sites, StageMap
         internal_assert(sites.contains(block->stage));
         uint64_t hash_of_producers = sites.get(block->stage).hash_of_producers_stored_at_root;
 
-        internal_assert(block->feature_intermediates_cache.count(hash_of_producers) > 0);
-        auto &intermediate_map = block->feature_intermediates_cache[hash_of_producers].get(&(f->stages[0]));
-        auto &intermediate = intermediate_map.get(stage);
+        FeatureIntermediates intermediate;
+        {
+            std::lock_guard<std::mutex> lock(block->cache_mutex);
+            internal_assert(block->feature_intermediates_cache.count(hash_of_producers) > 0);
+            const auto &intermediate_map = block->feature_intermediates_cache[hash_of_producers].get(&(f->stages[0]));
+            intermediate = intermediate_map.get(stage);
+        }
 
         auto &inlined_feat = features->get(&(f->stages[0]));
         inlined_feat.inlined_calls += intermediate.inlined_calls;
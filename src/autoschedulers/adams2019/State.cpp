@@ -513,7 +513,7 @@ void State::generate_children(const FunctionDAG &dag,
                     num_children++;
                     accept_child(std::move(child));
                     // Will early return if block caching is not enabled.
-                    cache->memoize_blocks(node, new_root);
+                    cache->memoize_blocks(this, node, new_root);
                 }
             }
         }
@@ -686,7 +686,7 @@ void State::apply_schedule(const FunctionDAG &dag, const Adams2019Params &params
 }
 
 // Keep track of how many times we evaluated a state.
-int State::cost_calculations = 0;
+std::atomic<int> State::cost_calculations{0};
 
 }  // namespace Autoscheduler
 }  // namespace Internal
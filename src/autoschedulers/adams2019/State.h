@@ -9,6 +9,7 @@
 #include "Halide.h"
 #include "LoopNest.h"
 #include "PerfectHashMap.h"
+#include <atomic>
 #include <map>
 #include <utility>
 
@@ -37,7 +38,7 @@ struct State {
 
     // The number of times a cost is enqueued into the cost model,
     // for all states.
-    static int cost_calculations;
+    static std::atomic<int> cost_calculations;
 
     State() = default;
     State(const State &) = delete;
@@ -77,7 +78,9 @@ struct State {
 
     // Generate the successor states to this state.
     // If they are not pruned by `calculate_cost()`,
-    // then calls `accept_child()` on them.
+    // then calls `accept_child()` on them. Several states may
+    // generate their children at once on different threads, as
+    // long as each is given its own `cost_model`.
     void generate_children(const FunctionDAG &dag,
                            const Adams2019Params &params,
                            CostModel *cost_model,
@@ -1,5 +1,7 @@
 #!/bin/bash
 
+# See also autotune.cpp, which does the same thing in a single process.
+
 # Build the generator to autotune. This script will be autotuning the
 # autoscheduler's cost model training pipeline, which is large enough
 # to be interesting.
@@ -113,6 +115,7 @@ make_featurization() {
         autoscheduler.beam_size=${beam} \
         autoscheduler.random_dropout=${dropout} \
         autoscheduler.random_dropout_seed=${SEED} \
+        autoscheduler.search_threads=1 \
         autoscheduler.weights_path=${WEIGHTS} \
             2> ${D}/compile_log.txt || echo "Compilation failed or timed out for ${D}"
 
@@ -0,0 +1,545 @@
+// An in-process version of adams2019_autotune_loop.sh.
+//
+// Link the adams2019_autotune library with the source of one or more
+// Generators (the way Halide::GenGen is linked to make a .generator
+// executable), and run the result to autotune one of them:
+//
+//     my_pipeline.autotune --generator=my_pipeline --samples=samples_dir
+//         --plugin=bin/libautoschedule_adams2019.so [generator params...]
+//
+// Each batch builds --batch_size schedules for the Generator's pipeline
+// with the Adams2019 autoscheduler and JIT-compiles them, several at a
+// time. Schedule 0 of each batch comes from a full beam search; the rest
+// are random probes biased by the current cost model. The schedules are
+// then benchmarked one at a time, with the benchmarking threads pinned to
+// a fixed set of cores, and each one is written to the samples directory
+// as a .sample file (in the same format as featurization_to_sample
+// produces) along with its .schedule.h. Finally the cost model is
+// retrained on all of the samples in the directory, and the weights are
+// written to samples_dir/updated.weights, which the next batch uses.
+//
+// Unlike the script, this doesn't enforce timeouts on compilation or
+// benchmarking, and it fills input buffers with zeros, sized from their
+// estimates, rather than using RunGen.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "cmdline.h"
+
+#include "DefaultCostModel.h"
+#include "NetworkSize.h"
+#include "halide_benchmark.h"
+
+namespace {
+
+using namespace Halide;
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace fs = std::filesystem;
+
+struct Flags {
+    string generator;
+    string samples_dir;
+    string plugin;
+    Target target;
+    string initial_weights_path;
+    int batch_size = 32;
+    int num_batches = 1;
+    int parallelism = 32;
+    int compile_threads = 0;
+    int benchmark_cores = 0;
+    int epochs = 0;
+    float rate = 0.0001f;
+    vector<std::pair<string, string>> generator_params;
+
+    Flags(int argc, char **argv) {
+        cmdline::parser a;
+
+        const char *kNoDesc = "";
+
+        constexpr bool kOptional = false;
+        a.add<string>("generator", 'g');
+        a.add<string>("samples", 'o');
+        a.add<string>("plugin", 'p', kNoDesc, kOptional, "");
+        a.add<string>("target", '\0', kNoDesc, kOptional, "host");
+        a.add<string>("initial_weights", '\0', kNoDesc, kOptional, "");
+        a.add<int>("batch_size", '\0', kNoDesc, kOptional, 32);
+        a.add<int>("num_batches", '\0', kNoDesc, kOptional, 1);
+        a.add<int>("parallelism", '\0', kNoDesc, kOptional, 32);
+        a.add<int>("compile_threads", '\0', kNoDesc, kOptional, 0);
+        a.add<int>("benchmark_cores", '\0', kNoDesc, kOptional, 0);
+        a.add<int>("epochs", '\0', kNoDesc, kOptional, 0);
+        a.add<float>("rate", '\0', kNoDesc, kOptional, 0.0001f);
+        a.footer("[generator_param=value ...]");
+
+        a.parse_check(argc, argv);  // exits if parsing fails
+
+        generator = a.get<string>("generator");
+        samples_dir = a.get<string>("samples");
+        plugin = a.get<string>("plugin");
+        target = Target(a.get<string>("target"));
+        initial_weights_path = a.get<string>("initial_weights");
+        batch_size = a.get<int>("batch_size");
+        num_batches = a.get<int>("num_batches");
+        parallelism = a.get<int>("parallelism");
+        compile_threads = a.get<int>("compile_threads");
+        benchmark_cores = a.get<int>("benchmark_cores");
+        epochs = a.get<int>("epochs");
+        rate = a.get<float>("rate");
+
+        for (const string &s : a.rest()) {
+            const size_t eq = s.find('=');
+            if (eq == string::npos) {
+                std::cerr << "Generator params must be of the form name=value: " << s << "\n";
+                std::cerr << a.usage();
+                exit(1);
+            }
+            generator_params.emplace_back(s.substr(0, eq), s.substr(eq + 1));
+        }
+
+        if (batch_size <= 0 || num_batches <= 0) {
+            std::cerr << "--batch_size and --num_batches must be > 0.\n";
+            std::cerr << a.usage();
+            exit(1);
+        }
+        if (compile_threads <= 0) {
+            compile_threads = (int)std::thread::hardware_concurrency();
+        }
+        if (epochs <= 0) {
+            // Same as the script
+            epochs = batch_size;
+        }
+    }
+};
+
+// One schedule of the pipeline, compiled and ready to benchmark.
+struct Candidate {
+    string name;
+    fs::path dir;
+    int32_t schedule_id = 0;
+    Internal::AbstractGeneratorPtr generator;
+    Pipeline pipeline;
+    AutoSchedulerResults results;
+    vector<Buffer<>> outputs;
+    string error;
+};
+
+// Give a scalar input its estimated value.
+void set_scalar_to_estimate(Parameter &p) {
+    user_assert(p.estimate().defined()) << "Can't autotune without an estimate for " << p.name() << "\n";
+    const Expr e = Internal::simplify(cast(p.type(), p.estimate()));
+    halide_scalar_value_t v;
+    if (p.type().is_float()) {
+        auto f = Internal::as_const_float(e);
+        user_assert(f) << "The estimate for " << p.name() << " must be a constant: " << p.estimate() << "\n";
+        if (p.type().bits() == 32) {
+            v.u.f32 = (float)*f;
+        } else {
+            v.u.f64 = *f;
+        }
+    } else {
+        std::optional<uint64_t> bits;
+        if (p.type().is_int()) {
+            if (auto i = Internal::as_const_int(e)) {
+                bits = (uint64_t)*i;
+            }
+        } else if (auto u = Internal::as_const_uint(e)) {
+            bits = *u;
+        }
+        user_assert(bits) << "The estimate for " << p.name() << " must be a constant: " << p.estimate() << "\n";
+        switch (p.type().bits()) {
+        case 1:
+            v.u.b = *bits != 0;
+            break;
+        case 8:
+            v.u.u8 = (uint8_t)*bits;
+            break;
+        case 16:
+            v.u.u16 = (uint16_t)*bits;
+            break;
+        case 32:
+            v.u.u32 = (uint32_t)*bits;
+            break;
+        default:
+            v.u.u64 = *bits;
+        }
+    }
+    p.set_scalar(p.type(), v);
+}
+
+// Make a buffer with the given estimates for the min and extent of each
+// dimension. The name is for the error message if they're missing.
+Buffer<> make_buffer(const Type &t, const vector<std::pair<Expr, Expr>> &estimates, const string &name) {
+    vector<int> min, extent;
+    for (const auto &[m, e] : estimates) {
+        auto mi = m.defined() ? Internal::as_const_int(Internal::simplify(m)) : std::nullopt;
+        auto ei = e.defined() ? Internal::as_const_int(Internal::simplify(e)) : std::nullopt;
+        user_assert(mi && ei) << "Can't autotune without estimates for all of the dimensions of " << name << "\n";
+        min.push_back((int)*mi);
+        extent.push_back((int)*ei);
+    }
+    Buffer<> b(t, extent);
+    b.set_min(min);
+    return b;
+}
+
+// Build a schedule of the pipeline and JIT-compile it.
+void compile_candidate(const Flags &flags, const string &weights_path, Candidate &c) {
+    c.generator = Internal::GeneratorRegistry::create(flags.generator, GeneratorContext(flags.target));
+    user_assert(c.generator) << "Unknown generator: " << flags.generator << "\n";
+    for (const auto &[name, value] : flags.generator_params) {
+        c.generator->set_generatorparam_value(name, value);
+    }
+    c.pipeline = c.generator->build_pipeline();
+
+    // Sample 0 in each batch is best effort beam search, with no
+    // randomness. The others are random probes biased by the cost model.
+    const bool beam = c.schedule_id % 10000 == 0;
+    AutoschedulerParams params("Adams2019",
+                               {{"parallelism", std::to_string(flags.parallelism)},
+                                {"beam_size", beam ? "32" : "1"},
+                                {"random_dropout", beam ? "100" : "1"},
+                                {"random_dropout_seed", std::to_string(c.schedule_id)},
+                                {"search_threads", "1"},
+                                {"weights_path", weights_path}});
+    c.results = c.pipeline.apply_autoscheduler(flags.target, params);
+    c.pipeline.compile_jit(flags.target);
+
+    for (const auto &arg : c.generator->arginfos()) {
+        if (arg.dir == Internal::ArgInfoDirection::Input) {
+            for (Parameter &p : c.generator->input_parameter(arg.name)) {
+                if (p.is_buffer()) {
+                    vector<std::pair<Expr, Expr>> estimates;
+                    for (int i = 0; i < p.dimensions(); i++) {
+                        estimates.emplace_back(p.min_constraint_estimate(i), p.extent_constraint_estimate(i));
+                    }
+                    Buffer<> b = make_buffer(p.type(), estimates, p.name());
+                    memset(b.data(), 0, b.size_in_bytes());
+                    p.set_buffer(b);
+                } else {
+                    set_scalar_to_estimate(p);
+                }
+            }
+        }
+    }
+
+    for (const Func &f : c.pipeline.outputs()) {
+        vector<std::pair<Expr, Expr>> estimates;
+        for (const string &arg : f.function().args()) {
+            std::pair<Expr, Expr> e;
+            for (const Internal::Bound &b : f.function().schedule().estimates()) {
+                if (b.var == arg) {
+                    e = {b.min, b.extent};
+                }
+            }
+            estimates.push_back(e);
+        }
+        for (const Type &t : f.types()) {
+            c.outputs.push_back(make_buffer(t, estimates, f.name()));
+        }
+    }
+}
+
+// Keep the calling thread, and so any threads it starts later (including
+// the Halide runtime's thread pool), on the first n cores.
+void pin_to_cores(int n) {
+#ifdef __linux__
+    if (n <= 0) {
+        return;
+    }
+    // Don't start more runtime threads than there are cores to run them
+    setenv("HL_NUM_THREADS", std::to_string(n).c_str(), 0);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < n && i < CPU_SETSIZE; i++) {
+        CPU_SET(i, &set);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        std::cerr << "Failed to pin the benchmarking thread to " << n << " cores\n";
+    }
+#else
+    (void)n;
+#endif
+}
+
+// Returns the runtime in seconds, or a negative value if it failed.
+double benchmark_candidate(const Target &target, Candidate &c) {
+    Realization outputs(c.outputs);
+    int result = 0;
+    auto op = [&]() {
+#ifdef HALIDE_WITH_EXCEPTIONS
+        try {
+            c.pipeline.realize(outputs, target);
+        } catch (const Halide::Error &e) {
+            result = -1;
+            c.error = e.what();
+        }
+#else
+        c.pipeline.realize(outputs, target);
+#endif
+    };
+    // Run it once first, to fail early and fault in the outputs
+    op();
+    if (result != 0) {
+        return -1;
+    }
+    return Tools::benchmark(op).wall_time;
+}
+
+struct Schedule {
+    float runtime;  // in msec
+    Runtime::Buffer<float> features;
+};
+
+struct PipelineSamples {
+    int num_stages = 0;
+    Runtime::Buffer<float> pipeline_features;
+    // Keyed by the schedule features, to merge repeated measurements of
+    // the same schedule.
+    map<vector<float>, Schedule> schedules;
+};
+
+// Load all the .sample files in the samples directory. This is the same
+// parsing that adams2019_retrain_cost_model does.
+map<int32_t, PipelineSamples> load_samples(const string &dir, string *best_path) {
+    map<int32_t, PipelineSamples> result;
+    const size_t features_per_stage = head2_w + (head1_w + 1) * head1_h;
+    float best_runtime = 1e20f;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+        if (it->path().extension() != ".sample") {
+            continue;
+        }
+        std::ifstream file(it->path(), std::ios::binary);
+        vector<float> scratch;
+        float f;
+        while (file.read((char *)&f, sizeof(f))) {
+            scratch.push_back(f);
+        }
+        if (scratch.size() < 3 || (scratch.size() - 3) % features_per_stage != 0) {
+            std::cout << "Truncated sample: " << it->path().string() << "\n";
+            continue;
+        }
+        const size_t num_features = scratch.size() - 3;
+        const size_t num_stages = num_features / features_per_stage;
+        const float runtime = scratch[num_features];
+        int32_t pipeline_id;
+        memcpy(&pipeline_id, &scratch[num_features + 1], sizeof(pipeline_id));
+
+        PipelineSamples &ps = result[pipeline_id];
+        if (ps.num_stages == 0) {
+            ps.num_stages = (int)num_stages;
+            ps.pipeline_features = Runtime::Buffer<float>(head1_w, head1_h, num_stages);
+            for (size_t i = 0; i < num_stages; i++) {
+                for (int x = 0; x < head1_w; x++) {
+                    for (int y = 0; y < head1_h; y++) {
+                        ps.pipeline_features(x, y, i) = scratch[i * features_per_stage + (x + 1) * 7 + y + head2_w];
+                    }
+                }
+            }
+        } else if ((size_t)ps.num_stages != num_stages) {
+            std::cout << "Sample has the wrong number of stages for its pipeline: " << it->path().string() << "\n";
+            continue;
+        }
+
+        vector<float> key;
+        Runtime::Buffer<float> features(head2_w, num_stages);
+        for (size_t i = 0; i < num_stages; i++) {
+            for (int x = 0; x < head2_w; x++) {
+                features(x, i) = scratch[i * features_per_stage + x];
+                key.push_back(features(x, i));
+            }
+        }
+        auto [s, inserted] = ps.schedules.emplace(std::move(key), Schedule{runtime, features});
+        if (!inserted) {
+            // Keep the fastest measurement
+            s->second.runtime = std::min(s->second.runtime, runtime);
+        }
+        if (runtime < best_runtime) {
+            best_runtime = runtime;
+            *best_path = it->path().string();
+        }
+    }
+    return result;
+}
+
+// Retrain the cost model on all the samples so far, in the same way that
+// adams2019_retrain_cost_model does (without a validation set).
+void retrain(const Flags &flags, const string &weights_path) {
+    string best_path;
+    auto samples = load_samples(flags.samples_dir, &best_path);
+    auto model = make_default_cost_model(weights_path, weights_path, false);
+    std::mt19937 rng(0);
+    for (int e = 0; e < flags.epochs; e++) {
+        float loss_sum = 0;
+        int loss_count = 0;
+        for (auto &[id, ps] : samples) {
+            if (ps.schedules.size() < 8) {
+                continue;
+            }
+            model->reset();
+            model->set_pipeline_features(ps.pipeline_features, flags.parallelism);
+
+            const size_t batch_size = std::min((size_t)1024, ps.schedules.size());
+            size_t first = 0;
+            if (ps.schedules.size() > 1024) {
+                first = rng() % (ps.schedules.size() - 1024);
+            }
+            vector<double> predictions(batch_size);
+            Runtime::Buffer<float> runtimes(batch_size);
+            auto it = std::next(ps.schedules.begin(), first);
+            for (size_t j = 0; j < batch_size; j++, it++) {
+                Runtime::Buffer<float> buf;
+                model->enqueue(ps.num_stages, &buf, &predictions[j]);
+                buf.copy_from(it->second.features);
+                runtimes(j) = it->second.runtime;
+            }
+            loss_sum += model->backprop(runtimes, flags.rate);
+            loss_count++;
+        }
+        if (loss_count > 0 && (e == 0 || e == flags.epochs - 1)) {
+            std::cout << "Epoch " << e << " loss: " << loss_sum / loss_count << "\n";
+        }
+    }
+    model->save_weights();
+    if (!best_path.empty()) {
+        std::cout << "Best schedule so far: " << best_path << "\n";
+    }
+}
+
+// The index of the last batch written to the samples directory, so that we
+// don't clobber existing samples.
+int last_batch(const string &dir) {
+    int last = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+        const string name = it->path().filename().string();
+        if (name.rfind("batch_", 0) == 0) {
+            last = std::max(last, std::atoi(name.c_str() + 6));
+        }
+    }
+    return last;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Flags flags(argc, argv);
+
+    if (!flags.plugin.empty()) {
+        load_plugin(flags.plugin);
+    }
+
+    fs::create_directories(flags.samples_dir);
+    const string weights_path = (fs::path(flags.samples_dir) / "updated.weights").string();
+    if (!fs::exists(weights_path)) {
+        // Only start from the initial weights if we don't have any already,
+        // so that restarted jobs can continue from where they left off.
+        if (flags.initial_weights_path.empty()) {
+            make_default_cost_model("", weights_path, false)->save_weights();
+        } else {
+            fs::copy_file(flags.initial_weights_path, weights_path);
+        }
+    }
+
+    const int first = last_batch(flags.samples_dir) + 1;
+    for (int batch = first; batch < first + flags.num_batches; batch++) {
+        const auto start = std::chrono::steady_clock::now();
+        const fs::path dir = fs::path(flags.samples_dir) / ("batch_" + std::to_string(batch) + "_0");
+        fs::create_directories(dir);
+        fs::copy_file(weights_path, dir / "used.weights", fs::copy_options::overwrite_existing);
+
+        vector<Candidate> candidates(flags.batch_size);
+        for (int i = 0; i < flags.batch_size; i++) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s_batch_%04d_sample_%04d", flags.generator.c_str(), batch, i);
+            candidates[i].name = name;
+            candidates[i].dir = dir / std::to_string(i);
+            candidates[i].schedule_id = batch * 10000 + i;
+        }
+
+        std::cout << "Compiling " << flags.batch_size << " samples on " << flags.compile_threads << " threads\n";
+        Internal::run_in_parallel(flags.batch_size, flags.compile_threads, [&](int i) {
+            Candidate &c = candidates[i];
+#ifdef HALIDE_WITH_EXCEPTIONS
+            try {
+                compile_candidate(flags, weights_path, c);
+            } catch (const Halide::Error &e) {
+                c.error = e.what();
+            }
+#else
+            compile_candidate(flags, weights_path, c);
+#endif
+        });
+
+        // Benchmark them serially, so that they don't compete for the
+        // cores. This happens on a thread of its own, so that pinning it
+        // doesn't also pin the threads that compile the next batch.
+        int succeeded = 0;
+        std::thread benchmarker([&]() {
+            pin_to_cores(flags.benchmark_cores);
+            for (Candidate &c : candidates) {
+                fs::create_directories(c.dir);
+                double runtime = -1;
+                if (c.error.empty()) {
+                    runtime = benchmark_candidate(flags.target, c);
+                }
+                if (!c.error.empty() || runtime < 0) {
+                    std::cout << "Compilation or benchmarking failed for " << c.dir.string() << ": " << c.error << "\n";
+                    continue;
+                }
+                std::cout << c.name << ": " << runtime * 1e3 << " ms\n";
+                succeeded++;
+
+                std::ofstream schedule(c.dir / (c.name + ".schedule.h"));
+                schedule << c.results.schedule_source;
+
+                std::ofstream sample(c.dir / (c.name + ".sample"), std::ios::binary);
+                sample.write((const char *)c.results.featurization.data(), c.results.featurization.size());
+                const float r = (float)(runtime * 1e3);
+                const int32_t pid = 0;
+                const int32_t sid = c.schedule_id;
+                sample.write((const char *)&r, 4);
+                sample.write((const char *)&pid, 4);
+                sample.write((const char *)&sid, 4);
+            }
+        });
+        benchmarker.join();
+        if (succeeded == 0) {
+            std::cerr << "Every sample in batch " << batch << " failed\n";
+            return 1;
+        }
+
+        // Release the compiled pipelines before retraining
+        candidates.clear();
+
+        std::cout << "Retraining model...\n";
+        retrain(flags, weights_path);
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Batch " << batch << " took " << seconds << " seconds to compile, benchmark, and retrain\n";
+    }
+
+    return 0;
+}
@@ -48,6 +48,7 @@ bool ends_with(const std::string &str, const std::string &suffix) {
 
 void DefaultCostModel::set_pipeline_features(const Internal::Autoscheduler::FunctionDAG &dag,
                                              const Internal::Autoscheduler::Anderson2021Params &params) {
+    wait_for_inference();
 
     const int pipeline_feat_size = head1_w * head1_h;
     // We ignore the first seven pipeline features in the cost
@@ -84,6 +85,7 @@ void DefaultCostModel::set_pipeline_features(const Internal::Autoscheduler::Func
 }
 
 void DefaultCostModel::set_pipeline_features(const Runtime::Buffer<float> &pipeline_feats, int n) {
+    wait_for_inference();
     pipeline_feat_queue = pipeline_feats;
     internal_assert(n > 0);
     num_cores = n;
@@ -169,7 +171,7 @@ void DefaultCostModel::enqueue(int ns, Runtime::Buffer<float> *schedule_feats, d
     }
 
     if (cursor == batch_size) {
-        evaluate_costs();
+        evaluate_costs_async();
     }
 
     *schedule_feats = schedule_feat_queue.sliced(0, cursor);
@@ -187,6 +189,7 @@ void DefaultCostModel::enqueue(int ns, Runtime::Buffer<float> *schedule_feats, d
 // the first moment, and buf(_, 2) is the ADAM running average of
 // the second moment.
 float DefaultCostModel::backprop(const Runtime::Buffer<const float> &true_runtimes, float learning_rate) {
+    wait_for_inference();
     internal_assert(cursor != 0);
     internal_assert(pipeline_feat_queue.data());
     internal_assert(schedule_feat_queue.data());
@@ -292,46 +295,109 @@ float DefaultCostModel::backprop(const Runtime::Buffer<const float> &true_runtim
     return loss();
 }
 
-void DefaultCostModel::evaluate_costs() {
-    if (cursor == 0 || !schedule_feat_queue.data()) {
-        return;
-    }
-
-    internal_assert(pipeline_feat_queue.data());
-    internal_assert(schedule_feat_queue.data());
-
-    Runtime::Buffer<float> dst = costs.cropped(0, 0, cursor);
-    Runtime::Buffer<float> dst_costs_per_stage = costs_per_stage.cropped({{0, cursor}, {0, num_stages}});
+void DefaultCostModel::run_cost_model(int n, int ns, int id,
+                                      Runtime::Buffer<float> pipeline_feats,
+                                      Runtime::Buffer<float> schedule_feats,
+                                      Runtime::Buffer<float> dst,
+                                      Runtime::Buffer<float> dst_costs_per_stage) {
+    internal_assert(pipeline_feats.data());
+    internal_assert(schedule_feats.data());
 
     auto loss = Runtime::Buffer<float>::make_scalar();
 
-    int result = cost_model(num_stages,
-                            cursor,
+    int result = cost_model(ns,
+                            n,
                             num_cores,
-                            batch_id++,
-                            pipeline_feat_queue,
-                            schedule_feat_queue,
+                            id,
+                            pipeline_feats,
+                            schedule_feats,
                             weights.head1_filter, weights.head1_bias,
                             weights.head2_filter, weights.head2_bias,
                             weights.conv1_filter, weights.conv1_bias,
                             0.0f, 0, 0, nullptr,
-                            dst, dst_costs_per_stage, loss);
+                            dst.cropped(0, 0, n),
+                            dst_costs_per_stage.cropped({{0, n}, {0, ns}}),
+                            loss);
     (void)result;
     internal_assert(result == 0);
+}
 
-    for (int i = 0; i < cursor; i++) {
-        internal_assert(cost_ptrs(i));
-        *(cost_ptrs(i)) = dst(i);
-        for (int s = 0; s < num_stages; ++s) {
-            (*cost_per_stage_ptrs[i])[s] = dst_costs_per_stage(i, s);
+void DefaultCostModel::write_costs(int n, int ns,
+                                   const Runtime::Buffer<float> &src,
+                                   const Runtime::Buffer<float> &src_costs_per_stage,
+                                   const Runtime::Buffer<double *> &dst_ptrs,
+                                   const std::vector<std::vector<double> *> &dst_per_stage_ptrs) {
+    for (int i = 0; i < n; i++) {
+        internal_assert(dst_ptrs(i));
+        *(dst_ptrs(i)) = src(i);
+        for (int s = 0; s < ns; ++s) {
+            (*dst_per_stage_ptrs[i])[s] = src_costs_per_stage(i, s);
         }
     }
+}
+
+void DefaultCostModel::evaluate_costs_async() {
+    // Only one batch is evaluated at a time, so that it can use all the cores.
+    wait_for_inference();
+
+    if (!spare_schedule_feat_queue.data() ||
+        spare_schedule_feat_queue.dim(2).extent() != schedule_feat_queue.dim(2).extent()) {
+        const int batch_size = schedule_feat_queue.dim(0).extent();
+        const int max_num_stages = schedule_feat_queue.dim(2).extent();
+        spare_schedule_feat_queue = Runtime::Buffer<float>(batch_size, head2_w, max_num_stages);
+        spare_costs_per_stage = Runtime::Buffer<float>(batch_size, max_num_stages);
+        spare_costs = Runtime::Buffer<float>(batch_size);
+        spare_cost_ptrs = Runtime::Buffer<double *>(batch_size);
+        spare_cost_per_stage_ptrs.resize(batch_size);
+    }
+    std::swap(schedule_feat_queue, spare_schedule_feat_queue);
+    std::swap(costs, spare_costs);
+    std::swap(costs_per_stage, spare_costs_per_stage);
+    std::swap(cost_ptrs, spare_cost_ptrs);
+    std::swap(cost_per_stage_ptrs, spare_cost_per_stage_ptrs);
+
+    // The thread gets its own references to the buffers it uses, but the
+    // weights are shared, so anything that changes them must wait for it.
+    in_flight = cursor;
+    in_flight_num_stages = num_stages;
+    inference_thread = std::thread([this, n = cursor, ns = num_stages, id = batch_id++,
+                                    pipeline_feats = pipeline_feat_queue,
+                                    schedule_feats = spare_schedule_feat_queue,
+                                    dst = spare_costs,
+                                    dst_costs_per_stage = spare_costs_per_stage]() {
+        run_cost_model(n, ns, id, pipeline_feats, schedule_feats, dst, dst_costs_per_stage);
+    });
+    cursor = 0;
+}
+
+void DefaultCostModel::wait_for_inference() {
+    if (!inference_thread.joinable()) {
+        return;
+    }
+    inference_thread.join();
+
+    // The costs are only written out on this thread, so that the search
+    // never sees them change underneath it.
+    write_costs(in_flight, in_flight_num_stages, spare_costs, spare_costs_per_stage, spare_cost_ptrs, spare_cost_per_stage_ptrs);
+    in_flight = 0;
+}
+
+void DefaultCostModel::evaluate_costs() {
+    wait_for_inference();
+
+    if (cursor == 0 || !schedule_feat_queue.data()) {
+        return;
+    }
+
+    run_cost_model(cursor, num_stages, batch_id++, pipeline_feat_queue, schedule_feat_queue, costs, costs_per_stage);
+    write_costs(cursor, num_stages, costs, costs_per_stage, cost_ptrs, cost_per_stage_ptrs);
 
     cursor = 0;
-    cost_per_stage_ptrs.clear();
 }
 
 void DefaultCostModel::load_weights() {
+    wait_for_inference();
+
     bool need_randomize = randomize_weights;
 
     if (weights_in_path.empty()) {
@@ -407,9 +473,14 @@ void DefaultCostModel::save_weights() {
 
 // Discard any enqueued but unevaluated schedules
 void DefaultCostModel::reset() {
+    wait_for_inference();
     cursor = 0;
 }
 
+DefaultCostModel::~DefaultCostModel() {
+    wait_for_inference();
+}
+
 std::unique_ptr<DefaultCostModel> make_default_cost_model(Internal::Autoscheduler::Statistics &stats,
                                                           const std::string &weights_in_path,
                                                           const std::string &weights_out_path,
@@ -5,6 +5,7 @@
 #include "Statistics.h"
 #include "Weights.h"
 #include <string>
+#include <thread>
 
 namespace Halide {
 
@@ -17,6 +18,14 @@ private:
     int cursor, num_stages, num_cores;
     int batch_id{0};
 
+    // When the queue fills up, it is evaluated on another thread while
+    // these take its place, so the search can keep enqueueing schedules.
+    Runtime::Buffer<float> spare_schedule_feat_queue, spare_costs, spare_costs_per_stage;
+    Runtime::Buffer<double *> spare_cost_ptrs;
+    std::vector<std::vector<double> *> spare_cost_per_stage_ptrs;
+    std::thread inference_thread;
+    int in_flight{0}, in_flight_num_stages{0};
+
     const std::string weights_in_path, weights_out_path;
     const bool randomize_weights;
 
@@ -28,6 +37,28 @@ private:
 
     Internal::Autoscheduler::Statistics &stats;
 
+    // Run the cost model on the first n schedules of a queue.
+    void run_cost_model(int n, int ns, int id,
+                        Runtime::Buffer<float> pipeline_feats,
+                        Runtime::Buffer<float> schedule_feats,
+                        Runtime::Buffer<float> dst,
+                        Runtime::Buffer<float> dst_costs_per_stage);
+
+    // Write the costs of the first n schedules of a queue out to where
+    // they were requested.
+    static void write_costs(int n, int ns,
+                            const Runtime::Buffer<float> &src,
+                            const Runtime::Buffer<float> &src_costs_per_stage,
+                            const Runtime::Buffer<double *> &dst_ptrs,
+                            const std::vector<std::vector<double> *> &dst_per_stage_ptrs);
+
+    // Start evaluating the full queue on another thread.
+    void evaluate_costs_async();
+
+    // Wait for any evaluation started by evaluate_costs_async to finish,
+    // and write out its costs.
+    void wait_for_inference();
+
 public:
     DefaultCostModel(const std::string &weights_in_path,
                      const std::string &weights_out_path,
@@ -39,6 +70,7 @@ public:
           stats{stats} {
         load_weights();
     }
+    ~DefaultCostModel() override;
 
     // Configure the cost model for the algorithm to be scheduled.
     void set_pipeline_features(const Internal::Autoscheduler::FunctionDAG &dag,
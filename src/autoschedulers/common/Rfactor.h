@@ -0,0 +1,228 @@
+#ifndef RFACTOR_H
+#define RFACTOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ASLog.h"
+#include "HalidePlugin.h"
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+// The autoschedulers can only parallelize and vectorize the pure loops of
+// an update definition, so a reduction with a small pure domain (a sum
+// over an image, a histogram) runs on one core however large its
+// reduction domain is. This pass finds such reductions with an
+// associative operator, splits one of their RVars, and rfactors the outer
+// half into a pure dimension of an intermediate Func, which the
+// autoscheduler can then parallelize and vectorize like any other. The
+// thresholds used to decide when this pays off are the ones Li2018 uses.
+//
+// The pass adds Funcs to the pipeline, so it must run before anything
+// analyses it. It returns the source code for what it did. That must come
+// before the rest of the schedule source, whose calls to
+// pipeline.get_func() count the new Funcs.
+inline std::string rfactor_large_reductions(const std::vector<Function> &outputs, int parallelism) {
+    const auto make_env = [&]() {
+        std::map<std::string, Function> env;
+        for (const Function &f : outputs) {
+            std::map<std::string, Function> more_funcs = find_transitive_calls(f);
+            env.insert(more_funcs.begin(), more_funcs.end());
+        }
+        return env;
+    };
+
+    std::map<std::string, Function> env = make_env();
+    for (const auto &it : env) {
+        if (it.second.has_extern_definition()) {
+            // We can't infer the bounds of the inputs to an extern stage.
+            return "";
+        }
+    }
+
+    struct Candidate {
+        Function func;
+        int update;
+        // The RVar to split, and its extent
+        std::string rvar;
+        int64_t extent;
+    };
+
+    // Look for associative reductions with enough work in them to be
+    // worth spreading across the machine.
+    std::vector<Candidate> candidates;
+    for (const std::string &name : topological_order(outputs, env)) {
+        const Function &f = env.at(name);
+        // If an update has been scheduled already, it may have been
+        // rfactored, and another rfactor would make a second Func with
+        // the same name as its intermediate.
+        if (std::any_of(f.updates().begin(), f.updates().end(),
+                        [](const Definition &def) { return def.schedule().touched(); })) {
+            continue;
+        }
+        for (int u = 0; u < (int)f.updates().size(); u++) {
+            const Definition &def = f.update(u);
+            const std::vector<ReductionVariable> &rvars = def.schedule().rvars();
+            if (rvars.empty()) {
+                continue;
+            }
+            std::vector<int64_t> extents;
+            int64_t work = 1;
+            for (const ReductionVariable &rv : rvars) {
+                auto extent = as_const_int(simplify(substitute_var_estimates(rv.extent)));
+                if (!extent) {
+                    break;
+                }
+                extents.push_back(*extent);
+                work *= *extent;
+            }
+            if (extents.size() != rvars.size() || work < 256 * (int64_t)parallelism) {
+                continue;
+            }
+            const AssociativeOp op = prove_associativity(f.name(), def.args(), def.values());
+            if (!op.associative()) {
+                continue;
+            }
+            // Split the outermost RVar, or the largest one if the operator
+            // is commutative, so long as it leaves at least two slices.
+            int r = (int)rvars.size() - 1;
+            if (op.commutative()) {
+                for (int i = r - 1; i >= 0; i--) {
+                    if (extents[i] > extents[r]) {
+                        r = i;
+                    }
+                }
+            }
+            if (extents[r] >= 16) {
+                candidates.push_back({f, u, rvars[r].var, extents[r]});
+            }
+        }
+    }
+    if (candidates.empty()) {
+        return "";
+    }
+
+    // Infer the bounds of everything from the estimates on the outputs,
+    // to find the size of the pure domain of each candidate.
+    std::vector<Func> output_funcs;
+    std::vector<Box> output_bounds;
+    for (const Function &output : outputs) {
+        const std::vector<Internal::Bound> &estimates = output.schedule().estimates();
+        std::vector<Interval> b;
+        for (const std::string &arg : output.args()) {
+            auto est = std::find_if(estimates.rbegin(), estimates.rend(), [&](const Internal::Bound &e) {
+                return e.var == arg && e.min.defined() && e.extent.defined();
+            });
+            if (est == estimates.rend()) {
+                // The autoscheduler will complain about this later.
+                return "";
+            }
+            b.emplace_back(est->min, simplify(est->min + est->extent - 1));
+        }
+        output_funcs.emplace_back(output);
+        output_bounds.emplace_back(b);
+    }
+    const std::map<std::string, Box> func_bounds = inference_bounds(output_funcs, output_bounds);
+
+    // Every intermediate rfactor makes for a Func is named after the Func,
+    // so only rfactor one update of each.
+    std::set<std::string> rfactored;
+    std::ostringstream src;
+    for (const Candidate &c : candidates) {
+        if (rfactored.count(c.func.name())) {
+            continue;
+        }
+        const Definition &def = c.func.update(c.update);
+        auto bounds = func_bounds.find(c.func.name());
+        if (bounds == func_bounds.end()) {
+            continue;
+        }
+        // Only the dimensions the update stores to with a pure Var can be
+        // parallelized.
+        int64_t pure_domain = 1;
+        for (int i = 0; i < c.func.dimensions() && pure_domain > 0; i++) {
+            const Variable *v = def.args()[i].as<Variable>();
+            if (!v || v->name != c.func.args()[i]) {
+                continue;
+            }
+            const Interval &in = bounds->second[i];
+            auto extent = in.is_bounded() ? as_const_int(simplify(substitute_var_estimates(in.max - in.min + 1))) : std::nullopt;
+            pure_domain = extent ? pure_domain * *extent : 0;
+        }
+        if (pure_domain <= 0 || pure_domain >= 8 * (int64_t)parallelism) {
+            continue;
+        }
+
+        rfactored.insert(c.func.name());
+
+        // The index of the Func in the pipeline as it is now, which
+        // counts the intermediates of any earlier rfactors.
+        env = make_env();
+        const std::vector<std::string> order = topological_order(outputs, env);
+        const size_t index = std::find(order.begin(), order.end(), c.func.name()) - order.begin();
+
+        const int factor = (int)std::ceil(std::sqrt((double)c.extent) / 8) * 8;
+        RVar r(c.rvar), ro(c.rvar + "o"), ri(c.rvar + "i");
+        Var v(c.rvar + "v");
+        Func intm = Func(c.func).update(c.update).split(r, ro, ri, factor, TailStrategy::GuardWithIf).rfactor(ro, v);
+        aslog(1) << "Rfactored " << c.func.name() << ".update(" << c.update << ") into "
+                 << intm.name() << " over " << c.rvar << "\n";
+
+        src << "{\n"
+            << "    Func f = pipeline.get_func(" << index << ");\n"
+            << "    RVar r(\"" << c.rvar << "\"), ro(\"" << ro.name() << "\"), ri(\"" << ri.name() << "\");\n"
+            << "    Var v(\"" << v.name() << "\");\n"
+            << "    Func intm = f.update(" << c.update << ")\n"
+            << "                    .split(r, ro, ri, " << factor << ", TailStrategy::GuardWithIf)\n"
+            << "                    .rfactor(ro, v);\n";
+
+        // The autoschedulers expect the loops of an update to be the
+        // RVars followed by the pure Vars in order, but rfactor leaves the
+        // new pure Var where the RVar was.
+        const StageSchedule &sched = intm.function().update(0).schedule();
+        std::vector<std::string> loops, canonical;
+        for (const Dim &d : sched.dims()) {
+            if (d.var != Var::outermost().name()) {
+                loops.push_back(d.var);
+            }
+        }
+        for (const ReductionVariable &rv : sched.rvars()) {
+            canonical.push_back(rv.var);
+        }
+        for (const std::string &arg : intm.function().args()) {
+            if (std::find(loops.begin(), loops.end(), arg) != loops.end()) {
+                canonical.push_back(arg);
+            }
+        }
+        if (loops != canonical) {
+            std::vector<VarOrRVar> reordered;
+            src << "    intm.update(0).reorder(";
+            for (size_t i = 0; i < canonical.size(); i++) {
+                const bool is_rvar = i < sched.rvars().size();
+                if (is_rvar) {
+                    reordered.emplace_back(RVar(canonical[i]));
+                } else {
+                    reordered.emplace_back(Var(canonical[i]));
+                }
+                src << (i > 0 ? ", " : "") << (is_rvar ? "RVar(\"" : "Var(\"") << canonical[i] << "\")";
+            }
+            src << ");\n";
+            intm.update(0).reorder(reordered);
+        }
+        src << "}\n";
+    }
+    return src.str();
+}
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
+
+#endif  // RFACTOR_H
@@ -0,0 +1,202 @@
+#ifndef SCHEDULE_DATABASE_H
+#define SCHEDULE_DATABASE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "ASLog.h"
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+// A persistent store of the results of autoscheduling, kept in a
+// directory on disk, so that autoscheduling the same pipeline again
+// (e.g. on the next build) doesn't have to repeat the search.
+//
+// Entries are looked up by a two-part key. The structure describes the
+// algorithm being scheduled, and the details describe everything else
+// that can change the schedule found: the estimates, the target, the
+// parameters of the autoscheduler, and so on. An entry with the same
+// structure but different details is a near-miss, which an autoscheduler
+// can use as a starting point for its search. What an entry holds is up
+// to the autoscheduler that stored it.
+//
+// Entries are written to a temporary file and then renamed into place,
+// so several processes can share one database. Any problem reading or
+// writing the database just makes it behave as if it were empty.
+class ScheduleDatabase {
+    std::filesystem::path dir;
+
+    static constexpr const char *magic = "HalideScheduleDatabase 1";
+
+    std::filesystem::path structure_dir(const std::string &structure) const {
+        return dir / hex(hash(structure));
+    }
+
+    // Read an entry, returning false if it is missing or malformed.
+    static bool read_entry(const std::filesystem::path &path,
+                           std::string *structure, std::string *details, std::string *payload) {
+        std::ifstream f(path, std::ios::binary);
+        std::string line;
+        if (!std::getline(f, line) || line != magic) {
+            return false;
+        }
+        for (std::string *s : {structure, details, payload}) {
+            size_t size = 0;
+            if (!(f >> size) || f.get() != '\n') {
+                return false;
+            }
+            s->resize(size);
+            if (!f.read(s->data(), size)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // How many lines two strings have in common.
+    static size_t common_lines(const std::string &a, const std::string &b) {
+        std::map<std::string, int> lines;
+        std::istringstream sa(a), sb(b);
+        std::string line;
+        while (std::getline(sa, line)) {
+            lines[line]++;
+        }
+        size_t result = 0;
+        while (std::getline(sb, line)) {
+            auto it = lines.find(line);
+            if (it != lines.end() && it->second > 0) {
+                it->second--;
+                result++;
+            }
+        }
+        return result;
+    }
+
+public:
+    struct Key {
+        std::string structure;
+        std::string details;
+    };
+
+    // A database in the given directory, or a disabled one if the
+    // directory is empty.
+    explicit ScheduleDatabase(const std::string &dir)
+        : dir(dir) {
+    }
+
+    bool enabled() const {
+        return !dir.empty();
+    }
+
+    // A 64-bit FNV-1a hash. It is stored on disk, so unlike std::hash it
+    // must be the same on every platform.
+    static uint64_t hash(const std::string &s) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (char c : s) {
+            h ^= (uint8_t)c;
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    static std::string hex(uint64_t h) {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+        return buf;
+    }
+
+    // Find the payload stored for exactly this key.
+    bool lookup(const Key &key, std::string *payload) const {
+        if (!enabled()) {
+            return false;
+        }
+        std::string structure, details;
+        const auto path = structure_dir(key.structure) / hex(hash(key.details));
+        if (!read_entry(path, &structure, &details, payload) ||
+            structure != key.structure || details != key.details) {
+            return false;
+        }
+        aslog(1) << "Found a schedule in the database: " << path.string() << "\n";
+        return true;
+    }
+
+    // Find the payload stored for the key with the same structure whose
+    // details have the most lines in common with the given key's.
+    bool lookup_closest(const Key &key, std::string *payload) const {
+        if (!enabled()) {
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::path closest;
+        size_t best = 0;
+        for (std::filesystem::directory_iterator it(structure_dir(key.structure), ec), end; it != end && !ec; it.increment(ec)) {
+            std::string structure, details, p;
+            if (it->path().extension() == ".tmp" ||
+                !read_entry(it->path(), &structure, &details, &p) ||
+                structure != key.structure) {
+                continue;
+            }
+            const size_t score = common_lines(details, key.details);
+            if (closest.empty() || score > best ||
+                (score == best && it->path().filename() < closest.filename())) {
+                // Break ties by name, so that the result doesn't depend
+                // on the order of the directory listing.
+                closest = it->path();
+                best = score;
+                *payload = std::move(p);
+            }
+        }
+        if (closest.empty()) {
+            return false;
+        }
+        aslog(1) << "Found a similar schedule in the database: " << closest.string() << "\n";
+        return true;
+    }
+
+    void store(const Key &key, const std::string &payload) const {
+        if (!enabled()) {
+            return;
+        }
+        namespace fs = std::filesystem;
+        const fs::path parent = structure_dir(key.structure);
+        const fs::path path = parent / hex(hash(key.details));
+        std::random_device rd;
+        const fs::path staging = parent / (path.filename().string() + "." + std::to_string(rd()) + ".tmp");
+        std::error_code ec;
+        fs::create_directories(parent, ec);
+        {
+            std::ofstream f(staging, std::ios::binary);
+            f << magic << "\n";
+            for (const std::string *s : {&key.structure, &key.details, &payload}) {
+                f << s->size() << "\n";
+                f.write(s->data(), s->size());
+            }
+            if (ec || !f.good()) {
+                aslog(1) << "Failed to write to the schedule database: " << staging.string() << "\n";
+                f.close();
+                fs::remove(staging, ec);
+                return;
+            }
+        }
+        fs::rename(staging, path, ec);
+        if (ec) {
+            fs::remove(staging, ec);
+        } else {
+            aslog(1) << "Added a schedule to the database: " << path.string() << "\n";
+        }
+    }
+};
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
+
+#endif  // SCHEDULE_DATABASE_H
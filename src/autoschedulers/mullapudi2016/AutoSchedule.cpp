@@ -1,11 +1,15 @@
 #include "HalidePlugin.h"
 
 #include "ParamParser.h"
+#include "Rfactor.h"
 
 #include <algorithm>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <set>
+#include <thread>
 #include <utility>
 
 namespace Halide {
@@ -35,6 +39,16 @@ struct ArchParams {
      * the cost of an arithmetic operation at last level cache. */
     float balance{};
 
+    /** Number of threads to evaluate grouping choices on. If 0, use one
+     * per core. Defaults to 1, so that builds running many generators at
+     * once don't oversubscribe the machine. The schedule found doesn't
+     * depend on it. */
+    int search_threads{1};
+
+    /** If true, don't rfactor reductions that have too little parallelism
+     * in their pure loops to keep the machine busy. */
+    bool disable_rfactor{};
+
     /** If GPU target is detected, but machine parameters are not specified, *
      * make a realistic estimate based on consumer-grade GPUs (Nvidia GTX *
      * 1660/Turing), or low-cost scientific-grade GPUs (Nvidia K40/Tesla).
@@ -59,6 +73,8 @@ struct ArchParams {
         parser.parse("parallelism", &parallelism);
         parser.parse("last_level_cache_size", &last_level_cache_size);
         parser.parse("balance", &balance);
+        parser.parse("search_threads", &search_threads);
+        parser.parse("disable_rfactor", &disable_rfactor);
         parser.finish();
     }
 };
@@ -221,18 +237,30 @@ struct DependenceAnalysis {
             return prods < other.prods;
         }
     };
-    struct RegionsRequired {
-        DimBounds bounds;
-        // Regions required to compute 'bounds' given a particular
-        // RegionsRequiredQuery.
-        map<string, Box> regions;
-        RegionsRequired(const DimBounds &b, const map<string, Box> &r)
-            : bounds(b), regions(r) {
+    // Orders bounds by the structure of their Exprs, so that queries for
+    // the same bounds hit in the cache even when the Exprs describing them
+    // were built separately (e.g. in different rounds of grouping).
+    struct DimBoundsCompare {
+        bool operator()(const DimBounds &a, const DimBounds &b) const {
+            return std::lexicographical_compare(
+                a.begin(), a.end(), b.begin(), b.end(),
+                [](const pair<const string, Interval> &x, const pair<const string, Interval> &y) {
+                    if (x.first != y.first) {
+                        return x.first < y.first;
+                    }
+                    if (!graph_equal(x.second.min, y.second.min)) {
+                        return graph_less_than(x.second.min, y.second.min);
+                    }
+                    return graph_less_than(x.second.max, y.second.max);
+                });
         }
     };
     // Cache for bounds queries (bound queries with the same parameters are
-    // common during the grouping process).
-    map<RegionsRequiredQuery, vector<RegionsRequired>> regions_required_cache;
+    // common during the grouping process). The regions for some bounds are
+    // always the same, so when several threads analyze groups at once, the
+    // first one to finish a query wins.
+    map<RegionsRequiredQuery, map<DimBounds, map<string, Box>, DimBoundsCompare>> regions_required_cache;
+    std::unique_ptr<std::mutex> regions_required_cache_mutex = std::make_unique<std::mutex>();
 
     DependenceAnalysis(const map<string, Function> &env, const vector<string> &order,
                        const FuncValueBounds &func_val_bounds)
@@ -429,13 +457,14 @@ DependenceAnalysis::regions_required(const Function &f, int stage_num,
 
     // Check the cache if we've already computed this previously.
     RegionsRequiredQuery query(f.name(), stage_num, prods, only_regions_computed);
-    const auto &iter = regions_required_cache.find(query);
-    if (iter != regions_required_cache.end()) {
-        const auto &it = std::find_if(iter->second.begin(), iter->second.end(),
-                                      [&bounds](const RegionsRequired &r) { return (r.bounds == bounds); });
-        if (it != iter->second.end()) {
-            internal_assert((iter->first == query) && (it->bounds == bounds));
-            return it->regions;
+    {
+        std::lock_guard<std::mutex> lock(*regions_required_cache_mutex);
+        const auto &iter = regions_required_cache.find(query);
+        if (iter != regions_required_cache.end()) {
+            const auto &it = iter->second.find(bounds);
+            if (it != iter->second.end()) {
+                return it->second;
+            }
         }
     }
 
@@ -629,8 +658,8 @@ DependenceAnalysis::regions_required(const Function &f, int stage_num,
         concrete_regions[f_reg.first] = concrete_box;
     }
 
-    regions_required_cache[query].emplace_back(bounds, concrete_regions);
-    return concrete_regions;
+    std::lock_guard<std::mutex> lock(*regions_required_cache_mutex);
+    return regions_required_cache[query].emplace(bounds, std::move(concrete_regions)).first->second;
 }
 
 // Return redundantly computed regions of producers ('prods') while computing a
@@ -868,11 +897,16 @@ struct AutoSchedule {
 
             const int num_stages = func.updates().size() + 1;
             for (int stage = 0; stage < num_stages; stage++) {
+                auto it = f.second.find(stage);
+                if (it == f.second.end() && stage > 0 &&
+                    func.updates()[stage - 1].schedule().touched()) {
+                    // The update was already scheduled, by an rfactor.
+                    continue;
+                }
                 schedule_ss << "    " << fname;
                 if (stage > 0) {
                     schedule_ss << ".update(" << (stage - 1) << ")";
                 }
-                auto it = f.second.find(stage);
                 if (it != f.second.end()) {
                     const vector<string> &schedules = it->second;
                     internal_assert(!schedules.empty());
@@ -1674,6 +1708,10 @@ struct Partitioner {
 
     void initialize_groups();
 
+    // Call body(i) for every i in [0, count), on as many threads as the
+    // machine parameters allow. The bodies may only read the grouping.
+    void run_in_parallel(int count, const std::function<void(int)> &body) const;
+
     // Merge 'prod_group' into 'cons_group'. The output stage of 'cons_group'
     // will be the output stage of the merged group.
     Group merge_groups(const Group &prod_group, const Group &cons_group);
@@ -1967,11 +2005,25 @@ Partitioner::Partitioner(const map<string, Box> &_pipeline_bounds,
     }
 }
 
+void Partitioner::run_in_parallel(int count, const std::function<void(int)> &body) const {
+    const int num_threads = arch_params.search_threads > 0 ?
+                                arch_params.search_threads :
+                                std::max(1, (int)std::thread::hardware_concurrency());
+    Internal::run_in_parallel(count, num_threads, body);
+}
+
 void Partitioner::initialize_groups() {
+    vector<Group *> to_tile;
     for (pair<const FStage, Group> &g : groups) {
-        pair<map<string, Expr>, GroupAnalysis> best = find_best_tile_config(g.second);
-        g.second.tile_sizes = best.first;
-        group_costs.emplace(g.second.output, best.second);
+        to_tile.push_back(&g.second);
+    }
+    vector<pair<map<string, Expr>, GroupAnalysis>> best(to_tile.size());
+    run_in_parallel((int)to_tile.size(), [&](int i) {
+        best[i] = find_best_tile_config(*to_tile[i]);
+    });
+    for (size_t i = 0; i < to_tile.size(); i++) {
+        to_tile[i]->tile_sizes = best[i].first;
+        group_costs.emplace(to_tile[i]->output, best[i].second);
     }
     grouping_cache.clear();
 }
@@ -2024,6 +2076,29 @@ map<string, Expr> Partitioner::evaluate_reuse(const FStage &stg,
 vector<pair<Partitioner::GroupingChoice, Partitioner::GroupConfig>>
 Partitioner::choose_candidate_grouping(const vector<pair<string, string>> &cands,
                                        Partitioner::Level level) {
+    // Evaluate the choices that haven't been evaluated for grouping before
+    // all at once. Evaluating a choice doesn't change the grouping, so the
+    // evaluations are independent of each other.
+    vector<GroupingChoice> to_evaluate;
+    for (const auto &p : cands) {
+        const Function &prod_f = get_element(dep_analysis.env, p.first);
+        FStage prod(prod_f, prod_f.updates().size());
+        for (const FStage &c : get_element(children, prod)) {
+            GroupingChoice cand_choice(prod_f.name(), c);
+            if (!grouping_cache.count(cand_choice)) {
+                to_evaluate.push_back(cand_choice);
+            }
+        }
+    }
+    vector<GroupConfig> configs(to_evaluate.size());
+    run_in_parallel((int)to_evaluate.size(), [&](int i) {
+        configs[i] = evaluate_choice(to_evaluate[i], level);
+    });
+    for (size_t i = 0; i < to_evaluate.size(); i++) {
+        // Cache the result of the evaluation for the pair
+        grouping_cache.emplace(to_evaluate[i], configs[i]);
+    }
+
     vector<pair<GroupingChoice, GroupConfig>> best_grouping;
     Expr best_benefit = make_zero(Int(64));
     for (const auto &p : cands) {
@@ -2036,20 +2111,8 @@ Partitioner::choose_candidate_grouping(const vector<pair<string, string>> &cands
         FStage prod(prod_f, final_stage);
 
         for (const FStage &c : get_element(children, prod)) {
-            GroupConfig best_config;
             GroupingChoice cand_choice(prod_f.name(), c);
-
-            // Check if the candidate has been evaluated for grouping before
-            const auto &iter = grouping_cache.find(cand_choice);
-            if (iter != grouping_cache.end()) {
-                best_config = iter->second;
-            } else {
-                best_config = evaluate_choice(cand_choice, level);
-                // Cache the result of the evaluation for the pair
-                grouping_cache.emplace(cand_choice, best_config);
-            }
-
-            grouping.emplace_back(cand_choice, best_config);
+            grouping.emplace_back(cand_choice, get_element(grouping_cache, cand_choice));
         }
 
         bool no_redundant_work = false;
@@ -3853,6 +3916,14 @@ bool inline_unbounded(const vector<Function> &outputs,
 // the schedules. The target architecture is specified by 'target'.
 string generate_schedules(const vector<Function> &outputs, const Target &target,
                           const ArchParams &arch_params) {
+    // Rfactor the reductions that would otherwise run on one core. This
+    // adds Funcs to the pipeline, so it must come before everything else.
+    string rfactor_source;
+    if (!arch_params.is_gpu_schedule && !arch_params.disable_rfactor) {
+        debug(2) << "Rfactoring large reductions...\n";
+        rfactor_source = rfactor_large_reductions(outputs, arch_params.parallelism);
+    }
+
     // Make an environment map which is used throughout the auto scheduling process.
     map<string, Function> env;
     for (const Function &f : outputs) {
@@ -4059,7 +4130,7 @@ string generate_schedules(const vector<Function> &outputs, const Target &target,
     // TODO: GPU scheduling
     // TODO: Hierarchical tiling
 
-    return sched_string;
+    return rfactor_source + sched_string;
 }
 
 struct Mullapudi2016 {
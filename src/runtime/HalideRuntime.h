@@ -407,6 +407,24 @@ extern int halide_get_num_threads();
 extern int halide_set_num_threads(int n);
 // @}
 
+/** Get or set whether Halide's thread pool pins its worker threads to
+ * CPUs. When enabled, workers are spread over the CPUs the process may run
+ * on, and on machines with more than one NUMA node, threads prefer to run
+ * work enqueued from their own node, so that parallel loops tend to run
+ * near the memory their caller allocated. Defaults to the value of the
+ * environment variable HL_THREAD_AFFINITY, or off if it is not set. Takes
+ * effect the next time the thread pool starts up (i.e. on first use, or
+ * after halide_shutdown_thread_pool). Set returns the old value.
+ *
+ * Currently only implemented on Linux; elsewhere threads are never pinned.
+ * (As with halide_set_num_threads, custom implementations of
+ * halide_do_par_for() may ignore this.)
+ */
+// @{
+extern bool halide_get_thread_affinity();
+extern bool halide_set_thread_affinity(bool enabled);
+// @}
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -435,6 +453,49 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** Set whether halide_default_malloc may hold onto freed host allocations
+ * and reuse them for later allocations of a similar size, instead of
+ * returning them to the system allocator right away. This helps pipelines
+ * that allocate scratch space inside parallel loops. Allocations up to
+ * 1MB are rounded up to a power of two and kept on per-size free lists,
+ * which are sharded by calling thread. The default is false. Setting it to
+ * false also releases all unused allocations, as
+ * halide_trim_host_allocations does. Always returns
+ * halide_error_code_success.
+ *
+ * This only affects runtimes that use the default posix allocator, and
+ * has no effect if a custom malloc and free have been set. */
+extern int halide_reuse_host_allocations(void *user_context, bool);
+
+/** Determines whether halide_default_free places host allocations on a
+ * free list for future use. By default just returns the value most
+ * recently set by the method above. */
+extern bool halide_can_reuse_host_allocations(void *user_context);
+
+/** Release all unused host allocations held for reuse back to the system
+ * allocator. */
+extern void halide_trim_host_allocations(void *user_context);
+
+/** Statistics about the reuse of host allocations. Counts are since the
+ * process started. */
+struct halide_host_allocation_stats_t {
+    /** The number of calls to halide_default_malloc made while reuse was
+     * enabled that were small enough to be reused, and how many of those
+     * were served from a free list. */
+    uint64_t allocations;
+    uint64_t reused;
+    /** The number of frees of such allocations, and how many of those
+     * were kept for reuse. */
+    uint64_t frees;
+    uint64_t kept;
+    /** The number of allocations and bytes currently held for reuse. */
+    uint64_t cached_allocations;
+    int64_t cached_bytes;
+};
+
+/** Get statistics about the reuse of host allocations. */
+extern void halide_get_host_allocation_stats(struct halide_host_allocation_stats_t *stats);
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -1026,6 +1087,109 @@ extern void halide_memoization_cache_release(void *user_context, void *host);
  */
 extern void halide_memoization_cache_cleanup(void);
 
+/** The policy the memoization cache uses to pick which unused entries to
+ * evict when it is over its size limit. */
+enum halide_memoization_cache_eviction_policy_t {
+    /** Evict the least recently used entry. This is the default. */
+    halide_memoization_cache_evict_lru = 0,
+    /** Greedy-Dual-Size: each entry's priority is the time it took to
+     * compute divided by its size in bytes, plus an inflation value that
+     * ages entries that go unused. Among the least recently used few
+     * entries, the one with the lowest priority is evicted. This favors
+     * keeping small, expensive entries over large, cheap ones. */
+    halide_memoization_cache_evict_greedy_dual_size = 1,
+};
+
+/** Set the eviction policy of the memoization cache. Returns the old
+ * policy. */
+extern enum halide_memoization_cache_eviction_policy_t
+halide_memoization_cache_set_eviction_policy(enum halide_memoization_cache_eviction_policy_t policy);
+
+/** Statistics about the default memoization cache as a whole. Counts are
+ * since the cache was created or last cleaned up. */
+struct halide_memoization_cache_stats_t {
+    /** The number of lookups that found an entry. */
+    uint64_t hits;
+    /** The number of lookups that did not find an entry. */
+    uint64_t misses;
+    /** The number of entries evicted to keep the cache within its size
+     * limit. Entries removed by halide_memoization_cache_evict are not
+     * counted. */
+    uint64_t evictions;
+    /** The number of lookups that missed in memory but were found in the
+     * persistent tier. These are also counted as misses. */
+    uint64_t persistent_hits;
+    /** The number of entries written to the persistent tier. */
+    uint64_t persistent_writes;
+    /** The number of entries currently in the cache. */
+    uint64_t entries;
+    /** The number of bytes of buffer data currently in the cache. */
+    int64_t current_bytes;
+    /** The size limit set by halide_memoization_cache_set_size. */
+    int64_t max_bytes;
+    /** The total time spent computing entries that were then stored,
+     * measured from the lookup that missed to the store. */
+    int64_t compute_ns;
+};
+
+/** Statistics about the cache entries of a single memoized Func. */
+struct halide_memoization_cache_func_stats_t {
+    /** The names of the pipeline and the memoized Func, truncated to fit. */
+    char pipeline_name[64];
+    char func_name[64];
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t persistent_hits;
+    uint64_t persistent_writes;
+    int64_t current_bytes;
+    int64_t compute_ns;
+};
+
+/** Set a directory for the persistent tier of the memoization cache, or
+ * pass nullptr to disable it. When set, entries evicted from memory to stay
+ * within the size limit, and entries still in memory at cleanup, are
+ * written to files in that directory, and lookups that miss in memory
+ * check there before recomputing. This lets a process that restarts skip
+ * recomputing memoized Funcs. The directory must exist and is never
+ * pruned. Files are identified by the Func name, a hash of the code of the
+ * pipeline the compiler embeds in the cache key, and parameter values, so
+ * a rebuilt pipeline with different code doesn't get stale results, and
+ * the same code compiled by another process does get them. The hash
+ * doesn't cover the contents of Buffers embedded in the pipeline or the
+ * behavior of extern functions it calls; if those change, use a different
+ * directory or evict the entries. halide_memoization_cache_evict also
+ * invalidates the persistent entries with the given eviction key.
+ *
+ * If this is never called, the persistent tier uses the directory named by
+ * the HL_MEMOIZATION_CACHE_DIR environment variable, if set. Must not be
+ * called while pipelines that use the cache are running. Returns zero on
+ * success, or nonzero if the path is too long. The tier is only available
+ * on posix platforms; elsewhere it silently does nothing.
+ */
+extern int halide_memoization_cache_set_persistent_path(const char *path);
+
+/** Get statistics about the default memoization cache, for example to pick
+ * a size for halide_memoization_cache_set_size. If func_stats is not null,
+ * also write the breakdown by memoized Func into it, up to max_func_stats
+ * of them. Returns the number of memoized Funcs the cache is tracking,
+ * which may be more than max_func_stats. At most 32 memoized Funcs are
+ * tracked at a time; the rest are only counted in the totals.
+ *
+ * The breakdown relies on the cache keys that Halide generates for
+ * memoized Funcs, which start with a pointer to a string naming the
+ * pipeline and the Func. Funcs are told apart by those names. */
+extern int halide_memoization_cache_get_stats(struct halide_memoization_cache_stats_t *stats,
+                                              struct halide_memoization_cache_func_stats_t *func_stats,
+                                              int max_func_stats);
+
+/** Stop tracking the memoized Funcs of the named pipeline in the breakdown
+ * of halide_memoization_cache_get_stats, so that other Funcs can be tracked
+ * in their place. Their counts remain in the totals. Call this when code
+ * for the pipeline is unloaded; the JIT calls it when it releases a
+ * compiled pipeline. */
+extern void halide_memoization_cache_forget_pipeline(const char *pipeline_name);
+
 /** Verify that a given range of memory has been initialized; only used when Target::MSAN is enabled.
  *
  * The default implementation simply calls the LLVM-provided __msan_check_mem_is_initialized() function.
@@ -1,6 +1,7 @@
 #include "HalideRuntime.h"
 #include "device_buffer_utils.h"
 #include "printer.h"
+#include "runtime_atomics.h"
 #include "scoped_mutex_lock.h"
 
 namespace Halide {
@@ -74,7 +75,7 @@ struct CacheEntry {
     uint8_t *metadata_storage;
     size_t key_size;
     uint8_t *key;
-    uint32_t hash;
+    uint64_t hash;
     uint32_t in_use_count;  // 0 if none returned from halide_cache_lookup
     uint32_t tuple_count;
     // The shape of the computed data. There may be more data allocated than this.
@@ -84,9 +85,16 @@ struct CacheEntry {
     halide_buffer_t *buf;
     uint64_t eviction_key;
     bool has_eviction_key;
+    // Which entry of cache_sources computed this, or kMaxCacheSources if
+    // none.
+    int source;
+    // How long the entry took to compute, and its Greedy-Dual-Size
+    // priority.
+    int64_t cost_ns;
+    double priority;
 
     bool init(const uint8_t *cache_key, size_t cache_key_size,
-              uint32_t key_hash,
+              uint64_t key_hash,
               const halide_buffer_t *computed_bounds_buf,
               int32_t tuples, halide_buffer_t **tuple_buffers,
               bool has_eviction_key, uint64_t eviction_key);
@@ -96,7 +104,9 @@ struct CacheEntry {
 
 struct CacheBlockHeader {
     CacheEntry *entry;
-    uint32_t hash;
+    uint64_t hash;
+    // When the lookup that missed allocated this block.
+    int64_t compute_start_ns;
 };
 
 // Each host block has extra space to store a header just before the
@@ -115,7 +125,7 @@ WEAK CacheBlockHeader *get_pointer_to_header(uint8_t *host) {
 }
 
 WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
-                           uint32_t key_hash, const halide_buffer_t *computed_bounds_buf,
+                           uint64_t key_hash, const halide_buffer_t *computed_bounds_buf,
                            int32_t tuples, halide_buffer_t **tuple_buffers,
                            bool has_eviction_key_arg, uint64_t eviction_key_arg) {
     next = nullptr;
@@ -188,63 +198,347 @@ WEAK void CacheEntry::destroy() {
     halide_free(nullptr, metadata_storage);
 }
 
-WEAK uint32_t djb_hash(const uint8_t *key, size_t key_size) {
-    uint32_t h = 5381;
-    for (size_t i = 0; i < key_size; i++) {
-        h = (h << 5) + h + key[i];
+// A 64-bit hash of the cache key that consumes eight bytes at a time
+// (MurmurHash64A). The high bits pick the shard and the low bits pick the
+// bucket within it.
+WEAK uint64_t hash_key(const uint8_t *key, size_t key_size) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = 0x8445d61a4e774912ULL ^ (key_size * m);
+    const uint8_t *end = key + (key_size & ~(size_t)7);
+    for (; key != end; key += 8) {
+        uint64_t k;
+        memcpy(&k, key, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    size_t tail = key_size & 7;
+    if (tail) {
+        uint64_t k = 0;
+        memcpy(&k, key, tail);
+        h ^= k;
+        h *= m;
     }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
     return h;
 }
 
-WEAK halide_mutex memoization_lock = {{0}};
+// Not every runtime links in a clock, but the declaration is weak, so
+// check for one before using it. Without a clock every entry costs the
+// same to compute.
+WEAK int64_t cache_time_ns(void *user_context) {
+    if (halide_start_clock == nullptr || halide_current_time_ns == nullptr) {
+        return 0;
+    }
+    halide_start_clock(user_context);
+    return halide_current_time_ns(user_context);
+}
+
+// Counters for the entries computed by one memoized Func. Kept per shard
+// and summed by halide_memoization_cache_get_stats, so that updating them
+// only needs the shard lock.
+struct CacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t persistent_hits;
+    uint64_t persistent_writes;
+    int64_t bytes;
+    int64_t compute_ns;
+
+    void add(const CacheStats &other) {
+        hits += other.hits;
+        misses += other.misses;
+        evictions += other.evictions;
+        persistent_hits += other.persistent_hits;
+        persistent_writes += other.persistent_writes;
+        bytes += other.bytes;
+        compute_ns += other.compute_ns;
+    }
+};
+
+// The memoized Funcs the cache has seen. Every key Halide generates starts
+// with a pointer to a string "<len>:<pipeline><len>:<func>..." (see KeyInfo
+// in src/Memoization.cpp). A Func is identified by a hash of the names in
+// that string rather than by the pointer, since the memory of a released
+// pipeline may hold another pipeline's string later. A slot whose id is
+// zero is free. Slots are filled and freed under cache_sources_lock, which
+// may be held while taking shard locks, and ids are published with release
+// stores, so lookups scan the slots without the lock.
+struct CacheSource {
+    uint64_t id;
+    // A hash of just the pipeline name, to find the slots of a pipeline.
+    uint64_t pipeline_id;
+    char pipeline_name[64];
+    char func_name[64];
+};
+
+const int kMaxCacheSources = 32;
 
-const size_t kHashTableSize = 256;
+WEAK CacheSource cache_sources[kMaxCacheSources];
+// The number of slots filled at some point since the last cleanup.
+WEAK int num_cache_sources = 0;
+WEAK halide_mutex cache_sources_lock = {{0}};
 
-WEAK CacheEntry *cache_entries[kHashTableSize];
+// Find one "<len>:<name>" field of a key string. Returns a pointer past the
+// field, or nullptr if the string isn't in the expected form.
+WEAK const char *parse_cache_source_field(const char *str, const char **name, size_t *name_size) {
+    size_t len = 0;
+    if (*str < '0' || *str > '9') {
+        return nullptr;
+    }
+    while (*str >= '0' && *str <= '9') {
+        len = len * 10 + (*str++ - '0');
+    }
+    if (*str++ != ':') {
+        return nullptr;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] == 0) {
+            return nullptr;
+        }
+    }
+    *name = str;
+    *name_size = len;
+    return str + len;
+}
+
+// Copy a name into dst, truncating it if need be.
+WEAK void copy_cache_source_name(const char *name, size_t name_size, char *dst, size_t dst_size) {
+    if (name_size > dst_size - 1) {
+        name_size = dst_size - 1;
+    }
+    memcpy(dst, name, name_size);
+    dst[name_size] = 0;
+}
+
+WEAK int find_cache_source(const uint8_t *cache_key, int32_t size) {
+    if ((size_t)size < sizeof(const char *)) {
+        return kMaxCacheSources;
+    }
+    const char *str;
+    memcpy(&str, cache_key, sizeof(str));
+    if (str == nullptr) {
+        return kMaxCacheSources;
+    }
+    const char *pipeline, *func;
+    size_t pipeline_size, func_size;
+    const char *rest = parse_cache_source_field(str, &pipeline, &pipeline_size);
+    if (rest == nullptr || parse_cache_source_field(rest, &func, &func_size) == nullptr) {
+        return kMaxCacheSources;
+    }
+    // Both fields, with their lengths. Never zero, which marks a free slot.
+    uint64_t id = hash_key((const uint8_t *)str, func + func_size - str) | 1;
+
+    int count;
+    Synchronization::atomic_load_acquire(&num_cache_sources, &count);
+    for (int i = 0; i < count; i++) {
+        uint64_t slot_id;
+        Synchronization::atomic_load_acquire(&cache_sources[i].id, &slot_id);
+        if (slot_id == id) {
+            return i;
+        }
+    }
+
+    ScopedMutexLock lock(&cache_sources_lock);
+    int index = -1;
+    for (int i = 0; i < num_cache_sources; i++) {
+        if (cache_sources[i].id == id) {
+            return i;
+        } else if (cache_sources[i].id == 0 && index < 0) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        if (num_cache_sources == kMaxCacheSources) {
+            return kMaxCacheSources;
+        }
+        index = num_cache_sources;
+    }
+    CacheSource &source = cache_sources[index];
+    copy_cache_source_name(pipeline, pipeline_size, source.pipeline_name, sizeof(source.pipeline_name));
+    copy_cache_source_name(func, func_size, source.func_name, sizeof(source.func_name));
+    source.pipeline_id = hash_key((const uint8_t *)pipeline, pipeline_size);
+    Synchronization::atomic_store_release(&source.id, &id);
+    if (index == num_cache_sources) {
+        int new_count = index + 1;
+        Synchronization::atomic_store_release(&num_cache_sources, &new_count);
+    }
+    return index;
+}
+
+// The cache is split into shards, each with its own lock, hash table and
+// LRU chain, so that concurrent lookups of different keys rarely contend.
+// The size limit applies to the cache as a whole.
+struct CacheShard {
+    halide_mutex lock;
+    // Allocated on first store, and doubled in size whenever there are
+    // more entries than buckets.
+    CacheEntry **buckets;
+    uint32_t num_buckets;
+    uint32_t num_entries;
+    CacheEntry *most_recently_used;
+    CacheEntry *least_recently_used;
+    // The Greedy-Dual-Size inflation value: the priority of the last
+    // entry evicted. New and recently hit entries start from here.
+    double inflation;
+    // Indexed by CacheEntry::source. The last slot counts everything
+    // not attributed to a tracked Func.
+    CacheStats stats[kMaxCacheSources + 1];
+
+    CacheEntry **bucket(uint64_t h) {
+        return &buckets[h & (num_buckets - 1)];
+    }
+};
 
-WEAK CacheEntry *most_recently_used = nullptr;
-WEAK CacheEntry *least_recently_used = nullptr;
+const int kCacheShardBits = 4;
+const int kNumCacheShards = 1 << kCacheShardBits;
+const uint32_t kInitialBucketsPerShard = 16;
+
+WEAK CacheShard cache_shards[kNumCacheShards];
+
+WEAK __attribute((always_inline)) CacheShard &shard_for_hash(uint64_t h) {
+    return cache_shards[h >> (64 - kCacheShardBits)];
+}
+
+// Protects the two sizes below. May be acquired while holding a shard
+// lock, but not the other way around.
+WEAK halide_mutex cache_size_lock = {{0}};
 
 const uint64_t kDefaultCacheSize = 1 << 20;
 WEAK int64_t max_cache_size = kDefaultCacheSize;
 WEAK int64_t current_cache_size = 0;
 
+WEAK void adjust_cache_size(int64_t delta) {
+    ScopedMutexLock lock(&cache_size_lock);
+    current_cache_size += delta;
+}
+
+WEAK int cache_eviction_policy = halide_memoization_cache_evict_lru;
+
+// When using Greedy-Dual-Size, the number of unused entries at the least
+// recently used end of a shard to pick a victim from. Looking at all of
+// them would make each eviction linear in the size of the cache.
+const int kGreedyDualSizeCandidates = 8;
+
+WEAK bool cache_over_budget() {
+    ScopedMutexLock lock(&cache_size_lock);
+    return current_cache_size > max_cache_size;
+}
+
+WEAK int64_t entry_size_in_bytes(const CacheEntry *entry) {
+    int64_t bytes = 0;
+    for (uint32_t i = 0; i < entry->tuple_count; i++) {
+        bytes += entry->buf[i].size_in_bytes();
+    }
+    return bytes;
+}
+
+// Must be called with the shard locked. Unlinks the entry from the shard's
+// LRU chain, but not from its hash bucket.
+WEAK void unlink_from_lru(CacheShard &shard, CacheEntry *entry) {
+    if (entry->more_recent != nullptr) {
+        entry->more_recent->less_recent = entry->less_recent;
+    } else {
+        shard.most_recently_used = entry->less_recent;
+    }
+    if (entry->less_recent != nullptr) {
+        entry->less_recent->more_recent = entry->more_recent;
+    } else {
+        shard.least_recently_used = entry->more_recent;
+    }
+    entry->more_recent = nullptr;
+    entry->less_recent = nullptr;
+}
+
+// Must be called with the shard locked.
+WEAK void make_most_recently_used(CacheShard &shard, CacheEntry *entry) {
+    entry->more_recent = nullptr;
+    entry->less_recent = shard.most_recently_used;
+    if (shard.most_recently_used != nullptr) {
+        shard.most_recently_used->more_recent = entry;
+    }
+    shard.most_recently_used = entry;
+    if (shard.least_recently_used == nullptr) {
+        shard.least_recently_used = entry;
+    }
+}
+
+// Must be called with the shard locked.
+WEAK void update_priority(CacheShard &shard, CacheEntry *entry, int64_t bytes) {
+    entry->priority = shard.inflation + (double)entry->cost_ns / (double)(bytes > 0 ? bytes : 1);
+}
+
+// Must be called with the shard locked. Doubles the number of buckets, or
+// allocates the initial ones. If the allocation fails the table just stays
+// at its current size.
+WEAK void grow_buckets(CacheShard &shard) {
+    uint32_t new_num_buckets = shard.num_buckets ? shard.num_buckets * 2 : kInitialBucketsPerShard;
+    CacheEntry **new_buckets = (CacheEntry **)halide_malloc(nullptr, sizeof(CacheEntry *) * new_num_buckets);
+    if (!new_buckets) {
+        return;
+    }
+    memset(new_buckets, 0, sizeof(CacheEntry *) * new_num_buckets);
+    for (uint32_t i = 0; i < shard.num_buckets; i++) {
+        CacheEntry *entry = shard.buckets[i];
+        while (entry != nullptr) {
+            CacheEntry *next = entry->next;
+            CacheEntry **b = &new_buckets[entry->hash & (new_num_buckets - 1)];
+            entry->next = *b;
+            *b = entry;
+            entry = next;
+        }
+    }
+    if (shard.buckets) {
+        halide_free(nullptr, shard.buckets);
+    }
+    shard.buckets = new_buckets;
+    shard.num_buckets = new_num_buckets;
+}
+
 #if CACHE_DEBUGGING
-WEAK void validate_cache() {
-    print(nullptr) << "validating cache, "
-                   << "current size " << current_cache_size
-                   << " of maximum " << max_cache_size << "\n";
-    int entries_in_hash_table = 0;
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
+WEAK void validate_shard(CacheShard &shard) {
+    uint32_t entries_in_hash_table = 0;
+    for (uint32_t i = 0; i < shard.num_buckets; i++) {
+        CacheEntry *entry = shard.buckets[i];
         while (entry != nullptr) {
             entries_in_hash_table++;
-            if (entry->more_recent == nullptr && entry != most_recently_used) {
+            if (&shard_for_hash(entry->hash) != &shard) {
+                halide_print(nullptr, "cache invalid case 0\n");
+                __builtin_trap();
+            }
+            if (entry->more_recent == nullptr && entry != shard.most_recently_used) {
                 halide_print(nullptr, "cache invalid case 1\n");
                 __builtin_trap();
             }
-            if (entry->less_recent == nullptr && entry != least_recently_used) {
+            if (entry->less_recent == nullptr && entry != shard.least_recently_used) {
                 halide_print(nullptr, "cache invalid case 2\n");
                 __builtin_trap();
             }
             entry = entry->next;
         }
     }
-    int entries_from_mru = 0;
-    CacheEntry *mru_chain = most_recently_used;
+    uint32_t entries_from_mru = 0;
+    CacheEntry *mru_chain = shard.most_recently_used;
     while (mru_chain != nullptr) {
         entries_from_mru++;
         mru_chain = mru_chain->less_recent;
     }
-    int entries_from_lru = 0;
-    CacheEntry *lru_chain = least_recently_used;
+    uint32_t entries_from_lru = 0;
+    CacheEntry *lru_chain = shard.least_recently_used;
     while (lru_chain != nullptr) {
         entries_from_lru++;
         lru_chain = lru_chain->more_recent;
     }
     print(nullptr) << "hash entries " << entries_in_hash_table
                    << ", mru entries " << entries_from_mru
-                   << ", lru entries " << entries_from_lru << "\n";
+                   << ", lru entries " << entries_from_lru
+                   << ", entry count " << shard.num_entries << "\n";
     if (entries_in_hash_table != entries_from_mru) {
         halide_print(nullptr, "cache invalid case 3\n");
         __builtin_trap();
@@ -253,6 +547,10 @@ WEAK void validate_cache() {
         halide_print(nullptr, "cache invalid case 4\n");
         __builtin_trap();
     }
+    if (entries_in_hash_table != shard.num_entries) {
+        halide_print(nullptr, "cache invalid case 5\n");
+        __builtin_trap();
+    }
     if (current_cache_size < 0) {
         halide_print(nullptr, "cache size is negative\n");
         __builtin_trap();
@@ -260,64 +558,425 @@ WEAK void validate_cache() {
 }
 #endif
 
-WEAK void prune_cache() {
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
-    CacheEntry *prune_candidate = least_recently_used;
-    while (current_cache_size > max_cache_size &&
-           prune_candidate != nullptr) {
-        CacheEntry *more_recent = prune_candidate->more_recent;
-
-        if (prune_candidate->in_use_count == 0) {
-            uint32_t h = prune_candidate->hash;
-            uint32_t index = h % kHashTableSize;
-
-            // Remove from hash table
-            CacheEntry *prev_hash_entry = cache_entries[index];
-            if (prev_hash_entry == prune_candidate) {
-                cache_entries[index] = prune_candidate->next;
-            } else {
-                while (prev_hash_entry != nullptr && prev_hash_entry->next != prune_candidate) {
-                    prev_hash_entry = prev_hash_entry->next;
-                }
-                halide_abort_if_false(nullptr, prev_hash_entry != nullptr);
-                prev_hash_entry->next = prune_candidate->next;
-            }
+// The persistent tier. When a directory is set, entries evicted from memory
+// to stay within the size limit, and entries still in memory at cleanup,
+// are written to a file each in that directory. Lookups that miss in
+// memory check there before asking the caller to compute. Files are keyed
+// by the Func name, the build id the compiler derives from the pipeline's
+// code, and the parameter values in the cache key, and are validated
+// against the shapes the caller asks for. They don't depend on the name of
+// the pipeline or the order pipelines were compiled in, so another process
+// running the same code finds them.
+//
+// An entry tagged with an eviction key records the epoch of that key when
+// written. halide_memoization_cache_evict bumps the epoch, kept in a small
+// file per key, which makes older files for that key stale.
+
+const uint32_t kPersistentMagic = 0x434d4c48;  // "HLMC"
+const uint32_t kPersistentVersion = 3;
+
+struct PersistentEntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key_size;
+    int32_t tuple_count;
+    int32_t dimensions;
+    uint32_t has_eviction_key;
+    uint64_t eviction_key;
+    uint64_t eviction_epoch;
+    int64_t cost_ns;
+};
 
-            // Remove from less recent chain.
-            if (least_recently_used == prune_candidate) {
-                least_recently_used = more_recent;
-            }
-            if (more_recent != nullptr) {
-                more_recent->less_recent = prune_candidate->less_recent;
-            }
+// Followed by the dimensions of the tuple buffer.
+struct PersistentTupleHeader {
+    halide_type_t type;
+    uint32_t padding;
+    uint64_t bytes;
+};
+
+const int kPersistentPathSize = 1024;
+
+WEAK char persistent_cache_dir[kPersistentPathSize];
+// 0 if HL_MEMOIZATION_CACHE_DIR hasn't been checked yet, 1 if the
+// persistent tier is disabled, 2 if it's enabled.
+WEAK int persistent_cache_state = 0;
+WEAK halide_mutex persistent_cache_lock = {{0}};
+
+WEAK __attribute((always_inline)) size_t round_up_to_8(size_t x) {
+    return (x + 7) & ~(size_t)7;
+}
+
+WEAK int set_persistent_cache_dir_already_locked(const char *dir) {
+    int state = 1;
+    int result = 0;
+    if (dir != nullptr && *dir != 0) {
+        if (strlen(dir) < kPersistentPathSize - 64) {
+            strncpy(persistent_cache_dir, dir, kPersistentPathSize);
+            state = 2;
+        } else {
+            result = -1;
+        }
+    }
+    Synchronization::atomic_store_release(&persistent_cache_state, &state);
+    return result;
+}
+
+WEAK bool persistent_cache_enabled() {
+    int state;
+    Synchronization::atomic_load_acquire(&persistent_cache_state, &state);
+    if (state == 0) {
+        ScopedMutexLock lock(&persistent_cache_lock);
+        if (persistent_cache_state == 0) {
+            (void)set_persistent_cache_dir_already_locked(getenv("HL_MEMOIZATION_CACHE_DIR"));
+        }
+        state = persistent_cache_state;
+    }
+    return state == 2;
+}
+
+// Write the path of a file in the persistent cache directory, named by a
+// 64-bit value, into buf.
+WEAK void persistent_cache_path(char *buf, const char *prefix, uint64_t name, const char *suffix) {
+    char *end = buf + kPersistentPathSize;
+    char *dst = halide_string_to_string(buf, end, persistent_cache_dir);
+    dst = halide_string_to_string(dst, end, "/");
+    dst = halide_string_to_string(dst, end, prefix);
+    char hex[17];
+    for (int i = 0; i < 16; i++) {
+        int digit = (name >> (60 - 4 * i)) & 0xf;
+        hex[i] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    }
+    hex[16] = 0;
+    dst = halide_string_to_string(dst, end, hex);
+    halide_string_to_string(dst, end, suffix);
+}
+
+// The key Halide generates starts with a pointer to a string naming the
+// pipeline and Func and identifying the build of the pipeline, followed by
+// a counter of the pipelines compiled in this process, which only mean
+// something in this process. The persistent key replaces both with the Func
+// name and build id from the string. Returns the size of the persistent
+// key, or zero if the key isn't in that form. Keys without a build id
+// aren't persisted, as results from an older build of the pipeline could be
+// returned for them.
+const size_t kProcessKeyPrefixSize = sizeof(const char *) + sizeof(int32_t);
+
+WEAK size_t persistent_key_size(const uint8_t *cache_key, int32_t size, const char **identity, size_t *identity_size) {
+    if ((size_t)size < kProcessKeyPrefixSize) {
+        return 0;
+    }
+    const char *id;
+    memcpy(&id, cache_key, sizeof(id));
+    if (id == nullptr) {
+        return 0;
+    }
+    const char *name;
+    size_t name_size;
+    const char *func = parse_cache_source_field(id, &name, &name_size);
+    const char *str = func;
+    if (str != nullptr) {
+        str = parse_cache_source_field(str, &name, &name_size);
+    }
+    if (str != nullptr) {
+        str = parse_cache_source_field(str, &name, &name_size);
+    }
+    if (str == nullptr) {
+        return 0;
+    }
+    *identity = func;
+    *identity_size = str - func;
+    return *identity_size + size - kProcessKeyPrefixSize;
+}
+
+WEAK void make_persistent_key(uint8_t *dst, const uint8_t *cache_key, int32_t size,
+                              const char *identity, size_t identity_size) {
+    memcpy(dst, identity, identity_size);
+    memcpy(dst + identity_size, cache_key + kProcessKeyPrefixSize, size - kProcessKeyPrefixSize);
+}
+
+WEAK uint64_t read_eviction_epoch(void *user_context, uint64_t eviction_key) {
+    char path[kPersistentPathSize];
+    persistent_cache_path(path, "evict-", eviction_key, ".epoch");
+    uint64_t epoch = 0;
+    size_t mapped_size = 0;
+    void *data = halide_map_file(user_context, path, &mapped_size);
+    if (data != nullptr) {
+        if (mapped_size == sizeof(epoch)) {
+            memcpy(&epoch, data, sizeof(epoch));
+        }
+        halide_unmap_file(user_context, data, mapped_size);
+    }
+    return epoch;
+}
+
+WEAK void bump_eviction_epoch(void *user_context, uint64_t eviction_key) {
+    char path[kPersistentPathSize];
+    persistent_cache_path(path, "evict-", eviction_key, ".epoch");
+    uint64_t epoch = read_eviction_epoch(user_context, eviction_key) + 1;
+    if (halide_replace_file(user_context, path, &epoch, sizeof(epoch)) != 0) {
+        debug(user_context) << "Could not write " << path << "\n";
+    }
+}
+
+// Write an entry to the persistent tier. Returns true if it was written.
+WEAK bool persistent_store(void *user_context, const CacheEntry *entry) {
+    const char *identity;
+    size_t identity_size;
+    size_t key_size = persistent_key_size(entry->key, entry->key_size, &identity, &identity_size);
+    if (key_size == 0) {
+        return false;
+    }
+
+    size_t file_size = sizeof(PersistentEntryHeader) + round_up_to_8(key_size) +
+                       sizeof(halide_dimension_t) * entry->dimensions;
+    for (uint32_t i = 0; i < entry->tuple_count; i++) {
+        if (entry->buf[i].device_dirty()) {
+            // The host copy is stale.
+            return false;
+        }
+        file_size += sizeof(PersistentTupleHeader) + sizeof(halide_dimension_t) * entry->dimensions +
+                     round_up_to_8(entry->buf[i].size_in_bytes());
+    }
+
+    uint8_t *image = (uint8_t *)halide_malloc(user_context, file_size);
+    if (image == nullptr) {
+        return false;
+    }
+    memset(image, 0, file_size);
+
+    PersistentEntryHeader *header = (PersistentEntryHeader *)image;
+    header->magic = kPersistentMagic;
+    header->version = kPersistentVersion;
+    header->key_size = key_size;
+    header->tuple_count = entry->tuple_count;
+    header->dimensions = entry->dimensions;
+    header->has_eviction_key = entry->has_eviction_key;
+    header->eviction_key = entry->eviction_key;
+    header->eviction_epoch = entry->has_eviction_key ? read_eviction_epoch(user_context, entry->eviction_key) : 0;
+    header->cost_ns = entry->cost_ns;
+
+    uint8_t *dst = image + sizeof(PersistentEntryHeader);
+    uint8_t *key = dst;
+    make_persistent_key(key, entry->key, entry->key_size, identity, identity_size);
+    dst += round_up_to_8(key_size);
+    memcpy(dst, entry->computed_bounds, sizeof(halide_dimension_t) * entry->dimensions);
+    dst += sizeof(halide_dimension_t) * entry->dimensions;
+    for (uint32_t i = 0; i < entry->tuple_count; i++) {
+        PersistentTupleHeader *tuple = (PersistentTupleHeader *)dst;
+        tuple->type = entry->buf[i].type;
+        tuple->bytes = entry->buf[i].size_in_bytes();
+        dst += sizeof(PersistentTupleHeader);
+        memcpy(dst, entry->buf[i].dim, sizeof(halide_dimension_t) * entry->dimensions);
+        dst += sizeof(halide_dimension_t) * entry->dimensions;
+    }
+    for (uint32_t i = 0; i < entry->tuple_count; i++) {
+        size_t bytes = entry->buf[i].size_in_bytes();
+        memcpy(dst, entry->buf[i].host, bytes);
+        dst += round_up_to_8(bytes);
+    }
+
+    char path[kPersistentPathSize];
+    persistent_cache_path(path, "", hash_key(key, key_size), ".halide_cache");
+    bool written = halide_replace_file(user_context, path, image, file_size) == 0;
+    if (!written) {
+        debug(user_context) << "Could not write " << path << "\n";
+    }
+    halide_free(user_context, image);
+    return written;
+}
+
+// Look for an entry in the persistent tier and, if there is one with the
+// right shape, copy it into the given buffers. Returns true on success.
+WEAK bool persistent_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
+                            const halide_buffer_t *computed_bounds,
+                            int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                            bool *has_eviction_key, uint64_t *eviction_key, int64_t *cost_ns) {
+    const char *identity;
+    size_t identity_size;
+    size_t key_size = persistent_key_size(cache_key, size, &identity, &identity_size);
+    if (key_size == 0) {
+        return false;
+    }
+    uint8_t *key = (uint8_t *)halide_malloc(user_context, key_size);
+    if (key == nullptr) {
+        return false;
+    }
+    make_persistent_key(key, cache_key, size, identity, identity_size);
+
+    char path[kPersistentPathSize];
+    persistent_cache_path(path, "", hash_key(key, key_size), ".halide_cache");
+    size_t mapped_size = 0;
+    const uint8_t *data = (const uint8_t *)halide_map_file(user_context, path, &mapped_size);
+    if (data == nullptr) {
+        halide_free(user_context, key);
+        return false;
+    }
 
-            // Remove from more recent chain.
-            if (most_recently_used == prune_candidate) {
-                most_recently_used = prune_candidate->less_recent;
+    bool found = false;
+    bool stale = false;
+    const int32_t dimensions = computed_bounds->dimensions;
+    const size_t shape_bytes = sizeof(halide_dimension_t) * dimensions;
+    const PersistentEntryHeader *header = (const PersistentEntryHeader *)data;
+    size_t offset = sizeof(PersistentEntryHeader) + round_up_to_8(key_size) + shape_bytes;
+    if (mapped_size >= offset &&
+        header->magic == kPersistentMagic &&
+        header->version == kPersistentVersion &&
+        header->key_size == key_size &&
+        header->tuple_count == tuple_count &&
+        header->dimensions == dimensions &&
+        keys_equal(data + sizeof(PersistentEntryHeader), key, key_size) &&
+        buffer_has_shape(computed_bounds, (const halide_dimension_t *)(data + offset - shape_bytes))) {
+        found = true;
+        size_t data_offset = offset + (sizeof(PersistentTupleHeader) + shape_bytes) * tuple_count;
+        for (int32_t i = 0; i < tuple_count; i++) {
+            // Don't look at the tuple header unless all of it is in the file.
+            if (mapped_size < offset + sizeof(PersistentTupleHeader) + shape_bytes) {
+                found = false;
+                break;
             }
-            if (prune_candidate->less_recent != nullptr) {
-                prune_candidate->less_recent = more_recent;
+            const PersistentTupleHeader *tuple = (const PersistentTupleHeader *)(data + offset);
+            offset += sizeof(PersistentTupleHeader) + shape_bytes;
+            if (tuple->type != tuple_buffers[i]->type ||
+                tuple->bytes != tuple_buffers[i]->size_in_bytes() ||
+                !buffer_has_shape(tuple_buffers[i], (const halide_dimension_t *)(data + offset - shape_bytes))) {
+                found = false;
+                break;
             }
+            data_offset += round_up_to_8(tuple->bytes);
+        }
+        found = found && mapped_size >= data_offset;
+        if (found && header->has_eviction_key &&
+            header->eviction_epoch != read_eviction_epoch(user_context, header->eviction_key)) {
+            found = false;
+            stale = true;
+        }
+    }
+
+    if (found) {
+        *has_eviction_key = header->has_eviction_key != 0;
+        *eviction_key = header->eviction_key;
+        *cost_ns = header->cost_ns;
+        const uint8_t *src = data + offset;
+        for (int32_t i = 0; i < tuple_count; i++) {
+            size_t bytes = tuple_buffers[i]->size_in_bytes();
+            memcpy(tuple_buffers[i]->host, src, bytes);
+            src += round_up_to_8(bytes);
+        }
+    }
+
+    halide_unmap_file(user_context, (void *)data, mapped_size);
+    halide_free(user_context, key);
+    if (stale) {
+        halide_remove_file(user_context, path);
+    }
+    return found;
+}
 
-            // Decrease cache used amount.
-            for (uint32_t i = 0; i < prune_candidate->tuple_count; i++) {
-                current_cache_size -= prune_candidate->buf[i].size_in_bytes();
+// Must be called with no shard locked. Frees a list of entries removed from
+// the cache by prune_shard, first writing them to the persistent tier if
+// it's enabled.
+WEAK void retire_entries(void *user_context, CacheEntry *entries) {
+    bool persist = entries != nullptr && persistent_cache_enabled();
+    while (entries != nullptr) {
+        CacheEntry *next = entries->next;
+        if (persist && persistent_store(user_context, entries)) {
+            CacheShard &shard = shard_for_hash(entries->hash);
+            ScopedMutexLock lock(&shard.lock);
+            shard.stats[entries->source].persistent_writes++;
+        }
+        entries->destroy();
+        halide_free(user_context, entries);
+        entries = next;
+    }
+}
+
+// Must be called with the shard locked. Picks the entry to evict, starting
+// from the given entry, which must not be in use.
+WEAK CacheEntry *pick_victim(CacheShard &shard, CacheEntry *candidate) {
+    int policy;
+    Synchronization::atomic_load_relaxed(&cache_eviction_policy, &policy);
+    if (policy != halide_memoization_cache_evict_greedy_dual_size) {
+        return candidate;
+    }
+    CacheEntry *victim = candidate;
+    int seen = 1;
+    for (CacheEntry *e = candidate->more_recent;
+         e != nullptr && seen < kGreedyDualSizeCandidates;
+         e = e->more_recent) {
+        if (e->in_use_count == 0) {
+            seen++;
+            if (e->priority < victim->priority) {
+                victim = e;
             }
+        }
+    }
+    if (victim->priority > shard.inflation) {
+        shard.inflation = victim->priority;
+    }
+    return victim;
+}
 
-            // Deallocate the entry.
-            prune_candidate->destroy();
-            halide_free(nullptr, prune_candidate);
+// Must be called with the shard locked. Evicts entries that aren't in use,
+// starting from the least recently used end of the shard, until the cache
+// as a whole fits in its budget or the shard runs out of candidates. The
+// evicted entries are added to a list chained through their next pointers,
+// to be passed to retire_entries once the shard is unlocked.
+WEAK void prune_shard(CacheShard &shard, CacheEntry **evicted) {
+#if CACHE_DEBUGGING
+    validate_shard(shard);
+#endif
+    CacheEntry *prune_candidate = shard.least_recently_used;
+    while (prune_candidate != nullptr && cache_over_budget()) {
+        if (prune_candidate->in_use_count != 0) {
+            prune_candidate = prune_candidate->more_recent;
+            continue;
         }
 
-        prune_candidate = more_recent;
+        CacheEntry *victim = pick_victim(shard, prune_candidate);
+        if (victim == prune_candidate) {
+            prune_candidate = prune_candidate->more_recent;
+        }
+
+        // Remove from hash table
+        CacheEntry **prev = shard.bucket(victim->hash);
+        while (*prev != victim) {
+            halide_abort_if_false(nullptr, *prev != nullptr);
+            prev = &(*prev)->next;
+        }
+        *prev = victim->next;
+        shard.num_entries--;
+
+        unlink_from_lru(shard, victim);
+
+        // Decrease cache used amount.
+        int64_t bytes = entry_size_in_bytes(victim);
+        adjust_cache_size(-bytes);
+        CacheStats &stats = shard.stats[victim->source];
+        stats.bytes -= bytes;
+        stats.evictions++;
+
+        victim->next = *evicted;
+        *evicted = victim;
     }
 #if CACHE_DEBUGGING
-    validate_cache();
+    validate_shard(shard);
 #endif
 }
 
+// Must be called with no shard locked. Prunes shards in turn, starting
+// after the given one, until the cache fits in its budget.
+WEAK void prune_cache(void *user_context, int first_shard) {
+    for (int i = 0; i < kNumCacheShards && cache_over_budget(); i++) {
+        CacheShard &shard = cache_shards[(first_shard + i) % kNumCacheShards];
+        CacheEntry *evicted = nullptr;
+        {
+            ScopedMutexLock lock(&shard.lock);
+            prune_shard(shard, &evicted);
+        }
+        retire_entries(user_context, evicted);
+    }
+}
+
 }  // namespace Internal
 }  // namespace Runtime
 }  // namespace Halide
@@ -329,78 +988,75 @@ WEAK void halide_memoization_cache_set_size(int64_t size) {
         size = kDefaultCacheSize;
     }
 
-    ScopedMutexLock lock(&memoization_lock);
-
-    max_cache_size = size;
-    prune_cache();
+    {
+        ScopedMutexLock lock(&cache_size_lock);
+        max_cache_size = size;
+    }
+    prune_cache(nullptr, 0);
 }
 
 WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                          halide_buffer_t *computed_bounds, int32_t tuple_count, halide_buffer_t **tuple_buffers) {
-    uint32_t h = djb_hash(cache_key, size);
-    uint32_t index = h % kHashTableSize;
+    uint64_t h = hash_key(cache_key, size);
+    CacheShard &shard = shard_for_hash(h);
+    int source = find_cache_source(cache_key, size);
 
-    ScopedMutexLock lock(&memoization_lock);
+    {
+        ScopedMutexLock lock(&shard.lock);
 
 #if CACHE_DEBUGGING
-    debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
+        debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
 
-    debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
+        debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
 
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            debug_print_buffer(user_context, "Allocation bounds", *buf);
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                debug_print_buffer(user_context, "Allocation bounds", *buf);
+            }
         }
-    }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != nullptr) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            // Check all the tuple buffers have the same bounds (they should).
-            bool all_bounds_equal = true;
-            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-            }
+        CacheEntry *entry = shard.buckets ? *shard.bucket(h) : nullptr;
+        while (entry != nullptr) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
 
-            if (all_bounds_equal) {
-                if (entry != most_recently_used) {
-                    halide_abort_if_false(user_context, entry->more_recent != nullptr);
-                    if (entry->less_recent != nullptr) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        halide_abort_if_false(user_context, least_recently_used == entry);
-                        least_recently_used = entry->more_recent;
-                    }
-                    halide_abort_if_false(user_context, entry->more_recent != nullptr);
-                    entry->more_recent->less_recent = entry->less_recent;
+                // Check all the tuple buffers have the same bounds (they should).
+                bool all_bounds_equal = true;
+                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
+                }
 
-                    entry->more_recent = nullptr;
-                    entry->less_recent = most_recently_used;
-                    if (most_recently_used != nullptr) {
-                        most_recently_used->more_recent = entry;
+                if (all_bounds_equal) {
+                    if (entry != shard.most_recently_used) {
+                        unlink_from_lru(shard, entry);
+                        make_most_recently_used(shard, entry);
                     }
-                    most_recently_used = entry;
-                }
+                    update_priority(shard, entry, entry_size_in_bytes(entry));
+                    shard.stats[source].hits++;
 
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    *buf = entry->buf[i];
-                }
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        *buf = entry->buf[i];
+                    }
 
-                entry->in_use_count += tuple_count;
+                    entry->in_use_count += tuple_count;
 
-                return 0;
+                    return 0;
+                }
             }
+            entry = entry->next;
         }
-        entry = entry->next;
+
+        shard.stats[source].misses++;
     }
 
+    // A miss. Allocate storage for the caller to compute into. This
+    // doesn't need the lock.
+    int64_t start_ns = cache_time_ns(user_context);
     for (int32_t i = 0; i < tuple_count; i++) {
         halide_buffer_t *buf = tuple_buffers[i];
 
@@ -416,11 +1072,28 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
         CacheBlockHeader *header = get_pointer_to_header(buf->host);
         header->hash = h;
         header->entry = nullptr;
+        header->compute_start_ns = start_ns;
     }
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
+    bool has_eviction_key = false;
+    uint64_t eviction_key = 0;
+    int64_t cost_ns = 0;
+    if (persistent_cache_enabled() &&
+        persistent_lookup(user_context, cache_key, size, computed_bounds, tuple_count, tuple_buffers,
+                          &has_eviction_key, &eviction_key, &cost_ns)) {
+        // Backdate the start time so the entry keeps its original compute
+        // cost, then move it into memory as if it had just been computed.
+        for (int32_t i = 0; i < tuple_count; i++) {
+            get_pointer_to_header(tuple_buffers[i]->host)->compute_start_ns = start_ns - cost_ns;
+        }
+        {
+            ScopedMutexLock lock(&shard.lock);
+            shard.stats[source].persistent_hits++;
+        }
+        int result = halide_memoization_cache_store(user_context, cache_key, size, computed_bounds,
+                                                    tuple_count, tuple_buffers, has_eviction_key, eviction_key);
+        return result == halide_error_code_success ? 0 : result;
+    }
 
     return 1;
 }
@@ -431,107 +1104,128 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
                                         bool has_eviction_key, uint64_t eviction_key) {
     debug(user_context) << "halide_memoization_cache_store has_eviction_key: " << has_eviction_key << " eviction_key " << eviction_key << " .\n";
 
-    uint32_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
-
-    uint32_t index = h % kHashTableSize;
+    const CacheBlockHeader *first_header = get_pointer_to_header(tuple_buffers[0]->host);
+    uint64_t h = first_header->hash;
+    int64_t cost_ns = cache_time_ns(user_context) - first_header->compute_start_ns;
+    int source = find_cache_source(cache_key, size);
+    int shard_index = (int)(h >> (64 - kCacheShardBits));
+    CacheShard &shard = cache_shards[shard_index];
+    CacheEntry *evicted = nullptr;
 
-    ScopedMutexLock lock(&memoization_lock);
+    {
+        ScopedMutexLock lock(&shard.lock);
 
 #if CACHE_DEBUGGING
-    debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
+        debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
 
-    debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
+        debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
 
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            debug_print_buffer(user_context, "Allocation bounds", *buf);
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                debug_print_buffer(user_context, "Allocation bounds", *buf);
+            }
         }
-    }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != nullptr) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            bool all_bounds_equal = true;
-            bool no_host_pointers_equal = true;
-            {
-                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-                    if (entry->buf[i].host == buf->host) {
-                        no_host_pointers_equal = false;
+        CacheEntry *entry = shard.buckets ? *shard.bucket(h) : nullptr;
+        while (entry != nullptr) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
+
+                bool all_bounds_equal = true;
+                bool no_host_pointers_equal = true;
+                {
+                    for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
+                        if (entry->buf[i].host == buf->host) {
+                            no_host_pointers_equal = false;
+                        }
                     }
                 }
-            }
-            if (all_bounds_equal) {
-                halide_abort_if_false(user_context, no_host_pointers_equal);
-                // This entry is still in use by the caller. Mark it as having no cache entry
-                // so halide_memoization_cache_release can free the buffer.
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+                if (all_bounds_equal) {
+                    halide_abort_if_false(user_context, no_host_pointers_equal);
+                    // This entry is still in use by the caller. Mark it as having no cache entry
+                    // so halide_memoization_cache_release can free the buffer.
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+                    }
+                    return halide_error_code_success;
                 }
-                return halide_error_code_success;
             }
+            entry = entry->next;
         }
-        entry = entry->next;
-    }
 
-    uint64_t added_size = 0;
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            added_size += buf->size_in_bytes();
+        int64_t added_size = 0;
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                added_size += buf->size_in_bytes();
+            }
         }
-    }
-    current_cache_size += added_size;
-    prune_cache();
+        adjust_cache_size(added_size);
+        prune_shard(shard, &evicted);
 
-    CacheEntry *new_entry = (CacheEntry *)halide_malloc(nullptr, sizeof(CacheEntry));
-    bool inited = false;
-    if (new_entry) {
-        inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers,
-                                 has_eviction_key, eviction_key);
-    }
-    if (!inited) {
-        current_cache_size -= added_size;
+        if (shard.num_entries >= shard.num_buckets) {
+            grow_buckets(shard);
+        }
 
-        // This entry is still in use by the caller. Mark it as having no cache entry
-        // so halide_memoization_cache_release can free the buffer.
-        for (int32_t i = 0; i < tuple_count; i++) {
-            get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+        CacheEntry *new_entry = nullptr;
+        bool inited = false;
+        if (shard.buckets) {
+            new_entry = (CacheEntry *)halide_malloc(nullptr, sizeof(CacheEntry));
+            if (new_entry) {
+                inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers,
+                                         has_eviction_key, eviction_key);
+            }
         }
+        if (inited) {
+            CacheEntry **b = shard.bucket(h);
+            new_entry->next = *b;
+            *b = new_entry;
+            shard.num_entries++;
+            make_most_recently_used(shard, new_entry);
+
+            new_entry->in_use_count = tuple_count;
+            new_entry->source = source;
+            new_entry->cost_ns = cost_ns > 0 ? cost_ns : 0;
+            update_priority(shard, new_entry, added_size);
+
+            CacheStats &stats = shard.stats[source];
+            stats.bytes += added_size;
+            stats.compute_ns += new_entry->cost_ns;
+
+            for (int32_t i = 0; i < tuple_count; i++) {
+                get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+            }
+        } else {
+            adjust_cache_size(-added_size);
 
-        if (new_entry) {
-            halide_free(user_context, new_entry);
+            // This entry is still in use by the caller. Mark it as having no cache entry
+            // so halide_memoization_cache_release can free the buffer.
+            for (int32_t i = 0; i < tuple_count; i++) {
+                get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+            }
+
+            if (new_entry) {
+                halide_free(user_context, new_entry);
+            }
         }
-        return halide_error_code_success;
-    }
 
-    new_entry->next = cache_entries[index];
-    new_entry->less_recent = most_recently_used;
-    if (most_recently_used != nullptr) {
-        most_recently_used->more_recent = new_entry;
-    }
-    most_recently_used = new_entry;
-    if (least_recently_used == nullptr) {
-        least_recently_used = new_entry;
+#if CACHE_DEBUGGING
+        validate_shard(shard);
+#endif
     }
-    cache_entries[index] = new_entry;
 
-    new_entry->in_use_count = tuple_count;
+    retire_entries(user_context, evicted);
 
-    for (int32_t i = 0; i < tuple_count; i++) {
-        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
-    }
+    // If this shard didn't have enough unused entries to evict, take
+    // some from the others.
+    prune_cache(user_context, shard_index + 1);
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
     debug(user_context) << "Exiting halide_memoization_cache_store\n";
 
     return halide_error_code_success;
@@ -545,12 +1239,13 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
     if (entry == nullptr) {
         halide_free(user_context, header);
     } else {
-        ScopedMutexLock lock(&memoization_lock);
+        CacheShard &shard = shard_for_hash(header->hash);
+        ScopedMutexLock lock(&shard.lock);
 
         halide_abort_if_false(user_context, entry->in_use_count > 0);
         entry->in_use_count--;
 #if CACHE_DEBUGGING
-        validate_cache();
+        validate_shard(shard);
 #endif
     }
 
@@ -559,42 +1254,87 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
 
 WEAK void halide_memoization_cache_cleanup() {
     debug(nullptr) << "halide_memoization_cache_cleanup\n";
-    for (auto &entry_ref : cache_entries) {
-        CacheEntry *entry = entry_ref;
-        entry_ref = nullptr;
-        while (entry != nullptr) {
-            CacheEntry *next = entry->next;
-            entry->destroy();
-            halide_free(nullptr, entry);
-            entry = next;
+    bool persist = persistent_cache_enabled();
+    for (auto &shard : cache_shards) {
+        for (uint32_t i = 0; i < shard.num_buckets; i++) {
+            CacheEntry *entry = shard.buckets[i];
+            while (entry != nullptr) {
+                CacheEntry *next = entry->next;
+                if (persist) {
+                    persistent_store(nullptr, entry);
+                }
+                entry->destroy();
+                halide_free(nullptr, entry);
+                entry = next;
+            }
         }
+        if (shard.buckets) {
+            halide_free(nullptr, shard.buckets);
+        }
+        shard.buckets = nullptr;
+        shard.num_buckets = 0;
+        shard.num_entries = 0;
+        shard.most_recently_used = nullptr;
+        shard.least_recently_used = nullptr;
+        shard.inflation = 0;
+        memset(shard.stats, 0, sizeof(shard.stats));
     }
     current_cache_size = 0;
-    most_recently_used = nullptr;
-    least_recently_used = nullptr;
+
+    ScopedMutexLock lock(&cache_sources_lock);
+    memset(cache_sources, 0, sizeof(cache_sources));
+    num_cache_sources = 0;
+}
+
+WEAK void halide_memoization_cache_forget_pipeline(const char *pipeline_name) {
+    const uint64_t pipeline_id = hash_key((const uint8_t *)pipeline_name, strlen(pipeline_name));
+    ScopedMutexLock lock(&cache_sources_lock);
+    for (int i = 0; i < num_cache_sources; i++) {
+        CacheSource &source = cache_sources[i];
+        if (source.id == 0 || source.pipeline_id != pipeline_id) {
+            continue;
+        }
+        uint64_t free_id = 0;
+        Synchronization::atomic_store_release(&source.id, &free_id);
+
+        // The entries the Func left in the cache, and its counts, are no
+        // longer attributed to it, so that the slot can be reused.
+        for (auto &shard : cache_shards) {
+            ScopedMutexLock shard_lock(&shard.lock);
+            for (uint32_t b = 0; b < shard.num_buckets; b++) {
+                for (CacheEntry *entry = shard.buckets[b]; entry != nullptr; entry = entry->next) {
+                    if (entry->source == i) {
+                        entry->source = kMaxCacheSources;
+                    }
+                }
+            }
+            shard.stats[kMaxCacheSources].add(shard.stats[i]);
+            memset(&shard.stats[i], 0, sizeof(shard.stats[i]));
+        }
+    }
 }
 
 WEAK void halide_memoization_cache_evict(void *user_context, uint64_t eviction_key) {
-    ScopedMutexLock lock(&memoization_lock);
+    if (persistent_cache_enabled()) {
+        ScopedMutexLock lock(&persistent_cache_lock);
+        bump_eviction_epoch(user_context, eviction_key);
+    }
 
-    for (auto &entry_ref : cache_entries) {
-        CacheEntry *entry = entry_ref;
-        if (entry != nullptr) {
-            CacheEntry **prev = &entry_ref;
+    for (auto &shard : cache_shards) {
+        ScopedMutexLock lock(&shard.lock);
+
+        for (uint32_t i = 0; i < shard.num_buckets; i++) {
+            CacheEntry **prev = &shard.buckets[i];
+            CacheEntry *entry = *prev;
             while (entry != nullptr) {
                 CacheEntry *next = entry->next;
                 if (entry->has_eviction_key && entry->eviction_key == eviction_key) {
                     *prev = next;
-                    if (entry->more_recent != nullptr) {
-                        entry->more_recent->less_recent = entry->less_recent;
-                    } else {
-                        most_recently_used = entry->less_recent;
-                    }
-                    if (entry->less_recent != nullptr) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        least_recently_used = entry->more_recent;
-                    }
+                    shard.num_entries--;
+                    unlink_from_lru(shard, entry);
+                    int64_t bytes = entry_size_in_bytes(entry);
+                    adjust_cache_size(-bytes);
+                    shard.stats[entry->source].bytes -= bytes;
                     entry->destroy();
                     halide_free(user_context, entry);
                 } else {
@@ -603,10 +1343,87 @@ WEAK void halide_memoization_cache_evict(void *user_context, uint64_t eviction_k
                 entry = next;
             }
         }
-    }
 #if CACHE_DEBUGGING
-    validate_cache();
+        validate_shard(shard);
 #endif
+    }
+}
+
+WEAK halide_memoization_cache_eviction_policy_t
+halide_memoization_cache_set_eviction_policy(halide_memoization_cache_eviction_policy_t policy) {
+    int new_policy = policy;
+    int old_policy = Synchronization::atomic_exchange_acquire(&cache_eviction_policy, new_policy);
+    return (halide_memoization_cache_eviction_policy_t)old_policy;
+}
+
+WEAK int halide_memoization_cache_set_persistent_path(const char *path) {
+    ScopedMutexLock lock(&persistent_cache_lock);
+    return set_persistent_cache_dir_already_locked(path);
+}
+
+WEAK int halide_memoization_cache_get_stats(halide_memoization_cache_stats_t *stats,
+                                            halide_memoization_cache_func_stats_t *func_stats,
+                                            int max_func_stats) {
+    if (func_stats == nullptr || max_func_stats < 0) {
+        max_func_stats = 0;
+    }
+    // Where the breakdown of each slot goes in func_stats, or -1 if it
+    // isn't reported.
+    int func_stats_index[kMaxCacheSources];
+    int count = 0;
+    {
+        ScopedMutexLock lock(&cache_sources_lock);
+        for (int i = 0; i < kMaxCacheSources; i++) {
+            func_stats_index[i] = -1;
+            if (i >= num_cache_sources || cache_sources[i].id == 0) {
+                continue;
+            }
+            if (count < max_func_stats) {
+                halide_memoization_cache_func_stats_t &f = func_stats[count];
+                memset(&f, 0, sizeof(f));
+                memcpy(f.pipeline_name, cache_sources[i].pipeline_name, sizeof(f.pipeline_name));
+                memcpy(f.func_name, cache_sources[i].func_name, sizeof(f.func_name));
+                func_stats_index[i] = count;
+            }
+            count++;
+        }
+    }
+
+    halide_memoization_cache_stats_t total;
+    memset(&total, 0, sizeof(total));
+    for (auto &shard : cache_shards) {
+        ScopedMutexLock lock(&shard.lock);
+        total.entries += shard.num_entries;
+        for (int i = 0; i <= kMaxCacheSources; i++) {
+            const CacheStats &s = shard.stats[i];
+            total.hits += s.hits;
+            total.misses += s.misses;
+            total.evictions += s.evictions;
+            total.persistent_hits += s.persistent_hits;
+            total.persistent_writes += s.persistent_writes;
+            total.compute_ns += s.compute_ns;
+            if (i < kMaxCacheSources && func_stats_index[i] >= 0) {
+                halide_memoization_cache_func_stats_t &f = func_stats[func_stats_index[i]];
+                f.hits += s.hits;
+                f.misses += s.misses;
+                f.evictions += s.evictions;
+                f.persistent_hits += s.persistent_hits;
+                f.persistent_writes += s.persistent_writes;
+                f.current_bytes += s.bytes;
+                f.compute_ns += s.compute_ns;
+            }
+        }
+    }
+    {
+        ScopedMutexLock lock(&cache_size_lock);
+        total.current_bytes = current_cache_size;
+        total.max_bytes = max_cache_size;
+    }
+
+    if (stats != nullptr) {
+        *stats = total;
+    }
+    return count;
 }
 
 namespace {
@@ -0,0 +1,25 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+// Memory-mapped file stores aren't supported on this platform, so the
+// persistent tier of the memoization cache is never enabled.
+
+WEAK void *halide_map_file(void *user_context, const char *path, size_t *size) {
+    *size = 0;
+    return nullptr;
+}
+
+WEAK void halide_unmap_file(void *user_context, void *data, size_t size) {
+}
+
+WEAK int halide_replace_file(void *user_context, const char *path, const void *data, size_t size) {
+    return -1;
+}
+
+WEAK int halide_remove_file(void *user_context, const char *path) {
+    return -1;
+}
+
+}  // extern "C"
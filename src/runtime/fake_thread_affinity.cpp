@@ -0,0 +1,19 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+WEAK int halide_host_cpu_topology(int *cpus, int *nodes, int max_cpus) {
+    // Thread placement isn't supported on this platform.
+    return 0;
+}
+
+WEAK bool halide_pin_current_thread(int cpu) {
+    return false;
+}
+
+WEAK int halide_current_cpu() {
+    return -1;
+}
+
+}  // extern "C"
@@ -122,6 +122,14 @@ WEAK int halide_set_num_threads(int n) {
     return 1;
 }
 
+WEAK bool halide_get_thread_affinity() {
+    return false;
+}
+
+WEAK bool halide_set_thread_affinity(bool enabled) {
+    return false;
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
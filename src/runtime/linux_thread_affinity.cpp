@@ -0,0 +1,114 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+extern int sched_getaffinity(int pid, size_t cpusetsize, void *mask);
+extern int sched_setaffinity(int pid, size_t cpusetsize, const void *mask);
+extern int sched_getcpu();
+extern ssize_t read(int fd, void *buf, size_t count);
+
+}  // extern "C"
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+
+// Same layout as glibc's cpu_set_t, which covers 1024 CPUs.
+constexpr int max_cpu_set_size = 1024;
+struct cpu_set {
+    uint64_t bits[max_cpu_set_size / 64];
+};
+
+// There's no way to enumerate the NUMA nodes without readdir, so just
+// probe this many node ids. Node ids may be sparse.
+constexpr int max_numa_nodes = 64;
+
+// Parse a sysfs cpu list such as "0-7,16-23\n", recording the given node
+// for each CPU in it.
+WEAK void parse_cpu_list(const char *s, int node, int *node_of_cpu) {
+    while (*s >= '0' && *s <= '9') {
+        int first = 0;
+        while (*s >= '0' && *s <= '9') {
+            first = first * 10 + (*s++ - '0');
+        }
+        int last = first;
+        if (*s == '-') {
+            s++;
+            last = 0;
+            while (*s >= '0' && *s <= '9') {
+                last = last * 10 + (*s++ - '0');
+            }
+        }
+        for (int cpu = first; cpu <= last && cpu < max_cpu_set_size; cpu++) {
+            node_of_cpu[cpu] = node;
+        }
+        if (*s == ',') {
+            s++;
+        }
+    }
+}
+
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_host_cpu_topology(int *cpus, int *nodes, int max_cpus) {
+    cpu_set allowed;
+    memset(&allowed, 0, sizeof(allowed));
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+
+    // CPUs we can't find a node for (e.g. because sysfs isn't mounted) are
+    // all treated as being on node zero.
+    int node_of_cpu[max_cpu_set_size];
+    memset(node_of_cpu, 0, sizeof(node_of_cpu));
+    for (int node = 0; node < max_numa_nodes; node++) {
+        char path[64];
+        char *dst = halide_string_to_string(path, path + sizeof(path), "/sys/devices/system/node/node");
+        dst = halide_int64_to_string(dst, path + sizeof(path), node, 1);
+        halide_string_to_string(dst, path + sizeof(path), "/cpulist");
+        void *f = halide_fopen(path, "rb");
+        if (f == nullptr) {
+            continue;
+        }
+        char buf[4096];
+        ssize_t bytes = read(fileno(f), buf, sizeof(buf) - 1);
+        fclose(f);
+        if (bytes > 0) {
+            buf[bytes] = 0;
+            parse_cpu_list(buf, node, node_of_cpu);
+        }
+    }
+
+    int count = 0;
+    for (int cpu = 0; cpu < max_cpu_set_size && count < max_cpus; cpu++) {
+        if (allowed.bits[cpu / 64] & ((uint64_t)1 << (cpu % 64))) {
+            cpus[count] = cpu;
+            nodes[count] = node_of_cpu[cpu];
+            count++;
+        }
+    }
+    return count;
+}
+
+WEAK bool halide_pin_current_thread(int cpu) {
+    if (cpu < 0 || cpu >= max_cpu_set_size) {
+        return false;
+    }
+    cpu_set mask;
+    memset(&mask, 0, sizeof(mask));
+    mask.bits[cpu / 64] = (uint64_t)1 << (cpu % 64);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+}
+
+WEAK int halide_current_cpu() {
+    return sched_getcpu();
+}
+
+}  // extern "C"
@@ -1,18 +1,216 @@
 #include "HalideRuntime.h"
+#include "runtime_atomics.h"
 #include "runtime_internal.h"
+#include "scoped_mutex_lock.h"
 
 extern "C" {
 
 extern void *malloc(size_t);
 extern void free(void *);
+}
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+
+// When enabled with halide_reuse_host_allocations, allocations of up to
+// 1MB are rounded up to a power of two and freed blocks are kept on free
+// lists, one per size class. The runtime can't use thread-local storage
+// (it isn't available to JIT code everywhere), so the lists are split into
+// shards picked by the address of the calling thread's stack. Threads
+// usually have a shard to themselves, and otherwise rarely contend.
+const int kPoolMinClassBits = 6;
+const int kPoolMaxClassBits = 20;
+const int kPoolNumClasses = kPoolMaxClassBits - kPoolMinClassBits + 1;
+const int kPoolShardBits = 4;
+const int kPoolNumShards = 1 << kPoolShardBits;
+// Each free list holds at most this many bytes, and at least one block.
+const size_t kPoolMaxBytesPerList = 256 * 1024;
+// The tag of blocks that aren't in a size class.
+const int kNotPooled = -1;
+
+struct PoolShard {
+    halide_mutex lock;
+    void *free_lists[kPoolNumClasses];
+    int list_lengths[kPoolNumClasses];
+    halide_host_allocation_stats_t stats;
+    // Keep shards on separate cache lines.
+    char padding[64];
+};
+
+WEAK PoolShard pool_shards[kPoolNumShards];
+WEAK int reuse_host_allocations_flag = 0;
+
+// Every block from halide_default_malloc has two words before it: its size
+// class or kNotPooled, and the pointer malloc returned. The latter is where
+// halide_internal_aligned_alloc keeps it too.
+WEAK_INLINE void *tagged_aligned_alloc(size_t alignment, size_t size, int tag) {
+    halide_debug_assert(nullptr, is_power_of_two(alignment) && alignment >= 2 * sizeof(void *));
+
+    // malloc returns memory aligned to at least two words, so the words
+    // fit in the same padding halide_internal_aligned_alloc uses.
+    const size_t aligned_size = align_up(size + alignment, alignment);
+    void *orig = ::malloc(aligned_size);
+    if (orig == nullptr) {
+        return nullptr;
+    }
+    halide_debug_assert(nullptr, (((uintptr_t)orig) % (2 * sizeof(void *))) == 0);
+
+    void *ptr = (void *)align_up((uintptr_t)orig + 2 * sizeof(void *), alignment);
+    ((void **)ptr)[-1] = orig;
+    ((intptr_t *)ptr)[-2] = tag;
+    return ptr;
+}
+
+WEAK_INLINE void tagged_aligned_free(void *ptr) {
+    ::free(((void **)ptr)[-1]);
+}
+
+WEAK_INLINE int block_tag(void *ptr) {
+    return (int)((intptr_t *)ptr)[-2];
+}
+
+WEAK_INLINE int size_class_of(size_t x) {
+    int bits = kPoolMinClassBits;
+    while (bits <= kPoolMaxClassBits && ((size_t)1 << bits) < x) {
+        bits++;
+    }
+    return bits <= kPoolMaxClassBits ? bits - kPoolMinClassBits : kNotPooled;
+}
+
+WEAK_INLINE PoolShard &current_pool_shard() {
+    // Thread stacks are far apart, so the bits above the first 64k of the
+    // address of a local variable mostly identify the thread.
+    int local;
+    uintptr_t h = ((uintptr_t)&local) >> 16;
+    h ^= h >> 7;
+    h ^= h >> kPoolShardBits;
+    return pool_shards[h & (kPoolNumShards - 1)];
+}
+
+WEAK_INLINE bool can_reuse_host_allocations() {
+    int flag;
+    Synchronization::atomic_load_relaxed(&reuse_host_allocations_flag, &flag);
+    return flag != 0;
+}
+
+WEAK void trim_pool_shard(PoolShard &shard) {
+    void *to_free[kPoolNumClasses];
+    {
+        ScopedMutexLock lock(&shard.lock);
+        for (int c = 0; c < kPoolNumClasses; c++) {
+            to_free[c] = shard.free_lists[c];
+            shard.free_lists[c] = nullptr;
+            shard.list_lengths[c] = 0;
+        }
+        shard.stats.cached_allocations = 0;
+        shard.stats.cached_bytes = 0;
+    }
+    for (void *block : to_free) {
+        while (block != nullptr) {
+            void *next = *(void **)block;
+            tagged_aligned_free(block);
+            block = next;
+        }
+    }
+}
+
+WEAK __attribute__((destructor)) void halide_host_allocation_pool_cleanup() {
+    for (PoolShard &shard : pool_shards) {
+        trim_pool_shard(shard);
+    }
+}
+
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+extern "C" {
 
 WEAK void *halide_default_malloc(void *user_context, size_t x) {
     const size_t alignment = ::halide_internal_malloc_alignment();
-    return ::halide_internal_aligned_alloc(alignment, x);
+    if (!can_reuse_host_allocations()) {
+        return tagged_aligned_alloc(alignment, x, kNotPooled);
+    }
+
+    int size_class = size_class_of(x);
+    if (size_class == kNotPooled) {
+        return tagged_aligned_alloc(alignment, x, kNotPooled);
+    }
+    const size_t class_size = (size_t)1 << (size_class + kPoolMinClassBits);
+
+    PoolShard &shard = current_pool_shard();
+    {
+        ScopedMutexLock lock(&shard.lock);
+        shard.stats.allocations++;
+        void *block = shard.free_lists[size_class];
+        if (block != nullptr) {
+            shard.free_lists[size_class] = *(void **)block;
+            shard.list_lengths[size_class]--;
+            shard.stats.reused++;
+            shard.stats.cached_allocations--;
+            shard.stats.cached_bytes -= class_size;
+            return block;
+        }
+    }
+    return tagged_aligned_alloc(alignment, class_size, size_class);
 }
 
 WEAK void halide_default_free(void *user_context, void *ptr) {
-    ::halide_internal_aligned_free(ptr);
+    int size_class = block_tag(ptr);
+    if (size_class != kNotPooled) {
+        const size_t class_size = (size_t)1 << (size_class + kPoolMinClassBits);
+        const size_t max_list_length = class_size < kPoolMaxBytesPerList ? kPoolMaxBytesPerList / class_size : 1;
+        // Freed blocks go to the freeing thread's shard, which is where
+        // that thread will look for its next allocation.
+        PoolShard &shard = current_pool_shard();
+        ScopedMutexLock lock(&shard.lock);
+        shard.stats.frees++;
+        if (can_reuse_host_allocations() &&
+            (size_t)shard.list_lengths[size_class] < max_list_length) {
+            *(void **)ptr = shard.free_lists[size_class];
+            shard.free_lists[size_class] = ptr;
+            shard.list_lengths[size_class]++;
+            shard.stats.kept++;
+            shard.stats.cached_allocations++;
+            shard.stats.cached_bytes += class_size;
+            return;
+        }
+    }
+    tagged_aligned_free(ptr);
+}
+
+WEAK int halide_reuse_host_allocations(void *user_context, bool flag) {
+    int value = flag ? 1 : 0;
+    Synchronization::atomic_store_relaxed(&reuse_host_allocations_flag, &value);
+    if (!flag) {
+        halide_trim_host_allocations(user_context);
+    }
+    return halide_error_code_success;
+}
+
+WEAK bool halide_can_reuse_host_allocations(void *user_context) {
+    return can_reuse_host_allocations();
+}
+
+WEAK void halide_trim_host_allocations(void *user_context) {
+    for (PoolShard &shard : pool_shards) {
+        trim_pool_shard(shard);
+    }
+}
+
+WEAK void halide_get_host_allocation_stats(halide_host_allocation_stats_t *stats) {
+    halide_host_allocation_stats_t total = {};
+    for (PoolShard &shard : pool_shards) {
+        ScopedMutexLock lock(&shard.lock);
+        total.allocations += shard.stats.allocations;
+        total.reused += shard.stats.reused;
+        total.frees += shard.stats.frees;
+        total.kept += shard.stats.kept;
+        total.cached_allocations += shard.stats.cached_allocations;
+        total.cached_bytes += shard.stats.cached_bytes;
+    }
+    *stats = total;
 }
 }
 
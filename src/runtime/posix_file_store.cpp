@@ -0,0 +1,92 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+// off_t is a long on all the posix platforms we target.
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+extern long lseek(int fd, long offset, int whence);
+extern int mkstemp(char *tmpl);
+extern int rename(const char *oldpath, const char *newpath);
+
+}  // extern "C"
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+
+// These have the same values on Linux, macOS, iOS, Android and Fuchsia.
+constexpr int prot_read = 1;
+constexpr int map_private = 2;
+constexpr int seek_end = 2;
+
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+extern "C" {
+
+WEAK void *halide_map_file(void *user_context, const char *path, size_t *size) {
+    void *f = halide_fopen(path, "rb");
+    if (f == nullptr) {
+        return nullptr;
+    }
+    int fd = fileno(f);
+    long end = lseek(fd, 0, seek_end);
+    void *data = nullptr;
+    if (end > 0) {
+        data = mmap(nullptr, end, prot_read, map_private, fd, 0);
+        if (data == (void *)-1) {
+            data = nullptr;
+        }
+    }
+    // The mapping outlives the file handle.
+    fclose(f);
+    *size = data ? (size_t)end : 0;
+    return data;
+}
+
+WEAK void halide_unmap_file(void *user_context, void *data, size_t size) {
+    munmap(data, size);
+}
+
+WEAK int halide_replace_file(void *user_context, const char *path, const void *data, size_t size) {
+    // Write to a temporary file in the same directory and rename it over
+    // the destination, so that readers never see a partial file.
+    char tmp[1024];
+    char *end = tmp + sizeof(tmp);
+    char *dst = halide_string_to_string(tmp, end, path);
+    dst = halide_string_to_string(dst, end, ".XXXXXX");
+    if (dst >= end - 1) {
+        return -1;
+    }
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        return -1;
+    }
+    const char *src = (const char *)data;
+    size_t remaining = size;
+    while (remaining > 0) {
+        ssize_t written = write(fd, src, remaining);
+        if (written <= 0) {
+            close(fd);
+            remove(tmp);
+            return -1;
+        }
+        src += written;
+        remaining -= written;
+    }
+    close(fd);
+    if (rename(tmp, path) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+WEAK int halide_remove_file(void *user_context, const char *path) {
+    return remove(path);
+}
+
+}  // extern "C"
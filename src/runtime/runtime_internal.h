@@ -184,6 +184,23 @@ WEAK void halide_enable_timer_interrupt();
 
 WEAK int halide_host_cpu_count();
 
+// Used by the thread pool to place worker threads when thread affinity is
+// enabled. halide_host_cpu_topology writes up to max_cpus of the CPUs this
+// process may run on, and the NUMA node of each, and returns how many it
+// wrote. It returns zero on platforms that don't support pinning threads.
+WEAK int halide_host_cpu_topology(int *cpus, int *nodes, int max_cpus);
+WEAK bool halide_pin_current_thread(int cpu);
+WEAK int halide_current_cpu();
+
+// Used by the persistent tier of the memoization cache. halide_map_file
+// maps a whole file read-only and returns nullptr if it can't.
+// halide_replace_file atomically replaces the contents of a file. All
+// four fail on platforms without a file store.
+WEAK void *halide_map_file(void *user_context, const char *path, size_t *size);
+WEAK void halide_unmap_file(void *user_context, void *data, size_t size);
+WEAK int halide_replace_file(void *user_context, const char *path, const void *data, size_t size);
+WEAK int halide_remove_file(void *user_context, const char *path);
+
 WEAK int halide_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf,
                                        const struct halide_device_interface_t *device_interface);
 WEAK int halide_device_and_host_free(void *user_context, struct halide_buffer_t *buf);
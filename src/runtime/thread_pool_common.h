@@ -98,6 +98,9 @@ struct work {
     int active_workers;
     int exit_status;
     int next_semaphore;
+    // The NUMA node of the thread that enqueued this job. Only meaningful
+    // when thread affinity is enabled.
+    int node;
     // which condition variable is the owner sleeping on. nullptr if it isn't sleeping.
     bool owner_is_sleeping;
 
@@ -120,6 +123,25 @@ struct work {
     ALWAYS_INLINE bool running() const {
         return task.extent || active_workers;
     }
+
+    // Jobs that never block and have no semaphores to acquire can have
+    // their iterations claimed in bulk and redistributed between threads
+    // by stealing, rather than claimed one at a time under the work queue
+    // lock.
+    ALWAYS_INLINE bool can_split() const {
+        return !task.serial && task.min_threads == 0 && task.num_semaphores == 0;
+    }
+};
+
+// A contiguous range of iterations of a splittable job that one thread
+// has claimed. The claiming thread pops iterations off the front without
+// holding the work queue lock. Idle threads steal the back half while
+// holding the work queue lock, which is also how the owner resolves a race
+// with a thief when the range is nearly exhausted.
+struct stealable_range {
+    work *job;
+    int next, end;
+    stealable_range *next_range;
 };
 
 ALWAYS_INLINE int clamp_num_threads(int threads) {
@@ -132,6 +154,11 @@ ALWAYS_INLINE int clamp_num_threads(int threads) {
     }
 }
 
+WEAK bool default_thread_affinity() {
+    char *affinity_str = getenv("HL_THREAD_AFFINITY");
+    return affinity_str && atoi(affinity_str) != 0;
+}
+
 WEAK int default_desired_num_threads() {
     char *threads_str = getenv("HL_NUM_THREADS");
     if (!threads_str) {
@@ -151,6 +178,10 @@ struct work_queue_t {
     // The desired number threads doing work (HL_NUM_THREADS).
     int desired_threads_working;
 
+    // Whether workers should be pinned to CPUs (HL_THREAD_AFFINITY). Zero
+    // means not yet decided, one means no, two means yes.
+    int desired_thread_affinity;
+
     // All fields after this must be zero in the initial state. See assert_zeroed
     // Field serves both to mark the offset in struct and as layout padding.
     int zero_marker;
@@ -158,6 +189,10 @@ struct work_queue_t {
     // Singly linked list for job stack
     work *jobs;
 
+    // Singly linked list of ranges of iterations that threads are currently
+    // working through, and which idle threads may steal from.
+    stealable_range *ranges;
+
     // The number threads created
     int threads_created;
 
@@ -181,6 +216,12 @@ struct work_queue_t {
     // Keep track of threads so they can be joined at shutdown
     halide_thread *threads[MAX_THREADS];
 
+    // When thread affinity is enabled, the CPUs that workers are pinned to,
+    // in order, and the NUMA node of each. num_nodes is zero when threads
+    // are not being pinned.
+    int num_cpus, num_nodes;
+    int cpus[MAX_THREADS], cpu_nodes[MAX_THREADS];
+
     // Global flags indicating the threadpool should shut down, and
     // whether the thread pool has been initialized.
     bool shutdown, initialized;
@@ -197,7 +238,7 @@ struct work_queue_t {
 
     // Used to check initial state is correct.
     ALWAYS_INLINE void assert_zeroed() const {
-        // Assert that all fields except the mutex and desired threads count are zeroed.
+        // Assert that all fields except the mutex and desired threads count and affinity are zeroed.
         const char *bytes = ((const char *)&this->zero_marker);
         const char *limit = ((const char *)this) + sizeof(work_queue_t);
         while (bytes < limit && *bytes == 0) {
@@ -209,7 +250,7 @@ struct work_queue_t {
     // Return the work queue to initial state. Must be called while locked
     // and queue will remain locked.
     ALWAYS_INLINE void reset() {
-        // Ensure all fields except the mutex and desired hreads count are zeroed.
+        // Ensure all fields except the mutex and desired threads count and affinity are zeroed.
         char *bytes = ((char *)&this->zero_marker);
         char *limit = ((char *)this) + sizeof(work_queue_t);
         memset(bytes, 0, limit - bytes);
@@ -253,6 +294,21 @@ WEAK void dump_job_state() {
 
 WEAK void worker_thread(void *);
 
+// The NUMA node the calling thread is currently running on. Must be called
+// with the work queue locked.
+WEAK int current_numa_node() {
+    if (work_queue.num_nodes <= 1) {
+        return 0;
+    }
+    int cpu = halide_current_cpu();
+    for (int i = 0; i < work_queue.num_cpus; i++) {
+        if (work_queue.cpus[i] == cpu) {
+            return work_queue.cpu_nodes[i];
+        }
+    }
+    return 0;
+}
+
 WEAK void worker_thread_stall(work *owned_job) {
     work_queue.owners_sleeping++;
     owned_job->owner_is_sleeping = true;
@@ -274,7 +330,122 @@ WEAK void worker_thread_idle() {
     work_queue.workers_sleeping--;
 }
 
+// Must be called with the work queue unlocked, by the thread that owns the
+// range. Claims the next iteration of the range. Returns true with the lock
+// still released if one was claimed. Only the slow path, where the owner
+// may be racing a thief for the last iterations, takes the lock, so that
+// returns true with the lock released again if the owner won, and false
+// with the lock held if the range is exhausted.
+WEAK bool pop_range_unlocked(stealable_range *range, int *idx) {
+    int i;
+    Synchronization::atomic_load_relaxed(&range->next, &i);
+    int n = i + 1;
+    Synchronization::atomic_store_relaxed(&range->next, &n);
+    Synchronization::atomic_thread_fence_sequentially_consistent();
+    int e;
+    Synchronization::atomic_load_relaxed(&range->end, &e);
+    if (n <= e) {
+        *idx = i;
+        return true;
+    }
+    // We may be racing with a thief for the last few iterations. Thieves
+    // hold the lock, so taking it settles who got what.
+    halide_mutex_lock(&work_queue.mutex);
+    Synchronization::atomic_load_relaxed(&range->end, &e);
+    if (n <= e) {
+        halide_mutex_unlock(&work_queue.mutex);
+        *idx = i;
+        return true;
+    }
+    Synchronization::atomic_store_relaxed(&range->next, &i);
+    return false;
+}
+
+// Must be called with the work queue locked. Runs the iterations in the
+// range, and whatever gets added to it, with the lock released. Returns
+// with the lock held.
+WEAK int run_range_already_locked(stealable_range *range) {
+    work *job = range->job;
+    range->next_range = work_queue.ranges;
+    work_queue.ranges = range;
+    halide_mutex_unlock(&work_queue.mutex);
+
+    int result = halide_error_code_success;
+    int idx;
+    while (pop_range_unlocked(range, &idx)) {
+        if (job->task_fn) {
+            result = halide_do_task(job->user_context, job->task_fn,
+                                    idx, job->task.closure);
+        } else {
+            result = halide_do_loop_task(job->user_context, job->task.fn,
+                                         idx, 1, job->task.closure, job);
+        }
+        if (result != halide_error_code_success) {
+            // Abandon the rest of the range. The job has failed anyway.
+            halide_mutex_lock(&work_queue.mutex);
+            break;
+        }
+    }
+
+    stealable_range **prev_ptr = &work_queue.ranges;
+    while (*prev_ptr != range) {
+        prev_ptr = &(*prev_ptr)->next_range;
+    }
+    *prev_ptr = range->next_range;
+    return result;
+}
+
+// Must be called with the work queue locked. Steals the back half of the
+// largest range some other thread is working on, preferring ranges of jobs
+// from the given NUMA node. Returns the job the iterations belong to, or
+// nullptr if there was nothing worth stealing.
+WEAK work *steal_range_already_locked(stealable_range *stolen, int node) {
+    stealable_range *victim = nullptr;
+    int victim_remaining = 1;
+    bool victim_is_local = false;
+    for (stealable_range *r = work_queue.ranges; r; r = r->next_range) {
+        if (r->job->exit_status != halide_error_code_success) {
+            continue;
+        }
+        int n, e;
+        Synchronization::atomic_load_relaxed(&r->next, &n);
+        Synchronization::atomic_load_relaxed(&r->end, &e);
+        bool is_local = r->job->node == node;
+        if (e - n > 1 &&
+            ((is_local && !victim_is_local) ||
+             (is_local == victim_is_local && e - n > victim_remaining))) {
+            victim = r;
+            victim_remaining = e - n;
+            victim_is_local = is_local;
+        }
+    }
+    if (!victim) {
+        return nullptr;
+    }
+
+    // Only thieves write to end, and they hold the lock, so this read
+    // can't be stale.
+    int old_end;
+    Synchronization::atomic_load_relaxed(&victim->end, &old_end);
+    int new_end = old_end - victim_remaining / 2;
+    Synchronization::atomic_store_relaxed(&victim->end, &new_end);
+    Synchronization::atomic_thread_fence_sequentially_consistent();
+    int n;
+    Synchronization::atomic_load_relaxed(&victim->next, &n);
+    if (n > new_end) {
+        // The owner got there first.
+        Synchronization::atomic_store_relaxed(&victim->end, &old_end);
+        return nullptr;
+    }
+    log_message("Stole " << old_end - new_end << " iterations of " << victim->job->task.name);
+    stolen->job = victim->job;
+    stolen->next = new_end;
+    stolen->end = old_end;
+    return stolen->job;
+}
+
 WEAK void worker_thread_already_locked(work *owned_job) {
+    const int node = current_numa_node();
     while (owned_job ? owned_job->running() : !work_queue.shutdown) {
         work *job = work_queue.jobs;
         work **prev_ptr = &work_queue.jobs;
@@ -302,51 +473,72 @@ WEAK void worker_thread_already_locked(work *owned_job) {
 
         dump_job_state();
 
-        // Find a job to run, prefering things near the top of the stack.
-        while (job) {
-            print_job(job, "", "Considering job ");
-            // Only schedule tasks with enough free worker threads
-            // around to complete. They may get stolen later, but only
-            // by tasks which can themselves use them to complete
-            // work, so forward progress is made.
-            bool enough_threads;
-
-            work *parent_job = job->parent_job;
-
-            int threads_available;
-            if (parent_job == nullptr) {
-                // The + 1 is because work_queue.threads_created does not include the main thread.
-                threads_available = (work_queue.threads_created + 1) - work_queue.threads_reserved;
-            } else {
-                if (parent_job->active_workers == 0) {
-                    threads_available = parent_job->task.min_threads - parent_job->threads_reserved;
+        // Find a job to run, prefering things near the top of the stack. If
+        // there's more than one NUMA node, first look only for work
+        // enqueued from our own node, so that it runs near its memory.
+        bool local_jobs_only = work_queue.num_nodes > 1;
+        while (true) {
+            while (job) {
+                print_job(job, "", "Considering job ");
+                // Only schedule tasks with enough free worker threads
+                // around to complete. They may get stolen later, but only
+                // by tasks which can themselves use them to complete
+                // work, so forward progress is made.
+                bool enough_threads;
+
+                work *parent_job = job->parent_job;
+
+                int threads_available;
+                if (parent_job == nullptr) {
+                    // The + 1 is because work_queue.threads_created does not include the main thread.
+                    threads_available = (work_queue.threads_created + 1) - work_queue.threads_reserved;
                 } else {
-                    threads_available = parent_job->active_workers * parent_job->task.min_threads - parent_job->threads_reserved;
+                    if (parent_job->active_workers == 0) {
+                        threads_available = parent_job->task.min_threads - parent_job->threads_reserved;
+                    } else {
+                        threads_available = parent_job->active_workers * parent_job->task.min_threads - parent_job->threads_reserved;
+                    }
                 }
-            }
-            enough_threads = threads_available >= job->task.min_threads;
+                enough_threads = threads_available >= job->task.min_threads;
 
-            if (!enough_threads) {
-                log_message("Not enough threads for job " << job->task.name << " available: " << threads_available << " min_threads: " << job->task.min_threads);
-            }
-            bool can_use_this_thread_stack = !owned_job || (job->siblings == owned_job->siblings) || job->task.min_threads == 0;
-            if (!can_use_this_thread_stack) {
-                log_message("Cannot run job " << job->task.name << " on this thread.");
-            }
-            bool can_add_worker = (!job->task.serial || (job->active_workers == 0));
-            if (!can_add_worker) {
-                log_message("Cannot add worker to job " << job->task.name);
-            }
+                if (!enough_threads) {
+                    log_message("Not enough threads for job " << job->task.name << " available: " << threads_available << " min_threads: " << job->task.min_threads);
+                }
+                bool can_use_this_thread_stack = !owned_job || (job->siblings == owned_job->siblings) || job->task.min_threads == 0;
+                if (!can_use_this_thread_stack) {
+                    log_message("Cannot run job " << job->task.name << " on this thread.");
+                }
+                bool can_add_worker = (!job->task.serial || (job->active_workers == 0));
+                if (!can_add_worker) {
+                    log_message("Cannot add worker to job " << job->task.name);
+                }
 
-            if (enough_threads && can_use_this_thread_stack && can_add_worker) {
-                if (job->make_runnable()) {
-                    break;
-                } else {
-                    log_message("Cannot acquire semaphores for " << job->task.name);
+                bool is_local = !local_jobs_only || job->node == node;
+
+                if (enough_threads && can_use_this_thread_stack && can_add_worker && is_local) {
+                    if (job->make_runnable()) {
+                        break;
+                    } else {
+                        log_message("Cannot acquire semaphores for " << job->task.name);
+                    }
                 }
+                prev_ptr = &(job->next_job);
+                job = job->next_job;
             }
-            prev_ptr = &(job->next_job);
-            job = job->next_job;
+            if (job || !local_jobs_only) {
+                break;
+            }
+            local_jobs_only = false;
+            job = work_queue.jobs;
+            prev_ptr = &work_queue.jobs;
+        }
+
+        // If there's nothing on the stack, help out with some other
+        // thread's claimed iterations instead.
+        stealable_range range;
+        range.job = nullptr;
+        if (!job) {
+            job = steal_range_already_locked(&range, node);
         }
 
         if (!job) {
@@ -379,7 +571,9 @@ WEAK void worker_thread_already_locked(work *owned_job) {
 
         int result = halide_error_code_success;
 
-        if (job->task.serial) {
+        if (range.job) {
+            result = run_range_already_locked(&range);
+        } else if (job->task.serial) {
             // Remove it from the stack while we work on it
             *prev_ptr = job->next_job;
 
@@ -416,6 +610,27 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                 job->next_job = work_queue.jobs;
                 work_queue.jobs = job;
             }
+        } else if (job->can_split()) {
+            // Claim our share of the remaining iterations. Threads that
+            // run out of work will steal some of them back if we fall
+            // behind.
+            int iters = job->task.extent / (work_queue.threads_created + 1);
+            if (iters < 1) {
+                iters = 1;
+            }
+            range.job = job;
+            range.next = job->task.min;
+            range.end = job->task.min + iters;
+            job->task.min += iters;
+            job->task.extent -= iters;
+
+            // If there were no more tasks pending for this job, remove it
+            // from the stack.
+            if (job->task.extent == 0) {
+                *prev_ptr = job->next_job;
+            }
+
+            result = run_range_already_locked(&range);
         } else {
             // Claim a task from it.
             work myjob = *job;
@@ -488,10 +703,27 @@ WEAK void worker_thread(void *arg) {
     halide_mutex_unlock(&work_queue.mutex);
 }
 
+WEAK void pinned_worker_thread(void *arg) {
+    halide_pin_current_thread((int)(intptr_t)arg);
+    worker_thread(nullptr);
+}
+
 WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_parent) {
     if (!work_queue.initialized) {
         work_queue.assert_zeroed();
 
+        if (!work_queue.desired_thread_affinity) {
+            work_queue.desired_thread_affinity = default_thread_affinity() ? 2 : 1;
+        }
+        if (work_queue.desired_thread_affinity == 2) {
+            work_queue.num_cpus = halide_host_cpu_topology(work_queue.cpus, work_queue.cpu_nodes, MAX_THREADS);
+            for (int i = 0; i < work_queue.num_cpus; i++) {
+                if (work_queue.cpu_nodes[i] >= work_queue.num_nodes) {
+                    work_queue.num_nodes = work_queue.cpu_nodes[i] + 1;
+                }
+            }
+        }
+
         // Compute the desired number of threads to use. Other code
         // can also mess with this value, but only when the work queue
         // is locked.
@@ -558,8 +790,15 @@ WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_paren
             // We might need to make some new threads, if work_queue.desired_threads_working has
             // increased, or if there aren't enough threads to complete this new task.
             work_queue.a_team_size++;
-            work_queue.threads[work_queue.threads_created++] =
-                halide_spawn_thread(worker_thread, nullptr);
+            if (work_queue.num_cpus > 0) {
+                // Leave the first CPU for the calling thread.
+                int cpu = work_queue.cpus[(work_queue.threads_created + 1) % work_queue.num_cpus];
+                work_queue.threads[work_queue.threads_created++] =
+                    halide_spawn_thread(pinned_worker_thread, (void *)(intptr_t)cpu);
+            } else {
+                work_queue.threads[work_queue.threads_created++] =
+                    halide_spawn_thread(worker_thread, nullptr);
+            }
         }
         log_message("enqueue_work_already_locked top level job " << jobs[0].task.name << " with min_threads " << min_threads << " work_queue.threads_created " << work_queue.threads_created << " work_queue.threads_reserved " << work_queue.threads_reserved);
         if (job_has_acquires || job_may_block) {
@@ -575,8 +814,11 @@ WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_paren
         }
     }
 
+    const int node = current_numa_node();
+
     // Push the jobs onto the stack.
     for (int i = num_jobs - 1; i >= 0; i--) {
+        jobs[i].node = node;
         // We could bubble it downwards based on some heuristics, but
         // it's not strictly necessary to do so.
         jobs[i].next_job = work_queue.jobs;
@@ -738,6 +980,27 @@ WEAK int halide_set_num_threads(int n) {
     return old;
 }
 
+WEAK bool halide_set_thread_affinity(bool enabled) {
+    halide_mutex_lock(&work_queue.mutex);
+    if (!work_queue.desired_thread_affinity) {
+        work_queue.desired_thread_affinity = default_thread_affinity() ? 2 : 1;
+    }
+    bool old = work_queue.desired_thread_affinity == 2;
+    work_queue.desired_thread_affinity = enabled ? 2 : 1;
+    halide_mutex_unlock(&work_queue.mutex);
+    return old;
+}
+
+WEAK bool halide_get_thread_affinity() {
+    halide_mutex_lock(&work_queue.mutex);
+    if (!work_queue.desired_thread_affinity) {
+        work_queue.desired_thread_affinity = default_thread_affinity() ? 2 : 1;
+    }
+    bool enabled = work_queue.desired_thread_affinity == 2;
+    halide_mutex_unlock(&work_queue.mutex);
+    return enabled;
+}
+
 WEAK int halide_get_num_threads() {
     halide_mutex_lock(&work_queue.mutex);
     int n = work_queue.desired_threads_working;
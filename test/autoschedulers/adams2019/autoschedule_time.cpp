@@ -0,0 +1,68 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long Adams2019 takes to schedule a pipeline, for a few beam
+// sizes. Most of that time goes on featurizing states and running the
+// cost model on them. The output is designed to be copy-pasted into a
+// spreadsheet, not read by a human.
+
+namespace {
+
+Pipeline make_pipeline(int stages) {
+    ImageParam input(Float(32), 2, "input");
+    Var x("x"), y("y");
+    Func prev = BoundaryConditions::repeat_edge(input);
+    for (int i = 0; i < stages; i++) {
+        Func f("stage_" + std::to_string(i));
+        if (i % 3 == 2) {
+            RDom r(0, 5);
+            f(x, y) = 0.f;
+            f(x, y) += prev(x + r - 2, y) * (i + 1);
+        } else {
+            f(x, y) = prev(x - 1, y) + prev(x + 1, y + (i % 2)) * 2 + prev(x, y - 1);
+        }
+        prev = f;
+    }
+    prev.set_estimates({{0, 1536}, {0, 2560}});
+    input.set_estimates({{0, 1536}, {0, 2560}});
+    return Pipeline(prev);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <autoscheduler-lib> <weights-path>\n", argv[0]);
+        return 1;
+    }
+
+    load_plugin(argv[1]);
+
+    // Use a fixed target so that the schedules searched are the same everywhere.
+    Target target("x86-64-linux-sse41-avx-avx2");
+
+    printf("stages beam_size seconds\n");
+    for (int stages : {8, 16}) {
+        for (int beam_size : {1, 8, 32}) {
+            AutoschedulerParams params("Adams2019",
+                                       {{"parallelism", "32"},
+                                        {"beam_size", std::to_string(beam_size)},
+                                        {"random_dropout_seed", "1"},
+                                        {"weights_path", argv[2]}});
+            Pipeline p = make_pipeline(stages);
+            double t = benchmark(1, 1, [&]() {
+                p.apply_autoscheduler(target, params);
+            });
+            printf("%d %d %g\n", stages, beam_size, t);
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include "Halide.h"
+
+namespace {
+
+using namespace Halide;
+
+// A small pipeline to check that adams2019_autotune can build, benchmark
+// and retrain on the schedules of a Generator linked with it.
+class AutotuneSmoke : public Generator<AutotuneSmoke> {
+public:
+    Input<Buffer<float, 2>> input{"input"};
+    Input<float> scale{"scale"};
+    Output<Buffer<float, 2>> output{"output"};
+
+    void generate() {
+        Var x("x"), y("y");
+        Func blur_x("blur_x");
+        blur_x(x, y) = (input(x - 1, y) + input(x, y) + input(x + 1, y)) * scale;
+        output(x, y) = blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1);
+
+        input.set_estimates({{0, 256}, {0, 256}});
+        scale.set_estimate(1.0f / 9);
+        output.set_estimates({{1, 254}, {1, 254}});
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(AutotuneSmoke, autotune_smoke)
@@ -1,6 +1,8 @@
 #include "Halide.h"
-#include <cstdlib>   // setenv (or Windows _putenv_s)
-#include <iostream>  // std::cerr / std::endl
+#include <cstdlib>     // setenv (or Windows _putenv_s)
+#include <filesystem>  // std::filesystem::remove_all
+#include <fstream>     // std::fstream
+#include <iostream>    // std::cerr / std::endl
 #include <map>       // std::map
 #include <string>    // std::to_string
 
@@ -56,6 +58,131 @@ bool test_caching(Pipeline &p1, Pipeline &p2, const Target &target) {
     return true;
 }
 
+bool test_search_threads(Pipeline &p1, Pipeline &p2, const Target &target) {
+    constexpr int parallelism = 32;
+    int seed = (int)time(nullptr);
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", std::to_string(parallelism)},
+            {"random_dropout", "50"},
+            {"random_dropout_seed", std::to_string(seed)},
+            {"weights_path", weights_path},
+            {"beam_size", "8"},
+        });
+
+    // The search runs on one thread unless told otherwise.
+    auto results_one_thread = p1.apply_autoscheduler(target, params);
+
+    params.extra["search_threads"] = "4";
+    auto results_four_threads = p2.apply_autoscheduler(target, params);
+
+    // The search must find the same schedule however many threads it uses.
+    // The schedule sources name the Funcs of each pipeline, which differ,
+    // so compare the featurizations.
+    return results_one_thread.featurization == results_four_threads.featurization;
+}
+
+bool test_schedule_database(Pipeline &p1, Pipeline &p2, Pipeline &p3, Pipeline &p4, const Target &target) {
+    constexpr int parallelism = 32;
+    const std::string database = Internal::dir_make_temp();
+    // Use a copy of the weights, so that they can be retrained in place.
+    const std::string weights_dir = Internal::dir_make_temp();
+    const std::string weights = weights_dir + "/retrained.weights";
+    std::filesystem::copy_file(weights_path, weights);
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", std::to_string(parallelism)},
+            {"weights_path", weights},
+            {"beam_size", "8"},
+            {"schedule_database", database},
+        });
+
+    const auto count_entries = [&]() {
+        int n = 0;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(database)) {
+            n += entry.is_regular_file();
+        }
+        return n;
+    };
+
+    // The generated schedule source says how the database lookup went.
+    const auto database_result = [](const AutoSchedulerResults &results) {
+        const std::string prefix = "// Schedule database: ";
+        const std::string &source = results.schedule_source;
+        if (source.compare(0, prefix.size(), prefix) != 0) {
+            return std::string();
+        }
+        return source.substr(prefix.size(), source.find('\n') - prefix.size());
+    };
+
+    auto results_searched = p1.apply_autoscheduler(target, params);
+
+    // The same pipeline again must get the schedule stored in the database.
+    auto results_stored = p2.apply_autoscheduler(target, params);
+    const int entries_before_retraining = count_entries();
+
+    // Changing the weights at the same path must not replay the schedule
+    // found with the old ones, but may warm-start the search with it.
+    {
+        std::fstream f(weights, std::ios::in | std::ios::out | std::ios::binary);
+        float w;
+        f.seekg(-(std::streamoff)sizeof(w), std::ios::end);
+        f.read((char *)&w, sizeof(w));
+        w += 0.01f;
+        f.seekp(-(std::streamoff)sizeof(w), std::ios::end);
+        f.write((const char *)&w, sizeof(w));
+    }
+    auto results_retrained = p3.apply_autoscheduler(target, params);
+    const int entries_after_retraining = count_entries();
+
+    // Different estimates only warm-start the search.
+    auto results_warm_started = p4.apply_autoscheduler(target, params);
+    const int entries_at_end = count_entries();
+
+    std::filesystem::remove_all(database);
+    std::filesystem::remove_all(weights_dir);
+
+    // The schedule sources name the Funcs of each pipeline, which differ,
+    // so compare the featurizations instead.
+    const std::string searched = database_result(results_searched);
+    const std::string stored = database_result(results_stored);
+    const std::string retrained = database_result(results_retrained);
+    const std::string warm_started = database_result(results_warm_started);
+    if (searched != "miss" || stored != "hit" || retrained != "near-miss" || warm_started != "near-miss") {
+        std::cerr << "Expected the database lookups to be a miss, a hit and two near-misses, got: "
+                  << searched << ", " << stored << ", " << retrained << ", " << warm_started << std::endl;
+        return false;
+    }
+    return results_searched.featurization == results_stored.featurization &&
+           entries_before_retraining == 1 &&
+           entries_after_retraining == 2 &&
+           entries_at_end == 3;
+}
+
+bool test_rfactor(Pipeline &p1, Pipeline &p2, const Target &target) {
+    constexpr int parallelism = 32;
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", std::to_string(parallelism)},
+            {"weights_path", weights_path},
+            {"beam_size", "4"},
+        });
+
+    auto results_rfactored = p1.apply_autoscheduler(target, params);
+
+    params.extra["disable_rfactor"] = "1";
+    auto results_serial = p2.apply_autoscheduler(target, params);
+
+    // The rfactored schedule must also be one that Halide can compile.
+    p1.compile_to_module(p1.infer_arguments(), "rfactored", target);
+
+    return results_rfactored.schedule_source.find(".rfactor(") != std::string::npos &&
+           results_serial.schedule_source.find(".rfactor(") == std::string::npos;
+}
+
 int main(int argc, char **argv) {
     if (argc != 3 || !strlen(argv[1]) || !strlen(argv[2])) {
         fprintf(stderr, "Usage: %s <autoscheduler-lib> <weights-path>\n", argv[0]);
@@ -903,6 +1030,99 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (true) {
+        Pipeline p1;
+        Pipeline p2;
+        for (int test_condition = 0; test_condition < 2; test_condition++) {
+            // A stencil chain with a reduction in it, with plenty of
+            // states to expand at each step of the search
+            const int N = 6;
+            Func f[N];
+            f[0](x, y) = x + y;
+            for (int i = 1; i < N; i++) {
+                if (i % 3 == 0) {
+                    RDom r(0, 5);
+                    f[i](x, y) += f[i - 1](x + r - 2, y);
+                } else {
+                    f[i](x, y) = f[i - 1](x - 1, y) + 2 * f[i - 1](x, y + 1) + f[i - 1](x + 1, y);
+                }
+            }
+
+            f[N - 1].set_estimate(x, 0, 2048).set_estimate(y, 0, 2048);
+
+            if (test_condition) {
+                p2 = Pipeline(f[N - 1]);
+            } else {
+                p1 = Pipeline(f[N - 1]);
+            }
+        }
+
+        if (!test_search_threads(p1, p2, target)) {
+            std::cerr << "Search threads check failed on stencil chain with a reduction" << std::endl;
+            return 1;
+        }
+    }
+
+    if (true) {
+        Pipeline p[4];
+        for (int test_condition = 0; test_condition < 4; test_condition++) {
+            // A stencil chain with a reduction in it, scheduled three times
+            // with the same estimates and once with different ones. The
+            // database key has the names of the reduction variables in it,
+            // so each copy gets the same ones.
+            const int N = 6;
+            Func f[N];
+            f[0](x, y) = x + y;
+            for (int i = 1; i < N; i++) {
+                if (i % 3 == 0) {
+                    RDom r(0, 5, "r");
+                    f[i](x, y) += f[i - 1](x + r - 2, y);
+                } else {
+                    f[i](x, y) = f[i - 1](x - 1, y) + 2 * f[i - 1](x, y + 1) + f[i - 1](x + 1, y);
+                }
+            }
+
+            const int size = test_condition < 3 ? 2048 : 1024;
+            f[N - 1].set_estimate(x, 0, size).set_estimate(y, 0, size);
+
+            p[test_condition] = Pipeline(f[N - 1]);
+        }
+
+        if (!test_schedule_database(p[0], p[1], p[2], p[3], target)) {
+            std::cerr << "Schedule database check failed on stencil chain with a reduction" << std::endl;
+            return 1;
+        }
+    }
+
+    if (true) {
+        Pipeline p1;
+        Pipeline p2;
+        for (int test_condition = 0; test_condition < 2; test_condition++) {
+            // A per-channel sum over a whole image, which can only use
+            // more than three cores if it's rfactored.
+            ImageParam im(Float(32), 3);
+            Var c("c");
+
+            RDom r(0, 2000, 0, 2000);
+            Func sum("sum");
+            sum(c) = 0.0f;
+            sum(c) += im(r.x, r.y, c);
+
+            sum.set_estimate(c, 0, 3);
+
+            if (test_condition) {
+                p2 = Pipeline(sum);
+            } else {
+                p1 = Pipeline(sum);
+            }
+        }
+
+        if (!test_rfactor(p1, p2, target)) {
+            std::cerr << "Rfactor check failed on per-channel sum" << std::endl;
+            return 1;
+        }
+    }
+
     std::cout << "adams2019 testing passed\n";
     return 0;
 }
@@ -0,0 +1,137 @@
+#include "Halide.h"
+#include "get_autoscheduler_params.hpp"
+#include "halide_benchmark.h"
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// A per-channel sum over a whole image. Its pure domain is too small to
+// keep more than three cores busy, so the autoscheduler should rfactor it.
+double run_test(bool auto_schedule, const Buffer<int32_t> &in, Buffer<int32_t> &out) {
+    Var c("c");
+    RDom r(0, in.width(), 0, in.height());
+    Func sum("sum");
+    sum(c) = 0;
+    sum(c) += in(r.x, r.y, c);
+
+    Target target = get_jit_target_from_environment();
+    Pipeline p(sum);
+
+    if (auto_schedule) {
+        // Provide estimates on the pipeline output
+        sum.set_estimates({{0, 3}});
+        // Auto-schedule the pipeline
+        std::string schedule = p.apply_autoscheduler(target, get_mullapudi2016_test_params(target.has_gpu_feature())).schedule_source;
+        if (!target.has_gpu_feature() && schedule.find(".rfactor(") == std::string::npos) {
+            std::cerr << "The autoscheduler didn't rfactor the sum:\n"
+                      << schedule;
+            exit(1);
+        }
+    } else {
+        RVar ryo("ryo"), ryi("ryi");
+        Var u("u");
+        Func intm = sum.update().split(r.y, ryo, ryi, 64).rfactor(ryo, u);
+        intm.compute_root().update().parallel(u);
+    }
+
+    double t = benchmark(3, 10, [&]() {
+        p.realize(out);
+    });
+
+    return t * 1000;
+}
+
+// Two reductions into the same Func. Only one of them may be rfactored, as
+// the intermediates of both would get the same name.
+bool test_two_updates(const Buffer<int32_t> &in) {
+    Var c("c");
+    RDom r(0, in.width(), 0, in.height());
+    RDom s(0, in.width() / 2, 0, in.height() / 2);
+    Func sum("sum");
+    sum(c) = 0;
+    sum(c) += in(r.x, r.y, c);
+    sum(c) += in(2 * s.x, 2 * s.y, c) * 2;
+
+    Target target = get_jit_target_from_environment();
+    Pipeline p(sum);
+    sum.set_estimates({{0, 3}});
+    std::string schedule = p.apply_autoscheduler(target, get_mullapudi2016_test_params(target.has_gpu_feature())).schedule_source;
+    size_t rfactors = 0;
+    for (size_t i = schedule.find(".rfactor("); i != std::string::npos; i = schedule.find(".rfactor(", i + 1)) {
+        rfactors++;
+    }
+    if (!target.has_gpu_feature() && rfactors != 1) {
+        std::cerr << "Expected the autoscheduler to rfactor one update, not " << rfactors << ":\n"
+                  << schedule;
+        return false;
+    }
+
+    Buffer<int32_t> out = p.realize({3});
+    for (int ch = 0; ch < 3; ch++) {
+        int32_t correct = 0;
+        for (int y = 0; y < in.height(); y++) {
+            for (int x = 0; x < in.width(); x++) {
+                correct += in(x, y, ch);
+                if (x % 2 == 0 && y % 2 == 0) {
+                    correct += in(x, y, ch) * 2;
+                }
+            }
+        }
+        if (out(ch) != correct) {
+            printf("sum(%d) = %d instead of %d with two updates\n", ch, out(ch), correct);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] Autoschedulers do not support WebAssembly.\n");
+        return 0;
+    }
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <autoscheduler-lib>\n", argv[0]);
+        return 1;
+    }
+
+    load_plugin(argv[1]);
+
+    Buffer<int32_t> in(2048, 2048, 3);
+    for (int c = 0; c < in.channels(); c++) {
+        for (int y = 0; y < in.height(); y++) {
+            for (int x = 0; x < in.width(); x++) {
+                in(x, y, c) = rand() & 0xff;
+            }
+        }
+    }
+
+    Buffer<int32_t> manual_out(3), auto_out(3);
+    double manual_time = run_test(false, in, manual_out);
+    double auto_time = run_test(true, in, auto_out);
+
+    for (int c = 0; c < 3; c++) {
+        if (manual_out(c) != auto_out(c)) {
+            printf("sum(%d) = %d instead of %d\n", c, auto_out(c), manual_out(c));
+            return 1;
+        }
+    }
+
+    if (!test_two_updates(in)) {
+        return 1;
+    }
+
+    const double slowdown_factor = 10.0;
+    if (!get_jit_target_from_environment().has_gpu_feature() && auto_time > manual_time * slowdown_factor) {
+        std::cerr << "Autoscheduler time is slower than expected:\n"
+                  << "======================\n"
+                  << "Manual time: " << manual_time << "ms\n"
+                  << "Auto time: " << auto_time << "ms\n"
+                  << "======================\n";
+        exit(1);
+    }
+
+    printf("Success!\n");
+    return 0;
+}
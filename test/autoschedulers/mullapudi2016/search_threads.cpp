@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include "get_autoscheduler_params.hpp"
+
+using namespace Halide;
+
+// A chain of stencils and downsamples with a reduction every few stages,
+// with plenty of grouping choices to evaluate in each round.
+Pipeline make_pipeline() {
+    ImageParam input(Float(32), 2, "input");
+    Var x("x"), y("y");
+
+    std::vector<Func> stages{BoundaryConditions::repeat_edge(input)};
+    for (int i = 0; i < 24; i++) {
+        Func f("stage_" + std::to_string(i));
+        Func a = stages.back();
+        Func b = stages[stages.size() > 3 ? stages.size() - 3 : 0];
+        if (i % 7 == 3) {
+            RDom r(0, 3);
+            f(x, y) = 0.f;
+            f(x, y) += a(x + r - 1, y) * (i + 1);
+        } else if (i % 5 == 2) {
+            f(x, y) = a(x / 2, y / 2) + b(x, y);
+        } else {
+            f(x, y) = a(x - 1, y) + a(x + 1, y + (i % 2)) * 2 + b(x, y - 1);
+        }
+        stages.push_back(f);
+    }
+
+    input.set_estimates({{0, 1536}, {0, 2560}});
+    stages.back().set_estimates({{0, 1536}, {0, 2560}});
+    return Pipeline(stages.back());
+}
+
+int main(int argc, char **argv) {
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] Autoschedulers do not support WebAssembly.\n");
+        return 0;
+    }
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <autoscheduler-lib>\n", argv[0]);
+        return 1;
+    }
+
+    load_plugin(argv[1]);
+
+    Target target = get_jit_target_from_environment();
+    AutoschedulerParams params = get_mullapudi2016_test_params(target.has_gpu_feature());
+
+    // Build and schedule each pipeline with a copy of the same name
+    // counters, so that their Funcs get the same names.
+    const Internal::NameCounters counters = Internal::snapshot_name_counters();
+    const auto schedule = [&]() {
+        Internal::NameCounters c = counters;
+        Internal::ScopedNameCounters scoped_counters(c);
+        Pipeline p = make_pipeline();
+        return p.apply_autoscheduler(target, params).schedule_source;
+    };
+
+    // The grouping must not depend on how many threads evaluate it. By
+    // default, one thread does.
+    const std::string one_thread = schedule();
+    for (const char *threads : {"4", "0"}) {
+        params.extra["search_threads"] = threads;
+        const std::string more_threads = schedule();
+        if (one_thread != more_threads) {
+            printf("Schedule with one thread:\n%s\nSchedule with search_threads=%s:\n%s\n",
+                   one_thread.c_str(), threads, more_threads.c_str());
+            return 1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include "Halide.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+using namespace Halide;
+
+// Checks that an AsyncCallable forwards calls to its fallback until the
+// compiled code is ready and to the compiled code from then on, that
+// compile errors are reported through it, and that it can be destroyed
+// while it is compiling.
+
+namespace {
+
+constexpr int size = 8;
+constexpr int compiled_offset = 1000;
+
+// Holds up the background compile at a warning that lowering the compiled
+// pipeline issues, so that calls can be made while it is still compiling.
+class CompileGate : public CompileTimeErrorReporter {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool open = false;
+    int waiting = 0;
+
+public:
+    void warning(const char *msg) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiting++;
+        cv.notify_all();
+        cv.wait(lock, [&]() { return open; });
+    }
+
+    void error(const char *msg) override {
+        fprintf(stderr, "%s", msg);
+        abort();
+    }
+
+    // Wait until the background compile is held up at the gate.
+    void wait_for_compile() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return waiting > 0; });
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+        cv.notify_all();
+    }
+};
+
+// The fallback computes x + p. The compiled pipeline computes
+// x + p + compiled_offset, so calls show which one they went to. It also
+// splits an inlined Func, which lowering warns about.
+Func make_pipeline(const Param<int> &p, bool compiled) {
+    Var x("x"), xo("xo"), xi("xi");
+    Func helper("helper"), out("out");
+    helper(x) = x + p;
+    if (compiled) {
+        helper.split(x, xo, xi, 4);
+        out(x) = helper(x) + compiled_offset;
+    } else {
+        out(x) = helper(x);
+    }
+    return out;
+}
+
+enum class Result { Fallback,
+                    Compiled,
+                    Failed };
+
+Result call(const AsyncCallable &h, int p) {
+    Buffer<int> out(size);
+    if (h(p, out) != 0) {
+        return Result::Failed;
+    }
+    if (out(3) == 3 + p) {
+        return Result::Fallback;
+    } else if (out(3) == 3 + p + compiled_offset) {
+        return Result::Compiled;
+    }
+    return Result::Failed;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const Target target = get_jit_target_from_environment();
+    Param<int> p("p");
+    const Callable fallback = make_pipeline(p, false).compile_to_callable({p}, target);
+
+    // Calls made while compiling go to the fallback. Once compilation is
+    // done, every call on every thread switches to the compiled code, and
+    // never goes back.
+    {
+        CompileGate gate;
+        set_custom_compile_time_error_reporter(&gate);
+        AsyncCallable h = make_pipeline(p, true).compile_to_callable_async({p}, fallback, target);
+        gate.wait_for_compile();
+
+        for (int i = 0; i < 10; i++) {
+            if (h.ready() || call(h, i) != Result::Fallback) {
+                printf("A call made while compiling didn't go to the fallback\n");
+                return 1;
+            }
+        }
+
+        constexpr int num_threads = 8;
+        std::atomic<bool> ok{true};
+        std::atomic<int> fallback_calls{0};
+        std::vector<std::thread> callers;
+        for (int t = 0; t < num_threads; t++) {
+            callers.emplace_back([&, t]() {
+                bool switched = false;
+                // Keep calling until the compiled code has been called a
+                // few times.
+                for (int compiled_calls = 0, i = 0; compiled_calls < 100; i++) {
+                    const bool was_ready = h.ready();
+                    Result r = call(h, t * 100000 + i);
+                    if (r == Result::Failed) {
+                        printf("A call failed on thread %d\n", t);
+                        ok = false;
+                        return;
+                    } else if (r == Result::Fallback) {
+                        if (switched || was_ready) {
+                            printf("A call went to the fallback after the compiled code was ready\n");
+                            ok = false;
+                            return;
+                        }
+                        fallback_calls++;
+                    } else {
+                        if (!h.ready()) {
+                            printf("A call went to the compiled code before it was ready\n");
+                            ok = false;
+                            return;
+                        }
+                        switched = true;
+                        compiled_calls++;
+                    }
+                }
+            });
+        }
+
+        gate.release();
+        for (auto &t : callers) {
+            t.join();
+        }
+        set_custom_compile_time_error_reporter(nullptr);
+        if (!ok) {
+            return 1;
+        }
+
+        Buffer<int> out(size);
+        if (h.get()(5, out) != 0 || out(3) != 3 + 5 + compiled_offset) {
+            printf("The compiled Callable computed the wrong thing\n");
+            return 1;
+        }
+        printf("%d calls went to the fallback while compiling\n", (int)fallback_calls);
+    }
+
+    // Without a fallback, calls wait for compilation.
+    {
+        AsyncCallable h = make_pipeline(p, true).compile_to_callable_async({p}, Callable(), target);
+        if (call(h, 7) != Result::Compiled || !h.ready()) {
+            printf("A call without a fallback didn't wait for compilation\n");
+            return 1;
+        }
+    }
+
+    // Destroying the handle, and the pipeline it was made from, while it is
+    // compiling is safe. Destroying the last handle waits for compilation,
+    // so do it on another thread and let the compile finish.
+    {
+        CompileGate gate;
+        set_custom_compile_time_error_reporter(&gate);
+        std::unique_ptr<AsyncCallable> h;
+        {
+            Func out = make_pipeline(p, true);
+            h = std::make_unique<AsyncCallable>(out.compile_to_callable_async({p}, fallback, target));
+        }
+        gate.wait_for_compile();
+        std::thread destroyer([&]() {
+            h.reset();
+        });
+        gate.release();
+        destroyer.join();
+        set_custom_compile_time_error_reporter(nullptr);
+
+        // Dropping a handle right away is safe too.
+        make_pipeline(p, true).compile_to_callable_async({p}, fallback, target);
+    }
+
+#ifdef HALIDE_WITH_EXCEPTIONS
+    // A compile error is reported through the handle. Calls keep going to
+    // the fallback, if there is one.
+    if (exceptions_enabled()) {
+        Param<int> missing("missing");
+        Var x("x");
+        Func bad("bad");
+        bad(x) = x + p + missing;
+
+        AsyncCallable h = bad.compile_to_callable_async({p}, fallback, target);
+        bool threw = false;
+        try {
+            h.get();
+        } catch (const CompileError &) {
+            threw = true;
+        }
+        if (!threw) {
+            printf("Compiling a pipeline with a missing argument didn't fail\n");
+            return 1;
+        }
+        if (!h.ready() || call(h, 7) != Result::Fallback) {
+            printf("A call after a failed compile didn't go to the fallback\n");
+            return 1;
+        }
+
+        AsyncCallable no_fallback = bad.compile_to_callable_async({p}, Callable(), target);
+        threw = false;
+        try {
+            call(no_fallback, 7);
+        } catch (const CompileError &) {
+            threw = true;
+        }
+        if (!threw) {
+            printf("A call without a fallback didn't report the compile error\n");
+            return 1;
+        }
+    }
+#endif
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "Halide.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+
+using namespace Halide;
+
+// Checks that one Callable can be called from many threads at once, through
+// operator() and through std::functions made on each thread, while other
+// threads change the default handlers and compile other pipelines. Calls
+// must get the right results, and failing calls must reach the error
+// handler of their own JITUserContext. This is intended to also be run in
+// a thread-sanitizer.
+
+namespace {
+
+constexpr int size = 16;
+
+std::atomic<int> errors{0};
+
+void count_error(JITUserContext *, const char *) {
+    errors++;
+}
+
+void quiet_print(JITUserContext *, const char *) {
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const Target target = get_jit_target_from_environment();
+    // Wasm JIT is substantially slower than others,
+    // so do fewer iterations to avoid timing out.
+    const int iters = target.arch == Target::WebAssembly ? 64 : 1000;
+    constexpr int num_threads = 8;
+
+    ImageParam in(Int(32), 1, "in");
+    Param<int32_t> p("p");
+    Var x("x");
+    Func f("f");
+    f(x) = in(x) * p + x;
+
+    Callable c = f.compile_to_callable({in, p}, target);
+
+    std::atomic<bool> done{false}, ok{true};
+    std::atomic<int> failed_calls{0};
+
+    std::vector<std::thread> callers;
+    for (int t = 0; t < num_threads; t++) {
+        callers.emplace_back([&, t]() {
+            // Made on every thread at once, from the same Callable.
+            auto fn = c.make_std_function<Buffer<int32_t, 1>, int32_t, Buffer<int32_t, 1>>();
+
+            Buffer<int32_t, 1> input(size), output(size), too_small(size / 2);
+            input.for_each_element([&](int i) { input(i) = i + t; });
+
+            JITUserContext context;
+            context.handlers.custom_error = count_error;
+
+            for (int i = 0; i < iters; i++) {
+                const int32_t param = t * iters + i;
+                int result;
+                if (i % 10 == 9) {
+                    // The input is too small, so the call fails.
+                    result = c(&context, too_small, param, output);
+                    if (result == 0) {
+                        printf("A call with a too-small input succeeded on thread %d\n", t);
+                        ok = false;
+                        return;
+                    }
+                    failed_calls++;
+                    continue;
+                }
+                result = (i % 2) ? fn(input, param, output) : c(input, param, output);
+                if (result != 0) {
+                    printf("Call %d failed on thread %d\n", i, t);
+                    ok = false;
+                    return;
+                }
+                for (int j = 0; j < size; j++) {
+                    const int correct = (j + t) * param + j;
+                    if (output(j) != correct) {
+                        printf("output(%d) = %d instead of %d on thread %d\n", j, output(j), correct, t);
+                        ok = false;
+                        return;
+                    }
+                }
+            }
+        });
+    }
+
+    // Meanwhile, change the default handlers and compile and run other
+    // pipelines.
+    std::thread other([&]() {
+        int n = 0;
+        while (!done) {
+            JITHandlers handlers;
+            handlers.custom_print = (n % 2) ? quiet_print : nullptr;
+            Internal::JITSharedRuntime::set_default_handlers(handlers);
+
+            Func g;
+            g(x) = x + n;
+            Buffer<int> out = g.realize({size});
+            if (out(3) != 3 + n) {
+                printf("A pipeline compiled alongside the calls computed %d instead of %d\n", out(3), 3 + n);
+                ok = false;
+            }
+            n++;
+        }
+        Internal::JITSharedRuntime::set_default_handlers(JITHandlers());
+    });
+
+    for (auto &t : callers) {
+        t.join();
+    }
+    done = true;
+    other.join();
+
+    if (!ok) {
+        return 1;
+    }
+    if (errors != failed_calls) {
+        printf("%d failed calls reached their error handler %d times\n", (int)failed_calls, (int)errors);
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "Halide.h"
+#include "halide_test_dirs.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+using namespace Halide;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int generate_calls = 0;
+
+class CacheTest : public Generator<CacheTest> {
+public:
+    GeneratorParam<int> offset{"offset", 1};
+
+    Input<Buffer<int, 1>> input{"input"};
+    Output<Buffer<int, 1>> output{"output"};
+
+    void generate() {
+        generate_calls++;
+        Var x;
+        output(x) = input(x) + offset;
+    }
+};
+
+std::string read_file(const fs::path &path) {
+    std::ifstream f(path, std::ios::binary);
+    std::ostringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+// The contents of every file in a directory, by name.
+std::map<std::string, std::string> read_files(const fs::path &dir) {
+    std::map<std::string, std::string> files;
+    for (const auto &e : fs::directory_iterator(dir)) {
+        files[e.path().filename().string()] = read_file(e.path());
+    }
+    return files;
+}
+
+size_t count_entries(const fs::path &dir) {
+    size_t n = 0;
+    for (const auto &e : fs::directory_iterator(dir)) {
+        (void)e;
+        n++;
+    }
+    return n;
+}
+
+// Run the Generator with the given offset into a fresh output directory,
+// and return the files it produced. Checks that generate() ran exactly once:
+// on a miss, the Pipeline built for the key must be the one that's compiled.
+std::map<std::string, std::string> run(const fs::path &cache_dir, const fs::path &output_dir, int offset) {
+    fs::remove_all(output_dir);
+    fs::create_directories(output_dir);
+
+    Internal::ExecuteGeneratorArgs args;
+    args.output_dir = output_dir.string();
+    args.output_types = {OutputFileType::c_header, OutputFileType::static_library};
+    args.targets = {get_target_from_environment()};
+    args.generator_name = "CacheTest";
+    args.create_generator = [](const std::string &, const GeneratorContext &context) -> Internal::AbstractGeneratorPtr {
+        return CacheTest::create(context);
+    };
+    args.generator_params = {{"offset", std::to_string(offset)}};
+    args.cache_dir = cache_dir.string();
+
+    generate_calls = 0;
+    Internal::execute_generator(args);
+    if (generate_calls != 1) {
+        printf("generate() ran %d times instead of once\n", generate_calls);
+        exit(1);
+    }
+    return read_files(output_dir);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const fs::path dir = fs::path(Internal::get_test_tmp_dir()) / "generator_cache";
+    const fs::path cache_dir = dir / "cache";
+    fs::remove_all(dir);
+    fs::create_directories(cache_dir);
+
+    const auto first = run(cache_dir, dir / "out1", 1);
+    if (count_entries(cache_dir) == 0) {
+        printf("[SKIP] Halide was built without serialization, so nothing is cached.\n");
+        return 0;
+    }
+    if (count_entries(cache_dir) != 1) {
+        printf("Expected one entry in the cache after the first run, found %d\n", (int)count_entries(cache_dir));
+        return 1;
+    }
+
+    // The same Generator and GeneratorParams are a hit, with the same outputs.
+    const auto second = run(cache_dir, dir / "out2", 1);
+    if (second != first) {
+        printf("The outputs of the second run differ from the first\n");
+        return 1;
+    }
+    if (count_entries(cache_dir) != 1) {
+        printf("The second run added an entry to the cache\n");
+        return 1;
+    }
+
+    // Make sure the outputs really come from the cache, by changing the
+    // entry and checking that the change shows up in the outputs.
+    const fs::path entry = fs::directory_iterator(cache_dir)->path();
+    const fs::path header = entry / "CacheTest.h";
+    if (!fs::exists(header)) {
+        printf("The cache entry %s has no header\n", entry.string().c_str());
+        return 1;
+    }
+    const std::string marker = "// Copied from the cache\n";
+    std::ofstream(header, std::ios::app) << marker;
+    const auto third = run(cache_dir, dir / "out3", 1);
+    if (third.at("CacheTest.h") != first.at("CacheTest.h") + marker) {
+        printf("The third run didn't copy its outputs from the cache\n");
+        return 1;
+    }
+
+    // Changing a GeneratorParam changes the pipeline, so it's a miss.
+    const auto fourth = run(cache_dir, dir / "out4", 2);
+    if (count_entries(cache_dir) != 2) {
+        printf("Expected two entries in the cache after changing a GeneratorParam, found %d\n", (int)count_entries(cache_dir));
+        return 1;
+    }
+    if (fourth == first) {
+        printf("Changing a GeneratorParam didn't change the outputs\n");
+        return 1;
+    }
+
+#ifdef HALIDE_WITH_EXCEPTIONS
+    // A failed compile leaves nothing behind in the cache.
+    if (exceptions_enabled()) {
+        Internal::ExecuteGeneratorArgs args;
+        args.output_dir = (dir / "out5").string();
+        fs::create_directories(args.output_dir);
+        args.output_types = {OutputFileType::static_library};
+        // Multitarget builds require matching arch-bits-os.
+        Target t = get_target_from_environment();
+        Target other = t;
+        other.bits = t.bits == 64 ? 32 : 64;
+        args.targets = {t, other};
+        args.generator_name = "CacheTest";
+        args.create_generator = [](const std::string &, const GeneratorContext &context) -> Internal::AbstractGeneratorPtr {
+            return CacheTest::create(context);
+        };
+        args.cache_dir = cache_dir.string();
+        bool threw = false;
+        try {
+            Internal::execute_generator(args);
+        } catch (const CompileError &) {
+            threw = true;
+        }
+        if (!threw) {
+            printf("Expected compiling for mismatched targets to fail\n");
+            return 1;
+        }
+        if (count_entries(cache_dir) != 2) {
+            printf("The failed compile left something in the cache\n");
+            return 1;
+        }
+    }
+#endif
+
+    fs::remove_all(dir);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "Halide.h"
+
+#include <set>
+#include <sstream>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Checks that allocating IR nodes from an arena doesn't change what
+// lowering produces, that the arena reuses the memory of nodes freed on its
+// thread, and that nodes from an arena can outlive it and be freed on
+// other threads.
+
+namespace {
+
+// Lower a pipeline from scratch, and return the bodies of the lowered
+// functions as text. The pipeline is built and lowered with a copy of the
+// given name counters, so that each call produces the same names.
+std::string lower_pipeline(NameCounters counters) {
+    ScopedNameCounters scoped_counters(counters);
+    ImageParam input(Float(32), 2, "input");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::mirror_image(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 6; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y + (i % 3) - 1) + prev(x + 1, y) * (i + 1) + prev(x, y - 1)) / (i + 3);
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 32, 32).vectorize(xi, 8).parallel(y);
+    stages[3].compute_root().vectorize(x, 8).parallel(y);
+    stages[1].compute_at(stages[3], x).vectorize(x, 8);
+    stages[4].compute_at(out, x);
+
+    Target t = get_host_target().without_feature(Target::JIT);
+    Module m = out.compile_to_module({input}, "ir_arena", t);
+    std::ostringstream s;
+    for (const auto &f : m.functions()) {
+        s << f.body;
+    }
+    return s.str();
+}
+
+bool in_arena(const Expr &e) {
+    return e.get()->in_ir_arena;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const bool was_enabled = ir_arena_enabled();
+    Expr x = Variable::make(Int(32), "x");
+
+    // Lowering produces the same Stmt with and without an arena, and
+    // when several threads lower at once, each with an arena of its own.
+    {
+        const NameCounters counters = snapshot_name_counters();
+        set_ir_arena_enabled(false);
+        const std::string off = lower_pipeline(counters);
+        set_ir_arena_enabled(true);
+        const std::string on = lower_pipeline(counters);
+        if (on != off) {
+            printf("Lowering with an IR arena changed the lowered Stmt\n");
+            return 1;
+        }
+
+        std::vector<std::string> stmts(4);
+        std::vector<std::thread> workers;
+        for (std::string &s : stmts) {
+            workers.emplace_back([&]() {
+                s = lower_pipeline(counters);
+            });
+        }
+        for (std::thread &t : workers) {
+            t.join();
+        }
+        for (const std::string &s : stmts) {
+            if (s != off) {
+                printf("Lowering on several threads at once changed the lowered Stmt\n");
+                return 1;
+            }
+        }
+    }
+
+    // When arenas are disabled, nodes come from the heap.
+    {
+        set_ir_arena_enabled(false);
+        ScopedIRArena arena;
+        if (in_arena(x + 1)) {
+            printf("A node was allocated from an arena while arenas were disabled\n");
+            return 1;
+        }
+    }
+
+    // The slots of nodes freed on the arena's thread are reused, so making
+    // and freeing nodes over and over doesn't grow the arena.
+    {
+        set_ir_arena_enabled(true);
+        ScopedIRArena arena;
+        std::set<const void *> addresses;
+        for (int i = 0; i < 100000; i++) {
+            Expr e = x + i;
+            if (!in_arena(e)) {
+                printf("A node was not allocated from the arena\n");
+                return 1;
+            }
+            addresses.insert(e.get());
+        }
+        // Each Add is freed before the next one is made, so they all fit in
+        // a handful of slots.
+        if (addresses.size() > 2) {
+            printf("Freed slots were not reused: %d distinct addresses\n", (int)addresses.size());
+            return 1;
+        }
+
+        // A nested ScopedIRArena leaves the outer one in place.
+        {
+            ScopedIRArena inner;
+        }
+        if (!in_arena(x + 1)) {
+            printf("Destroying a nested ScopedIRArena deactivated the outer one\n");
+            return 1;
+        }
+    }
+
+    // Nodes can outlive their arena, and be freed on another thread,
+    // whether the arena is still alive or not.
+    {
+        set_ir_arena_enabled(true);
+        std::vector<Expr> outlived, escaped;
+        {
+            ScopedIRArena arena;
+            for (int i = 0; i < 10000; i++) {
+                outlived.push_back(x * i + (x - i));
+                escaped.push_back(x * i + (x - i));
+            }
+            // Freed on another thread while the arena is alive.
+            std::thread t([escaped = std::move(escaped)]() mutable {
+                for (Expr &e : escaped) {
+                    Expr copy = e;
+                    e = Expr();
+                }
+            });
+            t.join();
+        }
+        set_ir_arena_enabled(false);
+        for (int i = 0; i < 10000; i++) {
+            if (!equal(outlived[i], x * i + (x - i))) {
+                std::cerr << "A node that outlived its arena changed: " << outlived[i] << "\n";
+                return 1;
+            }
+        }
+        // Freed on another thread after the arena is gone.
+        std::thread t([outlived = std::move(outlived)]() mutable {
+            outlived.clear();
+        });
+        t.join();
+    }
+
+    set_ir_arena_enabled(was_enabled);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "Halide.h"
+
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Checks that caching structural hashes in Exprs doesn't change which Exprs
+// compare equal, what CSE makes of them, or what lowering produces.
+
+namespace {
+
+// Exprs of every kind, including some pairs that are equal but were built
+// separately, and some that differ only in a field the hash covers.
+std::vector<Expr> make_exprs() {
+    Expr x = Variable::make(Int(32), "x");
+    Expr y = Variable::make(Int(32), "y");
+    Expr f = Variable::make(Float(32), "f");
+    Expr t = Variable::make(Int(32), "t");
+    Expr ramp = Ramp::make(x, 1, 4);
+    Expr other_ramp = Ramp::make(x, 2, 4);
+    return {
+        x,
+        y,
+        x + y,
+        y + x,
+        x - y,
+        x * y + x * y,
+        min(x, y),
+        max(x, y),
+        x / 3,
+        x % 3,
+        x < y,
+        x <= y,
+        x == y,
+        x != y,
+        (x < y) && (y < 4),
+        (x < y) || (y < 4),
+        !(x < y),
+        select(x < y, x, y),
+        select(x < y, y, x),
+        make_const(Float(32), 0.0),
+        make_const(Float(32), -0.0),
+        make_const(Float(32), NAN),
+        make_const(Float(32), -NAN),
+        make_const(Float(32), 1.5),
+        make_const(Float(64), 1.5),
+        make_const(Int(32), 7),
+        make_const(Int(64), 7),
+        make_const(UInt(32), 7),
+        f * 2.0f,
+        Cast::make(Float(32), x),
+        Cast::make(Float(64), x),
+        Reinterpret::make(UInt(32), x),
+        StringImm::make("hello"),
+        StringImm::make("world"),
+        Broadcast::make(x, 4),
+        Broadcast::make(x, 8),
+        ramp,
+        other_ramp,
+        Shuffle::make_interleave({ramp, other_ramp}),
+        Shuffle::make_concat({ramp, other_ramp}),
+        VectorReduce::make(VectorReduce::Add, ramp, 2),
+        VectorReduce::make(VectorReduce::Min, ramp, 2),
+        Load::make(Int(32), "buf", x, Buffer<>(), Parameter(), const_true(), ModulusRemainder()),
+        Load::make(Int(32), "buf", x, Buffer<>(), Parameter(), const_true(), ModulusRemainder(4, 1)),
+        Load::make(Int(32), "other_buf", x, Buffer<>(), Parameter(), const_true(), ModulusRemainder()),
+        Call::make(Int(32), "g", {x, y}, Call::Extern),
+        Call::make(Int(32), "g", {y, x}, Call::Extern),
+        Call::make(Int(32), "g", {x, y}, Call::PureExtern),
+        Call::make(Int(32), "h", {x, y}, Call::Extern),
+        Let::make("t", x, t + 1),
+        Let::make("t", y, t + 1),
+        Let::make("u", x, t + 1),
+    };
+}
+
+// Build a big Expr with lots of common subexpressions.
+Expr make_redundant_expr() {
+    Expr x = Variable::make(Int(32), "x");
+    Expr y = Variable::make(Int(32), "y");
+    Expr e = x;
+    for (int i = 0; i < 8; i++) {
+        Expr a = min(e + y * i, x - i);
+        Expr b = max(e - y, a * 2);
+        e = select(a < b, a + b, b - a) + (a * b) / (i + 3);
+    }
+    return e;
+}
+
+// Lower a pipeline from scratch, and return the bodies of the lowered
+// functions as text. The pipeline is built and lowered with a copy of the
+// given name counters, so that each call produces the same names.
+std::string lower_pipeline(NameCounters counters) {
+    ScopedNameCounters scoped_counters(counters);
+    ImageParam input(Float(32), 2, "input");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::mirror_image(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 4; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y) + prev(x, y + 1) * (i + 2) + prev(x + 1, y - 1)) / (i + 4);
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 32, 8).vectorize(xi, 8).parallel(y);
+    stages[1].compute_root().vectorize(x, 8);
+    stages[0].compute_at(stages[1], y);
+    stages[2].compute_at(out, x).vectorize(x, 8);
+
+    Target t = get_host_target().without_feature(Target::JIT);
+    Module m = out.compile_to_module({input}, "ir_hash_caching", t);
+    std::ostringstream s;
+    for (const auto &func : m.functions()) {
+        s << func.body;
+    }
+    return s.str();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const bool was_enabled = ir_hash_caching_enabled();
+
+    set_ir_hash_caching(true);
+    const std::vector<Expr> hashed = make_exprs();
+    const std::vector<Expr> hashed_again = make_exprs();
+    set_ir_hash_caching(false);
+    const std::vector<Expr> unhashed = make_exprs();
+
+    for (size_t i = 0; i < unhashed.size(); i++) {
+        if (hashed[i].get()->structural_hash == 0) {
+            std::cerr << "No hash was cached for " << hashed[i] << "\n";
+            return 1;
+        }
+        if (unhashed[i].get()->structural_hash != 0) {
+            std::cerr << "A hash was cached for " << unhashed[i] << " while caching was off\n";
+            return 1;
+        }
+    }
+
+    // Without hashes, equal() compares the Exprs in full, which is the
+    // answer the hashes must not change.
+    for (size_t i = 0; i < unhashed.size(); i++) {
+        for (size_t j = 0; j < unhashed.size(); j++) {
+            const bool expected = equal(unhashed[i], unhashed[j]);
+            if (i == j && !expected) {
+                std::cerr << unhashed[i] << " is not equal to a copy of itself\n";
+                return 1;
+            }
+            if (equal(hashed[i], hashed_again[j]) != expected ||
+                graph_equal(hashed[i], hashed_again[j]) != expected ||
+                equal(hashed[i], unhashed[j]) != expected ||
+                equal(unhashed[i], hashed[j]) != expected) {
+                std::cerr << "Caching hashes changed whether " << unhashed[i]
+                          << " and " << unhashed[j] << " are equal\n";
+                return 1;
+            }
+            if (expected && hashed[i].get()->structural_hash != hashed_again[j].get()->structural_hash) {
+                std::cerr << "The equal Exprs " << unhashed[i] << " and " << unhashed[j]
+                          << " have different hashes\n";
+                return 1;
+            }
+        }
+    }
+
+    // Maps ordered by hash find each Expr by its equal copies.
+    {
+        std::map<Expr, size_t, IRGraphHashCompare> by_hash;
+        std::map<Expr, size_t, IRDeepCompare> by_structure;
+        for (size_t i = 0; i < hashed.size(); i++) {
+            by_hash.emplace(hashed[i], i);
+            by_structure.emplace(unhashed[i], i);
+        }
+        if (by_hash.size() != by_structure.size()) {
+            printf("A map ordered by hash has %d entries instead of %d\n",
+                   (int)by_hash.size(), (int)by_structure.size());
+            return 1;
+        }
+        for (size_t i = 0; i < hashed_again.size(); i++) {
+            auto it = by_hash.find(hashed_again[i]);
+            if (it == by_hash.end() || it->second != by_structure.at(unhashed[i])) {
+                std::cerr << "A map ordered by hash didn't find " << hashed_again[i] << "\n";
+                return 1;
+            }
+        }
+    }
+
+    // CSE finds the same common subexpressions either way.
+    {
+        const NameCounters counters = snapshot_name_counters();
+        Expr with_hashes, without_hashes;
+        {
+            NameCounters c = counters;
+            ScopedNameCounters scoped_counters(c);
+            set_ir_hash_caching(true);
+            with_hashes = common_subexpression_elimination(make_redundant_expr());
+        }
+        {
+            NameCounters c = counters;
+            ScopedNameCounters scoped_counters(c);
+            set_ir_hash_caching(false);
+            without_hashes = common_subexpression_elimination(make_redundant_expr());
+        }
+        if (!equal(with_hashes, without_hashes)) {
+            std::cerr << "CSE with hashes:\n"
+                      << with_hashes << "\nis not the same as CSE without them:\n"
+                      << without_hashes << "\n";
+            return 1;
+        }
+    }
+
+    // Lowering produces the same Stmt either way.
+    {
+        const NameCounters counters = snapshot_name_counters();
+        set_ir_hash_caching(false);
+        const std::string off = lower_pipeline(counters);
+        set_ir_hash_caching(true);
+        const std::string on = lower_pipeline(counters);
+        if (on != off) {
+            printf("Caching hashes changed the lowered Stmt\n");
+            return 1;
+        }
+    }
+
+    set_ir_hash_caching(was_enabled);
+
+    printf("Success!\n");
+    return 0;
+}
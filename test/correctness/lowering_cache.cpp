@@ -0,0 +1,184 @@
+#include "Halide.h"
+
+#include <sstream>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Checks that a Pipeline reuses a lowered Module only when nothing lowering
+// read has changed, that it keeps no more Modules than it is allowed to, and
+// that a reused Module is the same as lowering again would produce.
+
+namespace {
+
+struct TestPipeline {
+    ImageParam input{Int(32), 2, "input"};
+    Param<int> offset{"offset"};
+    Var x{"x"}, y{"y"};
+    Func producer{"producer"}, output{"output"};
+    Pipeline p;
+
+    TestPipeline() {
+        producer(x, y) = input(x, y) * 2 + offset;
+        output(x, y) = producer(x - 1, y) + producer(x + 1, y);
+        p = Pipeline(output);
+    }
+
+    Module compile(const std::string &name = "lowering_cache",
+                   const Target &t = get_host_target().without_feature(Target::JIT)) {
+        return p.compile_to_module({input, offset}, name, t);
+    }
+};
+
+Stmt body(const Module &m) {
+    // The main function comes last, after the closures for any parallel
+    // loops.
+    return m.functions().back().body;
+}
+
+std::string text(const Module &m) {
+    std::ostringstream s;
+    for (const auto &f : m.functions()) {
+        s << f.body;
+    }
+    return s.str();
+}
+
+bool has_realization(const Module &m, const std::string &func) {
+    return text(m).find("produce " + func) != std::string::npos;
+}
+
+void check(bool condition, const char *message) {
+    if (!condition) {
+        printf("%s\n", message);
+        exit(1);
+    }
+}
+
+class CountPasses : public IRMutator {
+public:
+    int *count;
+    CountPasses(int *count)
+        : count(count) {
+    }
+    Stmt mutate(const Stmt &s) override {
+        (*count)++;
+        return s;
+    }
+    using IRMutator::mutate;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const size_t default_size = lowering_cache_size();
+    set_lowering_cache_size(8);
+
+    // Compiling again with nothing changed reuses the Module. Changing
+    // anything lowering reads lowers again, and gives a Module that
+    // reflects the change.
+    {
+        TestPipeline t;
+        Module first = t.compile();
+        check(body(t.compile()).same_as(body(first)), "Compiling an unchanged pipeline lowered it again");
+        check(!has_realization(first, "producer"), "The producer should be inlined");
+
+        t.producer.compute_root();
+        Module rescheduled = t.compile();
+        check(!body(rescheduled).same_as(body(first)), "Rescheduling a producer didn't lower the pipeline again");
+        check(has_realization(rescheduled, "producer"), "The Module lowered after rescheduling has the old schedule");
+
+        t.offset.set_range(0, 100);
+        Module ranged = t.compile();
+        check(!body(ranged).same_as(body(rescheduled)), "Setting the range of a Param didn't lower the pipeline again");
+
+        t.input.dim(0).set_min(0);
+        Module constrained = t.compile();
+        check(!body(constrained).same_as(body(ranged)), "Constraining an input didn't lower the pipeline again");
+
+        t.output.specialize(t.offset == 0);
+        Module specialized = t.compile();
+        check(!body(specialized).same_as(body(constrained)), "Adding a specialization didn't lower the pipeline again");
+
+        Module renamed = t.compile("other_name");
+        check(!body(renamed).same_as(body(specialized)), "Changing the function name didn't lower the pipeline again");
+
+        Module retargeted = t.compile("lowering_cache", get_host_target().without_feature(Target::JIT).with_feature(Target::NoAsserts));
+        check(!body(retargeted).same_as(body(specialized)), "Changing the target didn't lower the pipeline again");
+
+        // Going back to a state seen before reuses its Module.
+        check(body(t.compile()).same_as(body(specialized)), "Compiling a state seen before lowered it again");
+    }
+
+    // The Pipeline keeps only the most recently used Modules.
+    {
+        set_lowering_cache_size(2);
+        TestPipeline t;
+        Module inline_module = t.compile();
+        t.producer.compute_root();
+        Module root_module = t.compile();
+        t.producer.compute_at(t.output, t.y);
+        Module at_y_module = t.compile();
+
+        // The inlined schedule was the least recently used, so it was
+        // dropped, and the other two were kept.
+        t.producer.compute_inline();
+        Module inline_again = t.compile();
+        check(!body(inline_again).same_as(body(inline_module)), "A Module beyond the cache size was kept");
+        check(!has_realization(inline_again, "producer"), "The Module lowered again has the wrong schedule");
+        t.producer.compute_at(t.output, t.y);
+        check(body(t.compile()).same_as(body(at_y_module)), "A recently used Module was dropped");
+        (void)root_module;
+    }
+
+    // A size of zero turns the cache off.
+    {
+        set_lowering_cache_size(0);
+        TestPipeline t;
+        Module first = t.compile();
+        check(!body(t.compile()).same_as(body(first)), "Compiling with the cache off reused a Module");
+    }
+
+    // Pipelines with custom lowering passes are never cached, as there's no
+    // telling what the passes depend on.
+    {
+        set_lowering_cache_size(8);
+        TestPipeline t;
+        int count = 0;
+        t.p.add_custom_lowering_pass(new CountPasses(&count));
+        t.compile();
+        t.compile();
+        check(count == 2, "A pipeline with a custom lowering pass reused a Module");
+    }
+
+    // A reused Module is the same as lowering the pipeline again would
+    // produce.
+    {
+        const NameCounters counters = snapshot_name_counters();
+        std::string cached, uncached;
+        {
+            NameCounters c = counters;
+            ScopedNameCounters scoped_counters(c);
+            set_lowering_cache_size(8);
+            TestPipeline t;
+            t.producer.compute_root();
+            t.compile();
+            cached = text(t.compile());
+        }
+        {
+            NameCounters c = counters;
+            ScopedNameCounters scoped_counters(c);
+            set_lowering_cache_size(0);
+            TestPipeline t;
+            t.producer.compute_root();
+            uncached = text(t.compile());
+        }
+        check(cached == uncached, "A reused Module differs from lowering the pipeline again");
+    }
+
+    set_lowering_cache_size(default_size);
+
+    printf("Success!\n");
+    return 0;
+}
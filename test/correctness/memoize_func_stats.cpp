@@ -0,0 +1,101 @@
+#include "Halide.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+namespace {
+
+// The memoization cache can break its counts down by at most this many Funcs.
+constexpr int max_tracked = 32;
+
+int tracked(halide_memoization_cache_func_stats_t *func_stats) {
+    halide_memoization_cache_stats_t stats;
+    return JITSharedRuntime::memoization_cache_get_stats(&stats, func_stats, max_tracked);
+}
+
+const halide_memoization_cache_func_stats_t *find(const halide_memoization_cache_func_stats_t *func_stats, int n,
+                                                  const std::string &func_name) {
+    for (int i = 0; i < n; i++) {
+        if (func_name == func_stats[i].func_name) {
+            return &func_stats[i];
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support the memoization cache statistics.\n");
+        return 0;
+    }
+
+    halide_memoization_cache_func_stats_t func_stats[max_tracked];
+    Var x;
+
+    // Compile and release more memoized pipelines than can be tracked at
+    // once. Releasing each one must free its slot.
+    for (int i = 0; i < 2 * max_tracked; i++) {
+        Func f("memo_" + std::to_string(i));
+        f(x) = x + i;
+        f.compute_root().memoize();
+        Func g("pipeline_" + std::to_string(i));
+        g(x) = f(x) * 2;
+        Buffer<int> out = g.realize({10});
+        if (out(3) != (3 + i) * 2) {
+            printf("Pipeline %d computed %d instead of %d\n", i, out(3), (3 + i) * 2);
+            return 1;
+        }
+    }
+    int n = tracked(func_stats);
+    if (n != 0) {
+        printf("%d memoized Funcs are still tracked after their pipelines were released\n", n);
+        return 1;
+    }
+
+    // A live pipeline's Funcs get slots of their own, with their own counts.
+    {
+        Func f("memo_live"), g("pipeline_live");
+        f(x) = x * 3;
+        f.compute_root().memoize();
+        g(x) = f(x) + 1;
+        g.realize({10});
+        g.realize({10});
+
+        Func h("memo_other"), k("pipeline_other");
+        h(x) = x * 5;
+        h.compute_root().memoize();
+        k(x) = h(x) + 1;
+        k.realize({10});
+
+        n = tracked(func_stats);
+        if (n != 2) {
+            printf("Expected two memoized Funcs to be tracked, found %d\n", n);
+            return 1;
+        }
+        const auto *live = find(func_stats, n, "memo_live");
+        if (!live || strcmp(live->pipeline_name, "pipeline_live") != 0 ||
+            live->misses != 1 || live->hits != 1) {
+            printf("Wrong statistics for memo_live\n");
+            return 1;
+        }
+        const auto *other = find(func_stats, n, "memo_other");
+        if (!other || other->misses != 1 || other->hits != 0) {
+            printf("Wrong statistics for memo_other\n");
+            return 1;
+        }
+    }
+
+    n = tracked(func_stats);
+    if (n != 0) {
+        printf("%d memoized Funcs are still tracked after their pipelines were released\n", n);
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include "Halide.h"
+
+#include <sstream>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Checks that memoizing simplify() during lowering gives the same results
+// as not memoizing it, that the cache tells apart Exprs simplified with
+// different facts, and that it stays within its bound.
+
+namespace {
+
+std::vector<Expr> some_exprs() {
+    Expr x = Variable::make(Int(32), "x");
+    Expr y = Variable::make(Int(32), "y");
+    return {
+        x + 0,
+        min(x, 10) + min(x, 10),
+        (x * 4 + 3) / 4,
+        select(x < y, x, y) + 1 - 1,
+        max(x + y, y + x) * 2,
+        Let::make("t", 3, x + 1),
+        Let::make("t", x * 2, Variable::make(Int(32), "t") + Variable::make(Int(32), "t")),
+        (x % 4) + (y % 4),
+    };
+}
+
+void check_equal(const Expr &a, const Expr &b, const char *what) {
+    if (!equal(a, b)) {
+        std::cerr << what << ": " << a << " != " << b << "\n";
+        exit(1);
+    }
+}
+
+// Lower a small pipeline from scratch, and return the bodies of the
+// lowered functions as text. The pipeline is built and lowered with a copy
+// of the given name counters, so that each call produces the same names.
+std::string lower_blur(NameCounters counters) {
+    ScopedNameCounters scoped_counters(counters);
+    ImageParam input(UInt(16), 2, "input");
+    Func clamped("clamped"), blur_x("blur_x"), blur_y("blur_y");
+    Var vx("x"), vy("y"), xi("xi"), yi("yi");
+    clamped = BoundaryConditions::repeat_edge(input);
+    blur_x(vx, vy) = (clamped(vx - 1, vy) + clamped(vx, vy) * 2 + clamped(vx + 1, vy)) / 4;
+    blur_y(vx, vy) = (blur_x(vx, vy - 1) + blur_x(vx, vy) * 2 + blur_x(vx, vy + 1)) / 4;
+    blur_y.tile(vx, vy, xi, yi, 64, 32).vectorize(xi, 8).parallel(vy);
+    blur_x.compute_at(blur_y, vx).vectorize(vx, 8);
+
+    Target t = get_host_target().without_feature(Target::JIT);
+    Module m = blur_y.compile_to_module({input}, "blur", t);
+    std::ostringstream s;
+    for (const auto &f : m.functions()) {
+        s << f.body;
+    }
+    return s.str();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Expr x = Variable::make(Int(32), "x");
+    Expr y = Variable::make(Int(32), "y");
+
+    const size_t default_size = simplify_cache_size();
+    set_simplify_cache_size(16);
+
+    // Memoized results match the results without a cache, whether they
+    // come from a miss or a hit.
+    {
+        std::vector<Expr> expected;
+        for (const Expr &e : some_exprs()) {
+            expected.push_back(simplify(e));
+        }
+        ScopedSimplifyCache cache;
+        for (int pass = 0; pass < 2; pass++) {
+            std::vector<Expr> exprs = some_exprs();
+            for (size_t i = 0; i < exprs.size(); i++) {
+                check_equal(simplify(exprs[i]), expected[i], "memoized result");
+            }
+        }
+        if (cache.misses() != expected.size() || cache.hits() != expected.size()) {
+            printf("Expected %d misses then %d hits, got %d misses and %d hits\n",
+                   (int)expected.size(), (int)expected.size(), (int)cache.misses(), (int)cache.hits());
+            return 1;
+        }
+    }
+
+    // The same Expr simplified with different bounds, alignment or dead
+    // code removal gets a result of its own.
+    {
+        Scope<Interval> small, large;
+        small.push("x", Interval(0, 5));
+        large.push("x", Interval(20, 30));
+        Scope<ModulusRemainder> odd;
+        odd.push("x", ModulusRemainder(2, 1));
+        Expr clamped = min(x, 10);
+        Expr parity = x % 2;
+        Expr dead_let = Let::make("t", y, x + 1);
+        const Expr dead_let_removed = simplify(dead_let, true);
+        const Expr dead_let_kept = simplify(dead_let, false);
+
+        ScopedSimplifyCache cache;
+        for (int pass = 0; pass < 2; pass++) {
+            check_equal(simplify(clamped, true, small), x, "min with small bounds");
+            check_equal(simplify(clamped, true, large), make_const(Int(32), 10), "min with large bounds");
+            check_equal(simplify(clamped), clamped, "min without bounds");
+            check_equal(simplify(parity, true, Scope<Interval>(), odd), make_const(Int(32), 1), "mod with alignment");
+            check_equal(simplify(parity), parity, "mod without alignment");
+            check_equal(simplify(dead_let, true), dead_let_removed, "dead let removed");
+            check_equal(simplify(dead_let, false), dead_let_kept, "dead let kept");
+        }
+    }
+
+    // Facts about variables that don't occur in the Expr don't matter.
+    {
+        Scope<Interval> about_y;
+        about_y.push("y", Interval(0, 5));
+        ScopedSimplifyCache cache;
+        simplify(x + 0);
+        simplify(x + 0, true, about_y);
+        if (cache.hits() != 1) {
+            printf("Bounds on a variable that isn't used should not cause a miss\n");
+            return 1;
+        }
+    }
+
+    // Simplifying with assumptions bypasses the cache.
+    {
+        ScopedSimplifyCache cache;
+        simplify(min(x, 10), true, Scope<Interval>(), Scope<ModulusRemainder>(), {x < 5});
+        check_equal(simplify(min(x, 10)), min(x, 10), "min after assumption");
+        if (cache.hits() != 0 || cache.misses() != 1) {
+            printf("Simplifications with assumptions should not be memoized\n");
+            return 1;
+        }
+    }
+
+    // Once the cache holds its maximum number of entries, it starts over.
+    {
+        set_simplify_cache_size(4);
+        std::vector<Expr> exprs = some_exprs();
+        const Expr first = simplify(exprs[0]), last = simplify(exprs[5]);
+        ScopedSimplifyCache cache;
+        for (int i = 0; i < 6; i++) {
+            simplify(exprs[i]);
+        }
+        // The fifth insertion emptied the cache, so the first Expr is gone
+        // and the last one is still there.
+        check_equal(simplify(exprs[0]), first, "evicted result");
+        check_equal(simplify(exprs[5]), last, "retained result");
+        if (cache.misses() != 7 || cache.hits() != 1) {
+            printf("Expected 7 misses and 1 hit with a cache of 4 entries, got %d misses and %d hits\n",
+                   (int)cache.misses(), (int)cache.hits());
+            return 1;
+        }
+    }
+
+    // A size of zero turns the cache off.
+    {
+        set_simplify_cache_size(0);
+        ScopedSimplifyCache cache;
+        simplify(x + 0);
+        simplify(x + 0);
+        if (cache.hits() + cache.misses() != 0) {
+            printf("The cache was used while it was turned off\n");
+            return 1;
+        }
+    }
+
+    // Caches nest, and each only sees the calls made while it is innermost.
+    {
+        set_simplify_cache_size(16);
+        ScopedSimplifyCache outer;
+        simplify(x + 0);
+        {
+            ScopedSimplifyCache inner;
+            simplify(x + 0);
+            if (inner.misses() != 1) {
+                printf("The inner cache should not see the outer cache's entries\n");
+                return 1;
+            }
+        }
+        simplify(x + 0);
+        if (outer.misses() != 1 || outer.hits() != 1) {
+            printf("The outer cache should be active again after the inner one is destroyed\n");
+            return 1;
+        }
+    }
+
+    // Lowering produces the same Stmt with the cache off, small enough to
+    // be emptied many times, and at its default size.
+    {
+        const NameCounters counters = snapshot_name_counters();
+        set_simplify_cache_size(0);
+        const std::string off = lower_blur(counters);
+        set_simplify_cache_size(50);
+        const std::string small = lower_blur(counters);
+        set_simplify_cache_size(default_size ? default_size : 16384);
+        const std::string on = lower_blur(counters);
+        if (small != off || on != off) {
+            printf("Lowering with the simplifier cache changed the lowered Stmt\n");
+            return 1;
+        }
+    }
+
+    set_simplify_cache_size(default_size);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "HalideBuffer.h"
+#include "HalideRuntime.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#include "parallel_codegen.h"
+
+using namespace Halide::Runtime;
+
+// The library was compiled with HL_CODEGEN_THREADS set, so it holds one
+// object per partition of the module. Check that it links and computes
+// the same thing as a single object would.
+
+int main(int argc, char **argv) {
+    const int W = 123, H = 45;
+
+    Buffer<uint8_t, 2> input(W, H);
+    input.for_each_element([&](int x, int y) {
+        input(x, y) = (uint8_t)(x * 13 + y * 29 + (x * y) % 7);
+    });
+
+    Buffer<uint8_t, 2> output(W, H);
+    int result = parallel_codegen(input, output);
+    if (result != 0) {
+        printf("parallel_codegen failed: %d\n", result);
+        return 1;
+    }
+
+    auto in = [&](int x, int y) {
+        return (int)input(std::clamp(x, 0, W - 1), std::clamp(y, 0, H - 1));
+    };
+    auto blur_x = [&](int x, int y) {
+        return (in(x - 1, y) + 2 * in(x, y) + in(x + 1, y)) / 4;
+    };
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int blur_y = (blur_x(x, y - 1) + 2 * blur_x(x, y) + blur_x(x, y + 1)) / 4;
+            uint8_t correct = (uint8_t)((uint8_t)blur_y * 7 + 3);
+            if (output(x, y) != correct) {
+                printf("output(%d, %d) = %d instead of %d\n", x, y, output(x, y), correct);
+                return 1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include "Halide.h"
+
+namespace {
+
+// A few parallel, vectorized stages and a lookup table, so that the module
+// has several functions and a constant global to split across partitions.
+class ParallelCodegen : public Halide::Generator<ParallelCodegen> {
+public:
+    Input<Buffer<uint8_t, 2>> input{"input"};
+    Output<Buffer<uint8_t, 2>> output{"output"};
+
+    void generate() {
+        Buffer<uint8_t> table(256, "table");
+        for (int i = 0; i < 256; i++) {
+            table(i) = (uint8_t)(i * 7 + 3);
+        }
+
+        Func clamped = Halide::BoundaryConditions::repeat_edge(input);
+        Func wide{"wide"};
+        wide(x, y) = cast<uint16_t>(clamped(x, y));
+        blur_x(x, y) = (wide(x - 1, y) + 2 * wide(x, y) + wide(x + 1, y)) / 4;
+        blur_y(x, y) = (blur_x(x, y - 1) + 2 * blur_x(x, y) + blur_x(x, y + 1)) / 4;
+        output(x, y) = table(cast<uint8_t>(blur_y(x, y)));
+    }
+
+    void schedule() {
+        blur_x.compute_root().parallel(y).vectorize(x, natural_vector_size<uint16_t>());
+        blur_y.compute_root().parallel(y).vectorize(x, natural_vector_size<uint16_t>());
+        output.parallel(y).vectorize(x, natural_vector_size<uint8_t>());
+    }
+
+private:
+    Var x{"x"}, y{"y"};
+    Func blur_x{"blur_x"}, blur_y{"blur_y"};
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ParallelCodegen, parallel_codegen)
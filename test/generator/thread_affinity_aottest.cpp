@@ -0,0 +1,78 @@
+#include "HalideBuffer.h"
+#include "HalideRuntime.h"
+
+#include <stdio.h>
+
+#include "thread_affinity.h"
+
+using namespace Halide::Runtime;
+
+// Checks that halide_set_thread_affinity and halide_get_thread_affinity
+// round-trip, and that the thread pool runs parallel work with its workers
+// pinned. Pinning is only implemented on Linux; elsewhere it does nothing,
+// but the setting still round-trips and the work still runs.
+
+namespace {
+
+bool run_pipeline() {
+    Buffer<int, 2> out(64, 64);
+    for (int i = 0; i < 100; i++) {
+        int ret = thread_affinity(out);
+        if (ret) {
+            printf("Non zero exit code: %d\n", ret);
+            return false;
+        }
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                if (out(x, y) != x * 1000 + y) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), x * 1000 + y);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const bool initial = halide_get_thread_affinity();
+
+    // The setter returns the old value, and the getter the new one.
+    if (halide_set_thread_affinity(true) != initial || !halide_get_thread_affinity()) {
+        printf("Enabling thread affinity didn't round-trip\n");
+        return 1;
+    }
+    if (!halide_set_thread_affinity(false) || halide_get_thread_affinity()) {
+        printf("Disabling thread affinity didn't round-trip\n");
+        return 1;
+    }
+
+    // The setting takes effect when the thread pool starts up, so restart
+    // it with pinned workers. Run with more threads than there may be
+    // CPUs too, so that some workers share a CPU.
+    halide_set_thread_affinity(true);
+    halide_shutdown_thread_pool();
+    if (!run_pipeline()) {
+        return 1;
+    }
+    const int num_threads = halide_set_num_threads(256);
+    halide_shutdown_thread_pool();
+    if (!run_pipeline()) {
+        return 1;
+    }
+
+    // Turning it off again gives unpinned workers that work just as well.
+    halide_set_num_threads(num_threads);
+    halide_set_thread_affinity(false);
+    halide_shutdown_thread_pool();
+    if (!run_pipeline()) {
+        return 1;
+    }
+
+    halide_set_thread_affinity(initial);
+
+    printf("Success!\n");
+    return 0;
+}
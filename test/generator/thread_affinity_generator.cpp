@@ -0,0 +1,21 @@
+#include "Halide.h"
+
+namespace {
+
+class ThreadAffinity : public Halide::Generator<ThreadAffinity> {
+public:
+    Output<Buffer<int, 2>> output{"output"};
+
+    void generate() {
+        // A job with nested parallelism, so that every worker gets some
+        // of it.
+        Var x, y;
+
+        output(x, y) = x * 1000 + y;
+        output.parallel(x).parallel(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ThreadAffinity, thread_affinity)
@@ -0,0 +1,122 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long a caller has to wait for the first result of a
+// pipeline with an expensive-to-compile schedule, when it compiles the
+// pipeline before calling it, and when it compiles it in the background and
+// calls a cheaper, already compiled version of the pipeline in the meantime.
+
+namespace {
+
+constexpr int size = 512;
+
+Func make_pipeline(ImageParam input, bool optimized) {
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::repeat_edge(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 16; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y + (i % 3) - 1) + 2 * prev(x, y) + prev(x + 1, y)) / 4;
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    if (optimized) {
+        out.tile(x, y, xi, yi, 64, 32).vectorize(xi, 16).parallel(y);
+        for (size_t i = 0; i + 1 < stages.size(); i++) {
+            if (i % 4 == 3) {
+                stages[i].compute_root().vectorize(x, 16).parallel(y);
+            } else {
+                stages[i].compute_at(out, x).vectorize(x, 16);
+            }
+        }
+    } else {
+        // Everything computed at root, with no vectorization, to make it
+        // quick to compile.
+        for (size_t i = 0; i + 1 < stages.size(); i++) {
+            stages[i].compute_root();
+        }
+    }
+    return out;
+}
+
+bool check(const Buffer<int32_t> &output, const Buffer<int32_t> &correct, const char *what) {
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if (output(x, y) != correct(x, y)) {
+                printf("%s: output(%d, %d) = %d instead of %d\n",
+                       what, x, y, output(x, y), correct(x, y));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    ImageParam input(Int(32), 2, "input");
+    Buffer<int32_t> in(size, size), correct(size, size), output(size, size);
+    in.for_each_element([&](int x, int y) { in(x, y) = (x * 17 + y * 31) % 1024; });
+
+    // The fallback would normally be compiled well ahead of time.
+    Callable fallback = make_pipeline(input, false).compile_to_callable({input}, target);
+    if (fallback(in, correct) != 0) {
+        printf("Calling the fallback failed\n");
+        return 1;
+    }
+
+    printf("mode ms_to_first_result calls_before_compiled\n");
+
+    double blocking = benchmark(1, 1, [&]() {
+        Callable c = make_pipeline(input, true).compile_to_callable({input}, target);
+        (void)c(in, output);
+    });
+    if (!check(output, correct, "blocking")) {
+        return 1;
+    }
+    printf("blocking %g 0\n", blocking * 1e3);
+
+    AsyncCallable async;
+    double first_result = benchmark(1, 1, [&]() {
+        async = make_pipeline(input, true).compile_to_callable_async({input}, fallback, target);
+        (void)async(in, output);
+    });
+    if (!check(output, correct, "first async call")) {
+        return 1;
+    }
+
+    // Keep calling while the optimized version compiles. Every call must
+    // succeed, whichever version serves it.
+    int calls = 1;
+    while (!async.ready()) {
+        if (async(in, output) != 0 || !check(output, correct, "async call during compilation")) {
+            return 1;
+        }
+        calls++;
+    }
+    printf("async %g %d\n", first_result * 1e3, calls);
+
+    // Once compilation has finished, calls go to the optimized version.
+    Callable compiled = async.get();
+    if (!compiled.defined() ||
+        async(in, output) != 0 || !check(output, correct, "async call after compilation") ||
+        compiled(in, output) != 0 || !check(output, correct, "compiled call")) {
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how many calls per second one Callable can serve as the number of
+// threads calling it grows. The pipeline is tiny, so this mostly measures the
+// overhead of a call, and whether calls from different threads contend with
+// each other.
+
+namespace {
+
+constexpr int size = 16;
+constexpr int calls_per_thread = 20000;
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    ImageParam in(Int(32), 1, "in");
+    Param<int32_t> p("p");
+    Var x("x");
+    Func f("f");
+    f(x) = in(x) * p + x;
+
+    Callable c = f.compile_to_callable({in, p}, target);
+    auto fn = c.make_std_function<Buffer<int32_t, 1>, int32_t, Buffer<int32_t, 1>>();
+
+    const int max_threads = std::max(32, (int)std::thread::hardware_concurrency());
+
+    printf("threads calls_per_sec calls_per_sec_std_function\n");
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double rate[2];
+        std::atomic<bool> ok{true};
+        for (int use_std_function = 0; use_std_function < 2; use_std_function++) {
+            std::vector<Buffer<int32_t, 1>> inputs, outputs;
+            for (int t = 0; t < threads; t++) {
+                Buffer<int32_t, 1> input(size), output(size);
+                input.for_each_element([&](int i) { input(i) = i + t; });
+                inputs.push_back(input);
+                outputs.push_back(output);
+            }
+
+            double time = benchmark(1, 1, [&]() {
+                std::vector<std::thread> pool;
+                for (int t = 0; t < threads; t++) {
+                    pool.emplace_back([&, t]() {
+                        for (int i = 0; i < calls_per_thread; i++) {
+                            int result = use_std_function ?
+                                             fn(inputs[t], t, outputs[t]) :
+                                             c(inputs[t], t, outputs[t]);
+                            if (result != 0) {
+                                ok = false;
+                                return;
+                            }
+                        }
+                    });
+                }
+                for (auto &thread : pool) {
+                    thread.join();
+                }
+            });
+            rate[use_std_function] = (double)threads * calls_per_thread / time;
+
+            for (int t = 0; t < threads; t++) {
+                for (int i = 0; i < size; i++) {
+                    const int correct = (i + t) * t + i;
+                    if (outputs[t](i) != correct) {
+                        printf("outputs[%d](%d) = %d instead of %d\n", t, i, outputs[t](i), correct);
+                        return 1;
+                    }
+                }
+            }
+        }
+        if (!ok) {
+            printf("A call failed with %d threads\n", threads);
+            return 1;
+        }
+        printf("%d %g %g\n", threads, rate[0], rate[1]);
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+#include <fstream>
+#include <set>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to load a large serialized pipeline from a
+// file, from a stream, and from bytes in memory, and how many distinct Expr
+// nodes the loaded pipeline is made of.
+
+namespace {
+
+Pipeline make_pipeline() {
+    ImageParam input(Float(32), 2, "input");
+    Param<float> gain("gain");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::mirror_image(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 64; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y + (i % 3) - 1) + prev(x + 1, y) * (i + 1) +
+                   prev(x, y - 1) * gain + prev(x, y + 1) * gain) /
+                  (i + 3);
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 32, 32).vectorize(xi, 8).parallel(y);
+    for (size_t i = 0; i + 1 < stages.size(); i += 4) {
+        stages[i].compute_root().vectorize(x, 8).parallel(y);
+    }
+    return Pipeline(out);
+}
+
+// Counts the distinct Expr nodes reachable from a set of Exprs.
+class CountNodes : public Internal::IRGraphVisitor {
+protected:
+    using IRGraphVisitor::include;
+    void include(const Expr &e) override {
+        if (nodes.insert(e.get()).second) {
+            e.accept(this);
+        }
+    }
+
+public:
+    std::set<const Internal::IRNode *> nodes;
+
+    void count(const Internal::Definition &def) {
+        for (const Expr &e : def.args()) {
+            include(e);
+        }
+        for (const Expr &e : def.values()) {
+            include(e);
+        }
+    }
+};
+
+size_t count_nodes(const Pipeline &p) {
+    std::vector<Internal::Function> outputs;
+    for (const Func &f : p.outputs()) {
+        outputs.push_back(f.function());
+    }
+    CountNodes counter;
+    for (const auto &it : Internal::build_environment(outputs)) {
+        counter.count(it.second.definition());
+        for (const auto &update : it.second.updates()) {
+            counter.count(update);
+        }
+    }
+    return counter.nodes.size();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    target = target.without_feature(Target::JIT);
+
+    Pipeline original = make_pipeline();
+    Internal::TemporaryFile file("deserialization", ".hlpipe");
+    serialize_pipeline(original, file.pathname());
+    std::vector<uint8_t> bytes;
+    serialize_pipeline(original, bytes);
+    const size_t original_nodes = count_nodes(original);
+
+    printf("source ms_per_load distinct_expr_nodes\n");
+    printf("original 0 %d\n", (int)original_nodes);
+
+    const char *sources[] = {"file", "stream", "bytes"};
+    for (int s = 0; s < 3; s++) {
+        Pipeline p;
+        double time = benchmark(5, 1, [&]() {
+            if (s == 0) {
+                p = deserialize_pipeline(file.pathname(), {});
+            } else if (s == 1) {
+                std::ifstream in(file.pathname(), std::ios::binary);
+                p = deserialize_pipeline(in, {});
+            } else {
+                p = deserialize_pipeline(bytes.data(), bytes.size(), {});
+            }
+        });
+
+        // Exprs that appear many times should only be loaded once, so the
+        // loaded pipeline is never made of more nodes than the original.
+        const size_t nodes = count_nodes(p);
+        if (nodes > original_nodes) {
+            printf("Loading from %s made %d Expr nodes, but the original has %d\n",
+                   sources[s], (int)nodes, (int)original_nodes);
+            return 1;
+        }
+        printf("%s %g %d\n", sources[s], time * 1e3, (int)nodes);
+
+        // The loaded pipeline must still be usable.
+        Module m = p.compile_to_module(p.infer_arguments(), "deserialization", target);
+        if (m.functions().empty()) {
+            printf("Pipeline loaded from %s didn't lower\n", sources[s]);
+            return 1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
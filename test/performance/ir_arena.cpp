@@ -0,0 +1,148 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to lower a pipeline with the IR nodes it makes
+// allocated from an IR arena and without, and checks that several threads
+// can lower with arenas at once, and that IR can escape an arena to another
+// thread.
+
+namespace {
+
+Func make_pipeline(ImageParam input) {
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::mirror_image(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 24; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y + (i % 3) - 1) + prev(x + 1, y) * (i + 1) + prev(x, y - 1)) / (i + 3);
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 32, 32).vectorize(xi, 8).parallel(y);
+    for (size_t i = 0; i + 1 < stages.size(); i++) {
+        if (i % 4 == 3) {
+            stages[i].compute_root().vectorize(x, 8).parallel(y);
+        } else if (i % 2 == 1) {
+            // Computed inside the next stage that is computed at root.
+            const size_t root = i - i % 4 + 3;
+            if (root + 1 < stages.size()) {
+                stages[i].compute_at(stages[root], x).vectorize(x, 8);
+            } else {
+                stages[i].compute_at(out, x).vectorize(x, 8);
+            }
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    target = target.without_feature(Target::JIT);
+
+    printf("ir_arena ms_lowering\n");
+
+    const bool was_enabled = Internal::ir_arena_enabled();
+    for (bool enabled : {false, true}) {
+        Internal::set_ir_arena_enabled(enabled);
+        double time = 0;
+        const int reps = 3;
+        for (int r = 0; r < reps; r++) {
+            ImageParam input(Float(32), 2, "input");
+            Func out = make_pipeline(input);
+            Module m("ir_arena", target);
+            time += benchmark(1, 1, [&]() {
+                m = out.compile_to_module({input}, "ir_arena", target);
+            });
+
+            // The IR in the Module outlives the arena it was made in, so it
+            // must be safe to use and free on another thread.
+            std::string stmt;
+            std::thread t([&, m = std::move(m)]() mutable {
+                std::ostringstream s;
+                s << m.functions().back().body;
+                stmt = s.str();
+                m = Module("ir_arena", target);
+            });
+            t.join();
+            if (stmt.find("produce stage_23") == std::string::npos) {
+                printf("Lowering with ir_arena = %d produced:\n%s\n", enabled, stmt.c_str());
+                return 1;
+            }
+        }
+        printf("%d %g\n", enabled, 1e3 * time / reps);
+    }
+
+    // Several threads may lower at once, each with an arena of its own.
+    {
+        const int threads = 4;
+        std::vector<ImageParam> inputs;
+        std::vector<Func> outs;
+        for (int i = 0; i < threads; i++) {
+            inputs.emplace_back(Float(32), 2, "input");
+            outs.push_back(make_pipeline(inputs.back()));
+        }
+        std::vector<std::string> stmts(threads);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([&, i]() {
+                Module m = outs[i].compile_to_module({inputs[i]}, "ir_arena", target);
+                std::ostringstream s;
+                s << m.functions().back().body;
+                stmts[i] = s.str();
+            });
+        }
+        for (std::thread &t : workers) {
+            t.join();
+        }
+        for (int i = 0; i < threads; i++) {
+            if (stmts[i].find("produce stage_23") == std::string::npos) {
+                printf("Lowering on thread %d produced:\n%s\n", i, stmts[i].c_str());
+                return 1;
+            }
+        }
+    }
+
+    // IR made with an arena can escape it while it is alive (e.g. into a
+    // cache that outlives lowering), and be used and freed on another
+    // thread.
+    {
+        Internal::set_ir_arena_enabled(true);
+        Internal::ScopedIRArena arena;
+        Var x("x");
+        std::vector<Expr> escaped;
+        for (int i = 0; i < 1000; i++) {
+            escaped.push_back(x * i + (x - i));
+        }
+        std::thread t([escaped = std::move(escaped)]() mutable {
+            for (Expr &e : escaped) {
+                Expr copy = e;
+                e = Expr();
+            }
+        });
+        t.join();
+        // The arena is still usable afterwards.
+        Expr e = x * 2 + 1;
+        if (!e.defined()) {
+            return 1;
+        }
+    }
+    Internal::set_ir_arena_enabled(was_enabled);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to lower a pipeline with lots of redundant
+// index math, with and without Exprs caching their structural hashes.
+
+namespace {
+
+Func make_pipeline(ImageParam input) {
+    Var x("x"), y("y"), c("c"), xi("xi"), yi("yi");
+    Func clamped = BoundaryConditions::mirror_image(input);
+    Func prev = clamped;
+    std::vector<Func> stages;
+    for (int i = 0; i < 12; i++) {
+        Func f("stage_" + std::to_string(i));
+        Expr e = 0.0f;
+        for (int dy = -2; dy <= 2; dy++) {
+            for (int dx = -2; dx <= 2; dx++) {
+                e += prev(x + dx, y + dy, c) * ((dx + 3) * (dy + 3) + i);
+            }
+        }
+        f(x, y, c) = e / (25 * (9 + i));
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 64, 16).vectorize(xi, 8).parallel(y).reorder(c, xi, yi, x, y);
+    // Every third stage is computed at root, and the others are computed
+    // inside the stage that consumes them there.
+    for (size_t i = 0; i + 1 < stages.size(); i++) {
+        if (i % 3 == 2) {
+            stages[i].compute_root().vectorize(x, 8).parallel(y);
+        } else {
+            const size_t root = i - i % 3 + 2;
+            if (root + 1 < stages.size()) {
+                stages[i].compute_at(stages[root], y).vectorize(x, 8);
+            } else {
+                stages[i].compute_at(out, x).vectorize(x, 8);
+            }
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    target = target.without_feature(Target::JIT);
+
+    printf("cache_ir_hashes ms_lowering\n");
+
+    const bool was_enabled = Internal::ir_hash_caching_enabled();
+    for (bool enabled : {false, true}) {
+        Internal::set_ir_hash_caching(enabled);
+        // Each lowering starts from a freshly-built pipeline, so that all of
+        // its Exprs are made with the setting being measured.
+        double time = 0;
+        const int reps = 3;
+        for (int r = 0; r < reps; r++) {
+            ImageParam input(Float(32), 3, "input");
+            Func out = make_pipeline(input);
+            time += benchmark(1, 1, [&]() {
+                out.compile_to_module({input}, "ir_hash_caching", target);
+            });
+        }
+        printf("%d %g\n", enabled, 1e3 * time / reps);
+    }
+    Internal::set_ir_hash_caching(was_enabled);
+
+    printf("Success!\n");
+    return 0;
+}
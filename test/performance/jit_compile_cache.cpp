@@ -0,0 +1,168 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to JIT compile a pipeline in a fresh process,
+// first with an empty on-disk JIT cache and then with the cache populated by
+// the first process. Then checks that the cache stays within its size
+// budget, and that it isn't used unless HL_JIT_CACHE=1.
+
+namespace {
+
+int count_cache_entries(const std::string &dir) {
+    int entries = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".o") {
+            entries++;
+        }
+    }
+    return entries;
+}
+
+uint64_t cache_size(const std::string &dir) {
+    uint64_t size = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".o") {
+            size += entry.file_size();
+        }
+    }
+    return size;
+}
+
+int compile_and_run() {
+    ImageParam input(Float(32), 2, "input");
+    Func clamped("clamped"), blur_x("blur_x"), blur_y("blur_y"), sharpen("sharpen");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    clamped = BoundaryConditions::repeat_edge(input);
+    blur_x(x, y) = (clamped(x - 2, y) + clamped(x - 1, y) + clamped(x, y) + clamped(x + 1, y) + clamped(x + 2, y)) / 5;
+    blur_y(x, y) = (blur_x(x, y - 2) + blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 5;
+    sharpen(x, y) = 2 * clamped(x, y) - blur_y(x, y);
+
+    sharpen.tile(x, y, xi, yi, 64, 32).vectorize(xi, 8).parallel(y);
+    blur_y.compute_at(sharpen, x).vectorize(x, 8);
+    blur_x.compute_at(sharpen, x).vectorize(x, 8);
+
+    Pipeline p(sharpen);
+    double time = benchmark(1, 1, [&]() {
+        p.compile_jit();
+    });
+
+    Buffer<float> in(256, 256), out(256, 256);
+    in.fill(1.0f);
+    input.set(in);
+    p.realize(out);
+    for (int j = 0; j < out.height(); j++) {
+        for (int i = 0; i < out.width(); i++) {
+            if (out(i, j) != 1.0f) {
+                printf("out(%d, %d) = %f instead of 1\n", i, j, out(i, j));
+                return 1;
+            }
+        }
+    }
+
+    printf("%g ", 1e3 * time);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+#ifdef _WIN32
+    printf("[SKIP] Windows does not have a working setenv\n");
+    return 0;
+#else
+    if (argc > 1 && !strcmp(argv[1], "--compile")) {
+        return compile_and_run();
+    }
+
+    const std::string dir = Internal::dir_make_temp();
+    setenv("HL_JIT_CACHE", "1", 1);
+    setenv("HL_JIT_CACHE_DIR", dir.c_str(), 1);
+
+    printf("cache ms_compile new_entries\n");
+
+    const std::string command = std::string(argv[0]) + " --compile";
+    int entries[2];
+    int entries_before = 0;
+    const char *names[] = {"cold", "warm"};
+    for (int run = 0; run < 2; run++) {
+        printf("%s ", names[run]);
+        fflush(stdout);
+        if (std::system(command.c_str()) != 0) {
+            printf("\nCompiling in a child process failed\n");
+            return 1;
+        }
+        int total = count_cache_entries(dir);
+        entries[run] = total - entries_before;
+        entries_before = total;
+        printf("%d\n", entries[run]);
+    }
+
+    const uint64_t full_size = cache_size(dir);
+    std::filesystem::remove_all(dir);
+
+    if (entries[0] == 0) {
+        printf("The first process didn't add anything to the JIT cache\n");
+        return 1;
+    }
+    if (entries[1] >= entries[0]) {
+        printf("The second process didn't hit in the JIT cache\n");
+        return 1;
+    }
+
+    // With a budget of half of what the pipeline needs, the least recently
+    // used entries are removed as the new ones are written.
+    const std::string bounded_dir = Internal::dir_make_temp();
+    setenv("HL_JIT_CACHE_DIR", bounded_dir.c_str(), 1);
+    setenv("HL_JIT_CACHE_SIZE", std::to_string(full_size / 2).c_str(), 1);
+    printf("bounded ");
+    fflush(stdout);
+    if (std::system(command.c_str()) != 0) {
+        printf("\nCompiling in a child process failed\n");
+        return 1;
+    }
+    const int bounded_entries = count_cache_entries(bounded_dir);
+    const uint64_t bounded_size = cache_size(bounded_dir);
+    printf("%d\n", bounded_entries);
+    std::filesystem::remove_all(bounded_dir);
+    unsetenv("HL_JIT_CACHE_SIZE");
+    if (bounded_size > full_size / 2) {
+        printf("The JIT cache holds %llu bytes, over its budget of %llu\n",
+               (unsigned long long)bounded_size, (unsigned long long)(full_size / 2));
+        return 1;
+    }
+
+    // The cache is only used when asked for.
+    const std::string off_dir = Internal::dir_make_temp();
+    setenv("HL_JIT_CACHE_DIR", off_dir.c_str(), 1);
+    unsetenv("HL_JIT_CACHE");
+    printf("off ");
+    fflush(stdout);
+    if (std::system(command.c_str()) != 0) {
+        printf("\nCompiling in a child process failed\n");
+        return 1;
+    }
+    const int off_entries = count_cache_entries(off_dir);
+    printf("%d\n", off_entries);
+    std::filesystem::remove_all(off_dir);
+    if (off_entries != 0) {
+        printf("The JIT cache was used without HL_JIT_CACHE=1\n");
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
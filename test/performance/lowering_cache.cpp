@@ -0,0 +1,133 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+#include <sstream>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to compile a pipeline over and over while
+// cycling one of its Funcs through a few schedules, with lowered Modules
+// cached in the Pipeline and without. Only schedules seen before can reuse a
+// Module; the first compile of each schedule lowers the whole pipeline.
+
+namespace {
+
+std::vector<Func> make_pipeline(ImageParam input) {
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::mirror_image(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 24; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y + (i % 3) - 1) + prev(x + 1, y) * (i + 1) + prev(x, y - 1)) / (i + 3);
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 32, 32).vectorize(xi, 8).parallel(y);
+    for (size_t i = 0; i + 1 < stages.size(); i++) {
+        if (i % 4 == 3) {
+            stages[i].compute_root().vectorize(x, 8).parallel(y);
+        } else if (i % 2 == 1) {
+            // Computed inside the next stage that is computed at root.
+            const size_t root = i - i % 4 + 3;
+            if (root + 1 < stages.size()) {
+                stages[i].compute_at(stages[root], x).vectorize(x, 8);
+            } else {
+                stages[i].compute_at(out, x).vectorize(x, 8);
+            }
+        }
+    }
+    return stages;
+}
+
+// Schedule one of the stages that is inlined by default. This doesn't tell
+// the output's Pipeline that anything has changed.
+void schedule_producer(std::vector<Func> &stages, int schedule) {
+    Func f = stages[stages.size() - 4];
+    Func consumer = stages[stages.size() - 3];
+    Var x = f.args()[0];
+    if (schedule == 0) {
+        f.compute_inline();
+    } else if (schedule == 1) {
+        f.compute_at(consumer, x);
+    } else {
+        f.compute_root();
+    }
+}
+
+// Check that a Module was lowered with the given schedule for the producer.
+bool check_schedule(const Module &m, int schedule) {
+    // The main function comes last, after the closures for its parallel
+    // loops.
+    bool in_main = false, anywhere = false;
+    for (const auto &f : m.functions()) {
+        std::ostringstream s;
+        s << f.body;
+        in_main = s.str().find("produce stage_20") != std::string::npos;
+        anywhere = anywhere || in_main;
+    }
+    if (schedule == 0) {
+        return !anywhere;
+    } else if (schedule == 1) {
+        return anywhere && !in_main;
+    } else {
+        return in_main;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    target = target.without_feature(Target::JIT);
+
+    printf("cache_size ms_per_compile\n");
+
+    const size_t default_size = Internal::lowering_cache_size();
+    const size_t cache_size = 4;
+    const int num_schedules = 3, rounds = 3;
+    for (size_t size : {(size_t)0, cache_size}) {
+        Internal::set_lowering_cache_size(size);
+        ImageParam input(Float(32), 2, "input");
+        std::vector<Func> stages = make_pipeline(input);
+        Pipeline p(stages.back());
+        std::vector<Internal::Stmt> first(num_schedules);
+        double time = 0;
+        for (int r = 0; r < rounds; r++) {
+            for (int s = 0; s < num_schedules; s++) {
+                schedule_producer(stages, s);
+                Module m("lowering_cache", target);
+                time += benchmark(1, 1, [&]() {
+                    m = p.compile_to_module({input}, "lowering_cache", target);
+                });
+
+                // A Module lowered for one schedule must never be reused
+                // for another, and with the cache on, each schedule should
+                // only be lowered once.
+                if (!check_schedule(m, s)) {
+                    printf("Lowering with cache size %d did not use schedule %d\n", (int)size, s);
+                    return 1;
+                }
+                const Internal::Stmt &body = m.functions().back().body;
+                if (r == 0) {
+                    first[s] = body;
+                } else if (body.same_as(first[s]) != (size != 0)) {
+                    printf("Lowering with cache size %d %s schedule %d again\n",
+                           (int)size, size ? "lowered" : "did not lower", s);
+                    return 1;
+                }
+            }
+        }
+        printf("%d %g\n", (int)size, 1e3 * time / (rounds * num_schedules));
+    }
+    Internal::set_lowering_cache_size(default_size);
+
+    printf("Success!\n");
+    return 0;
+}
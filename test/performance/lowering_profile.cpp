@@ -0,0 +1,132 @@
+#include "Halide.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace Halide;
+
+// Measures how long it takes to compile a few pipelines, broken down by
+// lowering pass, using the lowering profile recorded in the compiler log.
+// Meant for tracking changes in compile time, rather than runtime.
+
+namespace {
+
+class LoweringProfile : public Internal::JSONCompilerLogger {
+public:
+    void print(const std::string &pipeline) {
+        double lowering = 0;
+        for (const auto &it : lowering_passes) {
+            printf("%s \"%s\" %g %llu %llu %llu\n", pipeline.c_str(), it.first.c_str(),
+                   1e3 * it.second.duration,
+                   (unsigned long long)it.second.ir_nodes,
+                   (unsigned long long)it.second.stmts,
+                   (unsigned long long)it.second.ir_bytes);
+            lowering += it.second.duration;
+        }
+        printf("%s total_lowering_passes %g 0 0 0\n", pipeline.c_str(), 1e3 * lowering);
+        printf("%s total_lowering %g 0 0 0\n", pipeline.c_str(), 1e3 * compilation_time[Phase::HalideLowering]);
+        printf("%s llvm_optimization %g 0 0 0\n", pipeline.c_str(), 1e3 * compilation_time[Phase::LLVMOptimization]);
+        printf("%s llvm_codegen %g 0 0 0\n", pipeline.c_str(), 1e3 * compilation_time[Phase::LLVMCodeGen]);
+    }
+
+    size_t num_lowering_passes() const {
+        return lowering_passes.size();
+    }
+};
+
+Func blur(ImageParam input) {
+    Func clamped("clamped"), blur_x("blur_x"), blur_y("blur_y");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    clamped = BoundaryConditions::repeat_edge(input);
+    blur_x(x, y) = (clamped(x - 1, y) + clamped(x, y) * 2 + clamped(x + 1, y)) / 4;
+    blur_y(x, y) = (blur_x(x, y - 1) + blur_x(x, y) * 2 + blur_x(x, y + 1)) / 4;
+
+    blur_y.tile(x, y, xi, yi, 64, 32).vectorize(xi, 8).parallel(y);
+    blur_x.compute_at(blur_y, x).vectorize(x, 8);
+    return blur_y;
+}
+
+Func many_stages(ImageParam input) {
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::repeat_edge(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 24; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y + (i % 3) - 1) + prev(x + 1, y) * (i + 1) + prev(x, y - 1)) / (i + 3);
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 32, 32).vectorize(xi, 8).parallel(y);
+    for (size_t i = 0; i + 1 < stages.size(); i++) {
+        if (i % 4 == 3) {
+            stages[i].compute_root().vectorize(x, 8).parallel(y);
+        } else if (i % 2 == 1) {
+            // Computed inside the next stage that is computed at root.
+            const size_t root = i - i % 4 + 3;
+            if (root + 1 < stages.size()) {
+                stages[i].compute_at(stages[root], x).vectorize(x, 8);
+            } else {
+                stages[i].compute_at(out, x).vectorize(x, 8);
+            }
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    target = target.without_feature(Target::JIT);
+
+    const std::string dir = Internal::dir_make_temp();
+
+    printf("pipeline pass ms ir_nodes stmts ir_bytes\n");
+
+    struct {
+        const char *name;
+        Func (*make)(ImageParam);
+    } pipelines[] = {
+        {"blur", blur},
+        {"many_stages", many_stages},
+    };
+    for (const auto &p : pipelines) {
+        ImageParam input(Float(32), 2, "input");
+        Func out = p.make(input);
+
+        Internal::set_compiler_logger(std::make_unique<LoweringProfile>());
+        Module m = out.compile_to_module({input}, p.name, target);
+        const std::string log = dir + "/" + p.name + ".halide_compiler_log";
+        m.compile({{OutputFileType::object, dir + "/" + p.name + ".o"},
+                   {OutputFileType::compiler_log, log}});
+        auto profile = Internal::set_compiler_logger(nullptr);
+        auto *lowering_profile = static_cast<LoweringProfile *>(profile.get());
+
+        if (lowering_profile->num_lowering_passes() == 0) {
+            printf("No lowering passes were recorded for %s\n", p.name);
+            return 1;
+        }
+        lowering_profile->print(p.name);
+
+        std::ifstream f(log);
+        std::stringstream contents;
+        contents << f.rdbuf();
+        if (contents.str().find("\"lowering_passes\"") == std::string::npos ||
+            contents.str().find("\"compilation_time_llvm_codegen\"") == std::string::npos) {
+            printf("The compiler log for %s has no lowering profile:\n%s\n", p.name, contents.str().c_str());
+            return 1;
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+
+    printf("Success!\n");
+    return 0;
+}
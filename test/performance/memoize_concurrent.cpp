@@ -0,0 +1,95 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cmath>
+#include <cstdio>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures the cost of memoization cache lookups made concurrently from
+// the iterations of a parallel loop, for workloads that mostly hit and
+// workloads that mostly miss.
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    const int width = 64, height = 8192;
+
+    // Every row of g looks up one row of f. The cache key includes the
+    // bounds of the row, so there are num_keys distinct entries.
+    Param<int> num_keys;
+    Func f, g;
+    Var x, y;
+    f(x, y) = sqrt(cast<float>(x + y));
+    g(x, y) = f(x, y % num_keys);
+    f.compute_at(g, y).memoize();
+    g.parallel(y);
+
+    auto callable = g.compile_to_callable({num_keys});
+    Buffer<float> out(width, height);
+
+    const int native_threads = Halide::Internal::JITSharedRuntime::get_num_threads();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < native_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(native_threads);
+
+    struct Scenario {
+        const char *name;
+        int keys;
+        int64_t cache_size;
+    };
+    // A row of f is 256 bytes. The first scenario fits in the cache, so
+    // after the first run every lookup hits. The second has a key per row
+    // and a cache that holds a small fraction of them, so nearly every
+    // lookup misses and evicts.
+    const Scenario scenarios[] = {
+        {"hit", 64, 1 << 20},
+        {"miss", height, 16 * 1024},
+    };
+
+    printf("scenario");
+    for (int t : thread_counts) {
+        printf(" ns_per_lookup@%d", t);
+    }
+    printf("\n");
+
+    for (const Scenario &s : scenarios) {
+        Halide::Internal::JITSharedRuntime::memoization_cache_set_size(s.cache_size);
+        printf("%s", s.name);
+        for (int t : thread_counts) {
+            Halide::Internal::JITSharedRuntime::set_num_threads(t);
+            double time = benchmark(5, 10, [&]() {
+                int result = callable(s.keys, out);
+                if (result != 0) {
+                    fprintf(stderr, "Pipeline failed with %d\n", result);
+                    exit(1);
+                }
+            });
+            printf(" %g", 1e9 * time / height);
+        }
+        printf("\n");
+
+        for (int j = 0; j < height; j++) {
+            for (int i = 0; i < width; i++) {
+                float correct = std::sqrt((float)(i + j % s.keys));
+                if (out(i, j) != correct) {
+                    printf("out(%d, %d) = %f instead of %f\n", i, j, out(i, j), correct);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    Halide::Internal::JITSharedRuntime::set_num_threads(native_threads);
+    Halide::Internal::JITSharedRuntime::memoization_cache_set_size(0);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Compares the memoization cache eviction policies on a pipeline with a
+// large Func that is cheap to compute and a small Func that is expensive
+// to compute, when the cache can't hold all of their entries.
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    const int size = 256, num_keys = 16;
+
+    Param<int> cheap_key, expensive_key;
+    Func cheap("cheap"), expensive("expensive"), out("out");
+    Var x, y;
+    RDom r(0, 4096);
+    cheap(x, y) = cast<float>(x + y + cheap_key);
+    expensive(x) = sum(sin(cast<float>(x + r + expensive_key)));
+    out(x, y) = cheap(x, y) + expensive(x % 64);
+    cheap.compute_root().memoize();
+    expensive.compute_root().memoize();
+
+    auto callable = out.compile_to_callable({cheap_key, expensive_key});
+    Buffer<float> output(size, size);
+
+    // Each entry of cheap is 256 KB and each entry of expensive is 256
+    // bytes. A 1 MB cache holds a few entries of cheap and all the entries
+    // of expensive, but under LRU the stream of cheap entries pushes the
+    // expensive ones out.
+    const int64_t cache_size = 1024 * 1024;
+    const int calls = 256;
+
+    printf("policy ms_per_call hits misses evictions expensive_hits expensive_misses\n");
+
+    const halide_memoization_cache_eviction_policy_t policies[] = {
+        halide_memoization_cache_evict_lru,
+        halide_memoization_cache_evict_greedy_dual_size,
+    };
+    const char *names[] = {"lru", "greedy_dual_size"};
+    for (int p = 0; p < 2; p++) {
+        Halide::Internal::JITSharedRuntime::memoization_cache_set_eviction_policy(policies[p]);
+        Halide::Internal::JITSharedRuntime::memoization_cache_set_size(cache_size);
+
+        halide_memoization_cache_stats_t before;
+        halide_memoization_cache_func_stats_t funcs_before[8] = {};
+        int num_funcs = Halide::Internal::JITSharedRuntime::memoization_cache_get_stats(&before, funcs_before, 8);
+
+        double time = benchmark(1, 1, [&]() {
+            uint32_t seed = 0;
+            for (int i = 0; i < calls; i++) {
+                seed = seed * 1664525 + 1013904223;
+                int result = callable((int)(seed >> 16) % num_keys, i % num_keys, output);
+                if (result != 0) {
+                    fprintf(stderr, "Pipeline failed with %d\n", result);
+                    exit(1);
+                }
+            }
+        });
+
+        halide_memoization_cache_stats_t after;
+        halide_memoization_cache_func_stats_t funcs_after[8] = {};
+        num_funcs = Halide::Internal::JITSharedRuntime::memoization_cache_get_stats(&after, funcs_after, 8);
+
+        uint64_t expensive_hits = 0, expensive_misses = 0;
+        for (int i = 0; i < num_funcs && i < 8; i++) {
+            if (std::string(funcs_after[i].func_name).find("expensive") == 0) {
+                expensive_hits = funcs_after[i].hits - funcs_before[i].hits;
+                expensive_misses = funcs_after[i].misses - funcs_before[i].misses;
+            }
+        }
+
+        printf("%s %g %llu %llu %llu %llu %llu\n", names[p], 1e3 * time / calls,
+               (unsigned long long)(after.hits - before.hits),
+               (unsigned long long)(after.misses - before.misses),
+               (unsigned long long)(after.evictions - before.evictions),
+               (unsigned long long)expensive_hits,
+               (unsigned long long)expensive_misses);
+
+        // Start the next policy from an empty cache.
+        Halide::Internal::JITSharedRuntime::memoization_cache_set_size(1);
+    }
+
+    Halide::Internal::JITSharedRuntime::memoization_cache_set_eviction_policy(halide_memoization_cache_evict_lru);
+    Halide::Internal::JITSharedRuntime::memoization_cache_set_size(0);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to get a memoized Func back after it has been
+// evicted from memory, with and without the persistent tier of the cache,
+// as a stand-in for a process restart. Also checks that the same pipeline
+// compiled again gets the results from disk, and that a redefined one
+// doesn't.
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    if (target.os == Target::Windows) {
+        printf("[SKIP] The persistent memoization cache isn't supported on Windows.\n");
+        return 0;
+    }
+
+    const int size = 256;
+
+    Param<int> key;
+    Func table("table"), out("out");
+    Var x, y;
+    RDom r(0, 1024);
+    table(x, y) = sum(sin(cast<float>(x + y + r + key)));
+    out(x, y) = table(x, y) * 2;
+    table.compute_root().memoize();
+
+    auto callable = out.compile_to_callable({key});
+    Buffer<float> output(size, size);
+
+    const std::string dir = Internal::dir_make_temp();
+
+    printf("persistent ms_compute ms_after_eviction persistent_hits\n");
+
+    for (bool persistent : {false, true}) {
+        Halide::Internal::JITSharedRuntime::memoization_cache_set_persistent_path(persistent ? dir : "");
+
+        halide_memoization_cache_stats_t before;
+        Halide::Internal::JITSharedRuntime::memoization_cache_get_stats(&before);
+
+        double compute_time = 0, reload_time = 0;
+        const int keys = 8;
+        for (int k = 0; k < keys; k++) {
+            // Each key is computed once, evicted by shrinking the cache,
+            // and then asked for again.
+            Halide::Internal::JITSharedRuntime::memoization_cache_set_size(0);
+            compute_time += benchmark(1, 1, [&]() {
+                (void)callable(k + (persistent ? keys : 0), output);
+            });
+            Halide::Internal::JITSharedRuntime::memoization_cache_set_size(1);
+            Halide::Internal::JITSharedRuntime::memoization_cache_set_size(0);
+            reload_time += benchmark(1, 1, [&]() {
+                (void)callable(k + (persistent ? keys : 0), output);
+            });
+        }
+
+        halide_memoization_cache_stats_t after;
+        Halide::Internal::JITSharedRuntime::memoization_cache_get_stats(&after);
+        const uint64_t persistent_hits = after.persistent_hits - before.persistent_hits;
+
+        printf("%d %g %g %llu\n", persistent, 1e3 * compute_time / keys, 1e3 * reload_time / keys,
+               (unsigned long long)persistent_hits);
+
+        if (persistent && persistent_hits != (uint64_t)keys) {
+            printf("Expected %d persistent hits, got %llu\n", keys, (unsigned long long)persistent_hits);
+            return 1;
+        }
+
+        const int last_key = keys - 1 + (persistent ? keys : 0);
+        for (int j = 0; j < size; j++) {
+            for (int i = 0; i < size; i++) {
+                float correct = 0;
+                for (int rv = 0; rv < 1024; rv++) {
+                    correct += std::sin((float)(i + j + rv + last_key));
+                }
+                correct *= 2;
+                if (std::abs(output(i, j) - correct) > 1e-2f * std::max(1.0f, std::abs(correct))) {
+                    printf("output(%d, %d) = %f instead of %f\n", i, j, output(i, j), correct);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    {
+        // Compiling the same code again, in new Funcs with different unique
+        // names, as another process might, must find the results on disk.
+        // A pipeline with the same names but a different definition, as if
+        // the program had been rebuilt, must not. As everything else about
+        // the two is the same, only the build id in the key tells them
+        // apart.
+        Halide::Internal::JITSharedRuntime::memoization_cache_set_persistent_path(dir);
+        const int last_key = 2 * 8 - 1;
+        for (bool redefined : {false, true}) {
+            Halide::Internal::JITSharedRuntime::memoization_cache_set_size(1);
+            Halide::Internal::JITSharedRuntime::memoization_cache_set_size(0);
+
+            Func table2("table"), out2("out");
+            Expr arg = cast<float>(x + y + r + key);
+            table2(x, y) = sum(redefined ? cos(arg) : sin(arg));
+            out2(x, y) = table2(x, y) * 2;
+            table2.compute_root().memoize();
+
+            halide_memoization_cache_stats_t before, after;
+            Halide::Internal::JITSharedRuntime::memoization_cache_get_stats(&before);
+            (void)out2.compile_to_callable({key})(last_key, output);
+            Halide::Internal::JITSharedRuntime::memoization_cache_get_stats(&after);
+
+            const uint64_t hits = after.persistent_hits - before.persistent_hits;
+            if (hits != (redefined ? 0 : 1)) {
+                printf("Expected %d persistent hits with the %s definition, got %llu\n",
+                       redefined ? 0 : 1, redefined ? "new" : "same", (unsigned long long)hits);
+                return 1;
+            }
+            for (int j = 0; j < size; j++) {
+                for (int i = 0; i < size; i++) {
+                    float correct = 0;
+                    for (int rv = 0; rv < 1024; rv++) {
+                        const float a = (float)(i + j + rv + last_key);
+                        correct += redefined ? std::cos(a) : std::sin(a);
+                    }
+                    correct *= 2;
+                    if (std::abs(output(i, j) - correct) > 1e-2f * std::max(1.0f, std::abs(correct))) {
+                        printf("output(%d, %d) = %f instead of %f after %s the pipeline\n", i, j, output(i, j), correct,
+                               redefined ? "redefining" : "recompiling");
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    Halide::Internal::JITSharedRuntime::memoization_cache_set_persistent_path("");
+    Halide::Internal::JITSharedRuntime::memoization_cache_set_size(0);
+    std::filesystem::remove_all(dir);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to compile a multitarget static library with
+// the targets compiled one at a time and concurrently, and checks that the
+// library doesn't depend on how many threads it was compiled on. Each
+// configuration is compiled in a fresh process, so that they all start from
+// the same state.
+
+namespace {
+
+std::vector<Target> multitarget_targets() {
+    Target base = get_jit_target_from_environment().without_feature(Target::JIT);
+    std::vector<std::vector<Target::Feature>> variants;
+    if (base.arch == Target::X86 && base.bits == 64) {
+        base.set_features({Target::SSE41, Target::AVX, Target::F16C, Target::FMA,
+                           Target::AVX2, Target::AVX512, Target::AVX512_Skylake},
+                          false);
+        variants = {{Target::SSE41, Target::AVX, Target::F16C, Target::FMA,
+                     Target::AVX2, Target::AVX512, Target::AVX512_Skylake},
+                    {Target::SSE41, Target::AVX, Target::F16C, Target::FMA, Target::AVX2},
+                    {Target::SSE41, Target::AVX},
+                    {Target::SSE41}};
+    } else {
+        variants = {{Target::NoAsserts, Target::NoBoundsQuery},
+                    {Target::NoAsserts},
+                    {Target::NoBoundsQuery}};
+    }
+    std::vector<Target> targets;
+    for (const auto &features : variants) {
+        Target t = base;
+        t.set_features(features);
+        targets.push_back(t);
+    }
+    targets.push_back(base);
+    return targets;
+}
+
+Module make_module(const std::string &fn_name, const Target &target) {
+    ImageParam input(Float(32), 2, "input");
+    Func clamped("clamped"), blur_x("blur_x"), blur_y("blur_y"), out("out");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    clamped = BoundaryConditions::mirror_interior(input);
+    blur_x(x, y) = (clamped(x - 1, y) + clamped(x, y) * 2 + clamped(x + 1, y)) / 4;
+    blur_y(x, y) = (blur_x(x, y - 1) + blur_x(x, y) * 2 + blur_x(x, y + 1)) / 4;
+    out(x, y) = sqrt(max(blur_y(x, y), 0.0f)) - clamped(x, y) + random_float();
+
+    const int vec = target.natural_vector_size<float>();
+    out.tile(x, y, xi, yi, 8 * vec, 32).vectorize(xi, vec).parallel(y);
+    blur_y.compute_at(out, x).vectorize(x, vec);
+    blur_x.compute_at(out, x).vectorize(x, vec);
+
+    return Pipeline(out).compile_to_module({input}, fn_name, target);
+}
+
+int compile(const std::string &dir, int threads) {
+    const std::vector<Target> targets = multitarget_targets();
+    const std::map<OutputFileType, std::string> outputs = {
+        {OutputFileType::c_header, dir + "/multitarget.h"},
+        {OutputFileType::static_library, dir + "/multitarget" + (targets.back().os == Target::Windows ? ".lib" : ".a")},
+    };
+    double time = benchmark(1, 1, [&]() {
+        compile_multitarget("multitarget", outputs, targets, {}, make_module, nullptr, threads);
+    });
+    printf("%g", 1e3 * time);
+    return 0;
+}
+
+std::string read_file(const std::string &path) {
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    if (argc > 3 && !strcmp(argv[1], "--compile")) {
+        return compile(argv[2], atoi(argv[3]));
+    }
+
+    const int num_targets = (int)multitarget_targets().size();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < num_targets; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(num_targets);
+
+    printf("targets threads ms_compile\n");
+
+    std::vector<std::string> dirs;
+    for (int t : thread_counts) {
+        const std::string dir = Internal::dir_make_temp();
+        dirs.push_back(dir);
+        printf("%d %d ", num_targets, t);
+        fflush(stdout);
+        const std::string command = std::string(argv[0]) + " --compile " + dir + " " + std::to_string(t);
+        if (std::system(command.c_str()) != 0) {
+            printf("\nCompiling in a child process failed\n");
+            return 1;
+        }
+        printf("\n");
+    }
+
+    for (const auto &entry : std::filesystem::directory_iterator(dirs[0])) {
+        const std::string name = entry.path().filename().string();
+        const std::string expected = read_file(entry.path().string());
+        for (size_t i = 1; i < dirs.size(); i++) {
+            if (read_file(dirs[i] + "/" + name) != expected) {
+                printf("%s differs between %d and %d threads\n", name.c_str(), thread_counts[0], thread_counts[i]);
+                return 1;
+            }
+        }
+    }
+
+    for (const auto &dir : dirs) {
+        std::filesystem::remove_all(dir);
+    }
+
+    printf("Success!\n");
+    return 0;
+}
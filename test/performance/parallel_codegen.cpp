@@ -0,0 +1,125 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to compile a module with many functions to a
+// static library, with LLVM's code generator running on one, two, and four
+// threads. generator_aot_parallel_codegen_* check that the resulting
+// libraries link and compute the right thing.
+
+// Count the object files in a static library in the ar format, skipping
+// the symbol table and the table of long names.
+int count_objects(const std::string &library) {
+    std::ifstream f(library, std::ios::binary);
+    char magic[8];
+    if (!f.read(magic, 8) || std::string(magic, 8) != "!<arch>\n") {
+        return -1;
+    }
+    int count = 0;
+    char header[60];
+    while (f.read(header, 60)) {
+        std::string name(header, 16);
+        long size = std::strtol(std::string(header + 48, 10).c_str(), nullptr, 10);
+        if (name.compare(0, 3, "#1/") == 0) {
+            // BSD archives put long names at the start of the data.
+            const int name_size = std::atoi(name.c_str() + 3);
+            name.resize(name_size);
+            f.read(name.data(), name_size);
+            size -= name_size;
+        }
+        // GNU archives name members with long names "/<offset>".
+        const bool is_table = name.compare(0, 2, "/ ") == 0 ||
+                              name.compare(0, 2, "//") == 0 ||
+                              name.compare(0, 7, "/SYM64/") == 0 ||
+                              name.compare(0, 9, "__.SYMDEF") == 0;
+        if (!is_table) {
+            count++;
+        }
+        f.seekg(size + (size & 1), std::ios::cur);
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+#ifdef _WIN32
+    printf("[SKIP] Windows does not have a working setenv\n");
+    return 0;
+#else
+    target = target.without_feature(Target::JIT);
+
+    // Several independent pipelines in one module, each with a few
+    // vectorized and parallelized stages.
+    const int num_pipelines = 8;
+    std::vector<Module> modules;
+    for (int p = 0; p < num_pipelines; p++) {
+        ImageParam input(Float(32), 2, "input");
+        Func clamped("clamped"), blur_x("blur_x"), blur_y("blur_y"), out("out");
+        Var x("x"), y("y"), xi("xi"), yi("yi");
+        clamped = BoundaryConditions::mirror_interior(input);
+        blur_x(x, y) = (clamped(x - 1, y) + clamped(x, y) * (p + 2) + clamped(x + 1, y)) / (p + 4);
+        blur_y(x, y) = (blur_x(x, y - 1) + blur_x(x, y) * (p + 2) + blur_x(x, y + 1)) / (p + 4);
+        out(x, y) = sqrt(max(blur_y(x, y), 0.0f)) - clamped(x, y);
+
+        out.tile(x, y, xi, yi, 64, 32).vectorize(xi, 8).parallel(y);
+        blur_y.compute_at(out, x).vectorize(x, 8);
+        blur_x.compute_at(out, x).vectorize(x, 8);
+
+        modules.push_back(out.compile_to_module({input}, "pipeline_" + std::to_string(p), target));
+    }
+
+    Module module("parallel_codegen", target);
+    for (const Module &m : modules) {
+        for (const auto &f : m.functions()) {
+            module.append(f);
+        }
+        for (const auto &b : m.buffers()) {
+            module.append(b);
+        }
+    }
+
+    const std::string dir = Internal::dir_make_temp();
+    const std::string library = dir + "/parallel_codegen" + (target.os == Target::Windows ? ".lib" : ".a");
+
+    // Use fixed thread counts, so that the partitioned paths are exercised
+    // (and timed comparably) regardless of the number of cores.
+    printf("threads ms_compile\n");
+
+    for (int t : {1, 2, 4}) {
+        setenv("HL_CODEGEN_THREADS", std::to_string(t).c_str(), 1);
+        double time = benchmark(1, 1, [&]() {
+            module.compile({{OutputFileType::static_library, library}});
+        });
+        if (!Internal::file_exists(library)) {
+            printf("%s was not written\n", library.c_str());
+            return 1;
+        }
+        if (target.os != Target::Windows) {
+            const int objects = count_objects(library);
+            if (t == 1 ? objects != 1 : (objects < 2 || objects > t)) {
+                printf("%s holds %d objects with %d threads\n", library.c_str(), objects, t);
+                return 1;
+            }
+        }
+        std::filesystem::remove(library);
+        printf("%d %g\n", t, 1e3 * time);
+    }
+
+    unsetenv("HL_CODEGEN_THREADS");
+    std::filesystem::remove_all(dir);
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,77 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how the throughput of the default thread pool scales with the
+// number of threads, using the same pipeline shapes as parallel_scenarios.
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    Param<int> inner_iterations, outer_iterations, memory_limit;
+    ImageParam input(Float(32), 1);
+
+    Func f, g;
+    Var x;
+
+    RDom r(0, inner_iterations);
+    f(x) = sum(sqrt(input(random_int(r) % memory_limit)));
+
+    g() = f(0) + f(outer_iterations - 1);
+
+    f.compute_root().parallel(x);
+
+    auto out = Runtime::Buffer<float>::make_scalar();
+    const int max_memory = 100 * 1024 * 1024;
+    Runtime::Buffer<float> in(max_memory);
+    in.fill(17.0f);
+
+    auto callable = g.compile_to_callable({inner_iterations, outer_iterations, memory_limit, input});
+
+    const int native_threads = Halide::Internal::JITSharedRuntime::get_num_threads();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < native_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(native_threads);
+
+    printf("memory_bound inner outer");
+    for (int t : thread_counts) {
+        printf(" ns_per_iter@%d", t);
+    }
+    printf(" speedup@%d\n", native_threads);
+
+    for (bool memory_bound : {false, true}) {
+        const int limit = memory_bound ? max_memory : 128;
+        for (int i : {1 << 6, 1 << 9, 1 << 12}) {
+            for (int o : {1, 8, 64, 256}) {
+                std::vector<double> times;
+                for (int t : thread_counts) {
+                    Halide::Internal::JITSharedRuntime::set_num_threads(t);
+                    double time = benchmark(3, 10, [&]() {
+                        (void)callable(i, o, limit, in, out);
+                    });
+                    times.push_back(time);
+                }
+                printf("%d %d %d", memory_bound, i, o);
+                for (double time : times) {
+                    printf(" %g", 1e9 * time / (i * o));
+                }
+                printf(" %g\n", times.front() / times.back());
+            }
+        }
+    }
+
+    Halide::Internal::JITSharedRuntime::set_num_threads(native_threads);
+
+    printf("Success!\n");
+    return 0;
+}
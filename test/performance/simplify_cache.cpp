@@ -0,0 +1,122 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+
+#include <cstdio>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Measures how long it takes to lower a few pipelines with the simplifier
+// memoizing the Exprs it simplifies and without, and how often it finds them
+// in its cache.
+
+namespace {
+
+class SimplifyCacheStats : public Internal::JSONCompilerLogger {
+public:
+    uint64_t hits() const {
+        return simplify_cache_hits;
+    }
+    uint64_t misses() const {
+        return simplify_cache_misses;
+    }
+};
+
+Func blur(ImageParam input) {
+    Func clamped("clamped"), blur_x("blur_x"), blur_y("blur_y");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    clamped = BoundaryConditions::repeat_edge(input);
+    blur_x(x, y) = (clamped(x - 1, y) + clamped(x, y) * 2 + clamped(x + 1, y)) / 4;
+    blur_y(x, y) = (blur_x(x, y - 1) + blur_x(x, y) * 2 + blur_x(x, y + 1)) / 4;
+
+    blur_y.tile(x, y, xi, yi, 64, 32).vectorize(xi, 8).parallel(y);
+    blur_x.compute_at(blur_y, x).vectorize(x, 8);
+    return blur_y;
+}
+
+Func many_stages(ImageParam input) {
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+    Func prev = BoundaryConditions::mirror_image(input);
+    std::vector<Func> stages;
+    for (int i = 0; i < 24; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = (prev(x - 1, y + (i % 3) - 1) + prev(x + 1, y) * (i + 1) + prev(x, y - 1)) / (i + 3);
+        stages.push_back(f);
+        prev = f;
+    }
+    Func out = stages.back();
+    out.tile(x, y, xi, yi, 32, 32).vectorize(xi, 8).parallel(y);
+    for (size_t i = 0; i + 1 < stages.size(); i++) {
+        if (i % 4 == 3) {
+            stages[i].compute_root().vectorize(x, 8).parallel(y);
+        } else if (i % 2 == 1) {
+            // Computed inside the next stage that is computed at root.
+            const size_t root = i - i % 4 + 3;
+            if (root + 1 < stages.size()) {
+                stages[i].compute_at(stages[root], x).vectorize(x, 8);
+            } else {
+                stages[i].compute_at(out, x).vectorize(x, 8);
+            }
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    target = target.without_feature(Target::JIT);
+
+    printf("pipeline cache_size ms_lowering hits misses\n");
+
+    struct {
+        const char *name;
+        Func (*make)(ImageParam);
+    } pipelines[] = {
+        {"blur", blur},
+        {"many_stages", many_stages},
+    };
+
+    const size_t default_size = Internal::simplify_cache_size();
+    const size_t cache_size = default_size ? default_size : 16384;
+    for (const auto &p : pipelines) {
+        for (size_t size : {(size_t)0, cache_size}) {
+            Internal::set_simplify_cache_size(size);
+            double time = 0;
+            uint64_t hits = 0, misses = 0;
+            const int reps = 3;
+            for (int r = 0; r < reps; r++) {
+                ImageParam input(Float(32), 2, "input");
+                Func out = p.make(input);
+                Internal::set_compiler_logger(std::make_unique<SimplifyCacheStats>());
+                time += benchmark(1, 1, [&]() {
+                    out.compile_to_module({input}, p.name, target);
+                });
+                auto logger = Internal::set_compiler_logger(nullptr);
+                auto *stats = static_cast<SimplifyCacheStats *>(logger.get());
+                hits += stats->hits();
+                misses += stats->misses();
+            }
+            printf("%s %d %g %llu %llu\n", p.name, (int)size, 1e3 * time / reps,
+                   (unsigned long long)(hits / reps), (unsigned long long)(misses / reps));
+
+            if (size == 0 && hits + misses != 0) {
+                printf("The simplifier used its cache while it was turned off\n");
+                return 1;
+            }
+            if (size != 0 && hits == 0) {
+                printf("The simplifier never found an Expr in its cache\n");
+                return 1;
+            }
+        }
+    }
+    Internal::set_simplify_cache_size(default_size);
+
+    printf("Success!\n");
+    return 0;
+}